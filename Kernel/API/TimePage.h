@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Types.h>
+
+// The kernel maps this page read-only into every process (its address is passed in the AT_TIME_PAGE
+// auxiliary vector entry), and updates it on every timer tick, so that LibC can read the clocks
+// without entering the kernel.
+//
+// The fields between update1 and update2 are protected by a sequence lock. The kernel increments
+// update1 before changing them, and stores the same value into update2 once it's done. Readers load
+// update2 first, then read the fields, and then (after an acquire fence) load update1. If update1
+// doesn't match the update2 they started with, an update was in progress and they have to try again.
+struct TimePage {
+    u32 update1;
+
+    // CLOCK_MONOTONIC_COARSE and CLOCK_REALTIME as of the last update.
+    i64 monotonic_seconds;
+    u32 monotonic_nanoseconds;
+    i64 epoch_seconds;
+    u32 epoch_nanoseconds;
+
+    // If counter_frequency is non-zero, the kernel keeps time with a free-running counter that is
+    // mapped read-only at counter_offset bytes past the start of this page, and counter_at_update
+    // holds its value at the time of the last update. Counters narrower than 64 bits wrap around
+    // according to counter_mask.
+    u64 counter_at_update;
+    u64 counter_frequency;
+    u64 counter_mask;
+    u32 counter_offset;
+
+    u32 update2;
+};
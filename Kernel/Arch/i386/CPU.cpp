@@ -1793,6 +1793,14 @@ void Processor::check_invoke_scheduler()
 
 void Processor::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
 {
+    // Past a certain size, reloading CR3 is cheaper than invalidating each page.
+    // This only drops non-global entries, so it's not an option for kernel mappings.
+    static constexpr size_t max_individual_user_page_flushes = 32;
+    if (page_count > max_individual_user_page_flushes && is_user_range(vaddr, page_count * PAGE_SIZE)) {
+        flush_entire_tlb_local();
+        return;
+    }
+
     auto ptr = vaddr.as_ptr();
     while (page_count > 0) {
         // clang-format off
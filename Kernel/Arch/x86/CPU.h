@@ -732,6 +732,11 @@ public:
         return *m_mm_data;
     }
 
+    ALWAYS_INLINE bool has_mm_data() const
+    {
+        return m_mm_data != nullptr;
+    }
+
     ALWAYS_INLINE Thread* idle_thread() const
     {
         return m_idle_thread;
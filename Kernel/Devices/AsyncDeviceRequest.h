@@ -80,6 +80,8 @@ public:
 
     [[nodiscard]] RequestWaitResult wait(Time* = nullptr);
 
+    bool is_completed() const { return is_completed_result(get_request_result()); }
+
     void do_start(ScopedSpinLock<SpinLock<u8>>&& requests_lock)
     {
         if (is_completed_result(m_result))
@@ -90,6 +92,13 @@ public:
         start();
     }
 
+    // For requests that are carried out as part of another request, and thus never start on their own.
+    void mark_as_started()
+    {
+        VERIFY(m_result == Pending);
+        m_result = Started;
+    }
+
     void complete(RequestResult result);
 
     void set_private(void* priv)
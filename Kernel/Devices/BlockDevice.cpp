@@ -48,6 +48,16 @@ BlockDevice::~BlockDevice()
 {
 }
 
+void BlockDevice::queue_request(NonnullRefPtr<AsyncDeviceRequest> request)
+{
+    m_io_scheduler.queue_request(static_ptr_cast<AsyncBlockDeviceRequest>(request));
+}
+
+void BlockDevice::finish_request(const AsyncDeviceRequest& request)
+{
+    m_io_scheduler.finish_request(static_cast<const AsyncBlockDeviceRequest&>(request));
+}
+
 bool BlockDevice::read_block(u64 index, UserOrKernelBuffer& buffer)
 {
     auto read_request = make_request<AsyncBlockDeviceRequest>(AsyncBlockDeviceRequest::Read, index, 1, buffer, 512);
@@ -26,13 +26,17 @@
 
 #pragma once
 
+#include <AK/Time.h>
 #include <Kernel/Devices/Device.h>
+#include <Kernel/Devices/IOScheduler.h>
 
 namespace Kernel {
 
 class BlockDevice;
 
 class AsyncBlockDeviceRequest : public AsyncDeviceRequest {
+    friend class IOScheduler;
+
 public:
     enum RequestType {
         Read,
@@ -68,6 +72,15 @@ private:
     const u32 m_block_count;
     UserOrKernelBuffer m_buffer;
     const size_t m_buffer_size;
+
+    // Bookkeeping for the IOScheduler.
+    u64 m_sequence_number { 0 };
+    Time m_queue_time;
+    Time m_deadline;
+    // Set on requests that the scheduler carries out as part of a larger request of its own.
+    bool m_is_merged { false };
+    NonnullRefPtrVector<AsyncBlockDeviceRequest> m_merged_requests;
+    u8* m_merge_buffer { nullptr };
 };
 
 class BlockDevice : public Device {
@@ -82,17 +95,30 @@ public:
 
     virtual void start_request(AsyncBlockDeviceRequest&) = 0;
 
+    // PATAChannel will chuck a wobbly if we try to transfer more than PAGE_SIZE
+    // at a time, because it uses a single page for its DMA buffer.
+    virtual size_t max_blocks_per_request() const { return PAGE_SIZE / block_size(); }
+
+    IOScheduler& io_scheduler() { return m_io_scheduler; }
+    const IOScheduler& io_scheduler() const { return m_io_scheduler; }
+
 protected:
     BlockDevice(unsigned major, unsigned minor, size_t block_size = PAGE_SIZE)
         : Device(major, minor)
         , m_block_size(block_size)
+        , m_io_scheduler(*this)
     {
     }
 
+    // ^Device
+    virtual void queue_request(NonnullRefPtr<AsyncDeviceRequest>) override;
+    virtual void finish_request(const AsyncDeviceRequest&) override;
+
 private:
     virtual bool is_block_device() const final { return true; }
 
     size_t m_block_size { 0 };
+    IOScheduler m_io_scheduler;
 };
 
 }
@@ -81,17 +81,41 @@ String Device::absolute_path(const FileDescription&) const
 }
 
 void Device::process_next_queued_request(Badge<AsyncDeviceRequest>, const AsyncDeviceRequest& completed_request)
+{
+    finish_request(completed_request);
+    evaluate_block_conditions();
+}
+
+void Device::queue_request(NonnullRefPtr<AsyncDeviceRequest> request)
 {
     ScopedSpinLock lock(m_requests_lock);
-    VERIFY(!m_requests.is_empty());
-    VERIFY(m_requests.first().ptr() == &completed_request);
-    m_requests.remove(m_requests.begin());
-    if (!m_requests.is_empty()) {
-        auto* next_request = m_requests.first().ptr();
-        next_request->do_start(move(lock));
+    m_requests.append(request);
+    if (m_requests_in_flight < max_requests_in_flight()) {
+        ++m_requests_in_flight;
+        request->do_start(move(lock));
     }
+}
 
-    evaluate_block_conditions();
+void Device::finish_request(const AsyncDeviceRequest& completed_request)
+{
+    ScopedSpinLock lock(m_requests_lock);
+    VERIFY(m_requests_in_flight > 0);
+    auto it = m_requests.begin();
+    while (it != m_requests.end() && (*it).ptr() != &completed_request)
+        ++it;
+    VERIFY(it != m_requests.end());
+    m_requests.remove(it);
+    --m_requests_in_flight;
+
+    // Requests are started in order, so the ones in flight are always at the front of the queue.
+    auto next = m_requests.begin();
+    for (size_t i = 0; i < m_requests_in_flight && next != m_requests.end(); ++i)
+        ++next;
+    if (next != m_requests.end()) {
+        ++m_requests_in_flight;
+        auto* next_request = (*next).ptr();
+        next_request->do_start(move(lock));
+    }
 }
 
 }
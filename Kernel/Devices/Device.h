@@ -72,19 +72,24 @@ public:
     NonnullRefPtr<AsyncRequestType> make_request(Args&&... args)
     {
         auto request = adopt(*new AsyncRequestType(*this, forward<Args>(args)...));
-        ScopedSpinLock lock(m_requests_lock);
-        bool was_empty = m_requests.is_empty();
-        m_requests.append(request);
-        if (was_empty)
-            request->do_start(move(lock));
+        queue_request(request);
         return request;
     }
 
+    // How many requests the driver is willing to have started at the same time.
+    // Requests may complete in any order.
+    virtual size_t max_requests_in_flight() const { return 1; }
+
 protected:
     Device(unsigned major, unsigned minor);
     void set_uid(uid_t uid) { m_uid = uid; }
     void set_gid(gid_t gid) { m_gid = gid; }
 
+    // These decide when queued requests are started. By default, requests are
+    // started in the order they were made.
+    virtual void queue_request(NonnullRefPtr<AsyncDeviceRequest>);
+    virtual void finish_request(const AsyncDeviceRequest&);
+
     static HashMap<u32, Device*>& all_devices();
 
 private:
@@ -95,6 +100,7 @@ private:
 
     SpinLock<u8> m_requests_lock;
     DoublyLinkedList<RefPtr<AsyncDeviceRequest>> m_requests;
+    size_t m_requests_in_flight { 0 };
 };
 
 }
@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Debug.h>
+#include <Kernel/Devices/BlockDevice.h>
+#include <Kernel/Devices/IOScheduler.h>
+#include <Kernel/Time/TimeManagement.h>
+#include <Kernel/VM/MemoryManager.h>
+
+namespace Kernel {
+
+IOScheduler::IOScheduler(BlockDevice& device)
+    : m_device(device)
+{
+}
+
+IOScheduler::~IOScheduler()
+{
+}
+
+void IOScheduler::enable_request_merging()
+{
+    VERIFY(!m_merge_buffers_region);
+    m_merge_buffers_region = MM.allocate_kernel_region(merge_buffer_size * merge_buffer_count, "IOScheduler merge buffers", Region::Access::Read | Region::Access::Write, AllocationStrategy::AllocateNow);
+    if (!m_merge_buffers_region) {
+        dmesgln("IOScheduler: Couldn't allocate merge buffers, requests won't be merged");
+        return;
+    }
+    ScopedSpinLock lock(m_lock);
+    for (size_t i = 0; i < merge_buffer_count; i++)
+        m_free_merge_buffers.append(m_merge_buffers_region->vaddr().offset(i * merge_buffer_size).as_ptr());
+}
+
+void IOScheduler::queue_request(NonnullRefPtr<AsyncBlockDeviceRequest> request)
+{
+    auto now = TimeManagement::the().monotonic_time();
+    auto direction = request->request_type() == AsyncBlockDeviceRequest::Read ? Read : Write;
+
+    ScopedSpinLock lock(m_lock);
+    request->m_sequence_number = m_next_sequence_number++;
+    request->m_queue_time = now;
+    request->m_deadline = now + Time::from_milliseconds(direction == Read ? read_expire_ms : write_expire_ms);
+
+    // Requests mostly arrive in ascending order, so look for the insertion point from the back.
+    auto& queue = m_queues[direction];
+    size_t index = queue.size();
+    while (index > 0 && queue[index - 1].block_index() > request->block_index())
+        --index;
+    queue.insert(index, move(request));
+
+    size_t queue_depth = m_queues[Read].size() + m_queues[Write].size() + m_requests_in_flight.size();
+    m_statistics.max_queue_depth = max(m_statistics.max_queue_depth, queue_depth);
+
+    start_next_request(move(lock));
+}
+
+void IOScheduler::finish_request(const AsyncBlockDeviceRequest& request)
+{
+    // Requests that were merged into another one are accounted for when that one finishes.
+    if (request.m_is_merged)
+        return;
+
+    ScopedSpinLock lock(m_lock);
+    Optional<size_t> index;
+    for (size_t i = 0; i < m_requests_in_flight.size(); i++) {
+        if (&m_requests_in_flight[i] == &request) {
+            index = i;
+            break;
+        }
+    }
+    VERIFY(index.has_value());
+    auto finished_request = m_requests_in_flight.take(index.value());
+    lock.unlock();
+
+    if (finished_request->m_merged_requests.is_empty())
+        account_completion(*finished_request);
+    else
+        complete_merged_requests(*finished_request);
+
+    lock.lock();
+    start_next_request(move(lock));
+}
+
+void IOScheduler::start_next_request(ScopedSpinLock<SpinLock<u8>>&& lock)
+{
+    VERIFY(m_lock.is_locked());
+    if (m_requests_in_flight.size() >= m_device.max_requests_in_flight())
+        return;
+    auto request = take_next_request();
+    if (!request)
+        return;
+    m_requests_in_flight.append(*request);
+    ++m_statistics.dispatched_requests;
+
+    if (request->m_merged_requests.is_empty()) {
+        request->do_start(move(lock));
+        return;
+    }
+
+    for (auto& merged_request : request->m_merged_requests)
+        merged_request.mark_as_started();
+    request->mark_as_started();
+    lock.unlock();
+
+    if (request->request_type() == AsyncBlockDeviceRequest::Write) {
+        size_t offset = 0;
+        for (auto& merged_request : request->m_merged_requests) {
+            size_t size = merged_request.block_count() * m_device.block_size();
+            if (!merged_request.read_from_buffer(merged_request.buffer(), request->m_merge_buffer + offset, size)) {
+                // FIXME: Only fail the request with the bad buffer.
+                request->complete(AsyncDeviceRequest::MemoryFault);
+                return;
+            }
+            offset += size;
+        }
+    }
+    dbgln_if(IO_SCHEDULER_DEBUG, "IOScheduler: Starting {} merged requests for blocks {}-{}", request->m_merged_requests.size(), request->block_index(), request->block_index() + request->block_count() - 1);
+    request->start();
+}
+
+RefPtr<AsyncBlockDeviceRequest> IOScheduler::take_next_request()
+{
+    if (m_queues[Read].is_empty() && m_queues[Write].is_empty())
+        return {};
+
+    auto now = TimeManagement::the().monotonic_time();
+    auto direction = select_direction(now);
+    auto index = select_request_index(direction, now);
+
+    // A request must never overtake an earlier one for overlapping blocks in the other direction.
+    for (;;) {
+        auto other_direction = direction == Read ? Write : Read;
+        auto conflicting_index = find_earlier_conflicting_request(m_queues[direction][index], other_direction);
+        if (!conflicting_index.has_value())
+            break;
+        direction = other_direction;
+        index = conflicting_index.value();
+    }
+
+    if (direction != m_direction) {
+        m_direction = direction;
+        m_batch_size = 0;
+    }
+    ++m_batch_size;
+
+    auto request = merge_adjacent_requests(direction, index);
+    m_next_block_index = request->block_index() + request->block_count();
+    return request;
+}
+
+bool IOScheduler::has_expired_request(Direction direction, const Time& now) const
+{
+    auto oldest_index = find_oldest_request(direction);
+    return oldest_index.has_value() && m_queues[direction][oldest_index.value()].m_deadline <= now;
+}
+
+Optional<size_t> IOScheduler::find_oldest_request(Direction direction) const
+{
+    auto& queue = m_queues[direction];
+    if (queue.is_empty())
+        return {};
+    size_t oldest_index = 0;
+    for (size_t i = 1; i < queue.size(); i++) {
+        if (queue[i].m_sequence_number < queue[oldest_index].m_sequence_number)
+            oldest_index = i;
+    }
+    return oldest_index;
+}
+
+IOScheduler::Direction IOScheduler::select_direction(const Time& now)
+{
+    auto other_direction = m_direction == Read ? Write : Read;
+    if (!m_queues[m_direction].is_empty() && m_batch_size < max_batch_size && !has_expired_request(other_direction, now))
+        return m_direction;
+
+    m_batch_size = 0;
+    bool has_reads = !m_queues[Read].is_empty();
+    bool has_writes = !m_queues[Write].is_empty();
+    if (has_writes && (!has_reads || m_starved_write_batches >= max_starved_write_batches || has_expired_request(Write, now))) {
+        m_starved_write_batches = 0;
+        return Write;
+    }
+    if (has_writes)
+        ++m_starved_write_batches;
+    return Read;
+}
+
+size_t IOScheduler::select_request_index(Direction direction, const Time& now)
+{
+    auto& queue = m_queues[direction];
+    VERIFY(!queue.is_empty());
+
+    auto oldest_index = find_oldest_request(direction).value();
+    if (queue[oldest_index].m_deadline <= now) {
+        ++m_statistics.expired_requests;
+        return oldest_index;
+    }
+
+    // Sweep across the disk in ascending order, and start over from the lowest block once we reach the end.
+    for (size_t i = 0; i < queue.size(); i++) {
+        if (queue[i].block_index() >= m_next_block_index)
+            return i;
+    }
+    return 0;
+}
+
+Optional<size_t> IOScheduler::find_earlier_conflicting_request(const AsyncBlockDeviceRequest& request, Direction direction) const
+{
+    auto& queue = m_queues[direction];
+    Optional<size_t> conflicting_index;
+    u64 end = request.block_index() + request.block_count();
+    for (size_t i = 0; i < queue.size(); i++) {
+        auto& other_request = queue[i];
+        if (other_request.block_index() >= end)
+            break;
+        if (other_request.m_sequence_number > request.m_sequence_number)
+            continue;
+        if (other_request.block_index() + other_request.block_count() <= request.block_index())
+            continue;
+        if (!conflicting_index.has_value() || other_request.m_sequence_number < queue[conflicting_index.value()].m_sequence_number)
+            conflicting_index = i;
+    }
+    return conflicting_index;
+}
+
+NonnullRefPtr<AsyncBlockDeviceRequest> IOScheduler::merge_adjacent_requests(Direction direction, size_t index)
+{
+    auto& queue = m_queues[direction];
+    auto other_direction = direction == Read ? Write : Read;
+    auto can_merge = [&](const AsyncBlockDeviceRequest& request) {
+        return request.buffer_size() >= request.block_count() * m_device.block_size()
+            && !find_earlier_conflicting_request(request, other_direction).has_value();
+    };
+    if (m_free_merge_buffers.is_empty() || !can_merge(queue[index]))
+        return queue.take(index);
+
+    size_t max_block_count = min(m_device.max_blocks_per_request(), merge_buffer_size / m_device.block_size());
+    size_t first_index = index;
+    size_t last_index = index;
+    u64 block_count = queue[index].block_count();
+    while (first_index > 0) {
+        auto& request = queue[first_index - 1];
+        if (request.block_index() + request.block_count() != queue[first_index].block_index())
+            break;
+        if (block_count + request.block_count() > max_block_count || !can_merge(request))
+            break;
+        block_count += request.block_count();
+        --first_index;
+    }
+    while (last_index + 1 < queue.size()) {
+        auto& request = queue[last_index + 1];
+        if (queue[last_index].block_index() + queue[last_index].block_count() != request.block_index())
+            break;
+        if (block_count + request.block_count() > max_block_count || !can_merge(request))
+            break;
+        block_count += request.block_count();
+        ++last_index;
+    }
+    if (first_index == last_index)
+        return queue.take(index);
+
+    auto* merge_buffer = m_free_merge_buffers.take_last();
+    auto merged_request = adopt(*new AsyncBlockDeviceRequest(m_device, queue[first_index].request_type(), queue[first_index].block_index(), block_count, UserOrKernelBuffer::for_kernel_buffer(merge_buffer), block_count * m_device.block_size()));
+    merged_request->m_merge_buffer = merge_buffer;
+    for (size_t i = first_index; i <= last_index; i++) {
+        auto request = queue.take(first_index);
+        request->m_is_merged = true;
+        merged_request->m_merged_requests.append(move(request));
+    }
+    m_statistics.merged_requests += merged_request->m_merged_requests.size();
+    return merged_request;
+}
+
+void IOScheduler::complete_merged_requests(AsyncBlockDeviceRequest& request)
+{
+    auto result = request.get_request_result();
+    size_t offset = 0;
+    for (auto& merged_request : request.m_merged_requests) {
+        size_t size = merged_request.block_count() * m_device.block_size();
+        auto merged_result = result;
+        if (result == AsyncDeviceRequest::Success && request.request_type() == AsyncBlockDeviceRequest::Read) {
+            if (!merged_request.write_to_buffer(merged_request.buffer(), request.m_merge_buffer + offset, size))
+                merged_result = AsyncDeviceRequest::MemoryFault;
+        }
+        offset += size;
+        account_completion(merged_request);
+        merged_request.complete(merged_result);
+    }
+
+    ScopedSpinLock lock(m_lock);
+    m_free_merge_buffers.append(request.m_merge_buffer);
+}
+
+void IOScheduler::account_completion(const AsyncBlockDeviceRequest& request)
+{
+    auto latency = TimeManagement::the().monotonic_time() - request.m_queue_time;
+    u64 latency_us = max<i64>(latency.to_microseconds(), 0);
+
+    ScopedSpinLock lock(m_lock);
+    if (request.request_type() == AsyncBlockDeviceRequest::Read)
+        ++m_statistics.completed_reads;
+    else
+        ++m_statistics.completed_writes;
+    m_statistics.total_latency_us += latency_us;
+    m_statistics.max_latency_us = max(m_statistics.max_latency_us, latency_us);
+}
+
+IOScheduler::Statistics IOScheduler::statistics() const
+{
+    ScopedSpinLock lock(m_lock);
+    auto statistics = m_statistics;
+    statistics.queued_requests = m_queues[Read].size() + m_queues[Write].size();
+    statistics.requests_in_flight = m_requests_in_flight.size();
+    return statistics;
+}
+
+}
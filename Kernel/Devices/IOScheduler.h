@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/NonnullRefPtrVector.h>
+#include <AK/Optional.h>
+#include <AK/OwnPtr.h>
+#include <AK/Time.h>
+#include <AK/Vector.h>
+#include <Kernel/SpinLock.h>
+
+namespace Kernel {
+
+class AsyncBlockDeviceRequest;
+class BlockDevice;
+class Region;
+
+// IOScheduler decides the order in which the requests queued on a BlockDevice are started.
+//
+// It is a deadline elevator: requests are sorted by block index and served in
+// ascending order in batches per direction, with reads preferred over writes.
+// Every request also gets a deadline, and a request that is overdue is served
+// next, so no process can be starved by a stream of requests elsewhere on the disk.
+//
+// Requests for adjacent blocks in the same direction are merged into a single
+// larger request, which transfers through a bounce buffer owned by the scheduler.
+class IOScheduler {
+    AK_MAKE_NONCOPYABLE(IOScheduler);
+    AK_MAKE_NONMOVABLE(IOScheduler);
+
+public:
+    explicit IOScheduler(BlockDevice&);
+    ~IOScheduler();
+
+    // Only devices that benefit from larger transfers should pay for the bounce buffers.
+    void enable_request_merging();
+
+    void queue_request(NonnullRefPtr<AsyncBlockDeviceRequest>);
+    void finish_request(const AsyncBlockDeviceRequest&);
+
+    struct Statistics {
+        size_t queued_requests { 0 };
+        size_t requests_in_flight { 0 };
+        size_t max_queue_depth { 0 };
+        u64 dispatched_requests { 0 };
+        u64 merged_requests { 0 };
+        u64 expired_requests { 0 };
+        u64 completed_reads { 0 };
+        u64 completed_writes { 0 };
+        u64 total_latency_us { 0 };
+        u64 max_latency_us { 0 };
+    };
+    Statistics statistics() const;
+
+private:
+    enum Direction {
+        Read = 0,
+        Write = 1,
+    };
+
+    void start_next_request(ScopedSpinLock<SpinLock<u8>>&&);
+    RefPtr<AsyncBlockDeviceRequest> take_next_request();
+    Direction select_direction(const Time& now);
+    size_t select_request_index(Direction, const Time& now);
+    Optional<size_t> find_oldest_request(Direction) const;
+    bool has_expired_request(Direction, const Time& now) const;
+    Optional<size_t> find_earlier_conflicting_request(const AsyncBlockDeviceRequest&, Direction) const;
+    NonnullRefPtr<AsyncBlockDeviceRequest> merge_adjacent_requests(Direction, size_t index);
+    void complete_merged_requests(AsyncBlockDeviceRequest&);
+    void account_completion(const AsyncBlockDeviceRequest&);
+
+    // Same as the defaults of the Linux deadline scheduler.
+    static constexpr i64 read_expire_ms = 500;
+    static constexpr i64 write_expire_ms = 5000;
+    static constexpr size_t max_batch_size = 16;
+    static constexpr size_t max_starved_write_batches = 2;
+
+    static constexpr size_t merge_buffer_size = 64 * KiB;
+    static constexpr size_t merge_buffer_count = 4;
+
+    BlockDevice& m_device;
+    mutable SpinLock<u8> m_lock;
+
+    // Sorted by block index, with requests for the same blocks in the order they were made.
+    NonnullRefPtrVector<AsyncBlockDeviceRequest> m_queues[2];
+    NonnullRefPtrVector<AsyncBlockDeviceRequest> m_requests_in_flight;
+
+    u64 m_next_sequence_number { 0 };
+    Direction m_direction { Read };
+    u64 m_next_block_index { 0 };
+    size_t m_batch_size { 0 };
+    size_t m_starved_write_batches { 0 };
+
+    OwnPtr<Region> m_merge_buffers_region;
+    Vector<u8*, merge_buffer_count> m_free_merge_buffers;
+
+    Statistics m_statistics;
+};
+
+}
@@ -25,9 +25,13 @@
  */
 
 #include <AK/IntrusiveList.h>
+#include <AK/NonnullOwnPtrVector.h>
+#include <AK/QuickSort.h>
 #include <Kernel/Debug.h>
+#include <Kernel/Devices/BlockDevice.h>
 #include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/Process.h>
+#include <Kernel/VM/MemoryManager.h>
 
 namespace Kernel {
 
@@ -36,42 +40,105 @@ struct CacheEntry {
     BlockBasedFS::BlockIndex block_index { 0 };
     u8* data { nullptr };
     bool has_data { false };
+    bool is_dirty { false };
+    bool is_hashed { false };
 };
 
+class DiskCacheChunk {
+    AK_MAKE_NONCOPYABLE(DiskCacheChunk);
+    AK_MAKE_NONMOVABLE(DiskCacheChunk);
+
+public:
+    static OwnPtr<DiskCacheChunk> try_create(size_t entry_count, size_t block_size)
+    {
+        auto cached_block_data = KBuffer::try_create_with_size(entry_count * block_size, Region::Access::Read | Region::Access::Write, "DiskCache");
+        if (!cached_block_data)
+            return {};
+        auto entries = KBuffer::try_create_with_size(entry_count * sizeof(CacheEntry), Region::Access::Read | Region::Access::Write, "DiskCache entries");
+        if (!entries)
+            return {};
+        return adopt_own(*new DiskCacheChunk(entry_count, block_size, cached_block_data.release_nonnull(), entries.release_nonnull()));
+    }
+
+    size_t entry_count() const { return m_entry_count; }
+    CacheEntry& entry(size_t index) { return ((CacheEntry*)m_entries->data())[index]; }
+
+private:
+    DiskCacheChunk(size_t entry_count, size_t block_size, NonnullOwnPtr<KBuffer>&& cached_block_data, NonnullOwnPtr<KBuffer>&& entries)
+        : m_entry_count(entry_count)
+        , m_cached_block_data(move(cached_block_data))
+        , m_entries(move(entries))
+    {
+        for (size_t i = 0; i < m_entry_count; ++i)
+            entry(i).data = m_cached_block_data->data() + i * block_size;
+    }
+
+    size_t m_entry_count { 0 };
+    NonnullOwnPtr<KBuffer> m_cached_block_data;
+    NonnullOwnPtr<KBuffer> m_entries;
+};
+
+// A run of blocks being read from the device into a buffer of its own. The FS lock
+// isn't held while the device is busy; whoever waits for the run first after it's
+// done copies the blocks into the cache.
+class ReadAheadRun : public RefCounted<ReadAheadRun> {
+public:
+    ReadAheadRun(BlockBasedFS::BlockIndex first_block, size_t block_count, NonnullOwnPtr<KBuffer>&& buffer)
+        : first_block(first_block)
+        , block_count(block_count)
+        , buffer(move(buffer))
+    {
+    }
+
+    bool is_completed() const
+    {
+        for (auto& request : requests) {
+            if (!request.is_completed())
+                return false;
+        }
+        return true;
+    }
+
+    const BlockBasedFS::BlockIndex first_block;
+    const size_t block_count;
+    NonnullOwnPtr<KBuffer> buffer;
+    NonnullRefPtrVector<AsyncBlockDeviceRequest> requests;
+    bool is_finished { false };
+    bool was_interrupted { false };
+};
+
+// The DiskCache grows one chunk at a time while there's plenty of uncommitted
+// physical memory around, and gives chunks back when memory gets tight.
 class DiskCache {
 public:
+    static constexpr size_t entries_per_chunk = 1024;
+
     explicit DiskCache(BlockBasedFS& fs)
         : m_fs(fs)
-        , m_cached_block_data(KBuffer::create_with_size(m_entry_count * m_fs.block_size()))
-        , m_entries(KBuffer::create_with_size(m_entry_count * sizeof(CacheEntry)))
     {
-        for (size_t i = 0; i < m_entry_count; ++i) {
-            entries()[i].data = m_cached_block_data.data() + i * m_fs.block_size();
-            m_clean_list.append(entries()[i]);
-        }
+        bool did_grow = try_grow();
+        VERIFY(did_grow);
     }
 
     ~DiskCache() = default;
 
     bool is_dirty() const { return m_dirty; }
-    void set_dirty(bool b) { m_dirty = b; }
 
-    void mark_all_clean()
-    {
-        while (auto* entry = m_dirty_list.first())
-            m_clean_list.prepend(*entry);
-        m_dirty = false;
-    }
+    size_t entry_count() const { return m_chunks.size() * entries_per_chunk; }
 
     void mark_dirty(CacheEntry& entry)
     {
+        entry.is_dirty = true;
         m_dirty_list.prepend(entry);
         m_dirty = true;
     }
 
     void mark_clean(CacheEntry& entry)
     {
+        entry.is_dirty = false;
         m_clean_list.prepend(entry);
+        if (m_dirty_list.is_empty())
+            m_dirty = false;
     }
 
     CacheEntry& get(BlockBasedFS::BlockIndex block_index) const
@@ -79,32 +146,100 @@ public:
         if (auto it = m_hash.find(block_index); it != m_hash.end()) {
             auto& entry = const_cast<CacheEntry&>(*it->value);
             VERIFY(entry.block_index == block_index);
+            // Keep the clean list in least recently used order.
+            if (!entry.is_dirty)
+                m_clean_list.prepend(entry);
             return entry;
         }
 
         if (m_clean_list.is_empty()) {
-            // Not a single clean entry! Flush writes and try again.
-            // NOTE: We want to make sure we only call FileBackedFS flush here,
-            //       not some FileBackedFS subclass flush!
-            m_fs.flush_writes_impl();
-            return get(block_index);
+            // Not a single clean entry! Rather than stalling on a flush of
+            // every dirty block, see if we can afford to grow the cache,
+            // and otherwise write back only the oldest dirty block.
+            // The rest is left for the SyncTask to deal with.
+            auto& self = const_cast<DiskCache&>(*this);
+            if (!self.try_grow()) {
+                auto& oldest_dirty_entry = *m_dirty_list.last();
+                auto result = m_fs.write_back_cached_block(oldest_dirty_entry.block_index, oldest_dirty_entry.data);
+                // We need the entry either way, and there's nobody to hand the error to.
+                if (result.is_error())
+                    dbgln("BlockBasedFileSystem: Failed to write back block {} to make room in the cache: {}", oldest_dirty_entry.block_index, result.error());
+                self.mark_clean(oldest_dirty_entry);
+            }
         }
 
         VERIFY(m_clean_list.last());
         auto& new_entry = *m_clean_list.last();
         m_clean_list.prepend(new_entry);
 
-        m_hash.remove(new_entry.block_index);
+        if (new_entry.is_hashed)
+            m_hash.remove(new_entry.block_index);
         m_hash.set(block_index, &new_entry);
 
         new_entry.block_index = block_index;
         new_entry.has_data = false;
+        new_entry.is_hashed = true;
 
         return new_entry;
     }
 
-    const CacheEntry* entries() const { return (const CacheEntry*)m_entries.data(); }
-    CacheEntry* entries() { return (CacheEntry*)m_entries.data(); }
+    bool has_data(BlockBasedFS::BlockIndex block_index) const
+    {
+        auto it = m_hash.find(block_index);
+        return it != m_hash.end() && it->value->has_data;
+    }
+
+    void invalidate(BlockBasedFS::BlockIndex block_index)
+    {
+        // Whatever a read-ahead brings in for this block is outdated now.
+        m_read_ahead_runs.remove(block_index);
+        auto it = m_hash.find(block_index);
+        if (it == m_hash.end())
+            return;
+        auto& entry = *it->value;
+        if (entry.is_dirty)
+            return;
+        // Move the entry to the end of the clean list so it gets reused first.
+        m_hash.remove(it);
+        entry.is_hashed = false;
+        entry.has_data = false;
+        m_clean_list.append(entry);
+    }
+
+    RefPtr<ReadAheadRun> read_ahead_run(BlockBasedFS::BlockIndex block_index) const
+    {
+        auto it = m_read_ahead_runs.find(block_index);
+        if (it == m_read_ahead_runs.end())
+            return {};
+        return it->value;
+    }
+
+    void add_read_ahead_run(ReadAheadRun& run)
+    {
+        m_interrupted_read_ahead_runs.remove_all_matching([](auto& interrupted_run) { return interrupted_run->is_completed(); });
+        for (size_t i = 0; i < run.block_count; ++i)
+            m_read_ahead_runs.set(BlockBasedFS::BlockIndex { run.first_block.value() + i }, run);
+    }
+
+    // Whoever was waiting for the run got interrupted, so nothing may be holding on to it while the device
+    // is still writing into its buffer, e.g. once all of its blocks have been invalidated.
+    void keep_until_completed(ReadAheadRun& run)
+    {
+        if (run.was_interrupted)
+            return;
+        run.was_interrupted = true;
+        m_interrupted_read_ahead_runs.append(run);
+    }
+
+    // Returns whether the block still expects its data from this run.
+    bool take_read_ahead_block(ReadAheadRun& run, BlockBasedFS::BlockIndex block_index)
+    {
+        auto it = m_read_ahead_runs.find(block_index);
+        if (it == m_read_ahead_runs.end() || it->value.ptr() != &run)
+            return false;
+        m_read_ahead_runs.remove(it);
+        return true;
+    }
 
     template<typename Callback>
     void for_each_dirty_entry(Callback callback)
@@ -113,14 +248,67 @@ public:
             callback(entry);
     }
 
+    bool try_grow()
+    {
+        if (!m_chunks.is_empty() && !has_memory_to_grow())
+            return false;
+        auto chunk = DiskCacheChunk::try_create(entries_per_chunk, m_fs.block_size());
+        if (!chunk)
+            return false;
+        for (size_t i = 0; i < chunk->entry_count(); ++i)
+            m_clean_list.append(chunk->entry(i));
+        m_chunks.append(chunk.release_nonnull());
+        dbgln_if(BBFS_DEBUG, "DiskCache: Grew to {} entries", entry_count());
+        return true;
+    }
+
+    // Gives back every chunk that holds no dirty entries, newest first, for as long as
+    // memory stays tight. The first chunk is never released.
+    void shrink_if_under_memory_pressure()
+    {
+        for (size_t i = m_chunks.size() - 1; i > 0 && MM.is_under_memory_pressure(); --i) {
+            if (!try_release_chunk(m_chunks[i]))
+                continue;
+            m_chunks.remove(i);
+            dbgln_if(BBFS_DEBUG, "DiskCache: Shrunk to {} entries", entry_count());
+        }
+    }
+
 private:
+    size_t pages_per_chunk() const
+    {
+        return ceil_div(entries_per_chunk * (m_fs.block_size() + sizeof(CacheEntry)), static_cast<size_t>(PAGE_SIZE));
+    }
+
+    // We keep a quarter of all user physical memory uncommitted for everyone else.
+    // The MemoryManager tells us to give memory back once less than an eighth is left.
+    bool has_memory_to_grow() const
+    {
+        return MM.user_physical_pages_uncommitted() >= pages_per_chunk() + MM.user_physical_pages() / 4;
+    }
+
+    bool try_release_chunk(DiskCacheChunk& chunk)
+    {
+        for (size_t i = 0; i < chunk.entry_count(); ++i) {
+            if (chunk.entry(i).is_dirty)
+                return false;
+        }
+        for (size_t i = 0; i < chunk.entry_count(); ++i) {
+            auto& entry = chunk.entry(i);
+            if (entry.is_hashed)
+                m_hash.remove(entry.block_index);
+            m_clean_list.remove(entry);
+        }
+        return true;
+    }
+
     BlockBasedFS& m_fs;
-    size_t m_entry_count { 10000 };
     mutable HashMap<BlockBasedFS::BlockIndex, CacheEntry*> m_hash;
     mutable IntrusiveList<CacheEntry, &CacheEntry::list_node> m_clean_list;
     mutable IntrusiveList<CacheEntry, &CacheEntry::list_node> m_dirty_list;
-    KBuffer m_cached_block_data;
-    KBuffer m_entries;
+    NonnullOwnPtrVector<DiskCacheChunk> m_chunks;
+    HashMap<BlockBasedFS::BlockIndex, NonnullRefPtr<ReadAheadRun>> m_read_ahead_runs;
+    NonnullRefPtrVector<ReadAheadRun> m_interrupted_read_ahead_runs;
     bool m_dirty { false };
 };
 
@@ -142,16 +330,12 @@ KResult BlockBasedFS::write_block(BlockIndex index, const UserOrKernelBuffer& da
     dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem::write_block {}, size={}", index, count);
 
     if (!allow_cache) {
-        flush_specific_block_if_needed(index);
-        u32 base_offset = index.value() * block_size() + offset;
-        auto seek_result = file_description().seek(base_offset, SEEK_SET);
-        if (seek_result.is_error())
-            return seek_result.error();
-        auto nwritten = file_description().write(data, count);
-        if (nwritten.is_error())
-            return nwritten.error();
-        VERIFY(nwritten.value() == count);
-        return KSuccess;
+        auto result = flush_specific_block_if_needed(index);
+        if (result.is_error())
+            return result;
+        // Make sure nobody keeps reading the old contents out of the cache.
+        cache().invalidate(index);
+        return write_to_device(index.value() * block_size() + offset, data, count);
     }
 
     auto& entry = cache().get(index);
@@ -169,52 +353,26 @@ KResult BlockBasedFS::write_block(BlockIndex index, const UserOrKernelBuffer& da
     return KSuccess;
 }
 
-bool BlockBasedFS::raw_read(BlockIndex index, UserOrKernelBuffer& buffer)
+KResult BlockBasedFS::raw_read(BlockIndex index, UserOrKernelBuffer& buffer)
 {
-    LOCKER(m_lock);
-    u32 base_offset = index.value() * m_logical_block_size;
-    auto seek_result = file_description().seek(base_offset, SEEK_SET);
-    VERIFY(!seek_result.is_error());
-    auto nread = file_description().read(buffer, m_logical_block_size);
-    VERIFY(!nread.is_error());
-    VERIFY(nread.value() == m_logical_block_size);
-    return true;
+    return raw_read_blocks(index, 1, buffer);
 }
 
-bool BlockBasedFS::raw_write(BlockIndex index, const UserOrKernelBuffer& buffer)
+KResult BlockBasedFS::raw_write(BlockIndex index, const UserOrKernelBuffer& buffer)
 {
-    LOCKER(m_lock);
-    size_t base_offset = index.value() * m_logical_block_size;
-    auto seek_result = file_description().seek(base_offset, SEEK_SET);
-    VERIFY(!seek_result.is_error());
-    auto nwritten = file_description().write(buffer, m_logical_block_size);
-    VERIFY(!nwritten.is_error());
-    VERIFY(nwritten.value() == m_logical_block_size);
-    return true;
+    return raw_write_blocks(index, 1, buffer);
 }
 
-bool BlockBasedFS::raw_read_blocks(BlockIndex index, size_t count, UserOrKernelBuffer& buffer)
+KResult BlockBasedFS::raw_read_blocks(BlockIndex index, size_t count, UserOrKernelBuffer& buffer)
 {
     LOCKER(m_lock);
-    auto current = buffer;
-    for (unsigned block = index.value(); block < (index.value() + count); block++) {
-        if (!raw_read(BlockIndex { block }, current))
-            return false;
-        current = current.offset(logical_block_size());
-    }
-    return true;
+    return read_from_device(index.value() * m_logical_block_size, buffer, count * m_logical_block_size);
 }
 
-bool BlockBasedFS::raw_write_blocks(BlockIndex index, size_t count, const UserOrKernelBuffer& buffer)
+KResult BlockBasedFS::raw_write_blocks(BlockIndex index, size_t count, const UserOrKernelBuffer& buffer)
 {
     LOCKER(m_lock);
-    auto current = buffer;
-    for (unsigned block = index.value(); block < (index.value() + count); block++) {
-        if (!raw_write(block, current))
-            return false;
-        current = current.offset(logical_block_size());
-    }
-    return true;
+    return write_to_device(index.value() * m_logical_block_size, buffer, count * m_logical_block_size);
 }
 
 KResult BlockBasedFS::write_blocks(BlockIndex index, unsigned count, const UserOrKernelBuffer& data, bool allow_cache)
@@ -222,6 +380,15 @@ KResult BlockBasedFS::write_blocks(BlockIndex index, unsigned count, const UserO
     LOCKER(m_lock);
     VERIFY(m_logical_block_size);
     dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem::write_blocks {}, count={}", index, count);
+    if (!allow_cache && count > 1) {
+        for (unsigned i = 0; i < count; ++i) {
+            auto result = flush_specific_block_if_needed(BlockIndex { index.value() + i });
+            if (result.is_error())
+                return result;
+            cache().invalidate(BlockIndex { index.value() + i });
+        }
+        return write_to_device(index.value() * block_size(), data, count * block_size());
+    }
     for (unsigned i = 0; i < count; ++i) {
         auto result = write_block(BlockIndex { index.value() + i }, data.offset(i * block_size()), block_size(), 0, allow_cache);
         if (result.is_error())
@@ -238,29 +405,27 @@ KResult BlockBasedFS::read_block(BlockIndex index, UserOrKernelBuffer* buffer, s
     dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem::read_block {}", index);
 
     if (!allow_cache) {
-        const_cast<BlockBasedFS*>(this)->flush_specific_block_if_needed(index);
-        auto base_offset = index.value() * block_size() + offset;
-        auto seek_result = file_description().seek(base_offset, SEEK_SET);
-        if (seek_result.is_error())
-            return seek_result.error();
-        auto nread = file_description().read(*buffer, count);
-        if (nread.is_error())
-            return nread.error();
-        VERIFY(nread.value() == count);
-        return KSuccess;
+        auto result = const_cast<BlockBasedFS*>(this)->flush_specific_block_if_needed(index);
+        if (result.is_error())
+            return result;
+        return read_from_device(index.value() * block_size() + offset, *buffer, count);
+    }
+
+    if (!cache().has_data(index)) {
+        if (auto run = cache().read_ahead_run(index)) {
+            // It's already on its way, so don't ask the device a second time.
+            locker.unlock();
+            finish_read_ahead_run(*run);
+            locker.lock();
+        }
     }
 
     auto& entry = cache().get(index);
     if (!entry.has_data) {
-        auto base_offset = index.value() * block_size();
-        auto seek_result = file_description().seek(base_offset, SEEK_SET);
-        if (seek_result.is_error())
-            return seek_result.error();
         auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry.data);
-        auto nread = file_description().read(entry_data_buffer, block_size());
-        if (nread.is_error())
-            return nread.error();
-        VERIFY(nread.value() == block_size());
+        auto result = read_from_device(index.value() * block_size(), entry_data_buffer, block_size());
+        if (result.is_error())
+            return result;
         entry.has_data = true;
     }
     if (buffer && !buffer->write(entry.data + offset, count))
@@ -270,12 +435,30 @@ KResult BlockBasedFS::read_block(BlockIndex index, UserOrKernelBuffer* buffer, s
 
 KResult BlockBasedFS::read_blocks(BlockIndex index, unsigned count, UserOrKernelBuffer& buffer, bool allow_cache) const
 {
-    LOCKER(m_lock);
     VERIFY(m_logical_block_size);
     if (!count)
         return EINVAL;
     if (count == 1)
         return read_block(index, &buffer, block_size(), 0, allow_cache);
+    if (!allow_cache) {
+        LOCKER(m_lock);
+        for (unsigned i = 0; i < count; ++i) {
+            auto result = const_cast<BlockBasedFS*>(this)->flush_specific_block_if_needed(BlockIndex { index.value() + i });
+            if (result.is_error())
+                return result;
+        }
+        return read_from_device(index.value() * block_size(), buffer, count * block_size());
+    }
+
+    // Fill whatever isn't cached yet with as few device requests as possible before copying out.
+    // This doesn't hold the FS lock while the device is busy.
+    Vector<BlockIndex> blocks;
+    blocks.ensure_capacity(count);
+    for (unsigned i = 0; i < count; ++i)
+        blocks.unchecked_append(BlockIndex { index.value() + i });
+    const_cast<BlockBasedFS*>(this)->read_ahead_blocks(blocks);
+
+    LOCKER(m_lock);
     auto out = buffer;
     for (unsigned i = 0; i < count; ++i) {
         auto result = read_block(BlockIndex { index.value() + i }, &out, block_size(), 0, allow_cache);
@@ -287,51 +470,236 @@ KResult BlockBasedFS::read_blocks(BlockIndex index, unsigned count, UserOrKernel
     return KSuccess;
 }
 
-void BlockBasedFS::flush_specific_block_if_needed(BlockIndex index)
+// NOTE: The underlying device may transfer less than we asked for (StorageDevice does at most a page per request),
+//       so these keep going until the whole range has been transferred.
+KResult BlockBasedFS::read_from_device(u64 offset, UserOrKernelBuffer& buffer, size_t length) const
+{
+    VERIFY(m_lock.is_locked());
+    auto seek_result = file_description().seek(offset, SEEK_SET);
+    if (seek_result.is_error())
+        return seek_result.error();
+    size_t nread = 0;
+    while (nread < length) {
+        auto chunk = buffer.offset(nread);
+        auto result = file_description().read(chunk, length - nread);
+        if (result.is_error())
+            return result.error();
+        if (result.value() == 0)
+            return EIO;
+        nread += result.value();
+    }
+    return KSuccess;
+}
+
+KResult BlockBasedFS::write_to_device(u64 offset, const UserOrKernelBuffer& buffer, size_t length)
+{
+    VERIFY(m_lock.is_locked());
+    auto seek_result = file_description().seek(offset, SEEK_SET);
+    if (seek_result.is_error())
+        return seek_result.error();
+    size_t nwritten = 0;
+    while (nwritten < length) {
+        auto result = file_description().write(buffer.offset(nwritten), length - nwritten);
+        if (result.is_error())
+            return result.error();
+        if (result.value() == 0)
+            return EIO;
+        nwritten += result.value();
+    }
+    return KSuccess;
+}
+
+KResult BlockBasedFS::write_back_cached_block(BlockIndex index, u8* data)
 {
     LOCKER(m_lock);
-    if (!cache().is_dirty())
+    auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(data);
+    return write_to_device(index.value() * block_size(), entry_data_buffer, block_size());
+}
+
+void BlockBasedFS::read_ahead_blocks(const Vector<BlockIndex>& blocks)
+{
+    constexpr size_t max_blocks_per_run = 64;
+
+    auto& file = file_description().file();
+    if (!file.is_block_device() || block_size() % static_cast<BlockDevice&>(file).block_size()) {
+        // Without a block device underneath, there's nobody to hand asynchronous requests to.
         return;
+    }
+    auto& device = static_cast<BlockDevice&>(file);
+    size_t device_blocks_per_block = block_size() / device.block_size();
+    // Devices take only so many blocks per request, and would otherwise come back with a short read.
+    size_t max_device_blocks_per_request = max(device.max_blocks_per_request(), device_blocks_per_block);
+
+    NonnullRefPtrVector<ReadAheadRun> runs;
+    {
+        LOCKER(m_lock);
+        size_t i = 0;
+        while (i < blocks.size()) {
+            if (cache().has_data(blocks[i])) {
+                ++i;
+                continue;
+            }
+            if (auto run = cache().read_ahead_run(blocks[i])) {
+                if (runs.is_empty() || &runs.last() != run.ptr())
+                    runs.append(run.release_nonnull());
+                ++i;
+                continue;
+            }
+
+            // Find the longest run of physically contiguous blocks that aren't cached or on their way yet.
+            size_t run_length = 1;
+            while (i + run_length < blocks.size()
+                && run_length < max_blocks_per_run
+                && blocks[i + run_length].value() == blocks[i].value() + run_length
+                && !cache().has_data(blocks[i + run_length])
+                && !cache().read_ahead_run(blocks[i + run_length]))
+                ++run_length;
+
+            auto buffer = KBuffer::try_create_with_size(run_length * block_size(), Region::Access::Read | Region::Access::Write, "BlockBasedFS read-ahead");
+            if (!buffer)
+                break;
+            auto run = adopt(*new ReadAheadRun(blocks[i], run_length, buffer.release_nonnull()));
+            u64 first_device_block = blocks[i].value() * device_blocks_per_block;
+            size_t device_block_count = run_length * device_blocks_per_block;
+            for (size_t submitted = 0; submitted < device_block_count;) {
+                size_t request_block_count = min(device_block_count - submitted, max_device_blocks_per_request);
+                auto request_buffer = UserOrKernelBuffer::for_kernel_buffer(run->buffer->data() + submitted * device.block_size());
+                run->requests.append(device.make_request<AsyncBlockDeviceRequest>(AsyncBlockDeviceRequest::Read, first_device_block + submitted, request_block_count, request_buffer, request_block_count * device.block_size()));
+                submitted += request_block_count;
+            }
+            cache().add_read_ahead_run(run);
+            dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem::read_ahead_blocks {}, count={}, requests={}", blocks[i], run_length, run->requests.size());
+            runs.append(move(run));
+            i += run_length;
+        }
+    }
+
+    for (auto& run : runs)
+        finish_read_ahead_run(run);
+}
+
+void BlockBasedFS::finish_read_ahead_run(ReadAheadRun& run) const
+{
+    bool success = true;
+    for (auto& request : run.requests) {
+        auto result = request.wait().request_result();
+        if (result == AsyncDeviceRequest::Pending || result == AsyncDeviceRequest::Started) {
+            // We were interrupted. Leave the run to whoever needs its blocks next, and make sure
+            // its buffer stays around until the device is done with it.
+            dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem: Interrupted while waiting for read-ahead of {} blocks at {}", run.block_count, run.first_block);
+            LOCKER(m_lock);
+            if (!run.is_finished)
+                cache().keep_until_completed(run);
+            return;
+        }
+        if (result != AsyncDeviceRequest::Success)
+            success = false;
+    }
+
+    LOCKER(m_lock);
+    if (run.is_finished)
+        return;
+    run.is_finished = true;
+    for (size_t i = 0; i < run.block_count; ++i) {
+        BlockIndex block_index { run.first_block.value() + i };
+        // Blocks that were written or invalidated in the meantime keep what they have now.
+        if (!cache().take_read_ahead_block(run, block_index) || !success || cache().has_data(block_index))
+            continue;
+        auto& entry = cache().get(block_index);
+        memcpy(entry.data, run.buffer->data() + i * block_size(), block_size());
+        entry.has_data = true;
+    }
+    // A failed run leaves its blocks uncached. Reading them goes through read_from_device(), which sorts out the error.
+    if (!success)
+        dbgln_if(BBFS_DEBUG, "BlockBasedFileSystem: Read-ahead of {} blocks at {} failed", run.block_count, run.first_block);
+}
+
+KResult BlockBasedFS::flush_specific_block_if_needed(BlockIndex index)
+{
+    LOCKER(m_lock);
+    if (!cache().is_dirty())
+        return KSuccess;
+    KResult result = KSuccess;
     Vector<CacheEntry*, 32> cleaned_entries;
     cache().for_each_dirty_entry([&](CacheEntry& entry) {
-        if (entry.block_index != index) {
-            size_t base_offset = entry.block_index.value() * block_size();
-            auto seek_result = file_description().seek(base_offset, SEEK_SET);
-            VERIFY(!seek_result.is_error());
-            // FIXME: Should this error path be surfaced somehow?
-            auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry.data);
-            [[maybe_unused]] auto rc = file_description().write(entry_data_buffer, block_size());
+        if (entry.block_index != index)
+            return;
+        result = write_back_cached_block(entry.block_index, entry.data);
+        if (!result.is_error())
             cleaned_entries.append(&entry);
-        }
     });
     // NOTE: We make a separate pass to mark entries clean since marking them clean
     //       moves them out of the dirty list which would disturb the iteration above.
     for (auto* entry : cleaned_entries)
         cache().mark_clean(*entry);
+    return result;
 }
 
-void BlockBasedFS::flush_writes_impl()
+KResult BlockBasedFS::flush_writes_impl()
 {
     LOCKER(m_lock);
-    if (!cache().is_dirty())
-        return;
-    u32 count = 0;
+    if (!cache().is_dirty()) {
+        cache().shrink_if_under_memory_pressure();
+        return KSuccess;
+    }
+    constexpr size_t max_blocks_per_request = 64;
+
+    // Write dirty blocks back in on-disk order, so that adjacent blocks can go out as a single request.
+    Vector<CacheEntry*> dirty_entries;
     cache().for_each_dirty_entry([&](CacheEntry& entry) {
-        u32 base_offset = entry.block_index.value() * block_size();
-        auto seek_result = file_description().seek(base_offset, SEEK_SET);
-        VERIFY(!seek_result.is_error());
-        // FIXME: Should this error path be surfaced somehow?
-        auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry.data);
-        [[maybe_unused]] auto rc = file_description().write(entry_data_buffer, block_size());
-        ++count;
+        dirty_entries.append(&entry);
     });
-    cache().mark_all_clean();
-    dbgln("{}: Flushed {} blocks to disk", class_name(), count);
+    quick_sort(dirty_entries, [](auto* a, auto* b) { return a->block_index < b->block_index; });
+
+    auto run_buffer = KBuffer::try_create_with_size(min(dirty_entries.size(), max_blocks_per_request) * block_size(), Region::Access::Read | Region::Access::Write, "BlockBasedFS write-back");
+    u32 count = 0;
+    u32 requests = 0;
+    KResult first_error = KSuccess;
+    for (size_t i = 0; i < dirty_entries.size();) {
+        size_t run_length = 1;
+        while (run_buffer
+            && i + run_length < dirty_entries.size()
+            && run_length < max_blocks_per_request
+            && dirty_entries[i + run_length]->block_index.value() == dirty_entries[i]->block_index.value() + run_length)
+            ++run_length;
+
+        KResult result = KSuccess;
+        if (run_length == 1) {
+            result = write_back_cached_block(dirty_entries[i]->block_index, dirty_entries[i]->data);
+        } else {
+            for (size_t j = 0; j < run_length; ++j)
+                memcpy(run_buffer->data() + j * block_size(), dirty_entries[i + j]->data, block_size());
+            auto buffer = UserOrKernelBuffer::for_kernel_buffer(run_buffer->data());
+            result = write_to_device(dirty_entries[i]->block_index.value() * block_size(), buffer, run_length * block_size());
+        }
+        if (result.is_error()) {
+            // Leave the run dirty so the next flush tries again.
+            dbgln("{}: Failed to write back {} blocks at {}: {}", class_name(), run_length, dirty_entries[i]->block_index, result.error());
+            if (!first_error.is_error())
+                first_error = result;
+        } else {
+            for (size_t j = 0; j < run_length; ++j)
+                cache().mark_clean(*dirty_entries[i + j]);
+            count += run_length;
+            ++requests;
+        }
+        i += run_length;
+    }
+    cache().shrink_if_under_memory_pressure();
+    dbgln("{}: Flushed {} blocks to disk in {} requests", class_name(), count, requests);
+    return first_error;
 }
 
-void BlockBasedFS::flush_writes()
+KResult BlockBasedFS::flush_writes()
 {
-    flush_writes_impl();
+    return flush_writes_impl();
+}
+
+void BlockBasedFS::release_cached_memory()
+{
+    LOCKER(m_lock);
+    if (m_cache)
+        m_cache->shrink_if_under_memory_pressure();
 }
 
 DiskCache& BlockBasedFS::cache() const
@@ -30,6 +30,8 @@
 
 namespace Kernel {
 
+class ReadAheadRun;
+
 class BlockBasedFS : public FileBackedFS {
 public:
     TYPEDEF_DISTINCT_ORDERED_ID(u64, BlockIndex);
@@ -38,8 +40,9 @@ public:
 
     size_t logical_block_size() const { return m_logical_block_size; };
 
-    virtual void flush_writes() override;
-    void flush_writes_impl();
+    virtual KResult flush_writes() override;
+    KResult flush_writes_impl();
+    virtual void release_cached_memory() override;
 
 protected:
     explicit BlockBasedFS(FileDescription&);
@@ -47,11 +50,16 @@ protected:
     KResult read_block(BlockIndex, UserOrKernelBuffer*, size_t count, size_t offset = 0, bool allow_cache = true) const;
     KResult read_blocks(BlockIndex, unsigned count, UserOrKernelBuffer&, bool allow_cache = true) const;
 
-    bool raw_read(BlockIndex, UserOrKernelBuffer&);
-    bool raw_write(BlockIndex, const UserOrKernelBuffer&);
+    KResult raw_read(BlockIndex, UserOrKernelBuffer&);
+    KResult raw_write(BlockIndex, const UserOrKernelBuffer&);
+
+    KResult raw_read_blocks(BlockIndex index, size_t count, UserOrKernelBuffer&);
+    KResult raw_write_blocks(BlockIndex index, size_t count, const UserOrKernelBuffer&);
 
-    bool raw_read_blocks(BlockIndex index, size_t count, UserOrKernelBuffer&);
-    bool raw_write_blocks(BlockIndex index, size_t count, const UserOrKernelBuffer&);
+    // Pulls the given blocks into the cache, coalescing contiguous runs into single device reads.
+    // The reads are submitted as asynchronous device requests, and the FS lock isn't held while
+    // they're in flight. Readers of a block that's on its way wait for it instead of asking again.
+    void read_ahead_blocks(const Vector<BlockIndex>&);
 
     KResult write_block(BlockIndex, const UserOrKernelBuffer&, size_t count, size_t offset = 0, bool allow_cache = true);
     KResult write_blocks(BlockIndex, unsigned count, const UserOrKernelBuffer&, bool allow_cache = true);
@@ -59,8 +67,14 @@ protected:
     size_t m_logical_block_size { 512 };
 
 private:
+    friend class DiskCache;
+
     DiskCache& cache() const;
-    void flush_specific_block_if_needed(BlockIndex index);
+    void finish_read_ahead_run(ReadAheadRun&) const;
+    KResult flush_specific_block_if_needed(BlockIndex index);
+    KResult write_back_cached_block(BlockIndex, u8* data);
+    KResult read_from_device(u64 offset, UserOrKernelBuffer&, size_t length) const;
+    KResult write_to_device(u64 offset, const UserOrKernelBuffer&, size_t length);
 
     mutable OwnPtr<DiskCache> m_cache;
 };
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/HashFunctions.h>
+#include <AK/Singleton.h>
+#include <Kernel/FileSystem/DentryCache.h>
+#include <Kernel/FileSystem/Inode.h>
+
+namespace Kernel {
+
+static AK::Singleton<DentryCache> s_the;
+
+DentryCache& DentryCache::the()
+{
+    return *s_the;
+}
+
+DentryCache::DentryCache()
+{
+}
+
+DentryCache::~DentryCache()
+{
+}
+
+unsigned DentryCache::hash_key(InodeIdentifier parent, StringView name)
+{
+    return pair_int_hash(pair_int_hash(parent.fsid(), parent.index().value()), name.hash());
+}
+
+DentryCache::Entry* DentryCache::find_entry(InodeIdentifier parent, StringView name, unsigned hash)
+{
+    VERIFY(m_lock.is_locked());
+    auto it = m_entries.find(hash, [&](auto* entry) { return entry->parent == parent && entry->name == name; });
+    if (it == m_entries.end())
+        return nullptr;
+    return *it;
+}
+
+void DentryCache::remove_entry(Entry& entry, Vector<RefPtr<Inode>>& dead_inodes)
+{
+    VERIFY(m_lock.is_locked());
+    m_entries.remove(&entry);
+    m_lru_list.remove(&entry);
+    // Dropping the last reference to an inode may have to write it back, which we can't do
+    // while holding a spinlock, so the caller releases these after unlocking.
+    if (entry.inode)
+        dead_inodes.append(move(entry.inode));
+    delete &entry;
+}
+
+u64 DentryCache::generation() const
+{
+    ScopedSpinLock lock(m_lock);
+    return m_generation;
+}
+
+Optional<RefPtr<Inode>> DentryCache::lookup(const Inode& parent, StringView name)
+{
+    if (!parent.fs().supports_lookup_caching())
+        return {};
+
+    auto parent_id = parent.identifier();
+    auto hash = hash_key(parent_id, name);
+
+    ScopedSpinLock lock(m_lock);
+    auto* entry = find_entry(parent_id, name, hash);
+    if (!entry)
+        return {};
+    if (m_lru_list.head() != entry) {
+        m_lru_list.remove(entry);
+        m_lru_list.prepend(entry);
+    }
+    return entry->inode;
+}
+
+void DentryCache::add(const Inode& parent, StringView name, Inode* child, u64 generation)
+{
+    if (!parent.fs().supports_lookup_caching())
+        return;
+
+    auto parent_id = parent.identifier();
+    auto hash = hash_key(parent_id, name);
+
+    auto* new_entry = new Entry;
+    new_entry->parent = parent_id;
+    new_entry->name = name;
+    new_entry->hash = hash;
+    new_entry->inode = child;
+
+    Vector<RefPtr<Inode>> dead_inodes;
+    {
+        ScopedSpinLock lock(m_lock);
+        if (generation != m_generation || find_entry(parent_id, name, hash)) {
+            dead_inodes.append(move(new_entry->inode));
+            delete new_entry;
+            return;
+        }
+        if (m_entries.size() >= max_entries)
+            remove_entry(*m_lru_list.tail(), dead_inodes);
+        m_entries.set(new_entry);
+        m_lru_list.prepend(new_entry);
+    }
+}
+
+void DentryCache::invalidate(const Inode& parent, StringView name)
+{
+    if (!parent.fs().supports_lookup_caching())
+        return;
+
+    auto parent_id = parent.identifier();
+    auto hash = hash_key(parent_id, name);
+
+    Vector<RefPtr<Inode>> dead_inodes;
+    ScopedSpinLock lock(m_lock);
+    ++m_generation;
+    if (auto* entry = find_entry(parent_id, name, hash))
+        remove_entry(*entry, dead_inodes);
+}
+
+void DentryCache::invalidate_file_system(u32 fsid)
+{
+    Vector<RefPtr<Inode>> dead_inodes;
+    ScopedSpinLock lock(m_lock);
+    ++m_generation;
+    for (auto* entry = m_lru_list.head(); entry;) {
+        auto* next = entry->next();
+        if (entry->parent.fsid() == fsid)
+            remove_entry(*entry, dead_inodes);
+        entry = next;
+    }
+}
+
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/HashTable.h>
+#include <AK/InlineLinkedList.h>
+#include <AK/Optional.h>
+#include <AK/RefPtr.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+#include <Kernel/FileSystem/InodeIdentifier.h>
+#include <Kernel/Forward.h>
+#include <Kernel/SpinLock.h>
+
+namespace Kernel {
+
+// Caches the result of Inode::lookup() for path resolution, keyed by (parent directory, name).
+// A cached entry either holds a reference to the child inode, or nothing if the name is known
+// not to exist in the parent (a negative entry).
+//
+// Only file systems that report every namespace change through Inode::did_add_child() and
+// Inode::did_remove_child() may be cached (see FS::supports_lookup_caching()), since that is
+// where stale entries get invalidated.
+class DentryCache {
+    AK_MAKE_NONCOPYABLE(DentryCache);
+    AK_MAKE_NONMOVABLE(DentryCache);
+
+public:
+    static DentryCache& the();
+
+    DentryCache();
+    ~DentryCache();
+
+    // Returns an empty Optional on a miss, and a (possibly null) inode on a hit.
+    Optional<RefPtr<Inode>> lookup(const Inode& parent, StringView name);
+
+    // Insertions made with a generation taken before an intervening invalidation are dropped,
+    // so a lookup that raced with a namespace change can't leave a stale entry behind.
+    u64 generation() const;
+    void add(const Inode& parent, StringView name, Inode* child, u64 generation);
+
+    void invalidate(const Inode& parent, StringView name);
+    void invalidate_file_system(u32 fsid);
+
+private:
+    struct Entry : public InlineLinkedListNode<Entry> {
+        InodeIdentifier parent;
+        String name;
+        unsigned hash { 0 };
+        RefPtr<Inode> inode;
+
+        Entry* m_next { nullptr };
+        Entry* m_prev { nullptr };
+    };
+
+    struct EntryTraits : public GenericTraits<Entry*> {
+        static unsigned hash(const Entry* entry) { return entry->hash; }
+        static bool equals(const Entry* a, const Entry* b) { return a->parent == b->parent && a->name == b->name; }
+    };
+
+    static unsigned hash_key(InodeIdentifier parent, StringView name);
+    Entry* find_entry(InodeIdentifier parent, StringView name, unsigned hash);
+    void remove_entry(Entry&, Vector<RefPtr<Inode>>& dead_inodes);
+
+    static constexpr size_t max_entries = 2048;
+
+    mutable SpinLock<u8> m_lock;
+    HashTable<Entry*, EntryTraits> m_entries;
+    InlineLinkedList<Entry> m_lru_list;
+    u64 m_generation { 0 };
+};
+
+}
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Debug.h>
+#include <Kernel/FileSystem/EPoll.h>
+#include <Kernel/FileSystem/FileDescription.h>
+
+namespace Kernel {
+
+EPollInterest::EPollInterest(EPoll& epoll, FileDescription& description, int fd, const epoll_event& event)
+    : m_epoll(&epoll)
+    , m_description(&description)
+    , m_key { &description, fd }
+    , m_event(event)
+{
+}
+
+EPollInterest::~EPollInterest()
+{
+    VERIFY(!m_ready_list_node.is_in_list());
+}
+
+auto EPollInterest::block_flags() const -> BlockFlags
+{
+    // Errors and hangups are always reported, like poll() does.
+    auto flags = BlockFlags::Exception;
+    if (m_event.events & EPOLLIN)
+        flags |= BlockFlags::Read;
+    if (m_event.events & EPOLLOUT)
+        flags |= BlockFlags::Write;
+    return flags;
+}
+
+bool EPollInterest::unblock(bool, void*)
+{
+    // Stay registered in any case, we want to hear about every future state change as well.
+    FileDescription* description;
+    BlockFlags flags;
+    {
+        ScopedSpinLock lock(m_lock);
+        if (!m_epoll || !m_description || m_disabled)
+            return false;
+        description = m_description;
+        flags = block_flags();
+    }
+
+    // NOTE: The description's block condition is calling us, so the description is still around.
+    //       Like in current_events(), we can't hold m_lock while asking it for its state.
+    if (description->should_unblock(flags) == BlockFlags::None)
+        return false;
+
+    // Holding m_lock keeps the EPoll from going away underneath us.
+    ScopedSpinLock lock(m_lock);
+    if (m_epoll && !m_disabled)
+        m_epoll->interest_became_ready({}, *this);
+    return false;
+}
+
+u32 EPollInterest::current_events()
+{
+    RefPtr<FileDescription> description;
+    BlockFlags flags;
+    u32 requested_events;
+    {
+        ScopedSpinLock lock(m_lock);
+        if (m_disabled || !m_description || !m_description->try_ref())
+            return 0;
+        description = adopt(*m_description);
+        flags = block_flags();
+        requested_events = m_event.events;
+    }
+
+    // NOTE: This may end up calling into code that can block, so we can't hold m_lock here.
+    auto unblocked_flags = description->should_unblock(flags);
+    u32 events = 0;
+    if (has_flag(unblocked_flags, BlockFlags::Read))
+        events |= EPOLLIN;
+    if (has_flag(unblocked_flags, BlockFlags::Write))
+        events |= EPOLLOUT;
+    if (has_flag(unblocked_flags, BlockFlags::WriteError))
+        events |= EPOLLERR;
+    if (has_flag(unblocked_flags, BlockFlags::WriteHangUp) || has_flag(unblocked_flags, BlockFlags::WriteNotOpen))
+        events |= EPOLLHUP;
+    if (has_flag(unblocked_flags, BlockFlags::ReadHangUp) && (requested_events & EPOLLRDHUP))
+        events |= EPOLLRDHUP;
+    return events;
+}
+
+void EPollInterest::detach_from_epoll()
+{
+    RefPtr<FileDescription> description;
+    {
+        ScopedSpinLock lock(m_lock);
+        m_epoll = nullptr;
+        if (m_description && m_description->try_ref())
+            description = adopt(*m_description);
+    }
+    // If the description is already being destroyed, it unregisters us by itself.
+    if (description) {
+        description->block_condition().remove_blocker(*this, nullptr);
+        description->remove_epoll_interest({}, *this);
+    }
+}
+
+void EPollInterest::description_destroyed(Badge<FileDescription>, FileDescription& description)
+{
+    description.block_condition().remove_blocker(*this, nullptr);
+
+    RefPtr<EPoll> epoll;
+    {
+        ScopedSpinLock lock(m_lock);
+        m_description = nullptr;
+        if (m_epoll && m_epoll->try_ref())
+            epoll = adopt(*m_epoll);
+    }
+    if (epoll)
+        epoll->interest_went_away({}, *this);
+}
+
+void EPollInterest::fd_closed(Badge<FileDescription>)
+{
+    RefPtr<EPoll> epoll;
+    {
+        ScopedSpinLock lock(m_lock);
+        if (m_epoll && m_epoll->try_ref())
+            epoll = adopt(*m_epoll);
+    }
+    if (epoll)
+        epoll->interest_went_away({}, *this);
+}
+
+NonnullRefPtr<EPoll> EPoll::create()
+{
+    return adopt(*new EPoll);
+}
+
+EPoll::~EPoll()
+{
+    // Nobody can get a new reference to us anymore, so there's nothing to race with here.
+    for (auto& it : m_interests)
+        it.value->detach_from_epoll();
+    ScopedSpinLock lock(m_ready_lock);
+    m_ready_list.clear();
+}
+
+KResult EPoll::add_interest(int fd, FileDescription& description, const epoll_event& event)
+{
+    // FIXME: Linux allows nesting EPoll instances (with loop detection), we don't.
+    if (description.file().is_epoll())
+        return EINVAL;
+
+    LOCKER(m_lock);
+    EPollInterestKey key { &description, fd };
+    if (m_interests.contains(key))
+        return EEXIST;
+
+    auto interest = adopt(*new EPollInterest(*this, description, fd, event));
+    m_interests.set(key, interest);
+    description.add_epoll_interest({}, interest);
+
+    // Adding the blocker checks the description's current state right away,
+    // so a description that's already ready is reported by the next wait.
+    description.block_condition().add_blocker(*interest, nullptr);
+
+    dbgln_if(EPOLL_DEBUG, "EPoll {}: Added interest in fd {} ({}), events {:#x}", this, fd, description.absolute_path(), event.events);
+    return KSuccess;
+}
+
+KResult EPoll::modify_interest(int fd, FileDescription& description, const epoll_event& event)
+{
+    LOCKER(m_lock);
+    auto it = m_interests.find({ &description, fd });
+    if (it == m_interests.end())
+        return ENOENT;
+
+    auto& interest = *it->value;
+    {
+        ScopedSpinLock lock(interest.m_lock);
+        interest.m_event = event;
+        interest.m_disabled = false;
+    }
+    // The new event mask may already be satisfied.
+    if (interest.current_events())
+        mark_ready(interest);
+    return KSuccess;
+}
+
+KResult EPoll::remove_interest(int fd, FileDescription& description)
+{
+    LOCKER(m_lock);
+    auto it = m_interests.find({ &description, fd });
+    if (it == m_interests.end())
+        return ENOENT;
+    remove_interest_locked(*it->value);
+    dbgln_if(EPOLL_DEBUG, "EPoll {}: Removed interest in fd {}", this, fd);
+    return KSuccess;
+}
+
+void EPoll::remove_interest_locked(EPollInterest& interest)
+{
+    VERIFY(m_lock.is_locked());
+    NonnullRefPtr<EPollInterest> protector(interest);
+    // Detach first, so the interest can't become ready again after it's been taken off the ready list.
+    interest.detach_from_epoll();
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        m_ready_list.remove(interest);
+    }
+    m_interests.remove(interest.m_key);
+}
+
+void EPoll::interest_went_away(Badge<EPollInterest>, EPollInterest& interest)
+{
+    LOCKER(m_lock);
+    // The interest may have been removed while we were waiting for the lock.
+    auto it = m_interests.find(interest.m_key);
+    if (it == m_interests.end() || it->value.ptr() != &interest)
+        return;
+    remove_interest_locked(interest);
+}
+
+void EPoll::interest_became_ready(Badge<EPollInterest>, EPollInterest& interest)
+{
+    mark_ready(interest);
+}
+
+void EPoll::mark_ready(EPollInterest& interest)
+{
+    {
+        ScopedSpinLock lock(m_ready_lock);
+        if (m_ready_list.contains(interest))
+            return;
+        m_ready_list.append(interest);
+    }
+    evaluate_block_conditions();
+}
+
+bool EPoll::can_read(const FileDescription&, size_t) const
+{
+    ScopedSpinLock lock(m_ready_lock);
+    return !m_ready_list.is_empty();
+}
+
+size_t EPoll::collect_ready_events(epoll_event* events, size_t max_events)
+{
+    LOCKER(m_lock);
+    Vector<NonnullRefPtr<EPollInterest>, 16> still_ready;
+    size_t count = 0;
+    while (count < max_events) {
+        RefPtr<EPollInterest> interest;
+        {
+            ScopedSpinLock lock(m_ready_lock);
+            interest = m_ready_list.take_first();
+        }
+        if (!interest)
+            break;
+
+        // Interests sit on the ready list until we get here, so the state may have changed since.
+        // If it's no longer ready, it's put back on the list by the next state change.
+        auto ready_events = interest->current_events();
+        if (!ready_events)
+            continue;
+
+        ScopedSpinLock lock(interest->m_lock);
+        events[count++] = { ready_events, interest->m_event.data };
+        if (interest->m_event.events & EPOLLONESHOT)
+            interest->m_disabled = true;
+        else if (!(interest->m_event.events & EPOLLET))
+            still_ready.append(*interest);
+    }
+
+    // Level-triggered interests stay ready until a wait finds them no longer ready.
+    for (auto& interest : still_ready) {
+        ScopedSpinLock lock(interest->m_lock);
+        if (!interest->m_epoll)
+            continue;
+        ScopedSpinLock ready_lock(m_ready_lock);
+        m_ready_list.append(interest);
+    }
+    return count;
+}
+
+}
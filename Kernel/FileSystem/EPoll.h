@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Badge.h>
+#include <AK/HashMap.h>
+#include <AK/IntrusiveList.h>
+#include <AK/RefCounted.h>
+#include <Kernel/FileSystem/File.h>
+#include <Kernel/Lock.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/Thread.h>
+#include <Kernel/UnixTypes.h>
+
+namespace Kernel {
+
+class EPoll;
+
+struct EPollInterestKey {
+    const FileDescription* description { nullptr };
+    int fd { -1 };
+
+    bool operator==(const EPollInterestKey& other) const { return description == other.description && fd == other.fd; }
+};
+
+// An EPollInterest ties a FileDescription to an EPoll instance. It stays
+// registered with the description's block condition for as long as it exists,
+// so the EPoll learns about readiness changes as they happen instead of
+// having to scan every description on each wait.
+//
+// Both sides can go away first: closing the EPoll drops all of its interests,
+// and closing the fd or destroying the FileDescription removes the interest
+// from the EPoll watching it.
+class EPollInterest final
+    : public RefCounted<EPollInterest>
+    , public Thread::FileBlocker {
+    friend class EPoll;
+
+public:
+    EPollInterest(EPoll&, FileDescription&, int fd, const epoll_event&);
+    virtual ~EPollInterest() override;
+
+    virtual const char* state_string() const override { return "EPoll"; }
+    virtual void not_blocking(bool) override { }
+    virtual bool unblock(bool, void*) override;
+
+    int fd() const { return m_key.fd; }
+
+    void description_destroyed(Badge<FileDescription>, FileDescription&);
+    void fd_closed(Badge<FileDescription>);
+
+private:
+    BlockFlags block_flags() const;
+    u32 current_events();
+    void detach_from_epoll();
+
+    EPoll* m_epoll { nullptr };
+    FileDescription* m_description { nullptr };
+    const EPollInterestKey m_key;
+    epoll_event m_event {};
+    // Set once a one-shot interest has reported an event, until it's modified again.
+    bool m_disabled { false };
+
+    IntrusiveListNode m_ready_list_node;
+};
+
+}
+
+namespace AK {
+
+template<>
+struct Traits<Kernel::EPollInterestKey> : public GenericTraits<Kernel::EPollInterestKey> {
+    static unsigned hash(const Kernel::EPollInterestKey& key) { return pair_int_hash(ptr_hash(key.description), int_hash(key.fd)); }
+};
+
+}
+
+namespace Kernel {
+
+class EPoll final : public File {
+public:
+    static NonnullRefPtr<EPoll> create();
+    virtual ~EPoll() override;
+
+    KResult add_interest(int fd, FileDescription&, const epoll_event&);
+    KResult modify_interest(int fd, FileDescription&, const epoll_event&);
+    KResult remove_interest(int fd, FileDescription&);
+
+    // Fills `events` with the interests that are currently ready, and returns how many there were.
+    size_t collect_ready_events(epoll_event* events, size_t max_events);
+
+    void interest_became_ready(Badge<EPollInterest>, EPollInterest&);
+    // Called when the interest's fd is closed or its description is destroyed.
+    void interest_went_away(Badge<EPollInterest>, EPollInterest&);
+
+    virtual bool can_read(const FileDescription&, size_t) const override;
+    virtual bool can_write(const FileDescription&, size_t) const override { return false; }
+    virtual KResultOr<size_t> read(FileDescription&, u64, UserOrKernelBuffer&, size_t) override { return EINVAL; }
+    virtual KResultOr<size_t> write(FileDescription&, u64, const UserOrKernelBuffer&, size_t) override { return EINVAL; }
+    virtual String absolute_path(const FileDescription&) const override { return "epoll"; }
+    virtual const char* class_name() const override { return "EPoll"; }
+    virtual bool is_epoll() const override { return true; }
+
+private:
+    EPoll() = default;
+
+    void mark_ready(EPollInterest&);
+    void remove_interest_locked(EPollInterest&);
+
+    // Protects the interest table, and keeps interests alive while collecting events.
+    Lock m_lock { "EPoll" };
+    HashMap<EPollInterestKey, NonnullRefPtr<EPollInterest>> m_interests;
+
+    // Interests are put on the ready list from block condition callbacks,
+    // so it has a spinlock of its own.
+    mutable SpinLock<u8> m_ready_lock;
+    IntrusiveList<EPollInterest, &EPollInterest::m_ready_list_node> m_ready_list;
+};
+
+}
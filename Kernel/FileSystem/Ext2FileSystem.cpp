@@ -35,6 +35,7 @@
 #include <Kernel/FileSystem/ext2_fs.h>
 #include <Kernel/Process.h>
 #include <Kernel/UnixTypes.h>
+#include <Kernel/WorkQueue.h>
 #include <LibC/errno_numbers.h>
 
 namespace Kernel {
@@ -73,6 +74,158 @@ static unsigned divide_rounded_up(unsigned a, unsigned b)
     return (a / b) + (a % b != 0);
 }
 
+// The hash functions used to index ext3/ext4 "htree" directories, see fs/ext4/hash.c in Linux.
+// Names are folded into 32-bit words either as signed or unsigned chars, depending on the
+// platform that created the file system, which the super block records.
+static constexpr size_t max_htree_indirect_levels = 2;
+static constexpr u32 htree_end_of_file = 0x7fffffff;
+
+static void htree_string_to_hash_buffer(const u8* name, size_t length, u32* buffer, size_t word_count, bool is_unsigned)
+{
+    u32 padding = static_cast<u32>(length) | (static_cast<u32>(length) << 8);
+    padding |= padding << 16;
+
+    u32 value = padding;
+    length = min(length, word_count * 4);
+    for (size_t i = 0; i < length; ++i) {
+        u32 c = is_unsigned ? name[i] : static_cast<u32>(static_cast<i32>(static_cast<i8>(name[i])));
+        value = c + (value << 8);
+        if ((i % 4) == 3) {
+            *buffer++ = value;
+            value = padding;
+            --word_count;
+        }
+    }
+    if (word_count > 0) {
+        *buffer++ = value;
+        --word_count;
+    }
+    while (word_count-- > 0)
+        *buffer++ = padding;
+}
+
+static inline u32 rotate_left(u32 value, u32 shift)
+{
+    return (value << shift) | (value >> (32 - shift));
+}
+
+static void half_md4_transform(u32 state[4], const u32 input[8])
+{
+    auto f = [](u32 x, u32 y, u32 z) { return z ^ (x & (y ^ z)); };
+    auto g = [](u32 x, u32 y, u32 z) { return (x & y) + ((x ^ y) & z); };
+    auto h = [](u32 x, u32 y, u32 z) { return x ^ y ^ z; };
+    constexpr u32 k2 = 013240474631;
+    constexpr u32 k3 = 015666365641;
+
+    u32 a = state[0], b = state[1], c = state[2], d = state[3];
+    auto round = [](auto function, u32& a, u32 b, u32 c, u32 d, u32 x, u32 shift) {
+        a = rotate_left(a + function(b, c, d) + x, shift);
+    };
+
+    round(f, a, b, c, d, input[0], 3);
+    round(f, d, a, b, c, input[1], 7);
+    round(f, c, d, a, b, input[2], 11);
+    round(f, b, c, d, a, input[3], 19);
+    round(f, a, b, c, d, input[4], 3);
+    round(f, d, a, b, c, input[5], 7);
+    round(f, c, d, a, b, input[6], 11);
+    round(f, b, c, d, a, input[7], 19);
+
+    round(g, a, b, c, d, input[1] + k2, 3);
+    round(g, d, a, b, c, input[3] + k2, 5);
+    round(g, c, d, a, b, input[5] + k2, 9);
+    round(g, b, c, d, a, input[7] + k2, 13);
+    round(g, a, b, c, d, input[0] + k2, 3);
+    round(g, d, a, b, c, input[2] + k2, 5);
+    round(g, c, d, a, b, input[4] + k2, 9);
+    round(g, b, c, d, a, input[6] + k2, 13);
+
+    round(h, a, b, c, d, input[3] + k3, 3);
+    round(h, d, a, b, c, input[7] + k3, 9);
+    round(h, c, d, a, b, input[2] + k3, 11);
+    round(h, b, c, d, a, input[6] + k3, 15);
+    round(h, a, b, c, d, input[1] + k3, 3);
+    round(h, d, a, b, c, input[5] + k3, 9);
+    round(h, c, d, a, b, input[0] + k3, 11);
+    round(h, b, c, d, a, input[4] + k3, 15);
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+static void tea_transform(u32 state[4], const u32 input[4])
+{
+    u32 sum = 0;
+    u32 b0 = state[0], b1 = state[1];
+    for (int i = 0; i < 16; ++i) {
+        sum += 0x9e3779b9;
+        b0 += ((b1 << 4) + input[0]) ^ (b1 + sum) ^ ((b1 >> 5) + input[1]);
+        b1 += ((b0 << 4) + input[2]) ^ (b0 + sum) ^ ((b0 >> 5) + input[3]);
+    }
+    state[0] += b0;
+    state[1] += b1;
+}
+
+static u32 legacy_htree_hash(const u8* name, size_t length, bool is_unsigned)
+{
+    u32 hash = 0;
+    u32 hash0 = 0x12a3fe2d;
+    u32 hash1 = 0x37abe8f9;
+    for (size_t i = 0; i < length; ++i) {
+        u32 c = is_unsigned ? name[i] : static_cast<u32>(static_cast<i32>(static_cast<i8>(name[i])));
+        hash = hash1 + (hash0 ^ (c * 7152373));
+        if (hash & 0x80000000)
+            hash -= 0x7fffffff;
+        hash1 = hash0;
+        hash0 = hash;
+    }
+    return hash0 << 1;
+}
+
+static Optional<u32> compute_htree_hash(const StringView& name, u8 hash_version, const u32 seed[4])
+{
+    u32 state[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    if (seed[0] || seed[1] || seed[2] || seed[3])
+        __builtin_memcpy(state, seed, sizeof(state));
+
+    auto* characters = reinterpret_cast<const u8*>(name.characters_without_null_termination());
+    size_t length = name.length();
+    u32 input[8];
+    u32 hash = 0;
+
+    switch (hash_version) {
+    case EXT2_HASH_LEGACY:
+    case EXT2_HASH_LEGACY_UNSIGNED:
+        hash = legacy_htree_hash(characters, length, hash_version == EXT2_HASH_LEGACY_UNSIGNED);
+        break;
+    case EXT2_HASH_HALF_MD4:
+    case EXT2_HASH_HALF_MD4_UNSIGNED:
+        for (size_t offset = 0; offset < length; offset += 32) {
+            htree_string_to_hash_buffer(characters + offset, length - offset, input, 8, hash_version == EXT2_HASH_HALF_MD4_UNSIGNED);
+            half_md4_transform(state, input);
+        }
+        hash = state[1];
+        break;
+    case EXT2_HASH_TEA:
+    case EXT2_HASH_TEA_UNSIGNED:
+        for (size_t offset = 0; offset < length; offset += 16) {
+            htree_string_to_hash_buffer(characters + offset, length - offset, input, 4, hash_version == EXT2_HASH_TEA_UNSIGNED);
+            tea_transform(state, input);
+        }
+        hash = state[0];
+        break;
+    default:
+        return {};
+    }
+
+    hash &= ~1u;
+    if (hash == (htree_end_of_file << 1))
+        hash = (htree_end_of_file - 1) << 1;
+    return hash;
+}
+
 NonnullRefPtr<Ext2FS> Ext2FS::create(FileDescription& file_description)
 {
     return adopt(*new Ext2FS(file_description));
@@ -87,14 +240,12 @@ Ext2FS::~Ext2FS()
 {
 }
 
-bool Ext2FS::flush_super_block()
+KResult Ext2FS::flush_super_block()
 {
     LOCKER(m_lock);
     VERIFY((sizeof(ext2_super_block) % logical_block_size()) == 0);
     auto super_block_buffer = UserOrKernelBuffer::for_kernel_buffer((u8*)&m_super_block);
-    bool success = raw_write_blocks(2, (sizeof(ext2_super_block) / logical_block_size()), super_block_buffer);
-    VERIFY(success);
-    return true;
+    return raw_write_blocks(2, (sizeof(ext2_super_block) / logical_block_size()), super_block_buffer);
 }
 
 const ext2_group_desc& Ext2FS::group_descriptor(GroupIndex group_index) const
@@ -110,8 +261,11 @@ bool Ext2FS::initialize()
     LOCKER(m_lock);
     VERIFY((sizeof(ext2_super_block) % logical_block_size()) == 0);
     auto super_block_buffer = UserOrKernelBuffer::for_kernel_buffer((u8*)&m_super_block);
-    bool success = raw_read_blocks(2, (sizeof(ext2_super_block) / logical_block_size()), super_block_buffer);
-    VERIFY(success);
+    auto super_block_result = raw_read_blocks(2, (sizeof(ext2_super_block) / logical_block_size()), super_block_buffer);
+    if (super_block_result.is_error()) {
+        dbgln("Ext2FS: Failed to read super block: {}", super_block_result.error());
+        return false;
+    }
 
     auto& super_block = this->super_block();
     if constexpr (EXT2_DEBUG) {
@@ -670,6 +824,8 @@ void Ext2FS::free_inode(Ext2FSInode& inode)
     VERIFY(inode.m_raw_inode.i_links_count == 0);
     dbgln_if(EXT2_DEBUG, "Ext2FS[{}]::free_inode(): Inode {} has no more links, time to delete!", fsid(), inode.index());
 
+    discard_preallocation(inode.index());
+
     // Mark all blocks used by this inode as free.
     for (auto block_index : inode.compute_block_list_with_meta_blocks()) {
         VERIFY(block_index <= super_block().s_blocks_count);
@@ -711,12 +867,18 @@ void Ext2FS::flush_block_group_descriptor_table()
         dbgln("Ext2FS[{}]::flush_block_group_descriptor_table(): Failed to write blocks: {}", fsid(), result.error());
 }
 
-void Ext2FS::flush_writes()
+KResult Ext2FS::flush_writes()
 {
     LOCKER(m_lock);
+    KResult first_error = KSuccess;
     if (m_super_block_dirty) {
-        flush_super_block();
-        m_super_block_dirty = false;
+        auto result = flush_super_block();
+        if (result.is_error()) {
+            dbgln("Ext2FS[{}]::flush_writes(): Failed to write super block: {}", fsid(), result.error());
+            first_error = result;
+        } else {
+            m_super_block_dirty = false;
+        }
     }
     if (m_block_group_descriptors_dirty) {
         flush_block_group_descriptor_table();
@@ -728,13 +890,18 @@ void Ext2FS::flush_writes()
             auto result = write_block(cached_bitmap->bitmap_block_index, buffer, block_size());
             if (result.is_error()) {
                 dbgln("Ext2FS[{}]::flush_writes(): Failed to write blocks: {}", fsid(), result.error());
+                if (!first_error.is_error())
+                    first_error = result;
+                continue;
             }
             cached_bitmap->dirty = false;
             dbgln_if(EXT2_DEBUG, "Ext2FS[{}]::flush_writes(): Flushed bitmap block {}", fsid(), cached_bitmap->bitmap_block_index);
         }
     }
 
-    BlockBasedFS::flush_writes();
+    auto result = BlockBasedFS::flush_writes();
+    if (result.is_error() && !first_error.is_error())
+        first_error = result;
 
     // Uncache Inodes that are only kept alive by the index-to-inode lookup cache.
     // We don't uncache Inodes that are being watched by at least one InodeWatcher.
@@ -752,6 +919,7 @@ void Ext2FS::flush_writes()
     }
     for (auto index : unused_inodes)
         uncache_inode(index);
+    return first_error;
 }
 
 Ext2FSInode::Ext2FSInode(Ext2FS& fs, InodeIndex index)
@@ -763,6 +931,24 @@ Ext2FSInode::~Ext2FSInode()
 {
     if (m_raw_inode.i_links_count == 0)
         fs().free_inode(*this);
+    else
+        fs().discard_preallocation(index());
+}
+
+KResult Ext2FSInode::attach(FileDescription&)
+{
+    LOCKER(m_lock);
+    ++m_attached_description_count;
+    return KSuccess;
+}
+
+void Ext2FSInode::detach(FileDescription&)
+{
+    LOCKER(m_lock);
+    VERIFY(m_attached_description_count);
+    // Once the last description is closed, nobody is going to keep appending to this file.
+    if (--m_attached_description_count == 0)
+        fs().discard_preallocation(index());
 }
 
 u64 Ext2FSInode::size() const
@@ -804,13 +990,6 @@ void Ext2FSInode::flush_metadata()
     LOCKER(m_lock);
     dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::flush_metadata(): Flushing inode", identifier());
     fs().write_ext2_inode(index(), m_raw_inode);
-    if (is_directory()) {
-        // Unless we're about to go away permanently, invalidate the lookup cache.
-        if (m_raw_inode.i_links_count != 0) {
-            // FIXME: This invalidation is way too hardcore. It's sad to throw away the whole cache.
-            m_lookup_cache.clear();
-        }
-    }
     set_metadata_dirty(false);
 }
 
@@ -851,6 +1030,16 @@ RefPtr<Inode> Ext2FS::get_inode(InodeIdentifier inode) const
 }
 
 ssize_t Ext2FSInode::read_bytes(off_t offset, ssize_t count, UserOrKernelBuffer& buffer, FileDescription* description) const
+{
+    return read_bytes_impl(offset, count, buffer, description, !description || !description->is_direct());
+}
+
+ssize_t Ext2FSInode::read_bytes_uncached(off_t offset, ssize_t count, UserOrKernelBuffer& buffer) const
+{
+    return read_bytes_impl(offset, count, buffer, nullptr, false);
+}
+
+ssize_t Ext2FSInode::read_bytes_impl(off_t offset, ssize_t count, UserOrKernelBuffer& buffer, FileDescription* description, bool allow_cache) const
 {
     Locker inode_locker(m_lock);
     VERIFY(offset >= 0);
@@ -867,22 +1056,18 @@ ssize_t Ext2FSInode::read_bytes(off_t offset, ssize_t count, UserOrKernelBuffer&
         return nread;
     }
 
-    if (m_block_list.is_empty())
-        m_block_list = compute_block_list();
-
-    if (m_block_list.is_empty()) {
+    auto block_count = data_block_count();
+    if (block_count == 0) {
         dmesgln("Ext2FSInode[{}]::read_bytes(): Empty block list", identifier());
         return -EIO;
     }
 
-    bool allow_cache = !description || !description->is_direct();
-
     const int block_size = fs().block_size();
 
-    BlockBasedFS::BlockIndex first_block_logical_index = offset / block_size;
-    BlockBasedFS::BlockIndex last_block_logical_index = (offset + count) / block_size;
-    if (last_block_logical_index >= m_block_list.size())
-        last_block_logical_index = m_block_list.size() - 1;
+    size_t first_block_logical_index = offset / block_size;
+    size_t last_block_logical_index = (offset + count) / block_size;
+    if (last_block_logical_index >= block_count)
+        last_block_logical_index = block_count - 1;
 
     int offset_into_first_block = offset % block_size;
 
@@ -891,24 +1076,270 @@ ssize_t Ext2FSInode::read_bytes(off_t offset, ssize_t count, UserOrKernelBuffer&
 
     dbgln_if(EXT2_VERY_DEBUG, "Ext2FSInode[{}]::read_bytes(): Reading up to {} bytes, {} bytes into inode to {}", identifier(), count, offset, buffer.user_or_kernel_ptr());
 
-    for (auto bi = first_block_logical_index; remaining_count && bi <= last_block_logical_index; bi = bi.value() + 1) {
-        auto block_index = m_block_list[bi.value()];
-        VERIFY(block_index.value());
+    if (allow_cache && remaining_count > 0 && last_block_logical_index > first_block_logical_index) {
+        // Bring in everything we're about to copy out, so contiguous blocks are fetched with one device request.
+        auto blocks_or_error = blocks_in_range(first_block_logical_index, last_block_logical_index - first_block_logical_index + 1);
+        if (blocks_or_error.is_error())
+            return blocks_or_error.error();
+        const_cast<Ext2FS&>(fs()).read_ahead_blocks(blocks_or_error.value());
+    }
+
+    for (auto bi = first_block_logical_index; remaining_count > 0 && bi <= last_block_logical_index; ++bi) {
         size_t offset_into_block = (bi == first_block_logical_index) ? offset_into_first_block : 0;
         size_t num_bytes_to_copy = min((off_t)block_size - offset_into_block, remaining_count);
+        size_t max_run_length = 1;
+        if (!allow_cache && offset_into_block == 0)
+            max_run_length = min(static_cast<size_t>(remaining_count / block_size), last_block_logical_index - bi + 1);
+
+        auto run_or_error = block_run_at(bi, max(max_run_length, (size_t)1));
+        if (run_or_error.is_error())
+            return run_or_error.error();
+        auto run = run_or_error.value();
         auto buffer_offset = buffer.offset(nread);
-        int err = fs().read_block(block_index, &buffer_offset, num_bytes_to_copy, offset_into_block, allow_cache);
-        if (err < 0) {
-            dmesgln("Ext2FSInode[{}]::read_bytes(): Failed to read block {} (index {})", identifier(), block_index.value(), bi);
-            return err;
+
+        if (!run.first_block.value()) {
+            // A hole in a sparse file reads back as zeroes.
+            if (!buffer_offset.memset(0, num_bytes_to_copy))
+                return -EFAULT;
+        } else if (max_run_length > 1 && run.length > 1) {
+            // Unbuffered reads go straight to the device, so hand it whole runs of adjacent blocks at once.
+            auto result = fs().read_blocks(run.first_block, run.length, buffer_offset, false);
+            if (result.is_error()) {
+                dmesgln("Ext2FSInode[{}]::read_bytes(): Failed to read {} blocks at {} (index {})", identifier(), run.length, run.first_block, bi);
+                return result;
+            }
+            remaining_count -= run.length * block_size;
+            nread += run.length * block_size;
+            bi += run.length - 1;
+            continue;
+        } else {
+            int err = fs().read_block(run.first_block, &buffer_offset, num_bytes_to_copy, offset_into_block, allow_cache);
+            if (err < 0) {
+                dmesgln("Ext2FSInode[{}]::read_bytes(): Failed to read block {} (index {})", identifier(), run.first_block, bi);
+                return err;
+            }
         }
         remaining_count -= num_bytes_to_copy;
         nread += num_bytes_to_copy;
     }
 
+    u64 read_ahead_offset;
+    size_t read_ahead_size;
+    if (allow_cache && description && description->should_read_ahead(offset, nread, read_ahead_offset, read_ahead_size) && read_ahead_offset < size()) {
+        // Fetch the next window in the background so the reader doesn't stall on the disk every time.
+        g_fs_work->queue([fs = NonnullRefPtr<FS>(const_cast<Ext2FS&>(fs())), inode = NonnullRefPtr<Ext2FSInode>(const_cast<Ext2FSInode&>(*this)), read_ahead_offset, read_ahead_size]() mutable {
+            inode->read_ahead(read_ahead_offset, read_ahead_size);
+        });
+    }
+
     return nread;
 }
 
+void Ext2FSInode::read_ahead(u64 offset, size_t count)
+{
+    Vector<BlockBasedFS::BlockIndex> blocks;
+    {
+        Locker inode_locker(m_lock);
+        if (offset >= size() || !data_block_count())
+            return;
+        count = min(static_cast<u64>(count), size() - offset);
+        const size_t block_size = fs().block_size();
+        size_t first_block_logical_index = offset / block_size;
+        size_t last_block_logical_index = min((offset + count - 1) / block_size, static_cast<u64>(data_block_count() - 1));
+        auto blocks_or_error = blocks_in_range(first_block_logical_index, last_block_logical_index - first_block_logical_index + 1);
+        if (blocks_or_error.is_error())
+            return;
+        blocks = blocks_or_error.release_value();
+    }
+    fs().read_ahead_blocks(blocks);
+}
+
+size_t Ext2FSInode::data_block_count() const
+{
+    if (is_symlink() && m_raw_inode.i_blocks == 0)
+        return 0;
+    return ceil_div(size(), static_cast<u64>(fs().block_size()));
+}
+
+size_t Ext2FSInode::block_map_leaf_start(size_t logical_index) const
+{
+    // A leaf is the direct block array in the inode, or one of the indirect blocks that hold data block pointers.
+    size_t entries_per_block = EXT2_ADDR_PER_BLOCK(&fs().super_block());
+    if (logical_index < EXT2_NDIR_BLOCKS)
+        return 0;
+    return logical_index - (logical_index - EXT2_NDIR_BLOCKS) % entries_per_block;
+}
+
+KResultOr<BlockBasedFS::BlockIndex> Ext2FSInode::read_block_pointer(BlockBasedFS::BlockIndex array_block, size_t index) const
+{
+    if (!array_block.value())
+        return BlockBasedFS::BlockIndex {};
+    u32 pointer = 0;
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer((u8*)&pointer);
+    auto result = fs().read_block(array_block, &buffer, sizeof(u32), index * sizeof(u32));
+    if (result.is_error())
+        return result;
+    return BlockBasedFS::BlockIndex { pointer };
+}
+
+KResult Ext2FSInode::load_block_map_leaf(size_t logical_index) const
+{
+    VERIFY(m_lock.is_locked());
+    size_t entries_per_block = EXT2_ADDR_PER_BLOCK(&fs().super_block());
+    size_t leaf_start = block_map_leaf_start(logical_index);
+    size_t entry_count = leaf_start < EXT2_NDIR_BLOCKS ? EXT2_NDIR_BLOCKS : entries_per_block;
+    entry_count = min(entry_count, data_block_count() - leaf_start);
+
+    Vector<u32> entries;
+    entries.resize(entry_count);
+    if (leaf_start < EXT2_NDIR_BLOCKS) {
+        memcpy(entries.data(), m_raw_inode.i_block, entry_count * sizeof(u32));
+    } else {
+        // Walk down from the inode to the indirect block holding the pointers for this leaf.
+        BlockBasedFS::BlockIndex leaf_block;
+        size_t leaf_number = (leaf_start - EXT2_NDIR_BLOCKS) / entries_per_block;
+        if (leaf_number == 0) {
+            leaf_block = m_raw_inode.i_block[EXT2_IND_BLOCK];
+        } else if (leaf_number <= entries_per_block) {
+            auto block_or_error = read_block_pointer(m_raw_inode.i_block[EXT2_DIND_BLOCK], leaf_number - 1);
+            if (block_or_error.is_error())
+                return block_or_error.error();
+            leaf_block = block_or_error.value();
+        } else {
+            leaf_number -= entries_per_block + 1;
+            auto doubly_indirect_block_or_error = read_block_pointer(m_raw_inode.i_block[EXT2_TIND_BLOCK], leaf_number / entries_per_block);
+            if (doubly_indirect_block_or_error.is_error())
+                return doubly_indirect_block_or_error.error();
+            auto block_or_error = read_block_pointer(doubly_indirect_block_or_error.value(), leaf_number % entries_per_block);
+            if (block_or_error.is_error())
+                return block_or_error.error();
+            leaf_block = block_or_error.value();
+        }
+
+        if (leaf_block.value()) {
+            auto buffer = UserOrKernelBuffer::for_kernel_buffer((u8*)entries.data());
+            auto result = fs().read_block(leaf_block, &buffer, entry_count * sizeof(u32));
+            if (result.is_error())
+                return result;
+        } else {
+            memset(entries.data(), 0, entry_count * sizeof(u32));
+        }
+    }
+
+    // Find where this leaf's runs go in the (sorted) map.
+    size_t insertion_index = 0;
+    size_t upper = m_block_map.size();
+    while (insertion_index < upper) {
+        size_t middle = (insertion_index + upper) / 2;
+        if (m_block_map[middle].logical_index < leaf_start)
+            insertion_index = middle + 1;
+        else
+            upper = middle;
+    }
+
+    for (size_t i = 0; i < entry_count;) {
+        if (!entries[i]) {
+            ++i;
+            continue;
+        }
+        BlockRun run { leaf_start + i, entries[i], 1 };
+        while (i + run.length < entry_count && entries[i + run.length] == run.first_block.value() + run.length)
+            ++run.length;
+        i += run.length;
+
+        if (insertion_index > 0) {
+            auto& previous = m_block_map[insertion_index - 1];
+            if (previous.logical_index + previous.length == run.logical_index && previous.first_block.value() + previous.length == run.first_block.value()) {
+                previous.length += run.length;
+                continue;
+            }
+        }
+        m_block_map.insert(insertion_index++, run);
+    }
+
+    // The leaf after us may have been loaded already and continue our last run.
+    if (insertion_index > 0 && insertion_index < m_block_map.size()) {
+        auto& previous = m_block_map[insertion_index - 1];
+        auto& next = m_block_map[insertion_index];
+        if (previous.logical_index + previous.length == next.logical_index && previous.first_block.value() + previous.length == next.first_block.value()) {
+            previous.length += next.length;
+            m_block_map.remove(insertion_index);
+        }
+    }
+
+    m_block_map_loaded_leaves.set(leaf_start);
+    return KSuccess;
+}
+
+auto Ext2FSInode::block_run_at(size_t logical_index, size_t max_length) const -> KResultOr<BlockRun>
+{
+    VERIFY(m_lock.is_locked());
+    VERIFY(max_length > 0);
+
+    // If we're in the middle of writing, the full block list is already around and authoritative.
+    if (!m_block_list.is_empty()) {
+        if (logical_index >= m_block_list.size() || !m_block_list[logical_index].value())
+            return BlockRun { logical_index, 0, 1 };
+        auto first_block = m_block_list[logical_index].value();
+        size_t length = 1;
+        while (length < max_length
+            && logical_index + length < m_block_list.size()
+            && m_block_list[logical_index + length].value() == first_block + length)
+            ++length;
+        return BlockRun { logical_index, first_block, length };
+    }
+
+    if (!m_block_map_loaded_leaves.contains(block_map_leaf_start(logical_index))) {
+        auto result = load_block_map_leaf(logical_index);
+        if (result.is_error())
+            return result;
+    }
+
+    // Find the last run starting at or before the logical index.
+    size_t lower = 0;
+    size_t upper = m_block_map.size();
+    while (lower < upper) {
+        size_t middle = (lower + upper) / 2;
+        if (m_block_map[middle].logical_index <= logical_index)
+            lower = middle + 1;
+        else
+            upper = middle;
+    }
+    if (lower == 0)
+        return BlockRun { logical_index, 0, 1 };
+    auto& run = m_block_map[lower - 1];
+    if (logical_index >= run.logical_index + run.length)
+        return BlockRun { logical_index, 0, 1 };
+
+    size_t offset_into_run = logical_index - run.logical_index;
+    size_t length = min(run.length - offset_into_run, max_length);
+    return BlockRun { logical_index, run.first_block.value() + offset_into_run, length };
+}
+
+KResultOr<Vector<BlockBasedFS::BlockIndex>> Ext2FSInode::blocks_in_range(size_t first_logical_index, size_t count) const
+{
+    Vector<BlockBasedFS::BlockIndex> blocks;
+    blocks.ensure_capacity(count);
+    for (size_t bi = first_logical_index; bi < first_logical_index + count;) {
+        auto run_or_error = block_run_at(bi, first_logical_index + count - bi);
+        if (run_or_error.is_error())
+            return run_or_error.error();
+        auto& run = run_or_error.value();
+        if (run.first_block.value()) {
+            for (size_t i = 0; i < run.length; ++i)
+                blocks.unchecked_append(run.first_block.value() + i);
+        }
+        bi += run.length;
+    }
+    return blocks;
+}
+
+void Ext2FSInode::invalidate_block_map()
+{
+    m_block_map.clear();
+    m_block_map_loaded_leaves.clear();
+}
+
 KResult Ext2FSInode::resize(u64 new_size)
 {
     auto old_size = size();
@@ -937,7 +1368,10 @@ KResult Ext2FSInode::resize(u64 new_size)
         m_block_list = this->compute_block_list();
 
     if (blocks_needed_after > blocks_needed_before) {
-        auto blocks_or_error = fs().allocate_blocks(fs().group_index_from_inode(index()), blocks_needed_after - blocks_needed_before);
+        BlockBasedFS::BlockIndex goal = m_block_list.is_empty() ? 0 : m_block_list.last().value();
+        if (goal.value())
+            goal = goal.value() + 1;
+        auto blocks_or_error = fs().allocate_blocks_for_inode(index(), goal, blocks_needed_after - blocks_needed_before);
         if (blocks_or_error.is_error())
             return blocks_or_error.error();
         m_block_list.append(blocks_or_error.release_value());
@@ -960,6 +1394,8 @@ KResult Ext2FSInode::resize(u64 new_size)
         }
     }
 
+    invalidate_block_map();
+
     auto result = flush_block_list();
     if (result.is_error())
         return result;
@@ -1022,18 +1458,16 @@ ssize_t Ext2FSInode::write_bytes(off_t offset, ssize_t count, const UserOrKernel
     if (resize_result.is_error())
         return resize_result;
 
-    if (m_block_list.is_empty())
-        m_block_list = compute_block_list();
-
-    if (m_block_list.is_empty()) {
+    auto block_count = data_block_count();
+    if (block_count == 0) {
         dbgln("Ext2FSInode[{}]::write_bytes(): Empty block list", identifier());
         return -EIO;
     }
 
-    BlockBasedFS::BlockIndex first_block_logical_index = offset / block_size;
-    BlockBasedFS::BlockIndex last_block_logical_index = (offset + count) / block_size;
-    if (last_block_logical_index >= m_block_list.size())
-        last_block_logical_index = m_block_list.size() - 1;
+    size_t first_block_logical_index = offset / block_size;
+    size_t last_block_logical_index = (offset + count) / block_size;
+    if (last_block_logical_index >= block_count)
+        last_block_logical_index = block_count - 1;
 
     size_t offset_into_first_block = offset % block_size;
 
@@ -1042,13 +1476,40 @@ ssize_t Ext2FSInode::write_bytes(off_t offset, ssize_t count, const UserOrKernel
 
     dbgln_if(EXT2_VERY_DEBUG, "Ext2FSInode[{}]::write_bytes(): Writing {} bytes, {} bytes into inode from {}", identifier(), count, offset, data.user_or_kernel_ptr());
 
-    for (auto bi = first_block_logical_index; remaining_count && bi <= last_block_logical_index; bi = bi.value() + 1) {
+    for (auto bi = first_block_logical_index; remaining_count > 0 && bi <= last_block_logical_index; ++bi) {
         size_t offset_into_block = (bi == first_block_logical_index) ? offset_into_first_block : 0;
         size_t num_bytes_to_copy = min((off_t)block_size - offset_into_block, remaining_count);
-        dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::write_bytes(): Writing block {} (offset_into_block: {})", identifier(), m_block_list[bi.value()], offset_into_block);
-        result = fs().write_block(m_block_list[bi.value()], data.offset(nwritten), num_bytes_to_copy, offset_into_block, allow_cache);
+        size_t max_run_length = 1;
+        if (!allow_cache && offset_into_block == 0)
+            max_run_length = min(static_cast<size_t>(remaining_count / block_size), last_block_logical_index - bi + 1);
+
+        auto run_or_error = block_run_at(bi, max(max_run_length, (size_t)1));
+        if (run_or_error.is_error())
+            return run_or_error.error();
+        auto run = run_or_error.value();
+        if (!run.first_block.value()) {
+            dbgln("Ext2FSInode[{}]::write_bytes(): No block allocated at index {}", identifier(), bi);
+            return -EIO;
+        }
+
+        if (max_run_length > 1 && run.length > 1) {
+            // Unbuffered writes go straight to the device, so hand it whole runs of adjacent blocks at once.
+            dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::write_bytes(): Writing {} blocks at {}", identifier(), run.length, run.first_block);
+            result = fs().write_blocks(run.first_block, run.length, data.offset(nwritten), false);
+            if (result.is_error()) {
+                dbgln("Ext2FSInode[{}]::write_bytes(): Failed to write {} blocks at {} (index {})", identifier(), run.length, run.first_block, bi);
+                return result;
+            }
+            remaining_count -= run.length * block_size;
+            nwritten += run.length * block_size;
+            bi += run.length - 1;
+            continue;
+        }
+
+        dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::write_bytes(): Writing block {} (offset_into_block: {})", identifier(), run.first_block, offset_into_block);
+        result = fs().write_block(run.first_block, data.offset(nwritten), num_bytes_to_copy, offset_into_block, allow_cache);
         if (result.is_error()) {
-            dbgln("Ext2FSInode[{}]::write_bytes(): Failed to write block {} (index {})", identifier(), m_block_list[bi.value()], bi);
+            dbgln("Ext2FSInode[{}]::write_bytes(): Failed to write block {} (index {})", identifier(), run.first_block, bi);
             return result;
         }
         remaining_count -= num_bytes_to_copy;
@@ -1115,6 +1576,7 @@ KResult Ext2FSInode::traverse_as_directory(Function<bool(const FS::DirectoryEntr
 KResult Ext2FSInode::write_directory(const Vector<Ext2FSDirectoryEntry>& entries)
 {
     LOCKER(m_lock);
+    drop_htree_index();
 
     int directory_size = 0;
     for (auto& entry : entries)
@@ -1169,6 +1631,225 @@ KResultOr<NonnullRefPtr<Inode>> Ext2FSInode::create_child(const String& name, mo
     return fs().create_inode(*this, name, mode, dev, uid, gid);
 }
 
+KResult Ext2FSInode::read_directory_block(size_t logical_index, ByteBuffer& block) const
+{
+    auto block_size = fs().block_size();
+    if ((logical_index + 1) * block_size > size())
+        return EIO;
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(block.data());
+    ssize_t nread = read_bytes(logical_index * block_size, block_size, buffer, nullptr);
+    if (nread < 0)
+        return KResult((ErrnoCode)-nread);
+    if (static_cast<size_t>(nread) != block_size)
+        return EIO;
+    return KSuccess;
+}
+
+KResult Ext2FSInode::write_directory_block(size_t logical_index, const ByteBuffer& block)
+{
+    auto block_size = fs().block_size();
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(const_cast<u8*>(block.data()));
+    ssize_t nwritten = write_bytes(logical_index * block_size, block_size, buffer, nullptr);
+    if (nwritten < 0)
+        return KResult((ErrnoCode)-nwritten);
+    set_metadata_dirty(true);
+    if (static_cast<size_t>(nwritten) != block_size)
+        return EIO;
+    return KSuccess;
+}
+
+static bool is_valid_directory_record(const ext2_dir_entry_2& entry, size_t offset, size_t block_size)
+{
+    return entry.rec_len >= 8 && (entry.rec_len % 4) == 0 && offset + entry.rec_len <= block_size && EXT2_DIR_REC_LEN(entry.name_len) <= entry.rec_len;
+}
+
+bool Ext2FSInode::is_htree_indexed() const
+{
+    return (m_raw_inode.i_flags & EXT2_INDEX_FL) && (fs().super_block().s_feature_compat & EXT2_FEATURE_COMPAT_DIR_INDEX);
+}
+
+void Ext2FSInode::drop_htree_index()
+{
+    // We don't keep the htree up to date when modifying a directory, so we turn it back into a
+    // plain linear one instead. Every htree block is also a valid linear directory block.
+    if (!(m_raw_inode.i_flags & EXT2_INDEX_FL))
+        return;
+    dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::drop_htree_index(): Directory is being modified, dropping its htree index", identifier());
+    m_raw_inode.i_flags &= ~EXT2_INDEX_FL;
+    set_metadata_dirty(true);
+}
+
+KResultOr<InodeIndex> Ext2FSInode::lookup_in_htree(const StringView& name) const
+{
+    LOCKER(m_lock);
+    VERIFY(is_htree_indexed());
+
+    auto block_size = fs().block_size();
+    auto block = ByteBuffer::create_uninitialized(block_size);
+    auto result = read_directory_block(0, block);
+    if (result.is_error())
+        return result;
+
+    // The root block starts with the "." and ".." entries, the latter spanning the rest of the
+    // block, so that the index that follows them is invisible to a linear directory scan.
+    constexpr size_t root_info_offset = 24;
+    auto& root_info = *reinterpret_cast<const ext2_dx_root_info*>(block.data() + root_info_offset);
+    if (root_info.reserved_zero != 0 || root_info.info_length != sizeof(ext2_dx_root_info) || root_info.indirect_levels > max_htree_indirect_levels)
+        return EINVAL;
+    u8 indirect_levels = root_info.indirect_levels;
+
+    auto& super_block = fs().super_block();
+    u8 hash_version = root_info.hash_version;
+    if (hash_version <= EXT2_HASH_TEA && (super_block.s_flags & EXT2_FLAGS_UNSIGNED_HASH))
+        hash_version += EXT2_HASH_LEGACY_UNSIGNED;
+    auto maybe_hash = compute_htree_hash(name, hash_version, super_block.s_hash_seed);
+    if (!maybe_hash.has_value())
+        return EINVAL;
+    u32 hash = maybe_hash.value();
+
+    size_t entries_offset = root_info_offset + root_info.info_length;
+    Vector<u32> collision_blocks;
+    for (u8 level = 0; level <= indirect_levels; ++level) {
+        // The first entry holds the count and limit in place of a hash, and covers every hash
+        // below that of the second one.
+        auto* entries = reinterpret_cast<const ext2_dx_entry*>(block.data() + entries_offset);
+        auto& count_limit = *reinterpret_cast<const ext2_dx_countlimit*>(entries);
+        if (count_limit.count == 0 || count_limit.count > count_limit.limit || entries_offset + count_limit.limit * sizeof(ext2_dx_entry) > block_size)
+            return EINVAL;
+
+        size_t low = 1;
+        size_t high = count_limit.count;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (entries[middle].hash > hash)
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        size_t index = low - 1;
+
+        // Names with the same hash may spill over into the following leaves, which are then
+        // marked by setting the low bit of their hash.
+        if (level == indirect_levels) {
+            for (size_t next = index + 1; next < count_limit.count && (entries[next].hash & 1) && (entries[next].hash & ~1u) == hash; ++next)
+                collision_blocks.append(entries[next].block & 0x0fffffff);
+        }
+
+        result = read_directory_block(entries[index].block & 0x0fffffff, block);
+        if (result.is_error())
+            return result;
+
+        // Interior nodes start with an empty entry spanning the whole block.
+        entries_offset = 8;
+    }
+
+    auto search_leaf = [&]() -> KResultOr<InodeIndex> {
+        for (size_t offset = 0; offset < block_size;) {
+            auto& entry = *reinterpret_cast<const ext2_dir_entry_2*>(block.data() + offset);
+            if (!is_valid_directory_record(entry, offset, block_size))
+                return EINVAL;
+            if (entry.inode != 0 && name == StringView(entry.name, entry.name_len))
+                return InodeIndex(entry.inode);
+            offset += entry.rec_len;
+        }
+        return InodeIndex(0);
+    };
+
+    auto index_or_error = search_leaf();
+    for (auto collision_block : collision_blocks) {
+        if (index_or_error.is_error() || index_or_error.value() != 0)
+            break;
+        // Don't search a stale or half-filled buffer if the next leaf can't be read.
+        result = read_directory_block(collision_block, block);
+        if (result.is_error())
+            return result;
+        index_or_error = search_leaf();
+    }
+    return index_or_error;
+}
+
+KResult Ext2FSInode::append_directory_entry(const StringView& name, InodeIndex child_index, u8 file_type)
+{
+    LOCKER(m_lock);
+    drop_htree_index();
+
+    auto block_size = fs().block_size();
+    size_t block_count = size() / block_size;
+    size_t record_length = EXT2_DIR_REC_LEN(name.length());
+    auto block = ByteBuffer::create_zeroed(block_size);
+
+    auto fill_entry = [&](size_t offset, size_t entry_record_length) {
+        auto& entry = *reinterpret_cast<ext2_dir_entry_2*>(block.data() + offset);
+        entry.inode = child_index.value();
+        entry.rec_len = entry_record_length;
+        entry.name_len = name.length();
+        entry.file_type = file_type;
+        __builtin_memcpy(entry.name, name.characters_without_null_termination(), name.length());
+    };
+
+    // New entries go into the slack at the end of the last block (or an unused record in it),
+    // so adding a name doesn't require rewriting the whole directory.
+    if (block_count > 0) {
+        auto result = read_directory_block(block_count - 1, block);
+        if (result.is_error())
+            return result;
+        for (size_t offset = 0; offset < block_size;) {
+            auto& entry = *reinterpret_cast<ext2_dir_entry_2*>(block.data() + offset);
+            if (!is_valid_directory_record(entry, offset, block_size))
+                return EIO;
+            if (entry.inode == 0 && entry.rec_len >= record_length) {
+                fill_entry(offset, entry.rec_len);
+                return write_directory_block(block_count - 1, block);
+            }
+            size_t used_length = EXT2_DIR_REC_LEN(entry.name_len);
+            if (entry.inode != 0 && entry.rec_len - used_length >= record_length) {
+                size_t remaining_length = entry.rec_len - used_length;
+                entry.rec_len = used_length;
+                fill_entry(offset + used_length, remaining_length);
+                return write_directory_block(block_count - 1, block);
+            }
+            offset += entry.rec_len;
+        }
+        __builtin_memset(block.data(), 0, block_size);
+    }
+
+    fill_entry(0, block_size);
+    return write_directory_block(block_count, block);
+}
+
+KResult Ext2FSInode::remove_directory_entry(const StringView& name)
+{
+    LOCKER(m_lock);
+    drop_htree_index();
+
+    auto block_size = fs().block_size();
+    size_t block_count = size() / block_size;
+    auto block = ByteBuffer::create_uninitialized(block_size);
+
+    for (size_t block_index = 0; block_index < block_count; ++block_index) {
+        auto result = read_directory_block(block_index, block);
+        if (result.is_error())
+            return result;
+        ext2_dir_entry_2* previous_entry = nullptr;
+        for (size_t offset = 0; offset < block_size;) {
+            auto& entry = *reinterpret_cast<ext2_dir_entry_2*>(block.data() + offset);
+            if (!is_valid_directory_record(entry, offset, block_size))
+                return EIO;
+            if (entry.inode != 0 && name == StringView(entry.name, entry.name_len)) {
+                // Fold the record into the one before it, or mark it unused if it's the first in its block.
+                if (previous_entry)
+                    previous_entry->rec_len += entry.rec_len;
+                else
+                    entry.inode = 0;
+                return write_directory_block(block_index, block);
+            }
+            previous_entry = &entry;
+            offset += entry.rec_len;
+        }
+    }
+    return ENOENT;
+}
+
 KResult Ext2FSInode::add_child(Inode& child, const StringView& name, mode_t mode)
 {
     LOCKER(m_lock);
@@ -1179,36 +1860,23 @@ KResult Ext2FSInode::add_child(Inode& child, const StringView& name, mode_t mode
 
     dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::add_child(): Adding inode {} with name '{}' and mode {:o} to directory {}", identifier(), child.index(), name, mode, index());
 
-    Vector<Ext2FSDirectoryEntry> entries;
-    bool name_already_exists = false;
-    KResult result = traverse_as_directory([&](auto& entry) {
-        if (name == entry.name) {
-            name_already_exists = true;
-            return false;
-        }
-        entries.append({ entry.name, entry.inode.index(), entry.file_type });
-        return true;
-    });
-
-    if (result.is_error())
-        return result;
-
-    if (name_already_exists) {
+    if (!populate_lookup_cache())
+        return EIO;
+    if (m_lookup_cache.find(name.hash(), [&](auto& entry) { return entry.key == name; }) != m_lookup_cache.end()) {
         dbgln("Ext2FSInode[{}]::add_child(): Name '{}' already exists", identifier(), name);
         return EEXIST;
     }
 
-    result = child.increment_link_count();
+    auto result = child.increment_link_count();
     if (result.is_error())
         return result;
 
-    entries.empend(name, child.index(), to_ext2_file_type(mode));
-    result = write_directory(entries);
+    result = append_directory_entry(name, child.index(), to_ext2_file_type(mode));
     if (result.is_error())
         return result;
 
     m_lookup_cache.set(name, child.index());
-    did_add_child(child.identifier());
+    did_add_child(child.identifier(), name);
     return KSuccess;
 }
 
@@ -1218,34 +1886,27 @@ KResult Ext2FSInode::remove_child(const StringView& name)
     dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]::remove_child(): Removing '{}'", identifier(), name);
     VERIFY(is_directory());
 
-    auto it = m_lookup_cache.find(name);
+    if (!populate_lookup_cache())
+        return EIO;
+    auto it = m_lookup_cache.find(name.hash(), [&](auto& entry) { return entry.key == name; });
     if (it == m_lookup_cache.end())
         return ENOENT;
     auto child_inode_index = (*it).value;
 
     InodeIdentifier child_id { fsid(), child_inode_index };
 
-    Vector<Ext2FSDirectoryEntry> entries;
-    KResult result = traverse_as_directory([&](auto& entry) {
-        if (name != entry.name)
-            entries.append({ entry.name, entry.inode.index(), entry.file_type });
-        return true;
-    });
-    if (result.is_error())
-        return result;
-
-    result = write_directory(entries);
+    auto result = remove_directory_entry(name);
     if (result.is_error())
         return result;
 
-    m_lookup_cache.remove(name);
+    m_lookup_cache.remove(it);
 
     auto child_inode = fs().get_inode(child_id);
     result = child_inode->decrement_link_count();
     if (result.is_error())
         return result;
 
-    did_remove_child(child_id);
+    did_remove_child(child_id, name);
     return KSuccess;
 }
 
@@ -1323,9 +1984,39 @@ auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) ->
         auto block_bitmap = cached_bitmap.bitmap(blocks_in_group);
 
         BlockIndex first_block_in_group = (group_index.value() - 1) * blocks_per_group() + first_block_index().value();
+
+        // Preallocated blocks are free as far as the bitmap is concerned, so hide them from the search.
+        Vector<InodeIndex> preallocations_in_group;
+        for (auto& it : m_preallocations) {
+            auto& preallocation = it.value;
+            if (preallocation.first_block.value() + preallocation.count > first_block_in_group.value() && preallocation.first_block.value() < first_block_in_group.value() + blocks_in_group)
+                preallocations_in_group.append(it.key);
+        }
+        Bitmap bitmap_without_preallocations;
+        if (!preallocations_in_group.is_empty()) {
+            bitmap_without_preallocations = Bitmap(blocks_in_group, false);
+            memcpy(bitmap_without_preallocations.data(), block_bitmap.data(), ceil_div(blocks_in_group, 8));
+            for (auto inode_index : preallocations_in_group) {
+                auto& preallocation = m_preallocations.get(inode_index).value();
+                for (size_t i = 0; i < preallocation.count; ++i) {
+                    auto block_index = preallocation.first_block.value() + i;
+                    if (block_index >= first_block_in_group.value() && block_index < first_block_in_group.value() + blocks_in_group)
+                        bitmap_without_preallocations.set(block_index - first_block_in_group.value(), true);
+                }
+            }
+        }
+
         size_t free_region_size = 0;
-        auto first_unset_bit_index = block_bitmap.find_longest_range_of_unset_bits(count - blocks.size(), free_region_size);
-        VERIFY(first_unset_bit_index.has_value());
+        auto first_unset_bit_index = preallocations_in_group.is_empty()
+            ? block_bitmap.find_longest_range_of_unset_bits(count - blocks.size(), free_region_size)
+            : bitmap_without_preallocations.find_longest_range_of_unset_bits(count - blocks.size(), free_region_size);
+        if (!first_unset_bit_index.has_value()) {
+            // Every free block in this group has been set aside for some file, so give those up rather than fail.
+            VERIFY(!preallocations_in_group.is_empty());
+            for (auto inode_index : preallocations_in_group)
+                discard_preallocation(inode_index);
+            continue;
+        }
         dbgln_if(EXT2_DEBUG, "Ext2FS: allocating free region of size: {} [{}]", free_region_size, group_index);
         for (size_t i = 0; i < free_region_size; ++i) {
             BlockIndex block_index = (first_unset_bit_index.value() + i) + first_block_in_group.value();
@@ -1343,6 +2034,99 @@ auto Ext2FS::allocate_blocks(GroupIndex preferred_group_index, size_t count) ->
     return blocks;
 }
 
+bool Ext2FS::is_preallocated_for_other_inode(BlockIndex block_index, InodeIndex inode_index) const
+{
+    for (auto& it : m_preallocations) {
+        if (it.key == inode_index)
+            continue;
+        auto& preallocation = it.value;
+        if (block_index.value() >= preallocation.first_block.value() && block_index.value() < preallocation.first_block.value() + preallocation.count)
+            return true;
+    }
+    return false;
+}
+
+auto Ext2FS::count_free_blocks_at(InodeIndex inode_index, BlockIndex first_block, size_t max_count) -> KResultOr<size_t>
+{
+    LOCKER(m_lock);
+    size_t count = 0;
+    for (; count < max_count; ++count) {
+        BlockIndex block_index = first_block.value() + count;
+        if (!block_index.value() || block_index.value() >= super_block().s_blocks_count)
+            break;
+        if (is_preallocated_for_other_inode(block_index, inode_index))
+            break;
+        auto state_or_error = get_block_allocation_state(block_index);
+        if (state_or_error.is_error())
+            return state_or_error.error();
+        if (state_or_error.value())
+            break;
+    }
+    return count;
+}
+
+auto Ext2FS::allocate_blocks_at(InodeIndex inode_index, BlockIndex first_block, size_t max_count, Vector<BlockIndex>& blocks) -> KResultOr<size_t>
+{
+    LOCKER(m_lock);
+    auto count_or_error = count_free_blocks_at(inode_index, first_block, max_count);
+    if (count_or_error.is_error())
+        return count_or_error.error();
+    for (size_t i = 0; i < count_or_error.value(); ++i) {
+        BlockIndex block_index = first_block.value() + i;
+        auto result = set_block_allocation_state(block_index, true);
+        if (result.is_error())
+            return result;
+        blocks.append(block_index);
+    }
+    return count_or_error.value();
+}
+
+auto Ext2FS::allocate_blocks_for_inode(InodeIndex inode_index, BlockIndex goal, size_t count) -> KResultOr<Vector<BlockIndex>>
+{
+    LOCKER(m_lock);
+    dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_blocks_for_inode(inode: {}, goal: {}, count: {})", inode_index, goal, count);
+    if (count == 0)
+        return Vector<BlockIndex> {};
+
+    Vector<BlockIndex> blocks;
+    blocks.ensure_capacity(count);
+
+    // A preallocation that doesn't start where the file ends won't help it grow contiguously.
+    if (auto preallocation = m_preallocations.get(inode_index); preallocation.has_value() && (!goal.value() || goal != preallocation.value().first_block))
+        discard_preallocation(inode_index);
+
+    // Try to keep extending the file in place. This uses up the inode's own preallocation, if it has one.
+    if (goal.value()) {
+        auto result = allocate_blocks_at(inode_index, goal, count, blocks);
+        if (result.is_error())
+            return result.error();
+    }
+
+    // Whatever is still missing comes from the longest free run in the inode's group.
+    if (blocks.size() < count) {
+        auto blocks_or_error = allocate_blocks(group_index_from_inode(inode_index), count - blocks.size());
+        if (blocks_or_error.is_error())
+            return blocks_or_error.error();
+        blocks.append(blocks_or_error.release_value());
+    }
+
+    // Finally, set aside the blocks following the new end of the file for the next time it grows.
+    m_preallocations.remove(inode_index);
+    BlockIndex window_start = blocks.last().value() + 1;
+    auto window_or_error = count_free_blocks_at(inode_index, window_start, preallocation_window_blocks);
+    if (!window_or_error.is_error() && window_or_error.value())
+        m_preallocations.set(inode_index, { window_start, window_or_error.value() });
+
+    VERIFY(blocks.size() == count);
+    return blocks;
+}
+
+void Ext2FS::discard_preallocation(InodeIndex inode_index)
+{
+    LOCKER(m_lock);
+    m_preallocations.remove(inode_index);
+}
+
 KResultOr<InodeIndex> Ext2FS::allocate_inode(GroupIndex preferred_group)
 {
     dbgln_if(EXT2_DEBUG, "Ext2FS: allocate_inode(preferred_group: {})", preferred_group);
@@ -1436,6 +2220,21 @@ KResultOr<bool> Ext2FS::get_inode_allocation_state(InodeIndex index) const
     return cached_bitmap_or_error.value()->bitmap(inodes_per_group()).get(bit_index);
 }
 
+KResultOr<bool> Ext2FS::get_block_allocation_state(BlockIndex block_index) const
+{
+    VERIFY(block_index != 0);
+    LOCKER(m_lock);
+    auto group_index = group_index_from_block_index(block_index);
+    unsigned index_in_group = (block_index.value() - first_block_index().value()) - ((group_index.value() - 1) * blocks_per_group());
+    unsigned bit_index = index_in_group % blocks_per_group();
+    auto& bgd = group_descriptor(group_index);
+
+    auto cached_bitmap_or_error = const_cast<Ext2FS&>(*this).get_bitmap_block(bgd.bg_block_bitmap);
+    if (cached_bitmap_or_error.is_error())
+        return cached_bitmap_or_error.error();
+    return cached_bitmap_or_error.value()->bitmap(blocks_per_group()).get(bit_index);
+}
+
 KResult Ext2FS::update_bitmap_block(BlockIndex bitmap_block, size_t bit_index, bool new_state, u32& super_block_counter, u16& group_descriptor_counter)
 {
     auto cached_bitmap_or_error = get_bitmap_block(bitmap_block);
@@ -1615,6 +2414,25 @@ RefPtr<Inode> Ext2FSInode::lookup(StringView name)
 {
     VERIFY(is_directory());
     dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]:lookup(): Looking up '{}'", identifier(), name);
+    {
+        // Indexed directories are searched through their htree, reading only a few blocks, until
+        // something needs the full in-memory index anyway.
+        LOCKER(m_lock);
+        if (m_lookup_cache.is_empty() && is_htree_indexed()) {
+            auto index_or_error = lookup_in_htree(name);
+            if (!index_or_error.is_error()) {
+                if (index_or_error.value() == 0)
+                    return {};
+                return fs().get_inode({ fsid(), index_or_error.value() });
+            }
+            // Only a malformed index is worth a linear scan, which would run into the same I/O errors.
+            if (index_or_error.error() != EINVAL) {
+                dbgln("Ext2FSInode[{}]::lookup(): Failed to read htree index: {}", identifier(), index_or_error.error());
+                return {};
+            }
+            dbgln_if(EXT2_DEBUG, "Ext2FSInode[{}]:lookup(): Unusable htree index ({}), falling back to a linear scan", identifier(), index_or_error.error());
+        }
+    }
     if (!populate_lookup_cache())
         return {};
     LOCKER(m_lock);
@@ -1725,6 +2543,8 @@ KResult Ext2FSInode::truncate(u64 size)
     LOCKER(m_lock);
     if (static_cast<u64>(m_raw_inode.i_size) == size)
         return KSuccess;
+    // Whatever was set aside for the old end of the file is no use anymore.
+    fs().discard_preallocation(index());
     auto result = resize(size);
     if (result.is_error())
         return result;
@@ -1736,13 +2556,13 @@ KResultOr<int> Ext2FSInode::get_block_address(int index)
 {
     LOCKER(m_lock);
 
-    if (m_block_list.is_empty())
-        m_block_list = compute_block_list();
-
-    if (index < 0 || (size_t)index >= m_block_list.size())
+    if (index < 0 || (size_t)index >= data_block_count())
         return 0;
 
-    return m_block_list[index].value();
+    auto run_or_error = block_run_at(index);
+    if (run_or_error.is_error())
+        return run_or_error.error();
+    return run_or_error.value().first_block.value();
 }
 
 unsigned Ext2FS::total_block_count() const
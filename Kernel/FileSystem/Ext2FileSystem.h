@@ -28,6 +28,7 @@
 
 #include <AK/BitmapView.h>
 #include <AK/HashMap.h>
+#include <AK/HashTable.h>
 #include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/FileSystem/ext2_fs.h>
@@ -59,6 +60,7 @@ public:
 private:
     // ^Inode
     virtual ssize_t read_bytes(off_t, ssize_t, UserOrKernelBuffer& buffer, FileDescription*) const override;
+    virtual ssize_t read_bytes_uncached(off_t, ssize_t, UserOrKernelBuffer& buffer) const override;
     virtual InodeMetadata metadata() const override;
     virtual KResult traverse_as_directory(Function<bool(const FS::DirectoryEntryView&)>) const override;
     virtual RefPtr<Inode> lookup(StringView name) override;
@@ -77,8 +79,17 @@ private:
     virtual KResult chown(uid_t, gid_t) override;
     virtual KResult truncate(u64) override;
     virtual KResultOr<int> get_block_address(int) override;
+    virtual KResult attach(FileDescription&) override;
+    virtual void detach(FileDescription&) override;
 
     KResult write_directory(const Vector<Ext2FSDirectoryEntry>&);
+    KResult read_directory_block(size_t logical_index, ByteBuffer&) const;
+    KResult write_directory_block(size_t logical_index, const ByteBuffer&);
+    KResult append_directory_entry(const StringView& name, InodeIndex, u8 file_type);
+    KResult remove_directory_entry(const StringView& name);
+    bool is_htree_indexed() const;
+    void drop_htree_index();
+    KResultOr<InodeIndex> lookup_in_htree(const StringView& name) const;
     bool populate_lookup_cache() const;
     KResult resize(u64);
     KResult write_indirect_block(BlockBasedFS::BlockIndex, Span<BlockBasedFS::BlockIndex>);
@@ -87,6 +98,22 @@ private:
     KResult grow_triply_indirect_block(BlockBasedFS::BlockIndex, size_t, Span<BlockBasedFS::BlockIndex>, Vector<BlockBasedFS::BlockIndex>&, unsigned&);
     KResult shrink_triply_indirect_block(BlockBasedFS::BlockIndex, size_t, size_t, unsigned&);
     KResult flush_block_list();
+    ssize_t read_bytes_impl(off_t, ssize_t, UserOrKernelBuffer&, FileDescription*, bool allow_cache) const;
+    void read_ahead(u64 offset, size_t count);
+
+    struct BlockRun {
+        size_t logical_index { 0 };
+        BlockBasedFS::BlockIndex first_block;
+        size_t length { 0 };
+    };
+
+    size_t data_block_count() const;
+    KResultOr<BlockRun> block_run_at(size_t logical_index, size_t max_length = 1) const;
+    KResultOr<Vector<BlockBasedFS::BlockIndex>> blocks_in_range(size_t first_logical_index, size_t count) const;
+    size_t block_map_leaf_start(size_t logical_index) const;
+    KResultOr<BlockBasedFS::BlockIndex> read_block_pointer(BlockBasedFS::BlockIndex array_block, size_t index) const;
+    KResult load_block_map_leaf(size_t logical_index) const;
+    void invalidate_block_map();
     Vector<BlockBasedFS::BlockIndex> compute_block_list() const;
     Vector<BlockBasedFS::BlockIndex> compute_block_list_with_meta_blocks() const;
     Vector<BlockBasedFS::BlockIndex> compute_block_list_impl(bool include_block_list_blocks) const;
@@ -97,6 +124,13 @@ private:
     Ext2FSInode(Ext2FS&, InodeIndex);
 
     mutable Vector<BlockBasedFS::BlockIndex> m_block_list;
+    size_t m_attached_description_count { 0 };
+
+    // Run-length map of the data blocks we've looked up so far, sorted by logical index.
+    // It's filled in one leaf (the direct pointers, or a single indirect block) at a time,
+    // so reading from a large file doesn't require walking its entire block list first.
+    mutable Vector<BlockRun> m_block_map;
+    mutable HashTable<size_t> m_block_map_loaded_leaves;
     mutable HashMap<String, InodeIndex> m_lookup_cache;
     ext2_inode m_raw_inode;
 };
@@ -123,6 +157,7 @@ public:
     virtual KResult prepare_to_unmount() const override;
 
     virtual bool supports_watchers() const override { return true; }
+    virtual bool supports_lookup_caching() const override { return true; }
 
     virtual u8 internal_file_type_to_directory_entry_type(const DirectoryEntryView& entry) const override;
 
@@ -146,22 +181,28 @@ private:
     bool write_ext2_inode(InodeIndex, const ext2_inode&);
     bool find_block_containing_inode(InodeIndex, BlockIndex& block_index, unsigned& offset) const;
 
-    bool flush_super_block();
+    KResult flush_super_block();
 
     virtual const char* class_name() const override;
     virtual NonnullRefPtr<Inode> root_inode() const override;
     RefPtr<Inode> get_inode(InodeIdentifier) const;
     KResultOr<NonnullRefPtr<Inode>> create_inode(Ext2FSInode& parent_inode, const String& name, mode_t, dev_t, uid_t, gid_t);
     KResult create_directory(Ext2FSInode& parent_inode, const String& name, mode_t, uid_t, gid_t);
-    virtual void flush_writes() override;
+    virtual KResult flush_writes() override;
 
     BlockIndex first_block_index() const;
     KResultOr<InodeIndex> allocate_inode(GroupIndex preferred_group = 0);
     KResultOr<Vector<BlockIndex>> allocate_blocks(GroupIndex preferred_group_index, size_t count);
+    KResultOr<Vector<BlockIndex>> allocate_blocks_for_inode(InodeIndex, BlockIndex goal, size_t count);
+    KResultOr<size_t> allocate_blocks_at(InodeIndex, BlockIndex first_block, size_t max_count, Vector<BlockIndex>&);
+    KResultOr<size_t> count_free_blocks_at(InodeIndex, BlockIndex first_block, size_t max_count);
+    bool is_preallocated_for_other_inode(BlockIndex, InodeIndex) const;
+    void discard_preallocation(InodeIndex);
     GroupIndex group_index_from_inode(InodeIndex) const;
     GroupIndex group_index_from_block_index(BlockIndex) const;
 
     KResultOr<bool> get_inode_allocation_state(InodeIndex) const;
+    KResultOr<bool> get_block_allocation_state(BlockIndex) const;
     KResult set_inode_allocation_state(InodeIndex, bool);
     KResult set_block_allocation_state(BlockIndex, bool);
 
@@ -204,6 +245,19 @@ private:
     KResult update_bitmap_block(BlockIndex bitmap_block, size_t bit_index, bool new_state, u32& super_block_counter, u16& group_descriptor_counter);
 
     Vector<OwnPtr<CachedBitmap>> m_cached_bitmaps;
+
+    // A run of free blocks following the end of a growing inode, which other inodes won't allocate from.
+    // Keeping one of these per growing inode lets interleaved writers each extend their files contiguously.
+    // Preallocations only live in memory and never show up in the bitmaps, so there's nothing to clean up
+    // after a crash. They're dropped when the inode is truncated, closed for the last time, or evicted.
+    struct Preallocation {
+        BlockIndex first_block;
+        size_t count { 0 };
+    };
+
+    static constexpr size_t preallocation_window_blocks = 64;
+
+    HashMap<InodeIndex, Preallocation> m_preallocations;
 };
 
 inline Ext2FS& Ext2FSInode::fs()
@@ -29,6 +29,7 @@
 #include <Kernel/Devices/BlockDevice.h>
 #include <Kernel/Devices/CharacterDevice.h>
 #include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/EPoll.h>
 #include <Kernel/FileSystem/FIFO.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/FileSystem.h>
@@ -43,6 +44,11 @@
 
 namespace Kernel {
 
+bool g_read_ahead_enabled = true;
+
+static constexpr size_t min_read_ahead_window_size = 16 * KiB;
+static constexpr size_t max_read_ahead_window_size = 512 * KiB;
+
 KResultOr<NonnullRefPtr<FileDescription>> FileDescription::create(Custody& custody)
 {
     auto description = adopt(*new FileDescription(InodeFile::create(custody.inode())));
@@ -77,6 +83,14 @@ FileDescription::FileDescription(File& file)
 
 FileDescription::~FileDescription()
 {
+    Vector<NonnullRefPtr<EPollInterest>> epoll_interests;
+    {
+        ScopedSpinLock lock(m_epoll_interests_lock);
+        epoll_interests = move(m_epoll_interests);
+    }
+    for (auto& interest : epoll_interests)
+        interest->description_destroyed({}, *this);
+
     m_file->detach(*this);
     if (is_fifo())
         static_cast<FIFO*>(m_file.ptr())->detach(m_fifo_direction);
@@ -179,6 +193,33 @@ KResultOr<size_t> FileDescription::read(UserOrKernelBuffer& buffer, size_t count
     return nread_or_error;
 }
 
+bool FileDescription::should_read_ahead(u64 offset, size_t count, u64& read_ahead_offset, size_t& read_ahead_size)
+{
+    u64 end_offset = offset + count;
+    bool is_sequential = offset == m_next_sequential_read_offset;
+    m_next_sequential_read_offset = end_offset;
+
+    if (!g_read_ahead_enabled || !is_sequential || count == 0) {
+        m_read_ahead_window_size = 0;
+        m_read_ahead_end_offset = 0;
+        return false;
+    }
+
+    // Don't issue another read-ahead until the reader has consumed half of the previous window.
+    if (m_read_ahead_end_offset > end_offset && m_read_ahead_end_offset - end_offset > m_read_ahead_window_size / 2)
+        return false;
+
+    if (m_read_ahead_window_size == 0)
+        m_read_ahead_window_size = min_read_ahead_window_size;
+    else
+        m_read_ahead_window_size = min(m_read_ahead_window_size * 2, max_read_ahead_window_size);
+
+    read_ahead_offset = max(end_offset, m_read_ahead_end_offset);
+    read_ahead_size = m_read_ahead_window_size;
+    m_read_ahead_end_offset = read_ahead_offset + read_ahead_size;
+    return true;
+}
+
 KResultOr<size_t> FileDescription::write(const UserOrKernelBuffer& data, size_t size)
 {
     LOCKER(m_lock);
@@ -396,4 +437,31 @@ FileBlockCondition& FileDescription::block_condition()
     return m_file->block_condition();
 }
 
+void FileDescription::add_epoll_interest(Badge<EPoll>, NonnullRefPtr<EPollInterest> interest)
+{
+    ScopedSpinLock lock(m_epoll_interests_lock);
+    m_epoll_interests.append(move(interest));
+}
+
+void FileDescription::remove_epoll_interest(Badge<EPollInterest>, EPollInterest& interest)
+{
+    ScopedSpinLock lock(m_epoll_interests_lock);
+    m_epoll_interests.remove_first_matching([&](auto& entry) { return entry.ptr() == &interest; });
+}
+
+void FileDescription::remove_epoll_interests_for_fd(Badge<Process>, int fd)
+{
+    Vector<NonnullRefPtr<EPollInterest>> epoll_interests;
+    {
+        ScopedSpinLock lock(m_epoll_interests_lock);
+        for (auto& interest : m_epoll_interests) {
+            if (interest->fd() == fd)
+                epoll_interests.append(interest);
+        }
+    }
+    // Removing an interest takes it out of m_epoll_interests, so we can't hold the lock here.
+    for (auto& interest : epoll_interests)
+        interest->fd_closed({});
+}
+
 }
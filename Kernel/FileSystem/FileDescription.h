@@ -38,6 +38,8 @@
 
 namespace Kernel {
 
+extern bool g_read_ahead_enabled;
+
 class FileDescriptionData {
 public:
     virtual ~FileDescriptionData() = default;
@@ -135,10 +137,20 @@ public:
 
     off_t offset() const { return m_current_offset; }
 
+    // File systems call this after each read to find out whether they should read ahead.
+    // Reads that pick up where the previous one left off double the read-ahead window,
+    // anything else resets it.
+    bool should_read_ahead(u64 offset, size_t count, u64& read_ahead_offset, size_t& read_ahead_size);
+
     KResult chown(uid_t, gid_t);
 
     FileBlockCondition& block_condition();
 
+    void add_epoll_interest(Badge<EPoll>, NonnullRefPtr<EPollInterest>);
+    void remove_epoll_interest(Badge<EPollInterest>, EPollInterest&);
+    // Interests are registered for a particular fd, so they go away when that fd is closed.
+    void remove_epoll_interests_for_fd(Badge<Process>, int fd);
+
 private:
     friend class VFS;
     explicit FileDescription(File&);
@@ -156,6 +168,10 @@ private:
 
     off_t m_current_offset { 0 };
 
+    u64 m_next_sequential_read_offset { 0 };
+    u64 m_read_ahead_end_offset { 0 };
+    size_t m_read_ahead_window_size { 0 };
+
     OwnPtr<FileDescriptionData> m_data;
 
     u32 m_file_flags { 0 };
@@ -169,6 +185,9 @@ private:
     FIFO::Direction m_fifo_direction { FIFO::Direction::Neither };
 
     Lock m_lock { "FileDescription" };
+
+    SpinLock<u8> m_epoll_interests_lock;
+    Vector<NonnullRefPtr<EPollInterest>> m_epoll_interests;
 };
 
 }
@@ -33,6 +33,7 @@
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/Net/LocalSocket.h>
 #include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/SharedInodeVMObject.h>
 #include <LibC/errno_numbers.h>
 
 namespace Kernel {
@@ -71,8 +72,9 @@ FS::DirectoryEntryView::DirectoryEntryView(const StringView& n, InodeIdentifier
 {
 }
 
-void FS::sync()
+KResult FS::sync()
 {
+    SharedInodeVMObject::write_back_all_dirty_pages();
     Inode::sync();
 
     NonnullRefPtrVector<FS, 32> fses;
@@ -82,8 +84,27 @@ void FS::sync()
             fses.append(*it.value);
     }
 
+    // Keep going if one of them fails, but let the caller know.
+    KResult result = KSuccess;
+    for (auto& fs : fses) {
+        auto flush_result = fs.flush_writes();
+        if (flush_result.is_error() && !result.is_error())
+            result = flush_result;
+    }
+    return result;
+}
+
+void FS::release_all_cached_memory()
+{
+    NonnullRefPtrVector<FS, 32> fses;
+    {
+        InterruptDisabler disabler;
+        for (auto& it : all_fses())
+            fses.append(*it.value);
+    }
+
     for (auto& fs : fses)
-        fs.flush_writes();
+        fs.release_cached_memory();
 }
 
 void FS::lock_all()
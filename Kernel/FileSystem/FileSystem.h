@@ -53,13 +53,15 @@ public:
 
     unsigned fsid() const { return m_fsid; }
     static FS* from_fsid(u32);
-    static void sync();
+    static KResult sync();
     static void lock_all();
+    static void release_all_cached_memory();
 
     virtual bool initialize() = 0;
     virtual const char* class_name() const = 0;
     virtual NonnullRefPtr<Inode> root_inode() const = 0;
     virtual bool supports_watchers() const { return false; }
+    virtual bool supports_lookup_caching() const { return false; }
 
     bool is_readonly() const { return m_readonly; }
 
@@ -78,7 +80,10 @@ public:
         u8 file_type { 0 };
     };
 
-    virtual void flush_writes() { }
+    virtual KResult flush_writes() { return KSuccess; }
+
+    // Called when physical memory runs low. Give back whatever can be dropped without writing anything.
+    virtual void release_cached_memory() { }
 
     size_t block_size() const { return m_block_size; }
 
@@ -73,6 +73,8 @@ public:
     virtual void detach(FileDescription&) { }
     virtual void did_seek(FileDescription&, off_t) { }
     virtual ssize_t read_bytes(off_t, ssize_t, UserOrKernelBuffer& buffer, FileDescription*) const = 0;
+    // For filling the page cache, which doesn't need the data kept in the file system's block cache as well.
+    virtual ssize_t read_bytes_uncached(off_t offset, ssize_t count, UserOrKernelBuffer& buffer) const { return read_bytes(offset, count, buffer, nullptr); }
     virtual KResult traverse_as_directory(Function<bool(const FS::DirectoryEntryView&)>) const = 0;
     virtual RefPtr<Inode> lookup(StringView name) = 0;
     virtual ssize_t write_bytes(off_t, ssize_t, const UserOrKernelBuffer& data, FileDescription*) = 0;
@@ -131,8 +133,8 @@ protected:
     void set_metadata_dirty(bool);
     KResult prepare_to_write_data();
 
-    void did_add_child(const InodeIdentifier&);
-    void did_remove_child(const InodeIdentifier&);
+    void did_add_child(const InodeIdentifier& child_id, const StringView& name);
+    void did_remove_child(const InodeIdentifier& child_id, const StringView& name);
 
     mutable Lock m_lock { "Inode" };
 
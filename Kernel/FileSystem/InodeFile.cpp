@@ -46,12 +46,38 @@ InodeFile::~InodeFile()
 {
 }
 
+SharedInodeVMObject* InodeFile::page_cache()
+{
+    // Keep the inode's page cache around for as long as the file is open, not just while it's mapped.
+    if (!m_page_cache && m_inode->metadata().is_regular_file() && m_inode->fs().is_file_backed())
+        m_page_cache = SharedInodeVMObject::create_with_inode(*m_inode);
+    return m_page_cache.ptr();
+}
+
 KResultOr<size_t> InodeFile::read(FileDescription& description, u64 offset, UserOrKernelBuffer& buffer, size_t count)
 {
     if (Checked<off_t>::addition_would_overflow(offset, count))
         return EOVERFLOW;
 
-    ssize_t nread = m_inode->read_bytes(offset, count, buffer, &description);
+    ssize_t nread = 0;
+    auto* page_cache = description.is_direct() ? nullptr : this->page_cache();
+    if (page_cache) {
+        nread = page_cache->read(offset, buffer, count);
+        if (nread < 0 && nread != -EFAULT) {
+            // The page cache couldn't be filled (most likely we're short on memory), so read from the inode instead.
+            nread = 0;
+            page_cache = nullptr;
+        }
+    }
+    // Whatever lies past the end of the page cache (the file has grown since it was set up) comes straight from the inode.
+    if (nread >= 0 && static_cast<size_t>(nread) < count && (!page_cache || offset + nread >= page_cache->size())) {
+        auto remaining_buffer = buffer.offset(nread);
+        auto nread_from_inode = m_inode->read_bytes(offset + nread, count - nread, remaining_buffer, &description);
+        if (nread_from_inode < 0 && nread == 0)
+            nread = nread_from_inode;
+        else if (nread_from_inode > 0)
+            nread += nread_from_inode;
+    }
     if (nread > 0) {
         Thread::current()->did_file_read(nread);
         evaluate_block_conditions();
@@ -68,6 +94,8 @@ KResultOr<size_t> InodeFile::write(FileDescription& description, u64 offset, con
 
     ssize_t nwritten = m_inode->write_bytes(offset, count, data, &description);
     if (nwritten > 0) {
+        if (auto shared_vmobject = m_inode->shared_vmobject())
+            shared_vmobject->update_cached_pages(offset, data, nwritten);
         m_inode->set_mtime(kgettimeofday().to_truncated_seconds());
         Thread::current()->did_file_write(nwritten);
         evaluate_block_conditions();
@@ -132,6 +160,8 @@ KResult InodeFile::truncate(u64 size)
     auto truncate_result = m_inode->truncate(size);
     if (truncate_result.is_error())
         return truncate_result;
+    if (auto shared_vmobject = m_inode->shared_vmobject())
+        shared_vmobject->truncate(size);
     int mtime_result = m_inode->set_mtime(kgettimeofday().to_truncated_seconds());
     if (mtime_result < 0)
         return KResult((ErrnoCode)-mtime_result);
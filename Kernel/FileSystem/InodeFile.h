@@ -31,6 +31,7 @@
 namespace Kernel {
 
 class Inode;
+class SharedInodeVMObject;
 
 class InodeFile final : public File {
 public:
@@ -65,7 +66,11 @@ public:
 
 private:
     explicit InodeFile(NonnullRefPtr<Inode>&&);
+
+    SharedInodeVMObject* page_cache();
+
     NonnullRefPtr<Inode> m_inode;
+    RefPtr<SharedInodeVMObject> m_page_cache;
 };
 
 }
@@ -49,6 +49,7 @@
 #include <Kernel/KSyms.h>
 #include <Kernel/Module.h>
 #include <Kernel/Net/LocalSocket.h>
+#include <Kernel/Net/LoopbackAdapter.h>
 #include <Kernel/Net/NetworkAdapter.h>
 #include <Kernel/Net/Routing.h>
 #include <Kernel/Net/TCPSocket.h>
@@ -62,6 +63,7 @@
 #include <Kernel/UBSanitizer.h>
 #include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PhysicalRegion.h>
 #include <LibC/errno_numbers.h>
 
 namespace Kernel {
@@ -86,6 +88,8 @@ enum ProcFileType {
     FI_Root_df,
     FI_Root_all,
     FI_Root_memstat,
+    FI_Root_pagealloc,
+    FI_Root_kmalloc,
     FI_Root_cpuinfo,
     FI_Root_dmesg,
     FI_Root_interrupts,
@@ -94,6 +98,7 @@ enum ProcFileType {
     FI_Root_keymap,
     FI_Root_pci,
     FI_Root_devices,
+    FI_Root_iostat,
     FI_Root_uptime,
     FI_Root_cmdline,
     FI_Root_modules,
@@ -443,6 +448,35 @@ static bool procfs$devices(InodeIdentifier, KBufferBuilder& builder)
     return true;
 }
 
+static bool procfs$iostat(InodeIdentifier, KBufferBuilder& builder)
+{
+    JsonArraySerializer array { builder };
+    Device::for_each([&array](auto& device) {
+        if (!device.is_block_device())
+            return;
+        auto& block_device = static_cast<BlockDevice&>(device);
+        auto statistics = block_device.io_scheduler().statistics();
+        auto completed_requests = statistics.completed_reads + statistics.completed_writes;
+        auto obj = array.add_object();
+        obj.add("device_name", block_device.device_name());
+        obj.add("major", block_device.major());
+        obj.add("minor", block_device.minor());
+        obj.add("queued_requests", statistics.queued_requests);
+        obj.add("requests_in_flight", statistics.requests_in_flight);
+        obj.add("max_requests_in_flight", block_device.max_requests_in_flight());
+        obj.add("max_queue_depth", statistics.max_queue_depth);
+        obj.add("dispatched_requests", statistics.dispatched_requests);
+        obj.add("merged_requests", statistics.merged_requests);
+        obj.add("expired_requests", statistics.expired_requests);
+        obj.add("completed_reads", statistics.completed_reads);
+        obj.add("completed_writes", statistics.completed_writes);
+        obj.add("average_latency_us", completed_requests ? statistics.total_latency_us / completed_requests : 0);
+        obj.add("max_latency_us", statistics.max_latency_us);
+    });
+    array.finish();
+    return true;
+}
+
 static bool procfs$uptime(InodeIdentifier, KBufferBuilder& builder)
 {
     builder.appendff("{}\n", TimeManagement::the().uptime_ms() / 1000);
@@ -513,6 +547,12 @@ static bool procfs$net_adapters(InodeIdentifier, KBufferBuilder& builder)
         obj.add("bytes_in", adapter.bytes_in());
         obj.add("packets_out", adapter.packets_out());
         obj.add("bytes_out", adapter.bytes_out());
+        obj.add("interrupts", adapter.interrupts());
+        obj.add("interrupts_per_second", adapter.interrupts_per_second());
+        obj.add("polls", adapter.polls());
+        obj.add("packets_dropped", adapter.packets_dropped());
+        obj.add("receive_batches", adapter.receive_batches());
+        obj.add("packets_per_batch", adapter.receive_batches() ? adapter.batched_packets() / adapter.receive_batches() : 0);
         obj.add("link_up", adapter.link_up());
         obj.add("mtu", adapter.mtu());
     });
@@ -549,6 +589,16 @@ static bool procfs$net_tcp(InodeIdentifier, KBufferBuilder& builder)
         obj.add("bytes_in", socket.bytes_in());
         obj.add("packets_out", socket.packets_out());
         obj.add("bytes_out", socket.bytes_out());
+        obj.add("congestion_window", socket.congestion_window());
+        obj.add("slow_start_threshold", socket.slow_start_threshold());
+        obj.add("send_window", socket.send_window());
+        obj.add("send_mss", socket.send_mss());
+        obj.add("srtt_ms", socket.smoothed_rtt_ms());
+        obj.add("rto_ms", socket.retransmission_timeout_ms());
+        obj.add("retransmissions", socket.retransmissions());
+        obj.add("sack_permitted", socket.is_sack_permitted());
+        obj.add("send_window_scale", socket.send_window_scale());
+        obj.add("receive_window_scale", socket.receive_window_scale());
     });
     array.finish();
     return true;
@@ -753,15 +803,105 @@ static bool procfs$memstat(InodeIdentifier, KBufferBuilder& builder)
     json.add("super_physical_available", super_physical_total - super_physical_used);
     json.add("kmalloc_call_count", stats.kmalloc_call_count);
     json.add("kfree_call_count", stats.kfree_call_count);
-    slab_alloc_stats([&json](size_t slab_size, size_t num_allocated, size_t num_free) {
-        auto prefix = String::formatted("slab_{}", slab_size);
-        json.add(String::formatted("{}_num_allocated", prefix), num_allocated);
-        json.add(String::formatted("{}_num_free", prefix), num_free);
+    slab_alloc_stats([&json](auto& slab_stats) {
+        auto prefix = String::formatted("slab_{}", slab_stats.object_size);
+        json.add(String::formatted("{}_num_allocated", prefix), slab_stats.object_count - slab_stats.free_object_count);
+        json.add(String::formatted("{}_num_free", prefix), slab_stats.free_object_count);
     });
     json.finish();
     return true;
 }
 
+static bool procfs$pagealloc(InodeIdentifier, KBufferBuilder& builder)
+{
+    u32 allocate_latency[PhysicalAllocatorLatencyHistogram::bucket_count] {};
+    u32 free_latency[PhysicalAllocatorLatencyHistogram::bucket_count] {};
+    u32 contiguous_allocate_latency[PhysicalAllocatorLatencyHistogram::bucket_count] {};
+    u32 magazine_hits = 0;
+    u32 magazine_refills = 0;
+    u32 magazine_flushes = 0;
+    size_t magazine_pages = 0;
+    MemoryManager::for_each_processor_data([&](MemoryManagerData& data) {
+        auto& statistics = data.m_allocator_statistics;
+        for (size_t i = 0; i < PhysicalAllocatorLatencyHistogram::bucket_count; ++i) {
+            allocate_latency[i] += statistics.allocate_latency.buckets[i];
+            free_latency[i] += statistics.free_latency.buckets[i];
+            contiguous_allocate_latency[i] += statistics.contiguous_allocate_latency.buckets[i];
+        }
+        magazine_hits += statistics.magazine_hits;
+        magazine_refills += statistics.magazine_refills;
+        magazine_flushes += statistics.magazine_flushes;
+        magazine_pages += data.m_user_page_magazine.count;
+    });
+
+    JsonObjectSerializer<KBufferBuilder> json { builder };
+    json.add("magazine_hits", magazine_hits);
+    json.add("magazine_refills", magazine_refills);
+    json.add("magazine_flushes", magazine_flushes);
+    json.add("magazine_pages", magazine_pages);
+
+    // Bucket N counts the operations that took between 2^N and 2^(N+1) TSC cycles.
+    auto add_histogram = [&](const char* name, const u32* buckets) {
+        auto array = json.add_array(name);
+        for (size_t i = 0; i < PhysicalAllocatorLatencyHistogram::bucket_count; ++i)
+            array.add(buckets[i]);
+    };
+    add_histogram("allocate_latency_cycles", allocate_latency);
+    add_histogram("free_latency_cycles", free_latency);
+    add_histogram("contiguous_allocate_latency_cycles", contiguous_allocate_latency);
+
+    struct RegionInfo {
+        PhysicalAddress lower;
+        PhysicalAddress upper;
+        unsigned free_pages;
+        size_t largest_free_block;
+    };
+    Vector<RegionInfo, 8> region_infos;
+    {
+        ScopedSpinLock mm_lock(s_mm_lock);
+        MM.for_each_user_physical_region([&](const PhysicalRegion& region) {
+            region_infos.append({ region.lower(), region.upper(), region.free(), region.largest_free_block() });
+        });
+    }
+    auto regions = json.add_array("user_physical_regions");
+    for (auto& info : region_infos) {
+        auto obj = regions.add_object();
+        obj.add("lower", info.lower.get());
+        obj.add("upper", info.upper.get());
+        obj.add("free_pages", info.free_pages);
+        obj.add("largest_free_block_pages", info.largest_free_block);
+    }
+    regions.finish();
+    json.finish();
+    return true;
+}
+
+static bool procfs$kmalloc(InodeIdentifier, KBufferBuilder& builder)
+{
+    Vector<SlabSizeClassStatistics, 8> size_classes;
+    slab_alloc_stats([&](auto& slab_stats) {
+        size_classes.append(slab_stats);
+    });
+
+    JsonArraySerializer array { builder };
+    for (auto& slab_stats : size_classes) {
+        auto obj = array.add_object();
+        obj.add("object_size", slab_stats.object_size);
+        obj.add("chunk_count", slab_stats.chunk_count);
+        obj.add("object_count", slab_stats.object_count);
+        obj.add("free_object_count", slab_stats.free_object_count);
+        obj.add("cached_object_count", slab_stats.cached_object_count);
+        obj.add("allocations", slab_stats.allocations);
+        obj.add("frees", slab_stats.frees);
+        obj.add("cache_hits", slab_stats.cache_hits);
+        obj.add("cache_refills", slab_stats.cache_refills);
+        obj.add("cache_flushes", slab_stats.cache_flushes);
+        obj.add("heap_fallbacks", slab_stats.heap_fallbacks);
+    }
+    array.finish();
+    return true;
+}
+
 static bool procfs$all(InodeIdentifier, KBufferBuilder& builder)
 {
     JsonArraySerializer array { builder };
@@ -996,6 +1136,8 @@ bool ProcFS::initialize()
 {
     static Lockable<bool>* kmalloc_stack_helper;
     static Lockable<bool>* ubsan_deadly_helper;
+    static Lockable<bool>* read_ahead_helper;
+    static Lockable<String>* loopback_packet_loss_helper;
 
     if (kmalloc_stack_helper == nullptr) {
         kmalloc_stack_helper = new Lockable<bool>();
@@ -1008,6 +1150,18 @@ bool ProcFS::initialize()
         ProcFS::add_sys_bool("ubsan_is_deadly", *ubsan_deadly_helper, [] {
             UBSanitizer::g_ubsan_is_deadly = ubsan_deadly_helper->resource();
         });
+        read_ahead_helper = new Lockable<bool>();
+        read_ahead_helper->resource() = g_read_ahead_enabled;
+        ProcFS::add_sys_bool("read_ahead", *read_ahead_helper, [] {
+            g_read_ahead_enabled = read_ahead_helper->resource();
+        });
+        loopback_packet_loss_helper = new Lockable<String>();
+        loopback_packet_loss_helper->resource() = String::number(g_loopback_packet_loss_permille);
+        ProcFS::add_sys_string("loopback_packet_loss_permille", *loopback_packet_loss_helper, [] {
+            auto permille = loopback_packet_loss_helper->resource().view().trim_whitespace().to_uint();
+            if (permille.has_value())
+                g_loopback_packet_loss_permille = min(permille.value(), 1000u);
+        });
     }
     return true;
 }
@@ -1701,6 +1855,8 @@ ProcFS::ProcFS()
     m_entries[FI_Root_df] = { "df", FI_Root_df, false, procfs$df };
     m_entries[FI_Root_all] = { "all", FI_Root_all, false, procfs$all };
     m_entries[FI_Root_memstat] = { "memstat", FI_Root_memstat, false, procfs$memstat };
+    m_entries[FI_Root_pagealloc] = { "pagealloc", FI_Root_pagealloc, false, procfs$pagealloc };
+    m_entries[FI_Root_kmalloc] = { "kmalloc", FI_Root_kmalloc, false, procfs$kmalloc };
     m_entries[FI_Root_cpuinfo] = { "cpuinfo", FI_Root_cpuinfo, false, procfs$cpuinfo };
     m_entries[FI_Root_dmesg] = { "dmesg", FI_Root_dmesg, true, procfs$dmesg };
     m_entries[FI_Root_self] = { "self", FI_Root_self, false, procfs$self };
@@ -1710,6 +1866,7 @@ ProcFS::ProcFS()
     m_entries[FI_Root_smbios_entry_point] = { "smbios_entry_point", FI_Root_smbios_entry_point, false, procfs$smbios_entry_point };
     m_entries[FI_Root_keymap] = { "keymap", FI_Root_keymap, false, procfs$keymap };
     m_entries[FI_Root_devices] = { "devices", FI_Root_devices, false, procfs$devices };
+    m_entries[FI_Root_iostat] = { "iostat", FI_Root_iostat, false, procfs$iostat };
     m_entries[FI_Root_uptime] = { "uptime", FI_Root_uptime, false, procfs$uptime };
     m_entries[FI_Root_cmdline] = { "cmdline", FI_Root_cmdline, true, procfs$cmdline };
     m_entries[FI_Root_modules] = { "modules", FI_Root_modules, true, procfs$modules };
@@ -47,6 +47,7 @@ public:
     virtual const char* class_name() const override { return "TmpFS"; }
 
     virtual bool supports_watchers() const override { return true; }
+    virtual bool supports_lookup_caching() const override { return true; }
 
     virtual NonnullRefPtr<Inode> root_inode() const override;
 
@@ -30,12 +30,14 @@
 #include <Kernel/Debug.h>
 #include <Kernel/Devices/BlockDevice.h>
 #include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/DentryCache.h>
 #include <Kernel/FileSystem/FileBackedFileSystem.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/FileSystem.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
 #include <Kernel/KSyms.h>
 #include <Kernel/Process.h>
+#include <Kernel/VM/SharedInodeVMObject.h>
 #include <LibC/errno_numbers.h>
 
 namespace Kernel {
@@ -117,6 +119,8 @@ KResult VFS::unmount(Inode& guest_inode)
     for (size_t i = 0; i < m_mounts.size(); ++i) {
         auto& mount = m_mounts.at(i);
         if (&mount.guest() == &guest_inode) {
+            // Cached dentries hold references to the file system's inodes, which would keep it busy.
+            DentryCache::the().invalidate_file_system(mount.guest_fs().fsid());
             auto result = mount.guest_fs().prepare_to_unmount();
             if (result.is_error()) {
                 dbgln("VFS: Failed to unmount!");
@@ -343,6 +347,8 @@ KResultOr<NonnullRefPtr<FileDescription>> VFS::open(StringView path, int options
         KResult result = inode.truncate(0);
         if (result.is_error())
             return result;
+        if (auto shared_vmobject = inode.shared_vmobject())
+            shared_vmobject->truncate(0);
         inode.set_mtime(kgettimeofday().to_truncated_seconds());
     }
     auto description = FileDescription::create(custody);
@@ -841,9 +847,9 @@ void VFS::for_each_mount(Function<void(const Mount&)> callback) const
     }
 }
 
-void VFS::sync()
+KResult VFS::sync()
 {
-    FS::sync();
+    return FS::sync();
 }
 
 Custody& VFS::root_custody()
@@ -994,8 +1000,17 @@ KResultOr<NonnullRefPtr<Custody>> VFS::resolve_path_without_veil(StringView path
             continue;
         }
 
-        // Okay, let's look up this part.
-        auto child_inode = parent.inode().lookup(part);
+        // Okay, let's look up this part, going to the file system only if the dentry cache
+        // doesn't know about it yet.
+        RefPtr<Inode> child_inode;
+        auto& dentry_cache = DentryCache::the();
+        if (auto cached_inode = dentry_cache.lookup(parent.inode(), part); cached_inode.has_value()) {
+            child_inode = cached_inode.release_value();
+        } else {
+            auto generation = dentry_cache.generation();
+            child_inode = parent.inode().lookup(part);
+            dentry_cache.add(parent.inode(), part, child_inode, generation);
+        }
         if (!child_inode) {
             if (out_parent) {
                 // ENOENT with a non-null parent custody signals to caller that
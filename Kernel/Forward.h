@@ -35,6 +35,8 @@ class Custody;
 class Device;
 class DiskCache;
 class DoubleBuffer;
+class EPoll;
+class EPollInterest;
 class File;
 class FileDescription;
 class FutexQueue;
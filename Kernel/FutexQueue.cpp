@@ -36,11 +36,55 @@ bool FutexQueue::should_add_blocker(Thread::Blocker& b, void* data)
     VERIFY(m_lock.is_locked());
     VERIFY(b.blocker_type() == Thread::Blocker::Type::Futex);
 
+    VERIFY(m_imminent_waits > 0);
+    --m_imminent_waits;
+    if (m_imminent_wakes > 0) {
+        // Someone woke us up before we got here.
+        --m_imminent_wakes;
+        dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: thread {} was woken before it blocked", this, *static_cast<Thread*>(data));
+        return false;
+    }
+
     dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: should block thread {}", this, *static_cast<Thread*>(data));
 
     return true;
 }
 
+void FutexQueue::queue_imminent_wait()
+{
+    ScopedSpinLock lock(m_lock);
+    ++m_imminent_waits;
+}
+
+void FutexQueue::cancel_imminent_wait()
+{
+    ScopedSpinLock lock(m_lock);
+    VERIFY(m_imminent_waits > 0);
+    --m_imminent_waits;
+    m_imminent_wakes = min(m_imminent_wakes, m_imminent_waits);
+}
+
+bool FutexQueue::is_empty_and_no_imminent_waits() const
+{
+    ScopedSpinLock lock(m_lock);
+    return is_empty_and_no_imminent_waits_locked();
+}
+
+bool FutexQueue::is_empty_and_no_imminent_waits_locked() const
+{
+    VERIFY(m_lock.is_locked());
+    // Imminent waiters that have been woken won't block here anymore.
+    return is_empty_locked() && m_imminent_wakes == m_imminent_waits;
+}
+
+u32 FutexQueue::wake_imminent_waiters_locked(u32 max_count)
+{
+    VERIFY(m_lock.is_locked());
+    u32 count = min(max_count, m_imminent_waits - m_imminent_wakes);
+    m_imminent_wakes += count;
+    return count;
+}
+
 u32 FutexQueue::wake_n_requeue(u32 wake_count, const Function<FutexQueue*()>& get_target_queue, u32 requeue_count, bool& is_empty, bool& is_empty_target)
 {
     is_empty_target = false;
@@ -49,21 +93,30 @@ u32 FutexQueue::wake_n_requeue(u32 wake_count, const Function<FutexQueue*()>& ge
     dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: wake_n_requeue({}, {})", this, wake_count, requeue_count);
 
     u32 did_wake = 0, did_requeue = 0;
-    do_unblock([&](Thread::Blocker& b, void* data, bool& stop_iterating) {
-        VERIFY(data);
-        VERIFY(b.blocker_type() == Thread::Blocker::Type::Futex);
-        auto& blocker = static_cast<Thread::FutexBlocker&>(b);
+    if (wake_count > 0) {
+        do_unblock([&](Thread::Blocker& b, void* data, bool& stop_iterating) {
+            VERIFY(data);
+            VERIFY(b.blocker_type() == Thread::Blocker::Type::Futex);
+            auto& blocker = static_cast<Thread::FutexBlocker&>(b);
 
-        dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: wake_n_requeue unblocking {}", this, *static_cast<Thread*>(data));
-        VERIFY(did_wake < wake_count);
-        if (blocker.unblock()) {
-            if (++did_wake >= wake_count)
-                stop_iterating = true;
-            return true;
-        }
-        return false;
-    });
-    is_empty = is_empty_locked();
+            dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: wake_n_requeue unblocking {}", this, *static_cast<Thread*>(data));
+            VERIFY(did_wake < wake_count);
+            if (blocker.unblock()) {
+                if (++did_wake >= wake_count)
+                    stop_iterating = true;
+                return true;
+            }
+            return false;
+        });
+        if (did_wake < wake_count)
+            did_wake += wake_imminent_waiters_locked(wake_count - did_wake);
+    }
+    if (requeue_count > 0) {
+        // Imminent waiters can't be moved to the target queue before they block, and would be
+        // left behind on this one. Wake them instead, which futex waiters have to expect anyway.
+        wake_imminent_waiters_locked(m_imminent_waits);
+    }
+    is_empty = is_empty_and_no_imminent_waits_locked();
     if (requeue_count > 0) {
         auto blockers_to_requeue = do_take_blockers(requeue_count);
         if (!blockers_to_requeue.is_empty()) {
@@ -89,7 +142,7 @@ u32 FutexQueue::wake_n_requeue(u32 wake_count, const Function<FutexQueue*()>& ge
                     blocker.finish_requeue(*target_futex_queue);
                 }
                 target_futex_queue->do_append_blockers(move(blockers_to_requeue));
-                is_empty_target = target_futex_queue->is_empty_locked();
+                is_empty_target = target_futex_queue->is_empty_and_no_imminent_waits_locked();
             } else {
                 dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: wake_n_requeue could not get target queue to requeue {} blockers", this, blockers_to_requeue.size());
                 do_append_blockers(move(blockers_to_requeue));
@@ -120,7 +173,14 @@ u32 FutexQueue::wake_n(u32 wake_count, const Optional<u32>& bitset, bool& is_emp
         }
         return false;
     });
-    is_empty = is_empty_locked();
+    if (bitset.has_value()) {
+        // We don't know which bits imminent waiters are waiting for, so wake all of them without
+        // counting them, rather than let a waiter with a matching bitset miss this wake.
+        wake_imminent_waiters_locked(m_imminent_waits);
+    } else if (did_wake < wake_count) {
+        did_wake += wake_imminent_waiters_locked(wake_count - did_wake);
+    }
+    is_empty = is_empty_and_no_imminent_waits_locked();
     return did_wake;
 }
 
@@ -140,8 +200,72 @@ u32 FutexQueue::wake_all(bool& is_empty)
         }
         return false;
     });
-    is_empty = is_empty_locked();
+    did_wake += wake_imminent_waiters_locked(m_imminent_waits);
+    is_empty = is_empty_and_no_imminent_waits_locked();
     return did_wake;
 }
 
+void FutexQueue::set_pi_owner(Thread* owner)
+{
+    if (m_pi_owner == owner)
+        return;
+    if (m_pi_owner)
+        m_pi_owner->set_inherited_priority(*this, 0);
+    m_pi_owner = owner;
+    update_pi_owner_priority();
+}
+
+void FutexQueue::update_pi_owner_priority(u32 waiting_priority)
+{
+    if (!m_pi_owner)
+        return;
+    u32 highest_priority = waiting_priority;
+    {
+        ScopedSpinLock lock(m_lock);
+        do_for_each_blocker([&](Thread::Blocker&, void* data) {
+            highest_priority = max(highest_priority, static_cast<Thread*>(data)->effective_priority());
+        });
+    }
+    dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: owner {} inherits priority {}", this, *m_pi_owner, highest_priority);
+    m_pi_owner->set_inherited_priority(*this, highest_priority);
+}
+
+RefPtr<Thread> FutexQueue::wake_highest_priority_waiter(bool& has_more_waiters)
+{
+    ScopedSpinLock lock(m_lock);
+    RefPtr<Thread> woken_thread;
+    for (;;) {
+        Thread* best_thread = nullptr;
+        do_for_each_blocker([&](Thread::Blocker&, void* data) {
+            auto* thread = static_cast<Thread*>(data);
+            if (!best_thread || thread->effective_priority() > best_thread->effective_priority())
+                best_thread = thread;
+        });
+        if (!best_thread)
+            break;
+        // The thread we picked may have been unblocked already (e.g. by a
+        // timeout), in which case it is simply dropped and we try again.
+        bool did_wake = false;
+        do_unblock([&](Thread::Blocker& b, void* data, bool& stop_iterating) {
+            if (data != best_thread)
+                return false;
+            VERIFY(b.blocker_type() == Thread::Blocker::Type::Futex);
+            stop_iterating = true;
+            did_wake = static_cast<Thread::FutexBlocker&>(b).unblock();
+            return true;
+        });
+        if (did_wake) {
+            dbgln_if(FUTEXQUEUE_DEBUG, "FutexQueue @ {}: handing off to {}", this, *best_thread);
+            woken_thread = best_thread;
+            break;
+        }
+    }
+    if (!woken_thread) {
+        // A waiter that hasn't blocked yet will find the futex unlocked when it tries again.
+        wake_imminent_waiters_locked(1);
+    }
+    has_more_waiters = !is_empty_and_no_imminent_waits_locked();
+    return woken_thread;
+}
+
 }
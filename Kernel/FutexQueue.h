@@ -53,15 +53,38 @@ public:
 
     virtual void vmobject_deleted(VMObject&) override;
 
+    // A thread that checked the futex word has to drop the queue lock before it can block, and is an
+    // imminent waiter until then. Wakes that don't find enough blocked threads are handed to imminent
+    // waiters instead, which then return without blocking. Every wait_on() has to be preceded by
+    // queue_imminent_wait(), while still holding the queue lock.
+    void queue_imminent_wait();
+    void cancel_imminent_wait();
+    bool is_empty_and_no_imminent_waits() const;
+
+    // Priority inheritance futexes (FUTEX_LOCK_PI). The owner runs with at
+    // least the priority of the highest priority thread waiting here.
+    const Thread* pi_owner() const { return m_pi_owner.ptr(); }
+    void set_pi_owner(Thread*);
+    void update_pi_owner_priority(u32 waiting_priority = 0);
+    RefPtr<Thread> wake_highest_priority_waiter(bool& has_more_waiters);
+
 protected:
     virtual bool should_add_blocker(Thread::Blocker& b, void* data) override;
 
 private:
+    bool is_empty_and_no_imminent_waits_locked() const;
+    u32 wake_imminent_waiters_locked(u32 max_count);
+
     // For private futexes we just use the user space address.
     // But for global futexes we use the offset into the VMObject
     const FlatPtr m_user_address_or_offset;
     WeakPtr<VMObject> m_vmobject;
     const bool m_is_global;
+    RefPtr<Thread> m_pi_owner;
+
+    // Protected by m_lock. m_imminent_wakes counts the imminent waiters that have already been woken.
+    u32 m_imminent_waits { 0 };
+    u32 m_imminent_wakes { 0 };
 };
 
 }
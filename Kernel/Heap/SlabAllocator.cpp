@@ -25,165 +25,359 @@
  */
 
 #include <AK/Assertions.h>
+#include <AK/Atomic.h>
 #include <AK/Memory.h>
+#include <AK/ScopeGuard.h>
+#include <Kernel/Arch/x86/CPU.h>
+#include <Kernel/Debug.h>
 #include <Kernel/Heap/SlabAllocator.h>
 #include <Kernel/Heap/kmalloc.h>
 #include <Kernel/SpinLock.h>
+#include <Kernel/VM/AnonymousVMObject.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageDirectory.h>
 #include <Kernel/VM/Region.h>
 
 #define SANITIZE_SLABS
 
 namespace Kernel {
 
-template<size_t templated_slab_size>
-class SlabAllocator {
-public:
-    SlabAllocator() = default;
+// Slab memory is carved into 64 KiB chunks, each of which holds objects of a
+// single size class. The chunks are aligned to their size, so the size class
+// of any kernel pointer can be found with a single table lookup.
+static constexpr size_t slab_chunk_size = 64 * KiB;
+static constexpr FlatPtr slab_table_base = 0xc0000000;
+static constexpr size_t slab_table_entry_count = (0x100000000ull - slab_table_base) / slab_chunk_size;
 
-    void init(size_t size)
-    {
-        m_base = kmalloc_eternal(size);
-        m_end = (u8*)m_base + size;
-        FreeSlab* slabs = (FreeSlab*)m_base;
-        m_slab_count = size / templated_slab_size;
-        for (size_t i = 1; i < m_slab_count; ++i) {
-            slabs[i].next = &slabs[i - 1];
-        }
-        slabs[0].next = nullptr;
-        m_freelist = &slabs[m_slab_count - 1];
-        m_num_allocated = 0;
-    }
+static constexpr size_t slab_size_class_count = 8;
+static constexpr size_t slab_min_object_size = 16;
+static_assert(slab_min_object_size << (slab_size_class_count - 1) == slab_max_object_size);
 
-    constexpr size_t slab_size() const { return templated_slab_size; }
-    size_t slab_count() const { return m_slab_count; }
+// Each CPU keeps a small stash of free objects for every size class, which
+// is only ever touched by that CPU with interrupts disabled. The shared depot
+// of a size class is only locked to move a batch of objects in or out.
+static constexpr size_t slab_cpu_cache_capacity = 32;
+static constexpr size_t slab_cpu_cache_batch_size = slab_cpu_cache_capacity / 2;
+static constexpr size_t slab_max_cpu_caches = 32;
 
-    void* alloc()
-    {
-        FreeSlab* free_slab;
-        {
-            // We want to avoid being swapped out in the middle of this
-            ScopedCritical critical;
-            FreeSlab* next_free;
-            free_slab = m_freelist.load(AK::memory_order_consume);
-            do {
-                if (!free_slab)
-                    return kmalloc(slab_size());
-                // It's possible another processor is doing the same thing at
-                // the same time, so next_free *can* be a bogus pointer. However,
-                // in that case compare_exchange_strong would fail and we would
-                // try again.
-                next_free = free_slab->next;
-            } while (!m_freelist.compare_exchange_strong(free_slab, next_free, AK::memory_order_acq_rel));
-
-            m_num_allocated++;
-        }
+struct FreeSlabObject {
+    FreeSlabObject* next;
+};
 
-#ifdef SANITIZE_SLABS
-        memset(free_slab, SLAB_ALLOC_SCRUB_BYTE, slab_size());
-#endif
-        return free_slab;
+struct SlabDepot {
+    SpinLock<u8> lock;
+    FreeSlabObject* freelist { nullptr };
+    size_t free_count { 0 };
+    size_t chunk_count { 0 };
+    Atomic<bool> growth_pending { false };
+};
+
+struct SlabCpuCache {
+    size_t count;
+    void* objects[slab_cpu_cache_capacity];
+
+    // Only updated by the owning CPU, summed up when read.
+    u64 allocations;
+    u64 frees;
+    u64 cache_hits;
+    u64 cache_refills;
+    u64 cache_flushes;
+    u64 heap_fallbacks;
+};
+
+// NOTE: All of this is set up before global constructors run, so nothing
+// here may have a constructor that would wipe it out again later.
+READONLY_AFTER_INIT static SlabDepot* s_slab_depots;
+alignas(SlabDepot) static u8 s_slab_depots_storage[sizeof(SlabDepot) * slab_size_class_count];
+static SlabCpuCache s_slab_cpu_caches[slab_max_cpu_caches][slab_size_class_count];
+
+// 0 if the chunk doesn't belong to the slabs, otherwise its size class index + 1.
+static u8 s_slab_chunk_size_class[slab_table_entry_count];
+
+static constexpr size_t object_size_for_size_class(size_t size_class)
+{
+    return slab_min_object_size << size_class;
+}
+
+static constexpr size_t size_class_for_size(size_t size)
+{
+    size_t size_class = 0;
+    while (object_size_for_size_class(size_class) < size)
+        ++size_class;
+    return size_class;
+}
+
+static Optional<size_t> size_class_for_pointer(const void* ptr)
+{
+    auto address = (FlatPtr)ptr;
+    if (address < slab_table_base)
+        return {};
+    auto entry = s_slab_chunk_size_class[(address - slab_table_base) / slab_chunk_size];
+    if (!entry)
+        return {};
+    return entry - 1;
+}
+
+static SlabCpuCache* cpu_cache_for_size_class(size_t size_class)
+{
+    // Allocations made before the BSP is fully set up (or on CPUs beyond the
+    // ones we have caches for) go straight to the depot.
+    if (!Processor::is_initialized())
+        return nullptr;
+    auto cpu = Processor::id();
+    if (cpu >= slab_max_cpu_caches)
+        return nullptr;
+    return &s_slab_cpu_caches[cpu][size_class];
+}
+
+static void add_chunk_to_size_class(u8* chunk, size_t size_class)
+{
+    VERIFY((FlatPtr)chunk % slab_chunk_size == 0);
+    VERIFY((FlatPtr)chunk >= slab_table_base);
+
+    auto object_size = object_size_for_size_class(size_class);
+    auto object_count = slab_chunk_size / object_size;
+    auto* objects = (FreeSlabObject*)chunk;
+    for (size_t i = 0; i < object_count - 1; ++i)
+        ((FreeSlabObject*)(chunk + i * object_size))->next = (FreeSlabObject*)(chunk + (i + 1) * object_size);
+    auto* last = (FreeSlabObject*)(chunk + (object_count - 1) * object_size);
+
+    auto& depot = s_slab_depots[size_class];
+    ScopedSpinLock lock(depot.lock);
+    s_slab_chunk_size_class[((FlatPtr)chunk - slab_table_base) / slab_chunk_size] = size_class + 1;
+    last->next = depot.freelist;
+    depot.freelist = objects;
+    depot.free_count += object_count;
+    depot.chunk_count++;
+}
+
+static void grow_size_class(void* data)
+{
+    auto size_class = (size_t)data;
+    auto& depot = s_slab_depots[size_class];
+    ScopeGuard clear_pending([&] { depot.growth_pending.store(false, AK::memory_order_release); });
+
+    auto range = MM.kernel_page_directory().range_allocator().allocate_anywhere(slab_chunk_size, slab_chunk_size);
+    if (!range.has_value()) {
+        dbgln("Slab: Could not allocate a range to grow the {} byte slabs", object_size_for_size_class(size_class));
+        return;
+    }
+    auto vmobject = AnonymousVMObject::create_with_size(slab_chunk_size, AllocationStrategy::AllocateNow);
+    if (!vmobject) {
+        MM.kernel_page_directory().range_allocator().deallocate(range.value());
+        dbgln("Slab: Could not allocate memory to grow the {} byte slabs", object_size_for_size_class(size_class));
+        return;
+    }
+    auto region = MM.allocate_kernel_region_with_vmobject(range.value(), *vmobject, "kmalloc slabs", Region::Access::Read | Region::Access::Write);
+    if (!region) {
+        MM.kernel_page_directory().range_allocator().deallocate(range.value());
+        dbgln("Slab: Could not map memory to grow the {} byte slabs", object_size_for_size_class(size_class));
+        return;
     }
 
-    void dealloc(void* ptr)
-    {
-        VERIFY(ptr);
-        if (ptr < m_base || ptr >= m_end) {
-            kfree(ptr);
-            return;
-        }
-        FreeSlab* free_slab = (FreeSlab*)ptr;
-#ifdef SANITIZE_SLABS
-        if (slab_size() > sizeof(FreeSlab*))
-            memset(free_slab->padding, SLAB_DEALLOC_SCRUB_BYTE, sizeof(FreeSlab::padding));
-#endif
+    dbgln_if(KMALLOC_DEBUG, "Slab: Adding chunk at {} to the {} byte slabs", region->vaddr(), object_size_for_size_class(size_class));
+
+    // Slab chunks are never given back, objects from them may be anywhere.
+    auto* chunk = region.leak_ptr()->vaddr().as_ptr();
+    add_chunk_to_size_class(chunk, size_class);
+}
+
+static void request_size_class_growth(size_t size_class)
+{
+    if (!MemoryManager::is_initialized())
+        return;
+    auto& depot = s_slab_depots[size_class];
+    if (depot.growth_pending.exchange(true, AK::memory_order_acq_rel))
+        return;
+    // Growing needs the MM lock and allocates from kmalloc() itself, so don't do
+    // it while the caller may be holding a spinlock. Until the new chunk is
+    // added, allocations of this size class are served by the heap.
+    Processor::deferred_call_queue(grow_size_class, (void*)size_class, nullptr);
+}
 
-        // We want to avoid being swapped out in the middle of this
-        ScopedCritical critical;
-        FreeSlab* next_free = m_freelist.load(AK::memory_order_consume);
-        do {
-            free_slab->next = next_free;
-        } while (!m_freelist.compare_exchange_strong(next_free, free_slab, AK::memory_order_acq_rel));
+// Moves up to `count` objects from the depot into `objects`, returns how many were moved.
+static size_t take_objects_from_depot(size_t size_class, void** objects, size_t count)
+{
+    auto& depot = s_slab_depots[size_class];
+    ScopedSpinLock lock(depot.lock);
+    size_t taken = 0;
+    while (taken < count && depot.freelist) {
+        auto* object = depot.freelist;
+        depot.freelist = object->next;
+        objects[taken++] = object;
+    }
+    depot.free_count -= taken;
+    return taken;
+}
 
-        m_num_allocated--;
+static void return_objects_to_depot(size_t size_class, void** objects, size_t count)
+{
+    auto& depot = s_slab_depots[size_class];
+    ScopedSpinLock lock(depot.lock);
+    for (size_t i = 0; i < count; ++i) {
+        auto* object = (FreeSlabObject*)objects[i];
+        object->next = depot.freelist;
+        depot.freelist = object;
     }
+    depot.free_count += count;
+}
 
-    size_t num_allocated() const { return m_num_allocated; }
-    size_t num_free() const { return m_slab_count - m_num_allocated; }
+UNMAP_AFTER_INIT void slab_alloc_init()
+{
+    auto* depots = (SlabDepot*)s_slab_depots_storage;
+    for (size_t i = 0; i < slab_size_class_count; ++i)
+        new (&depots[i]) SlabDepot;
+    s_slab_depots = depots;
 
-private:
-    struct FreeSlab {
-        FreeSlab* next;
-        char padding[templated_slab_size - sizeof(FreeSlab*)];
+    struct InitialChunks {
+        size_t object_size;
+        size_t size;
+    };
+    // The larger size classes start out empty and grow once MM is up.
+    constexpr InitialChunks initial_chunks[] = {
+        { 16, 128 * KiB },
+        { 32, 128 * KiB },
+        { 64, 512 * KiB },
+        { 128, 512 * KiB },
     };
 
-    Atomic<FreeSlab*> m_freelist { nullptr };
-    Atomic<ssize_t, AK::MemoryOrder::memory_order_relaxed> m_num_allocated;
-    size_t m_slab_count;
-    void* m_base { nullptr };
-    void* m_end { nullptr };
+    size_t total_size = 0;
+    for (auto& entry : initial_chunks)
+        total_size += entry.size;
 
-    static_assert(sizeof(FreeSlab) == templated_slab_size);
-};
+    // Eternal memory isn't chunk aligned, so allocate one extra chunk to align within.
+    auto* memory = (u8*)kmalloc_eternal(total_size + slab_chunk_size);
+    auto* chunk = (u8*)round_up_to_power_of_two((FlatPtr)memory, slab_chunk_size);
+    for (auto& entry : initial_chunks) {
+        auto size_class = size_class_for_size(entry.object_size);
+        for (size_t offset = 0; offset < entry.size; offset += slab_chunk_size) {
+            add_chunk_to_size_class(chunk, size_class);
+            chunk += slab_chunk_size;
+        }
+    }
+}
+
+void* slab_try_alloc(size_t size)
+{
+    if (size > slab_max_object_size || !s_slab_depots)
+        return nullptr;
+    auto size_class = size_class_for_size(size);
 
-static SlabAllocator<16> s_slab_allocator_16;
-static SlabAllocator<32> s_slab_allocator_32;
-static SlabAllocator<64> s_slab_allocator_64;
-static SlabAllocator<128> s_slab_allocator_128;
+    void* ptr = nullptr;
+    bool needs_growth = false;
+    {
+        InterruptDisabler disabler;
+        auto* cache = cpu_cache_for_size_class(size_class);
+        if (!cache) {
+            take_objects_from_depot(size_class, &ptr, 1);
+        } else if (cache->count) {
+            cache->cache_hits++;
+            ptr = cache->objects[--cache->count];
+        } else {
+            cache->cache_refills++;
+            cache->count = take_objects_from_depot(size_class, cache->objects, slab_cpu_cache_batch_size);
+            if (cache->count)
+                ptr = cache->objects[--cache->count];
+        }
+
+        if (cache) {
+            if (ptr)
+                cache->allocations++;
+            else
+                cache->heap_fallbacks++;
+        }
+        needs_growth = !ptr;
+    }
 
-#if ARCH(I386)
-static_assert(sizeof(Region) <= s_slab_allocator_128.slab_size());
+    if (needs_growth) {
+        request_size_class_growth(size_class);
+        return nullptr;
+    }
+
+#ifdef SANITIZE_SLABS
+    memset(ptr, SLAB_ALLOC_SCRUB_BYTE, object_size_for_size_class(size_class));
 #endif
+    return ptr;
+}
 
-template<typename Callback>
-void for_each_allocator(Callback callback)
+bool slab_try_dealloc(void* ptr)
 {
-    callback(s_slab_allocator_16);
-    callback(s_slab_allocator_32);
-    callback(s_slab_allocator_64);
-    callback(s_slab_allocator_128);
+    auto size_class = size_class_for_pointer(ptr);
+    if (!size_class.has_value())
+        return false;
+
+    auto object_size = object_size_for_size_class(size_class.value());
+    VERIFY((FlatPtr)ptr % object_size == 0);
+#ifdef SANITIZE_SLABS
+    if (object_size > sizeof(FreeSlabObject))
+        memset((u8*)ptr + sizeof(FreeSlabObject), SLAB_DEALLOC_SCRUB_BYTE, object_size - sizeof(FreeSlabObject));
+#endif
+
+    InterruptDisabler disabler;
+    auto* cache = cpu_cache_for_size_class(size_class.value());
+    if (!cache) {
+        return_objects_to_depot(size_class.value(), &ptr, 1);
+        return true;
+    }
+    cache->frees++;
+    if (cache->count == slab_cpu_cache_capacity) {
+        // Give the older half of our cached objects back, keeping the recently freed (warm) ones.
+        cache->cache_flushes++;
+        return_objects_to_depot(size_class.value(), cache->objects, slab_cpu_cache_batch_size);
+        cache->count -= slab_cpu_cache_batch_size;
+        memmove(cache->objects, cache->objects + slab_cpu_cache_batch_size, cache->count * sizeof(void*));
+    }
+    cache->objects[cache->count++] = ptr;
+    return true;
 }
 
-UNMAP_AFTER_INIT void slab_alloc_init()
+Optional<size_t> slab_allocation_size(const void* ptr)
 {
-    s_slab_allocator_16.init(128 * KiB);
-    s_slab_allocator_32.init(128 * KiB);
-    s_slab_allocator_64.init(512 * KiB);
-    s_slab_allocator_128.init(512 * KiB);
+    auto size_class = size_class_for_pointer(ptr);
+    if (!size_class.has_value())
+        return {};
+    return object_size_for_size_class(size_class.value());
 }
 
 void* slab_alloc(size_t slab_size)
 {
-    if (slab_size <= 16)
-        return s_slab_allocator_16.alloc();
-    if (slab_size <= 32)
-        return s_slab_allocator_32.alloc();
-    if (slab_size <= 64)
-        return s_slab_allocator_64.alloc();
-    if (slab_size <= 128)
-        return s_slab_allocator_128.alloc();
-    VERIFY_NOT_REACHED();
+    VERIFY(slab_size <= slab_max_object_size);
+    return kmalloc(slab_size);
 }
 
 void slab_dealloc(void* ptr, size_t slab_size)
 {
-    if (slab_size <= 16)
-        return s_slab_allocator_16.dealloc(ptr);
-    if (slab_size <= 32)
-        return s_slab_allocator_32.dealloc(ptr);
-    if (slab_size <= 64)
-        return s_slab_allocator_64.dealloc(ptr);
-    if (slab_size <= 128)
-        return s_slab_allocator_128.dealloc(ptr);
-    VERIFY_NOT_REACHED();
+    VERIFY(slab_size <= slab_max_object_size);
+    kfree(ptr);
 }
 
-void slab_alloc_stats(Function<void(size_t slab_size, size_t allocated, size_t free)> callback)
+void slab_alloc_stats(Function<void(const SlabSizeClassStatistics&)> callback)
 {
-    for_each_allocator([&](auto& allocator) {
-        auto num_allocated = allocator.num_allocated();
-        auto num_free = allocator.slab_count() - num_allocated;
-        callback(allocator.slab_size(), num_allocated, num_free);
-    });
+    if (!s_slab_depots)
+        return;
+    for (size_t size_class = 0; size_class < slab_size_class_count; ++size_class) {
+        SlabSizeClassStatistics stats;
+        stats.object_size = object_size_for_size_class(size_class);
+        {
+            auto& depot = s_slab_depots[size_class];
+            ScopedSpinLock lock(depot.lock);
+            stats.chunk_count = depot.chunk_count;
+            stats.free_object_count = depot.free_count;
+        }
+        stats.object_count = stats.chunk_count * (slab_chunk_size / stats.object_size);
+        for (size_t cpu = 0; cpu < slab_max_cpu_caches; ++cpu) {
+            auto& cache = s_slab_cpu_caches[cpu][size_class];
+            stats.cached_object_count += cache.count;
+            stats.allocations += cache.allocations;
+            stats.frees += cache.frees;
+            stats.cache_hits += cache.cache_hits;
+            stats.cache_refills += cache.cache_refills;
+            stats.cache_flushes += cache.cache_flushes;
+            stats.heap_fallbacks += cache.heap_fallbacks;
+        }
+        stats.free_object_count += stats.cached_object_count;
+        callback(stats);
+    }
 }
 
 }
@@ -27,6 +27,7 @@
 #pragma once
 
 #include <AK/Function.h>
+#include <AK/Optional.h>
 #include <AK/Types.h>
 
 namespace Kernel {
@@ -34,10 +35,34 @@ namespace Kernel {
 #define SLAB_ALLOC_SCRUB_BYTE 0xab
 #define SLAB_DEALLOC_SCRUB_BYTE 0xbc
 
+// Allocations up to this size are served from per-size-class slabs,
+// through a small per-CPU cache of free objects for each class.
+static constexpr size_t slab_max_object_size = 2048;
+
 void* slab_alloc(size_t slab_size);
 void slab_dealloc(void*, size_t slab_size);
 void slab_alloc_init();
-void slab_alloc_stats(Function<void(size_t slab_size, size_t allocated, size_t free)>);
+
+// Used by kmalloc(). These return nullptr/false if the allocation can't be
+// served from (or doesn't belong to) the slabs, and kmalloc falls back to its heap.
+void* slab_try_alloc(size_t);
+bool slab_try_dealloc(void*);
+Optional<size_t> slab_allocation_size(const void*);
+
+struct SlabSizeClassStatistics {
+    size_t object_size { 0 };
+    size_t chunk_count { 0 };
+    size_t object_count { 0 };
+    size_t free_object_count { 0 };
+    size_t cached_object_count { 0 };
+    u64 allocations { 0 };
+    u64 frees { 0 };
+    u64 cache_hits { 0 };
+    u64 cache_refills { 0 };
+    u64 cache_flushes { 0 };
+    u64 heap_fallbacks { 0 };
+};
+void slab_alloc_stats(Function<void(const SlabSizeClassStatistics&)>);
 
 #define MAKE_SLAB_ALLOCATED(type)                                        \
 public:                                                                  \
@@ -35,6 +35,7 @@
 #include <Kernel/Arch/x86/CPU.h>
 #include <Kernel/Debug.h>
 #include <Kernel/Heap/Heap.h>
+#include <Kernel/Heap/SlabAllocator.h>
 #include <Kernel/Heap/kmalloc.h>
 #include <Kernel/KSyms.h>
 #include <Kernel/Panic.h>
@@ -207,8 +208,8 @@ __attribute__((section(".heap"))) static u8 kmalloc_eternal_heap[ETERNAL_RANGE_S
 __attribute__((section(".heap"))) static u8 kmalloc_pool_heap[POOL_SIZE];
 
 static size_t g_kmalloc_bytes_eternal = 0;
-static size_t g_kmalloc_call_count;
-static size_t g_kfree_call_count;
+static Atomic<size_t, AK::MemoryOrder::memory_order_relaxed> g_kmalloc_call_count;
+static Atomic<size_t, AK::MemoryOrder::memory_order_relaxed> g_kfree_call_count;
 bool g_dump_kmalloc_stacks;
 
 static u8* s_next_eternal_ptr;
@@ -249,17 +250,28 @@ void* kmalloc_eternal(size_t size)
     return ptr;
 }
 
-void* kmalloc(size_t size)
+void* try_kmalloc(size_t size)
 {
-    ScopedSpinLock lock(s_lock);
     ++g_kmalloc_call_count;
 
     if (g_dump_kmalloc_stacks && Kernel::g_kernel_symbols_available) {
+        ScopedSpinLock lock(s_lock);
         dbgln("kmalloc({})", size);
         Kernel::dump_backtrace();
     }
 
-    void* ptr = g_kmalloc_global->m_heap.allocate(size);
+    // Small allocations are served from the per-CPU size class slabs without
+    // taking the heap lock. Fall back to the heap if the size class is empty.
+    if (void* ptr = Kernel::slab_try_alloc(size))
+        return ptr;
+
+    ScopedSpinLock lock(s_lock);
+    return g_kmalloc_global->m_heap.allocate(size);
+}
+
+void* kmalloc(size_t size)
+{
+    void* ptr = try_kmalloc(size);
     if (!ptr) {
         PANIC("kmalloc: Out of memory (requested size: {})", size);
     }
@@ -272,14 +284,26 @@ void kfree(void* ptr)
     if (!ptr)
         return;
 
-    ScopedSpinLock lock(s_lock);
     ++g_kfree_call_count;
 
+    if (Kernel::slab_try_dealloc(ptr))
+        return;
+
+    ScopedSpinLock lock(s_lock);
     g_kmalloc_global->m_heap.deallocate(ptr);
 }
 
 void* krealloc(void* ptr, size_t new_size)
 {
+    if (auto slab_size = Kernel::slab_allocation_size(ptr); slab_size.has_value()) {
+        if (new_size <= slab_size.value())
+            return ptr;
+        void* new_ptr = kmalloc(new_size);
+        memcpy(new_ptr, ptr, slab_size.value());
+        kfree(ptr);
+        return new_ptr;
+    }
+
     ScopedSpinLock lock(s_lock);
     return g_kmalloc_global->m_heap.reallocate(ptr, new_size);
 }
@@ -300,6 +324,10 @@ void get_kmalloc_stats(kmalloc_stats& stats)
     stats.bytes_allocated = g_kmalloc_global->m_heap.allocated_bytes();
     stats.bytes_free = g_kmalloc_global->m_heap.free_bytes() + g_kmalloc_global->backup_memory_bytes();
     stats.bytes_eternal = g_kmalloc_bytes_eternal;
+    Kernel::slab_alloc_stats([&](auto& slab_stats) {
+        stats.bytes_allocated += (slab_stats.object_count - slab_stats.free_object_count) * slab_stats.object_size;
+        stats.bytes_free += slab_stats.free_object_count * slab_stats.object_size;
+    });
     stats.kmalloc_call_count = g_kmalloc_call_count;
     stats.kfree_call_count = g_kfree_call_count;
 }
@@ -219,7 +219,11 @@ UNMAP_AFTER_INIT E1000NetworkAdapter::E1000NetworkAdapter(PCI::Address address,
     u32 flags = in32(REG_CTRL);
     out32(REG_CTRL, flags | ECTRL_SLU);
 
-    out32(REG_INTERRUPT_RATE, 6000); // Interrupt rate of 1.536 milliseconds
+    // Moderate interrupts to at most one every ~125 microseconds (8000 per second). Receive interrupts
+    // only kick off polling anyway, so there's no point in taking one for every frame in a burst.
+    out32(REG_INTERRUPT_RATE, interrupt_throttle_interval);
+    out32(REG_RDTR, 0);
+    out32(REG_RADV, 0);
 
     initialize_rx_descriptors();
     initialize_tx_descriptors();
@@ -242,13 +246,15 @@ void E1000NetworkAdapter::handle_irq(const RegisterState&)
     u32 status = in32(REG_INTERRUPT_CAUSE_READ);
 
     m_entropy_source.add_random_event(status);
+    did_handle_interrupt();
 
     if (status & 4) {
         u32 flags = in32(REG_CTRL);
         out32(REG_CTRL, flags | ECTRL_SLU);
     }
-    if (status & 0x80) {
-        receive();
+    if (status & (INTERRUPT_RXT0 | INTERRUPT_RXO)) {
+        // Leave the receive interrupts masked and let NetworkTask pull frames off the ring until it's empty.
+        schedule_poll();
     }
     if (status & 0x10) {
         // Threshold OK?
@@ -256,7 +262,22 @@ void E1000NetworkAdapter::handle_irq(const RegisterState&)
 
     m_wait_queue.wake_all();
 
-    out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC | INTERRUPT_RXT0 | INTERRUPT_RXO);
+    if (is_poll_scheduled())
+        out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC);
+    else
+        out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC | INTERRUPT_RXT0 | INTERRUPT_RXO);
+}
+
+size_t E1000NetworkAdapter::poll(size_t budget)
+{
+    did_poll();
+    size_t received = receive(budget);
+    if (received < budget) {
+        // The ring is empty. Clear the flag before unmasking, so a frame arriving right now schedules a new poll.
+        did_complete_poll();
+        out32(REG_INTERRUPT_MASK_SET, INTERRUPT_RXT0 | INTERRUPT_RXO);
+    }
+    return received;
 }
 
 UNMAP_AFTER_INIT void E1000NetworkAdapter::detect_eeprom()
@@ -441,14 +462,15 @@ void E1000NetworkAdapter::send_raw(ReadonlyBytes payload)
     dbgln_if(E1000_DEBUG, "E1000: Sent packet, status is now {:#02x}!", (u8)descriptor.status);
 }
 
-void E1000NetworkAdapter::receive()
+size_t E1000NetworkAdapter::receive(size_t max_frames)
 {
     auto* rx_descriptors = (e1000_tx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
     u32 rx_current;
-    for (;;) {
+    size_t received = 0;
+    while (received < max_frames) {
         rx_current = in32(REG_RXDESCTAIL) % number_of_rx_descriptors;
         if (rx_current == (in32(REG_RXDESCHEAD) % number_of_rx_descriptors))
-            return;
+            break;
         rx_current = (rx_current + 1) % number_of_rx_descriptors;
         if (!(rx_descriptors[rx_current].status & 1))
             break;
@@ -459,7 +481,9 @@ void E1000NetworkAdapter::receive()
         did_receive({ buffer, length });
         rx_descriptors[rx_current].status = 0;
         out32(REG_RXDESCTAIL, rx_current);
+        ++received;
     }
+    return received;
 }
 
 }
@@ -50,6 +50,8 @@ public:
 
     virtual const char* purpose() const override { return class_name(); }
 
+    virtual size_t poll(size_t budget) override;
+
 private:
     virtual void handle_irq(const RegisterState&) override;
     virtual const char* class_name() const override { return "E1000NetworkAdapter"; }
@@ -90,7 +92,7 @@ private:
     u16 in16(u16 address);
     u32 in32(u16 address);
 
-    void receive();
+    size_t receive(size_t max_frames);
 
     IOAddress m_io_base;
     VirtualAddress m_mmio_base;
@@ -107,6 +109,9 @@ private:
     static const size_t number_of_rx_descriptors = 32;
     static const size_t number_of_tx_descriptors = 8;
 
+    // In units of 256 nanoseconds.
+    static constexpr u32 interrupt_throttle_interval = 488;
+
     WaitQueue m_wait_queue;
 };
 }
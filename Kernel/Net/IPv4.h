@@ -29,6 +29,7 @@
 #include <AK/Assertions.h>
 #include <AK/Endian.h>
 #include <AK/IPv4Address.h>
+#include <AK/Span.h>
 #include <AK/String.h>
 #include <AK/Types.h>
 
@@ -102,6 +103,7 @@ public:
     }
 
     u16 payload_size() const { return m_length - sizeof(IPv4Packet); }
+    ReadonlyBytes bytes() const { return { (const u8*)this, m_length }; }
 
     NetworkOrdered<u16> compute_checksum() const
     {
@@ -67,12 +67,10 @@ KResultOr<NonnullRefPtr<Socket>> IPv4Socket::create(int type, int protocol)
 
 IPv4Socket::IPv4Socket(int type, int protocol)
     : Socket(AF_INET, type, protocol)
+    , m_receive_buffer(type == SOCK_STREAM ? stream_receive_buffer_size : 65536)
 {
     dbgln_if(IPV4_SOCKET_DEBUG, "IPv4Socket({}) created with type={}, protocol={}", this, type, protocol);
     m_buffer_mode = type == SOCK_STREAM ? BufferMode::Bytes : BufferMode::Packets;
-    if (m_buffer_mode == BufferMode::Bytes) {
-        m_scratch_buffer = KBuffer::create_with_size(65536);
-    }
     LOCKER(all_sockets().lock());
     all_sockets().resource().set(this);
 }
@@ -190,9 +188,9 @@ int IPv4Socket::allocate_local_port_if_needed()
     return port;
 }
 
-KResultOr<size_t> IPv4Socket::sendto(FileDescription&, const UserOrKernelBuffer& data, size_t data_length, [[maybe_unused]] int flags, Userspace<const sockaddr*> addr, socklen_t addr_length)
+KResultOr<size_t> IPv4Socket::sendto(FileDescription& description, const UserOrKernelBuffer& data, size_t data_length, [[maybe_unused]] int flags, Userspace<const sockaddr*> addr, socklen_t addr_length)
 {
-    LOCKER(lock());
+    Locker locker(lock());
 
     if (addr && addr_length != sizeof(sockaddr_in))
         return EINVAL;
@@ -231,6 +229,17 @@ KResultOr<size_t> IPv4Socket::sendto(FileDescription&, const UserOrKernelBuffer&
         return data_length;
     }
 
+    // Stream sockets have a bounded send queue; wait for the peer to acknowledge some of it.
+    while (type() == SOCK_STREAM && is_connected() && !can_write(description, data_length)) {
+        if (!description.is_blocking())
+            return EAGAIN;
+        locker.unlock();
+        auto unblock_flags = BlockFlags::None;
+        if (Thread::current()->block<Thread::WriteBlocker>({}, description, unblock_flags).was_interrupted())
+            return EINTR;
+        locker.lock();
+    }
+
     auto nsent_or_error = protocol_send(data, data_length);
     if (!nsent_or_error.is_error())
         Thread::current()->did_ipv4_socket_write(nsent_or_error.value());
@@ -266,6 +275,7 @@ KResultOr<size_t> IPv4Socket::receive_byte_buffered(FileDescription& description
         Thread::current()->did_ipv4_socket_read((size_t)nreceived);
 
     set_can_read(!m_receive_buffer.is_empty());
+    protocol_did_read_from_receive_buffer();
     return nreceived;
 }
 
@@ -289,11 +299,11 @@ KResultOr<size_t> IPv4Socket::receive_packet_buffered(FileDescription& descripti
 
             dbgln_if(IPV4_SOCKET_DEBUG, "IPv4Socket({}): recvfrom without blocking {} bytes, packets in queue: {}",
                 this,
-                packet.data.value().size(),
+                packet.data.size(),
                 m_receive_queue.size());
         }
     }
-    if (!packet.data.has_value()) {
+    if (!packet.buffer) {
         if (protocol_is_disconnected()) {
             dbgln("IPv4Socket({}) is protocol-disconnected, returning 0 in recvfrom!", this);
             return 0;
@@ -318,10 +328,10 @@ KResultOr<size_t> IPv4Socket::receive_packet_buffered(FileDescription& descripti
 
         dbgln_if(IPV4_SOCKET_DEBUG, "IPv4Socket({}): recvfrom with blocking {} bytes, packets in queue: {}",
             this,
-            packet.data.value().size(),
+            packet.data.size(),
             m_receive_queue.size());
     }
-    VERIFY(packet.data.has_value());
+    VERIFY(packet.buffer);
 
     packet_timestamp = packet.timestamp;
 
@@ -343,13 +353,13 @@ KResultOr<size_t> IPv4Socket::receive_packet_buffered(FileDescription& descripti
     }
 
     if (type() == SOCK_RAW) {
-        size_t bytes_written = min(packet.data.value().size(), buffer_length);
-        if (!buffer.write(packet.data.value().data(), bytes_written))
+        size_t bytes_written = min(packet.data.size(), buffer_length);
+        if (!buffer.write(packet.data.data(), bytes_written))
             return EFAULT;
         return bytes_written;
     }
 
-    return protocol_receive(ReadonlyBytes { packet.data.value().data(), packet.data.value().size() }, buffer, buffer_length, flags);
+    return protocol_receive(packet.data, buffer, buffer_length, flags);
 }
 
 KResultOr<size_t> IPv4Socket::recvfrom(FileDescription& description, UserOrKernelBuffer& buffer, size_t buffer_length, int flags, Userspace<sockaddr*> user_addr, Userspace<socklen_t*> user_addr_length, Time& packet_timestamp)
@@ -375,51 +385,52 @@ KResultOr<size_t> IPv4Socket::recvfrom(FileDescription& description, UserOrKerne
     return nreceived;
 }
 
-bool IPv4Socket::did_receive(const IPv4Address& source_address, u16 source_port, KBuffer&& packet, const Time& packet_timestamp)
+bool IPv4Socket::did_receive(const IPv4Address& source_address, u16 source_port, PacketBuffer& packet, ReadonlyBytes ipv4_packet)
 {
     LOCKER(lock());
+    VERIFY(buffer_mode() == BufferMode::Packets);
 
     if (is_shut_down_for_reading())
         return false;
 
-    auto packet_size = packet.size();
-
-    if (buffer_mode() == BufferMode::Bytes) {
-        size_t space_in_receive_buffer = m_receive_buffer.space_for_writing();
-        if (packet_size > space_in_receive_buffer) {
-            dbgln("IPv4Socket({}): did_receive refusing packet since buffer is full.", this);
-            VERIFY(m_can_read);
-            return false;
-        }
-        auto scratch_buffer = UserOrKernelBuffer::for_kernel_buffer(m_scratch_buffer.value().data());
-        auto nreceived_or_error = protocol_receive(ReadonlyBytes { packet.data(), packet.size() }, scratch_buffer, m_scratch_buffer.value().size(), 0);
-        if (nreceived_or_error.is_error())
-            return false;
-        ssize_t nwritten = m_receive_buffer.write(scratch_buffer, nreceived_or_error.value());
-        if (nwritten < 0)
-            return false;
-        set_can_read(!m_receive_buffer.is_empty());
-    } else {
-        if (m_receive_queue.size() > 2000) {
-            dbgln("IPv4Socket({}): did_receive refusing packet since queue is full.", this);
-            return false;
-        }
-        m_receive_queue.append({ source_address, source_port, packet_timestamp, move(packet) });
-        set_can_read(true);
+    if (m_receive_queue.size() > 2000) {
+        dbgln("IPv4Socket({}): did_receive refusing packet since queue is full.", this);
+        return false;
     }
-    m_bytes_received += packet_size;
+    // The queue keeps a reference to the received frame rather than a copy of it.
+    m_receive_queue.append({ source_address, source_port, packet.timestamp(), packet, ipv4_packet });
+    set_can_read(true);
+    m_bytes_received += ipv4_packet.size();
 
-    if constexpr (IPV4_SOCKET_DEBUG) {
-        if (buffer_mode() == BufferMode::Bytes)
-            dbgln("IPv4Socket({}): did_receive {} bytes, total_received={}", this, packet_size, m_bytes_received);
-        else
-            dbgln("IPv4Socket({}): did_receive {} bytes, total_received={}, packets in queue: {}",
-                this,
-                packet_size,
-                m_bytes_received,
-                m_receive_queue.size());
+    dbgln_if(IPV4_SOCKET_DEBUG, "IPv4Socket({}): did_receive {} bytes, total_received={}, packets in queue: {}",
+        this,
+        ipv4_packet.size(),
+        m_bytes_received,
+        m_receive_queue.size());
+    return true;
+}
+
+bool IPv4Socket::did_receive_stream_data(ReadonlyBytes payload)
+{
+    LOCKER(lock());
+    VERIFY(buffer_mode() == BufferMode::Bytes);
+
+    if (is_shut_down_for_reading())
+        return false;
+
+    if (payload.size() > m_receive_buffer.space_for_writing()) {
+        dbgln("IPv4Socket({}): did_receive_stream_data refusing data since buffer is full.", this);
+        VERIFY(m_can_read);
+        return false;
     }
+    auto data = UserOrKernelBuffer::for_kernel_buffer(const_cast<u8*>(payload.data()));
+    ssize_t nwritten = m_receive_buffer.write(data, payload.size());
+    if (nwritten < 0)
+        return false;
+    set_can_read(!m_receive_buffer.is_empty());
+    m_bytes_received += payload.size();
 
+    dbgln_if(IPV4_SOCKET_DEBUG, "IPv4Socket({}): did_receive_stream_data {} bytes, total_received={}", this, payload.size(), m_bytes_received);
     return true;
 }
 
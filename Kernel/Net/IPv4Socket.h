@@ -33,6 +33,7 @@
 #include <Kernel/Lock.h>
 #include <Kernel/Net/IPv4.h>
 #include <Kernel/Net/IPv4SocketTuple.h>
+#include <Kernel/Net/PacketBuffer.h>
 #include <Kernel/Net/Socket.h>
 
 namespace Kernel {
@@ -63,7 +64,8 @@ public:
 
     virtual int ioctl(FileDescription&, unsigned request, FlatPtr arg) override;
 
-    bool did_receive(const IPv4Address& peer_address, u16 peer_port, KBuffer&&, const Time&);
+    // Queues a datagram. ipv4_packet must point into the PacketBuffer, which is kept alive until it has been read.
+    bool did_receive(const IPv4Address& peer_address, u16 peer_port, PacketBuffer&, ReadonlyBytes ipv4_packet);
 
     const IPv4Address& local_address() const { return m_local_address; }
     u16 local_port() const { return m_local_port; }
@@ -99,12 +101,19 @@ protected:
     virtual KResult protocol_connect(FileDescription&, ShouldBlock) { return KSuccess; }
     virtual int protocol_allocate_local_port() { return 0; }
     virtual bool protocol_is_disconnected() const { return false; }
+    virtual void protocol_did_read_from_receive_buffer() { }
 
     virtual void shut_down_for_reading() override;
 
     void set_local_address(IPv4Address address) { m_local_address = address; }
     void set_peer_address(IPv4Address address) { m_peer_address = address; }
 
+    // Appends payload bytes to the receive buffer of a stream socket.
+    bool did_receive_stream_data(ReadonlyBytes payload);
+
+    static constexpr size_t stream_receive_buffer_size = 128 * KiB;
+    size_t receive_buffer_space() const { return m_receive_buffer.space_for_writing(); }
+
 private:
     virtual bool is_ipv4() const override { return true; }
 
@@ -120,7 +129,8 @@ private:
         IPv4Address peer_address;
         u16 peer_port;
         Time timestamp;
-        Optional<KBuffer> data;
+        RefPtr<PacketBuffer> buffer;
+        ReadonlyBytes data;
     };
 
     SinglyLinkedListWithCount<ReceivedPacket> m_receive_queue;
@@ -138,7 +148,6 @@ private:
 
     BufferMode m_buffer_mode { BufferMode::Packets };
 
-    Optional<KBuffer> m_scratch_buffer;
 };
 
 }
@@ -25,10 +25,14 @@
  */
 
 #include <AK/Singleton.h>
+#include <Kernel/Debug.h>
 #include <Kernel/Net/LoopbackAdapter.h>
+#include <Kernel/Random.h>
 
 namespace Kernel {
 
+u32 g_loopback_packet_loss_permille = 0;
+
 static AK::Singleton<LoopbackAdapter> s_loopback;
 
 LoopbackAdapter& LoopbackAdapter::the()
@@ -49,7 +53,11 @@ LoopbackAdapter::~LoopbackAdapter()
 
 void LoopbackAdapter::send_raw(ReadonlyBytes payload)
 {
-    dbgln("LoopbackAdapter: Sending {} byte(s) to myself.", payload.size());
+    if (g_loopback_packet_loss_permille && get_fast_random<u32>() % 1000 < g_loopback_packet_loss_permille) {
+        dbgln_if(LOOPBACK_DEBUG, "LoopbackAdapter: Dropping {} byte(s)", payload.size());
+        return;
+    }
+    dbgln_if(LOOPBACK_DEBUG, "LoopbackAdapter: Sending {} byte(s) to myself.", payload.size());
     did_receive(payload);
 }
 
@@ -30,6 +30,9 @@
 
 namespace Kernel {
 
+// Drops this many out of every thousand packets sent over loopback, for exercising loss recovery.
+extern u32 g_loopback_packet_loss_permille;
+
 class LoopbackAdapter final : public NetworkAdapter {
     AK_MAKE_ETERNAL
 public:
@@ -209,6 +209,7 @@ UNMAP_AFTER_INIT NE2000NetworkAdapter::~NE2000NetworkAdapter()
 
 void NE2000NetworkAdapter::handle_irq(const RegisterState&)
 {
+    did_handle_interrupt();
     u8 status = in8(REG_RW_INTERRUPTSTATUS);
     dbgln_if(NE2000_DEBUG, "NE2000NetworkAdapter: Got interrupt, status=0x{}", String::format("%02x", status));
 
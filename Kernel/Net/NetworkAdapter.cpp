@@ -36,6 +36,7 @@
 #include <Kernel/Process.h>
 #include <Kernel/Random.h>
 #include <Kernel/StdLib.h>
+#include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
@@ -178,43 +179,54 @@ void NetworkAdapter::did_receive(ReadonlyBytes payload)
     m_packets_in++;
     m_bytes_in += payload.size();
 
-    Optional<KBuffer> buffer;
-
-    if (m_unused_packet_buffers.is_empty()) {
-        buffer = KBuffer::copy(payload.data(), payload.size());
-    } else {
-        buffer = m_unused_packet_buffers.take_first();
-        --m_unused_packet_buffers_count;
-        if (payload.size() <= buffer.value().capacity()) {
-            memcpy(buffer.value().data(), payload.data(), payload.size());
-            buffer.value().set_size(payload.size());
-        } else {
-            buffer = KBuffer::copy(payload.data(), payload.size());
-        }
+    // This is the only copy of the frame inside the kernel; everything downstream shares the PacketBuffer.
+    auto packet = PacketBuffer::try_create_with_bytes(payload, kgettimeofday());
+    if (!packet) {
+        ++m_packets_dropped;
+        return;
     }
-
-    m_packet_queue.append({ buffer.value(), kgettimeofday() });
+    m_packet_queue.append(packet.release_nonnull());
 
     if (on_receive)
         on_receive();
 }
 
-size_t NetworkAdapter::dequeue_packet(u8* buffer, size_t buffer_size, Time& packet_timestamp)
+void NetworkAdapter::dequeue_packets(ReceiveBatch& batch)
 {
     InterruptDisabler disabler;
-    if (m_packet_queue.is_empty())
-        return 0;
-    auto packet_with_timestamp = m_packet_queue.take_first();
-    packet_timestamp = packet_with_timestamp.timestamp;
-    auto packet = move(packet_with_timestamp.packet);
-    size_t packet_size = packet.size();
-    VERIFY(packet_size <= buffer_size);
-    memcpy(buffer, packet.data(), packet_size);
-    if (m_unused_packet_buffers_count < 100) {
-        m_unused_packet_buffers.append(packet);
-        ++m_unused_packet_buffers_count;
+    while (batch.size() < receive_batch_size && !m_packet_queue.is_empty())
+        batch.append(m_packet_queue.take_first());
+    if (!batch.is_empty()) {
+        ++m_receive_batches;
+        m_batched_packets += batch.size();
     }
-    return packet_size;
+}
+
+void NetworkAdapter::schedule_poll()
+{
+    m_poll_scheduled = true;
+    if (on_receive)
+        on_receive();
+}
+
+void NetworkAdapter::did_handle_interrupt()
+{
+    ++m_interrupts;
+    auto now_ms = TimeManagement::the().uptime_ms();
+    if (now_ms - m_rate_window_start_ms >= 1000) {
+        m_interrupts_per_second = (m_interrupts - m_interrupts_at_rate_window_start) * 1000 / (now_ms - m_rate_window_start_ms);
+        m_interrupts_at_rate_window_start = m_interrupts;
+        m_rate_window_start_ms = now_ms;
+    }
+}
+
+u32 NetworkAdapter::interrupts_per_second() const
+{
+    // The rate is only updated by interrupts, so if they stopped coming the last window is stale.
+    auto now_ms = TimeManagement::the().uptime_ms();
+    if (now_ms - m_rate_window_start_ms >= 2000)
+        return (m_interrupts - m_interrupts_at_rate_window_start) * 1000 / (now_ms - m_rate_window_start_ms);
+    return m_interrupts_per_second;
 }
 
 void NetworkAdapter::set_ipv4_address(const IPv4Address& address)
@@ -26,17 +26,20 @@
 
 #pragma once
 
+#include <AK/Atomic.h>
 #include <AK/ByteBuffer.h>
 #include <AK/Function.h>
 #include <AK/MACAddress.h>
 #include <AK/SinglyLinkedList.h>
 #include <AK/Types.h>
+#include <AK/Vector.h>
 #include <AK/WeakPtr.h>
 #include <AK/Weakable.h>
 #include <Kernel/KBuffer.h>
 #include <Kernel/Net/ARP.h>
 #include <Kernel/Net/ICMP.h>
 #include <Kernel/Net/IPv4.h>
+#include <Kernel/Net/PacketBuffer.h>
 #include <Kernel/UserOrKernelBuffer.h>
 
 namespace Kernel {
@@ -67,10 +70,21 @@ public:
     KResult send_ipv4(const MACAddress&, const IPv4Address&, IPv4Protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl);
     KResult send_ipv4_fragmented(const MACAddress&, const IPv4Address&, IPv4Protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl);
 
-    size_t dequeue_packet(u8* buffer, size_t buffer_size, Time& packet_timestamp);
+    static constexpr size_t receive_batch_size = 32;
+    using ReceiveBatch = Vector<NonnullRefPtr<PacketBuffer>, receive_batch_size>;
+
+    // Takes up to receive_batch_size packets off the receive queue in one go.
+    void dequeue_packets(ReceiveBatch&);
 
     bool has_queued_packets() const { return !m_packet_queue.is_empty(); }
 
+    // Adapters that support polling mask their receive interrupt when it fires and call schedule_poll().
+    // NetworkTask then keeps calling poll() until it returns fewer frames than the budget, at which
+    // point the driver unmasks the interrupt again. Under load this turns one interrupt per frame
+    // into one per burst.
+    bool is_poll_scheduled() const { return m_poll_scheduled; }
+    virtual size_t poll([[maybe_unused]] size_t budget) { return 0; }
+
     u32 mtu() const { return m_mtu; }
     void set_mtu(u32 mtu) { m_mtu = mtu; }
 
@@ -78,6 +92,12 @@ public:
     u32 bytes_in() const { return m_bytes_in; }
     u32 packets_out() const { return m_packets_out; }
     u32 bytes_out() const { return m_bytes_out; }
+    u32 interrupts() const { return m_interrupts; }
+    u32 interrupts_per_second() const;
+    u32 receive_batches() const { return m_receive_batches; }
+    u32 batched_packets() const { return m_batched_packets; }
+    u32 polls() const { return m_polls; }
+    u32 packets_dropped() const { return m_packets_dropped; }
 
     Function<void()> on_receive;
 
@@ -87,6 +107,10 @@ protected:
     void set_mac_address(const MACAddress& mac_address) { m_mac_address = mac_address; }
     virtual void send_raw(ReadonlyBytes) = 0;
     void did_receive(ReadonlyBytes);
+    void did_handle_interrupt();
+    void schedule_poll();
+    void did_complete_poll() { m_poll_scheduled = false; }
+    void did_poll() { ++m_polls; }
 
 private:
     MACAddress m_mac_address;
@@ -94,19 +118,21 @@ private:
     IPv4Address m_ipv4_netmask;
     IPv4Address m_ipv4_gateway;
 
-    struct PacketWithTimestamp {
-        KBuffer packet;
-        Time timestamp;
-    };
-
-    SinglyLinkedList<PacketWithTimestamp> m_packet_queue;
-    SinglyLinkedList<KBuffer> m_unused_packet_buffers;
-    size_t m_unused_packet_buffers_count { 0 };
+    SinglyLinkedList<NonnullRefPtr<PacketBuffer>> m_packet_queue;
     String m_name;
     u32 m_packets_in { 0 };
     u32 m_bytes_in { 0 };
     u32 m_packets_out { 0 };
     u32 m_bytes_out { 0 };
+    u32 m_interrupts { 0 };
+    u32 m_interrupts_at_rate_window_start { 0 };
+    u32 m_interrupts_per_second { 0 };
+    u64 m_rate_window_start_ms { 0 };
+    u32 m_receive_batches { 0 };
+    u32 m_batched_packets { 0 };
+    u32 m_polls { 0 };
+    u32 m_packets_dropped { 0 };
+    Atomic<bool> m_poll_scheduled { false };
     u32 m_mtu { 1500 };
 };
 
@@ -40,28 +40,70 @@
 #include <Kernel/Net/UDP.h>
 #include <Kernel/Net/UDPSocket.h>
 #include <Kernel/Process.h>
+#include <Kernel/Scheduler.h>
+#include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
 static void handle_arp(const EthernetFrameHeader&, size_t frame_size);
-static void handle_ipv4(const EthernetFrameHeader&, size_t frame_size, const Time& packet_timestamp);
-static void handle_icmp(const EthernetFrameHeader&, const IPv4Packet&, const Time& packet_timestamp);
-static void handle_udp(const IPv4Packet&, const Time& packet_timestamp);
-static void handle_tcp(const IPv4Packet&, const Time& packet_timestamp);
+static void handle_ipv4(const EthernetFrameHeader&, size_t frame_size, PacketBuffer&);
+static void handle_icmp(const EthernetFrameHeader&, const IPv4Packet&, PacketBuffer&);
+static void handle_udp(const IPv4Packet&, PacketBuffer&);
+static void handle_tcp(const IPv4Packet&, PacketBuffer&);
 
 [[noreturn]] static void NetworkTask_main(void*);
 
+static WaitQueue* s_packet_wait_queue;
+
 void NetworkTask::spawn()
 {
     RefPtr<Thread> thread;
     Process::create_kernel_process(thread, "NetworkTask", NetworkTask_main, nullptr);
 }
 
+void NetworkTask::wake()
+{
+    if (s_packet_wait_queue)
+        s_packet_wait_queue->wake_all();
+}
+
+static void handle_frame(PacketBuffer& packet)
+{
+    auto* frame = packet.data();
+    size_t frame_size = packet.size();
+    if (frame_size < sizeof(EthernetFrameHeader)) {
+        dbgln("NetworkTask: Packet is too small to be an Ethernet packet! ({})", frame_size);
+        return;
+    }
+    auto& eth = *(const EthernetFrameHeader*)frame;
+    dbgln_if(ETHERNET_DEBUG, "NetworkTask: From {} to {}, ether_type={:#04x}, packet_size={}", eth.source().to_string(), eth.destination().to_string(), eth.ether_type(), frame_size);
+
+    switch (eth.ether_type()) {
+    case EtherType::ARP:
+        handle_arp(eth, frame_size);
+        break;
+    case EtherType::IPv4:
+        handle_ipv4(eth, frame_size, packet);
+        break;
+    case EtherType::IPv6:
+        // ignore
+        break;
+    default:
+        dbgln("NetworkTask: Unknown ethernet type {:#04x}", eth.ether_type());
+    }
+}
+
+// How many frames an adapter may pull off its receive ring per poll() before we move on to other work.
+static constexpr size_t poll_budget = 64;
+
+// How often the TCP retransmission and delayed ACK timers are checked while any of them is armed.
+static constexpr i64 tcp_timer_interval_ms = 20;
+
 void NetworkTask_main(void*)
 {
     WaitQueue packet_wait_queue;
+    s_packet_wait_queue = &packet_wait_queue;
     u8 octet = 15;
-    int pending_packets = 0;
     NetworkAdapter::for_each([&](auto& adapter) {
         if (String(adapter.class_name()) == "LoopbackAdapter") {
             adapter.set_ipv4_address({ 127, 0, 0, 1 });
@@ -81,56 +123,59 @@ void NetworkTask_main(void*)
             adapter.ipv4_gateway());
 
         adapter.on_receive = [&]() {
-            pending_packets++;
             packet_wait_queue.wake_all();
         };
     });
 
-    auto dequeue_packet = [&pending_packets](u8* buffer, size_t buffer_size, Time& packet_timestamp) -> size_t {
-        if (pending_packets == 0)
-            return 0;
-        size_t packet_size = 0;
-        NetworkAdapter::for_each([&](auto& adapter) {
-            if (packet_size || !adapter.has_queued_packets())
-                return;
-            packet_size = adapter.dequeue_packet(buffer, buffer_size, packet_timestamp);
-            pending_packets--;
-            dbgln_if(NETWORK_TASK_DEBUG, "NetworkTask: Dequeued packet from {} ({} bytes)", adapter.name(), packet_size);
-        });
-        return packet_size;
-    };
+    Vector<NonnullRefPtr<NetworkAdapter>, 4> busy_adapters;
+    NetworkAdapter::ReceiveBatch batch;
 
-    size_t buffer_size = 64 * KiB;
-    auto buffer_region = MM.allocate_kernel_region(buffer_size, "Kernel Packet Buffer", Region::Access::Read | Region::Access::Write);
-    auto buffer = (u8*)buffer_region->vaddr().get();
-    Time packet_timestamp;
+    auto tcp_timer_interval = Time::from_milliseconds(tcp_timer_interval_ms);
+    Time next_tcp_timer_tick {};
+    bool tcp_timers_armed = false;
 
     for (;;) {
-        size_t packet_size = dequeue_packet(buffer, buffer_size, packet_timestamp);
-        if (!packet_size) {
-            packet_wait_queue.wait_forever("NetworkTask");
-            continue;
+        auto now = TimeManagement::the().monotonic_time();
+        if (now >= next_tcp_timer_tick) {
+            tcp_timers_armed = TCPSocket::process_timers();
+            next_tcp_timer_tick = now + tcp_timer_interval;
         }
-        if (packet_size < sizeof(EthernetFrameHeader)) {
-            dbgln("NetworkTask: Packet is too small to be an Ethernet packet! ({})", packet_size);
+
+        busy_adapters.clear();
+        NetworkAdapter::for_each([&](auto& adapter) {
+            if (adapter.is_poll_scheduled() || adapter.has_queued_packets())
+                busy_adapters.append(adapter);
+        });
+        if (busy_adapters.is_empty()) {
+            if (tcp_timers_armed) {
+                Thread::BlockTimeout timeout(false, &tcp_timer_interval);
+                [[maybe_unused]] auto result = packet_wait_queue.wait_on(timeout, "NetworkTask");
+            } else {
+                packet_wait_queue.wait_forever("NetworkTask");
+                // Whoever woke us may have armed a TCP timer; check right away.
+                next_tcp_timer_tick = {};
+            }
             continue;
         }
-        auto& eth = *(const EthernetFrameHeader*)buffer;
-        dbgln_if(ETHERNET_DEBUG, "NetworkTask: From {} to {}, ether_type={:#04x}, packet_size={}", eth.source().to_string(), eth.destination().to_string(), eth.ether_type(), packet_size);
-
-        switch (eth.ether_type()) {
-        case EtherType::ARP:
-            handle_arp(eth, packet_size);
-            break;
-        case EtherType::IPv4:
-            handle_ipv4(eth, packet_size, packet_timestamp);
-            break;
-        case EtherType::IPv6:
-            // ignore
-            break;
-        default:
-            dbgln("NetworkTask: Unknown ethernet type {:#04x}", eth.ether_type());
+
+        // Give every adapter with pending work one turn, so a busy adapter can't starve the others.
+        bool still_busy = false;
+        for (auto& adapter : busy_adapters) {
+            if (adapter->is_poll_scheduled() && adapter->poll(poll_budget) >= poll_budget)
+                still_busy = true;
+
+            adapter->dequeue_packets(batch);
+            dbgln_if(NETWORK_TASK_DEBUG, "NetworkTask: Dequeued {} packets from {}", batch.size(), adapter->name());
+            for (auto& packet : batch)
+                handle_frame(packet);
+            if (batch.size() == NetworkAdapter::receive_batch_size)
+                still_busy = true;
+            batch.clear();
         }
+
+        // The receive path is hot, so keep polling instead of going back to sleep, but let others run in between.
+        if (still_busy)
+            Scheduler::yield();
     }
 }
 
@@ -183,7 +228,7 @@ void handle_arp(const EthernetFrameHeader& eth, size_t frame_size)
     }
 }
 
-void handle_ipv4(const EthernetFrameHeader& eth, size_t frame_size, const Time& packet_timestamp)
+void handle_ipv4(const EthernetFrameHeader& eth, size_t frame_size, PacketBuffer& frame)
 {
     constexpr size_t minimum_ipv4_frame_size = sizeof(EthernetFrameHeader) + sizeof(IPv4Packet);
     if (frame_size < minimum_ipv4_frame_size) {
@@ -207,18 +252,18 @@ void handle_ipv4(const EthernetFrameHeader& eth, size_t frame_size, const Time&
 
     switch ((IPv4Protocol)packet.protocol()) {
     case IPv4Protocol::ICMP:
-        return handle_icmp(eth, packet, packet_timestamp);
+        return handle_icmp(eth, packet, frame);
     case IPv4Protocol::UDP:
-        return handle_udp(packet, packet_timestamp);
+        return handle_udp(packet, frame);
     case IPv4Protocol::TCP:
-        return handle_tcp(packet, packet_timestamp);
+        return handle_tcp(packet, frame);
     default:
         dbgln("handle_ipv4: Unhandled protocol {:#02x}", packet.protocol());
         break;
     }
 }
 
-void handle_icmp(const EthernetFrameHeader& eth, const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
+void handle_icmp(const EthernetFrameHeader& eth, const IPv4Packet& ipv4_packet, PacketBuffer& frame)
 {
     auto& icmp_header = *static_cast<const ICMPHeader*>(ipv4_packet.payload());
     dbgln_if(ICMP_DEBUG, "handle_icmp: source={}, destination={}, type={:#02x}, code={:#02x}", ipv4_packet.source().to_string(), ipv4_packet.destination().to_string(), icmp_header.type(), icmp_header.code());
@@ -234,7 +279,7 @@ void handle_icmp(const EthernetFrameHeader& eth, const IPv4Packet& ipv4_packet,
             }
         }
         for (auto& socket : icmp_sockets)
-            socket.did_receive(ipv4_packet.source(), 0, KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp);
+            socket.did_receive(ipv4_packet.source(), 0, frame, ipv4_packet.bytes());
     }
 
     auto adapter = NetworkAdapter::from_ipv4_address(ipv4_packet.destination());
@@ -264,7 +309,7 @@ void handle_icmp(const EthernetFrameHeader& eth, const IPv4Packet& ipv4_packet,
     }
 }
 
-void handle_udp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
+void handle_udp(const IPv4Packet& ipv4_packet, PacketBuffer& frame)
 {
     if (ipv4_packet.payload_size() < sizeof(UDPPacket)) {
         dbgln("handle_udp: Packet too small ({}, need {})", ipv4_packet.payload_size(), sizeof(UDPPacket));
@@ -291,10 +336,10 @@ void handle_udp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
 
     VERIFY(socket->type() == SOCK_DGRAM);
     VERIFY(socket->local_port() == udp_packet.destination_port());
-    socket->did_receive(ipv4_packet.source(), udp_packet.source_port(), KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp);
+    socket->did_receive(ipv4_packet.source(), udp_packet.source_port(), frame, ipv4_packet.bytes());
 }
 
-void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
+void handle_tcp(const IPv4Packet& ipv4_packet, PacketBuffer& frame)
 {
     if (ipv4_packet.payload_size() < sizeof(TCPPacket)) {
         dbgln("handle_tcp: IPv4 payload is too small to be a TCP packet ({}, need {})", ipv4_packet.payload_size(), sizeof(TCPPacket));
@@ -376,6 +421,11 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
         // TODO: we may want to send an RST here, maybe as a configurable option
         return;
     case TCPSocket::State::TimeWait:
+        if (tcp_packet.has_fin()) {
+            // The peer retransmitted its FIN, so our ACK got lost.
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            return;
+        }
         dbgln("handle_tcp: unexpected flags in TimeWait state");
         unused_rc = socket->send_tcp_packet(TCPFlags::RST);
         socket->set_state(TCPSocket::State::Closed);
@@ -395,6 +445,7 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
             dbgln_if(TCP_DEBUG, "handle_tcp: created new client socket with tuple {}", client->tuple().to_string());
             client->set_sequence_number(1000);
             client->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
+            client->apply_syn_options(tcp_packet);
             [[maybe_unused]] auto rc2 = client->send_tcp_packet(TCPFlags::SYN | TCPFlags::ACK);
             client->set_state(TCPSocket::State::SynReceived);
             return;
@@ -408,11 +459,13 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
         switch (tcp_packet.flags()) {
         case TCPFlags::SYN:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
+            socket->apply_syn_options(tcp_packet);
             unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
             socket->set_state(TCPSocket::State::SynReceived);
             return;
         case TCPFlags::ACK | TCPFlags::SYN:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
+            socket->apply_syn_options(tcp_packet);
             unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
             socket->set_state(TCPSocket::State::Established);
             socket->set_setup_state(Socket::SetupState::Completed);
@@ -478,7 +531,14 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
             return;
         }
     case TCPSocket::State::CloseWait:
+        if (tcp_packet.has_fin()) {
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            return;
+        }
         switch (tcp_packet.flags()) {
+        case TCPFlags::ACK:
+            // We may still be sending, this acknowledges our data.
+            return;
         default:
             dbgln("handle_tcp: unexpected flags in CloseWait state");
             unused_rc = socket->send_tcp_packet(TCPFlags::RST);
@@ -486,10 +546,14 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
             return;
         }
     case TCPSocket::State::LastAck:
+        if (tcp_packet.has_fin()) {
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            return;
+        }
         switch (tcp_packet.flags()) {
         case TCPFlags::ACK:
-            socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
-            socket->set_state(TCPSocket::State::Closed);
+            if (tcp_packet.ack_number() == socket->sequence_number())
+                socket->set_state(TCPSocket::State::Closed);
             return;
         default:
             dbgln("handle_tcp: unexpected flags in LastAck state");
@@ -498,41 +562,31 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
             return;
         }
     case TCPSocket::State::FinWait1:
-        switch (tcp_packet.flags()) {
-        case TCPFlags::ACK:
-            socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
-            socket->set_state(TCPSocket::State::FinWait2);
-            return;
-        case TCPFlags::FIN:
-            socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
-            socket->set_state(TCPSocket::State::Closing);
-            return;
-        default:
-            dbgln("handle_tcp: unexpected flags in FinWait1 state");
-            unused_rc = socket->send_tcp_packet(TCPFlags::RST);
+    case TCPSocket::State::FinWait2: {
+        if (tcp_packet.has_rst()) {
             socket->set_state(TCPSocket::State::Closed);
             return;
         }
-    case TCPSocket::State::FinWait2:
-        switch (tcp_packet.flags()) {
-        case TCPFlags::FIN:
-            socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
-            socket->set_state(TCPSocket::State::TimeWait);
-            return;
-        case TCPFlags::ACK | TCPFlags::RST:
-            socket->set_state(TCPSocket::State::Closed);
-            return;
-        default:
-            dbgln("handle_tcp: unexpected flags in FinWait2 state");
-            unused_rc = socket->send_tcp_packet(TCPFlags::RST);
-            socket->set_state(TCPSocket::State::Closed);
-            return;
+        // The peer may keep sending until it closes its side as well.
+        bool fin_in_order = socket->receive_data(frame, tcp_packet, payload_size);
+        if (socket->state() == TCPSocket::State::FinWait1 && tcp_packet.has_ack() && tcp_packet.ack_number() == socket->sequence_number())
+            socket->set_state(TCPSocket::State::FinWait2);
+        if (tcp_packet.has_fin() && fin_in_order) {
+            socket->set_ack_number(socket->ack_number() + 1);
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            socket->set_state(socket->state() == TCPSocket::State::FinWait2 ? TCPSocket::State::TimeWait : TCPSocket::State::Closing);
         }
+        return;
+    }
     case TCPSocket::State::Closing:
+        if (tcp_packet.has_fin()) {
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            return;
+        }
         switch (tcp_packet.flags()) {
         case TCPFlags::ACK:
-            socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
-            socket->set_state(TCPSocket::State::TimeWait);
+            if (tcp_packet.ack_number() == socket->sequence_number())
+                socket->set_state(TCPSocket::State::TimeWait);
             return;
         default:
             dbgln("handle_tcp: unexpected flags in Closing state");
@@ -541,26 +595,15 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const Time& packet_timestamp)
             return;
         }
     case TCPSocket::State::Established:
-        if (tcp_packet.has_fin()) {
-            if (payload_size != 0)
-                socket->did_receive(ipv4_packet.source(), tcp_packet.source_port(), KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp);
-
-            socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
-            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
-            socket->set_state(TCPSocket::State::CloseWait);
-            socket->set_connected(false);
+        // Data is acknowledged by receive_data(), a FIN only once everything before it has arrived.
+        if (!socket->receive_data(frame, tcp_packet, payload_size) || !tcp_packet.has_fin())
             return;
-        }
-
-        socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
-
-        dbgln_if(TCP_DEBUG, "Got packet with ack_no={}, seq_no={}, payload_size={}, acking it with new ack_no={}, seq_no={}",
-            tcp_packet.ack_number(), tcp_packet.sequence_number(), payload_size, socket->ack_number(), socket->sequence_number());
 
-        if (payload_size) {
-            if (socket->did_receive(ipv4_packet.source(), tcp_packet.source_port(), KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp))
-                unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
-        }
+        socket->set_ack_number(socket->ack_number() + 1);
+        unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+        socket->set_state(TCPSocket::State::CloseWait);
+        socket->set_connected(false);
+        return;
     }
 }
 
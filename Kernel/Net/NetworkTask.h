@@ -30,5 +30,8 @@ namespace Kernel {
 class NetworkTask {
 public:
     static void spawn();
+
+    // Wakes NetworkTask up, e.g. so it notices a newly armed TCP timer.
+    static void wake();
 };
 }
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <AK/Singleton.h>
+#include <AK/Vector.h>
+#include <Kernel/Heap/kmalloc.h>
+#include <Kernel/Net/PacketBuffer.h>
+#include <Kernel/SpinLock.h>
+
+namespace Kernel {
+
+// Large enough for a full Ethernet frame (1514 bytes) plus a VLAN tag and some slack.
+static constexpr size_t small_buffer_size = 2 * KiB;
+static constexpr size_t max_cached_small_buffers = 256;
+static constexpr size_t max_cached_large_buffers = 16;
+
+// Free small buffers are chained through their first bytes.
+struct FreeSmallBuffer {
+    FreeSmallBuffer* next;
+};
+
+static SpinLock<u8> s_cache_lock;
+static FreeSmallBuffer* s_free_small_buffers;
+static size_t s_free_small_buffer_count;
+static AK::Singleton<Vector<KBuffer, max_cached_large_buffers>> s_free_large_buffers;
+
+static u8* take_small_buffer()
+{
+    {
+        ScopedSpinLock lock(s_cache_lock);
+        if (auto* buffer = s_free_small_buffers) {
+            s_free_small_buffers = buffer->next;
+            --s_free_small_buffer_count;
+            return reinterpret_cast<u8*>(buffer);
+        }
+    }
+    // This runs for every received frame, so running out of memory has to drop the frame rather than panic.
+    return static_cast<u8*>(try_kmalloc(small_buffer_size));
+}
+
+static void return_small_buffer(u8* data)
+{
+    {
+        ScopedSpinLock lock(s_cache_lock);
+        if (s_free_small_buffer_count < max_cached_small_buffers) {
+            auto* buffer = reinterpret_cast<FreeSmallBuffer*>(data);
+            buffer->next = s_free_small_buffers;
+            s_free_small_buffers = buffer;
+            ++s_free_small_buffer_count;
+            return;
+        }
+    }
+    kfree(data);
+}
+
+static Optional<KBuffer> take_large_buffer(size_t size)
+{
+    {
+        ScopedSpinLock lock(s_cache_lock);
+        auto& free_buffers = *s_free_large_buffers;
+        for (size_t i = 0; i < free_buffers.size(); ++i) {
+            if (free_buffers[i].capacity() >= size)
+                return free_buffers.take(i);
+        }
+    }
+    auto buffer = KBuffer::try_create_with_size(size, Region::Access::Read | Region::Access::Write, "PacketBuffer");
+    if (!buffer)
+        return {};
+    return move(*buffer);
+}
+
+static void return_large_buffer(KBuffer&& buffer)
+{
+    ScopedSpinLock lock(s_cache_lock);
+    auto& free_buffers = *s_free_large_buffers;
+    if (free_buffers.size() < max_cached_large_buffers)
+        free_buffers.unchecked_append(move(buffer));
+}
+
+RefPtr<PacketBuffer> PacketBuffer::try_create_with_bytes(ReadonlyBytes bytes, const Time& timestamp)
+{
+    u8* data = nullptr;
+    Optional<KBuffer> large_buffer;
+    if (bytes.size() <= small_buffer_size) {
+        data = take_small_buffer();
+    } else {
+        large_buffer = take_large_buffer(bytes.size());
+        if (large_buffer.has_value()) {
+            large_buffer.value().set_size(bytes.size());
+            data = large_buffer.value().data();
+        }
+    }
+    if (!data)
+        return {};
+    memcpy(data, bytes.data(), bytes.size());
+    auto* packet = new PacketBuffer(data, bytes.size(), move(large_buffer), timestamp);
+    if (!packet) {
+        if (large_buffer.has_value())
+            return_large_buffer(large_buffer.release_value());
+        else
+            return_small_buffer(data);
+        return {};
+    }
+    return adopt(*packet);
+}
+
+PacketBuffer::PacketBuffer(u8* data, size_t size, Optional<KBuffer>&& large_buffer, const Time& timestamp)
+    : m_data(data)
+    , m_size(size)
+    , m_large_buffer(move(large_buffer))
+    , m_timestamp(timestamp)
+{
+}
+
+PacketBuffer::~PacketBuffer()
+{
+    if (m_large_buffer.has_value())
+        return_large_buffer(m_large_buffer.release_value());
+    else
+        return_small_buffer(m_data);
+}
+
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <AK/Optional.h>
+#include <AK/RefCounted.h>
+#include <AK/RefPtr.h>
+#include <AK/Span.h>
+#include <AK/Time.h>
+#include <Kernel/Heap/kmalloc.h>
+#include <Kernel/KBuffer.h>
+
+namespace Kernel {
+
+// A received frame. The adapter copies each frame into a PacketBuffer once, and from then on the
+// protocol handlers and socket receive queues share it by reference, pointing into it with spans,
+// until the payload is copied out to userspace.
+//
+// Frames that fit a standard Ethernet MTU are carved from a pool of fixed-size buffers; larger
+// ones (e.g. on the loopback adapter) get a KBuffer, a few of which are cached for reuse too.
+class PacketBuffer : public RefCounted<PacketBuffer> {
+public:
+    static RefPtr<PacketBuffer> try_create_with_bytes(ReadonlyBytes, const Time& timestamp);
+    ~PacketBuffer();
+
+    // Allocation failures make `new` return nullptr, so a frame can be dropped instead.
+    static void* operator new(size_t size) noexcept { return try_kmalloc(size); }
+
+    const u8* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    ReadonlyBytes bytes() const { return { m_data, m_size }; }
+    const Time& timestamp() const { return m_timestamp; }
+
+private:
+    PacketBuffer(u8* data, size_t size, Optional<KBuffer>&& large_buffer, const Time& timestamp);
+
+    u8* m_data { nullptr };
+    size_t m_size { 0 };
+    Optional<KBuffer> m_large_buffer;
+    Time m_timestamp;
+};
+
+}
@@ -180,6 +180,7 @@ UNMAP_AFTER_INIT RTL8139NetworkAdapter::~RTL8139NetworkAdapter()
 
 void RTL8139NetworkAdapter::handle_irq(const RegisterState&)
 {
+    did_handle_interrupt();
     for (;;) {
         int status = in16(REG_ISR);
         out16(REG_ISR, status);
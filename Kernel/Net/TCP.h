@@ -41,6 +41,22 @@ struct TCPFlags {
     };
 };
 
+struct TCPOptionKind {
+    enum : u8 {
+        End = 0,
+        NOP = 1,
+        MSS = 2,
+        WindowScale = 3,
+        SACKPermitted = 4,
+        SACK = 5,
+    };
+};
+
+// The largest shift RFC 7323 allows for the window scale option.
+static constexpr u8 max_tcp_window_scale = 14;
+// How many SACK blocks fit next to the two NOPs that align them in a 40 byte option area.
+static constexpr size_t max_tcp_sack_blocks = 4;
+
 class [[gnu::packed]] TCPPacket {
 public:
     TCPPacket() = default;
@@ -67,6 +83,7 @@ public:
     bool has_ack() const { return flags() & TCPFlags::ACK; }
     bool has_fin() const { return flags() & TCPFlags::FIN; }
     bool has_rst() const { return flags() & TCPFlags::RST; }
+    bool has_push() const { return flags() & TCPFlags::PUSH; }
 
     u8 data_offset() const { return (m_flags_and_data_offset & 0xf000) >> 12; }
     void set_data_offset(u16 data_offset) { m_flags_and_data_offset = (m_flags_and_data_offset & ~0xf000) | data_offset << 12; }
@@ -83,6 +100,34 @@ public:
     const void* payload() const { return ((const u8*)this) + header_size(); }
     void* payload() { return ((u8*)this) + header_size(); }
 
+    const u8* options() const { return ((const u8*)this) + sizeof(TCPPacket); }
+    u8* options() { return ((u8*)this) + sizeof(TCPPacket); }
+    size_t options_size() const { return header_size() > sizeof(TCPPacket) ? header_size() - sizeof(TCPPacket) : 0; }
+
+    // Calls callback(kind, data, length) for every well-formed option. Stops at the first malformed one.
+    template<typename Callback>
+    void for_each_option(Callback callback) const
+    {
+        auto* option = options();
+        auto* end = option + options_size();
+        while (option < end) {
+            u8 kind = option[0];
+            if (kind == TCPOptionKind::End)
+                return;
+            if (kind == TCPOptionKind::NOP) {
+                ++option;
+                continue;
+            }
+            if (option + 1 >= end)
+                return;
+            u8 length = option[1];
+            if (length < 2 || option + length > end)
+                return;
+            callback(kind, option + 2, (size_t)(length - 2));
+            option += length;
+        }
+    }
+
 private:
     NetworkOrdered<u16> m_source_port;
     NetworkOrdered<u16> m_destination_port;
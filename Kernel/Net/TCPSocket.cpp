@@ -24,20 +24,39 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <AK/Array.h>
 #include <AK/Singleton.h>
 #include <AK/Time.h>
 #include <Kernel/Debug.h>
 #include <Kernel/Devices/RandomDevice.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/Net/NetworkAdapter.h>
+#include <Kernel/Net/NetworkTask.h>
 #include <Kernel/Net/Routing.h>
 #include <Kernel/Net/TCP.h>
 #include <Kernel/Net/TCPSocket.h>
 #include <Kernel/Process.h>
 #include <Kernel/Random.h>
+#include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
+// How much unacknowledged payload a socket may queue before writers block.
+static constexpr size_t send_buffer_size = 128 * KiB;
+static constexpr size_t max_out_of_order_segments = 64;
+// RFC 6298 bounds on the retransmission timeout, with the 200 ms lower bound other stacks use instead of 1 s.
+static constexpr i64 min_retransmission_timeout_us = 200'000;
+static constexpr i64 max_retransmission_timeout_us = 60'000'000;
+// The timers run off the coarse monotonic clock and NetworkTask's tick.
+static constexpr i64 clock_granularity_us = 20'000;
+static constexpr i64 delayed_ack_timeout_ms = 40;
+
+static inline bool sequence_less_than(u32 a, u32 b) { return (i32)(a - b) < 0; }
+static inline bool sequence_less_or_equal(u32 a, u32 b) { return (i32)(a - b) <= 0; }
+
+// RFC 6928
+static u32 initial_congestion_window(u32 mss) { return min(10 * mss, max(2 * mss, 14600u)); }
+
 void TCPSocket::for_each(Function<void(const TCPSocket&)> callback)
 {
     LOCKER(sockets_by_tuple().lock(), Lock::Mode::Shared);
@@ -147,6 +166,9 @@ void TCPSocket::release_for_accept(RefPtr<TCPSocket> socket)
 TCPSocket::TCPSocket(int protocol)
     : IPv4Socket(SOCK_STREAM, protocol)
 {
+    while ((stream_receive_buffer_size >> m_receive_window_scale) > NumericLimits<u16>::max())
+        ++m_receive_window_scale;
+    m_congestion_window = initial_congestion_window(m_send_mss);
 }
 
 TCPSocket::~TCPSocket()
@@ -162,56 +184,155 @@ NonnullRefPtr<TCPSocket> TCPSocket::create(int protocol)
     return adopt(*new TCPSocket(protocol));
 }
 
-KResultOr<size_t> TCPSocket::protocol_receive(ReadonlyBytes raw_ipv4_packet, UserOrKernelBuffer& buffer, size_t buffer_size, [[maybe_unused]] int flags)
+bool TCPSocket::can_write(const FileDescription& description, size_t size) const
 {
-    auto& ipv4_packet = *reinterpret_cast<const IPv4Packet*>(raw_ipv4_packet.data());
-    auto& tcp_packet = *static_cast<const TCPPacket*>(ipv4_packet.payload());
-    size_t payload_size = raw_ipv4_packet.size() - sizeof(IPv4Packet) - tcp_packet.header_size();
-    dbgln_if(TCP_SOCKET_DEBUG, "payload_size {}, will it fit in {}?", payload_size, buffer_size);
-    VERIFY(buffer_size >= payload_size);
-    if (!buffer.write(tcp_packet.payload(), payload_size))
-        return EFAULT;
-    return payload_size;
+    return IPv4Socket::can_write(description, size) && m_send_queue_bytes < send_buffer_size;
 }
 
 KResultOr<size_t> TCPSocket::protocol_send(const UserOrKernelBuffer& data, size_t data_length)
 {
-    int err = send_tcp_packet(TCPFlags::PUSH | TCPFlags::ACK, &data, data_length);
-    if (err < 0)
-        return KResult((ErrnoCode)-err);
-    return data_length;
+    size_t space = send_buffer_size > m_send_queue_bytes ? send_buffer_size - m_send_queue_bytes : 0;
+    size_t length = min(data_length, space);
+    if (length == 0)
+        return EAGAIN;
+
+    size_t mss = min(m_send_mss, our_mss());
+    size_t nsent = 0;
+    while (nsent < length) {
+        size_t segment_size = min(mss, length - nsent);
+        auto segment_data = data.offset(nsent);
+        auto result = send_tcp_packet(TCPFlags::PUSH | TCPFlags::ACK, &segment_data, segment_size);
+        if (result.is_error()) {
+            if (nsent > 0)
+                break;
+            return result;
+        }
+        nsent += segment_size;
+    }
+    return nsent;
+}
+
+u16 TCPSocket::our_mss() const
+{
+    auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+    if (routing_decision.is_zero())
+        return default_mss;
+    size_t mtu = routing_decision.adapter->mtu();
+    if (mtu <= sizeof(IPv4Packet) + sizeof(TCPPacket) + default_mss)
+        return default_mss;
+    return min(mtu - sizeof(IPv4Packet) - sizeof(TCPPacket), (size_t)NumericLimits<u16>::max() - sizeof(IPv4Packet) - sizeof(TCPPacket));
+}
+
+u32 TCPSocket::receive_window() const
+{
+    // Data held in the out-of-order queue will need room in the receive buffer once the hole before it is filled.
+    size_t space = receive_buffer_space();
+    if (space <= m_out_of_order_bytes)
+        return 0;
+    return space - m_out_of_order_bytes;
+}
+
+size_t TCPSocket::build_options(u16 flags, u8* options) const
+{
+    size_t size = 0;
+    auto append = [&](u8 byte) { options[size++] = byte; };
+
+    if (flags & TCPFlags::SYN) {
+        // On a SYN-ACK we may only echo the options the peer offered.
+        bool is_syn_ack = flags & TCPFlags::ACK;
+        u16 mss = our_mss();
+        append(TCPOptionKind::MSS);
+        append(4);
+        append(mss >> 8);
+        append(mss & 0xff);
+        if (!is_syn_ack || m_window_scaling_enabled) {
+            append(TCPOptionKind::NOP);
+            append(TCPOptionKind::WindowScale);
+            append(3);
+            append(m_receive_window_scale);
+        }
+        if (!is_syn_ack || m_sack_permitted) {
+            append(TCPOptionKind::NOP);
+            append(TCPOptionKind::NOP);
+            append(TCPOptionKind::SACKPermitted);
+            append(2);
+        }
+        return size;
+    }
+
+    if (!m_sack_permitted || m_out_of_order_segments.is_empty() || (flags & (TCPFlags::FIN | TCPFlags::RST)))
+        return size;
+
+    // Merge the out-of-order queue into contiguous blocks. The block containing the most recently
+    // received segment goes first, as RFC 2018 asks.
+    Vector<Array<u32, 2>, 16> blocks;
+    for (auto& segment : m_out_of_order_segments) {
+        u32 start = segment.sequence_number;
+        u32 end = segment.sequence_number + segment.payload.size();
+        if (!blocks.is_empty() && sequence_less_or_equal(start, blocks.last()[1])) {
+            if (sequence_less_than(blocks.last()[1], end))
+                blocks.last()[1] = end;
+            continue;
+        }
+        blocks.append({ start, end });
+    }
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        if (sequence_less_or_equal(blocks[i][0], m_last_out_of_order_sequence_number) && sequence_less_than(m_last_out_of_order_sequence_number, blocks[i][1])) {
+            auto block = blocks[i];
+            blocks.remove(i);
+            blocks.prepend(block);
+            break;
+        }
+    }
+
+    size_t block_count = min(blocks.size(), max_tcp_sack_blocks);
+    append(TCPOptionKind::NOP);
+    append(TCPOptionKind::NOP);
+    append(TCPOptionKind::SACK);
+    append(2 + block_count * 8);
+    for (size_t i = 0; i < block_count; ++i) {
+        for (u32 edge : blocks[i]) {
+            append(edge >> 24);
+            append((edge >> 16) & 0xff);
+            append((edge >> 8) & 0xff);
+            append(edge & 0xff);
+        }
+    }
+    return size;
 }
 
 KResult TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload, size_t payload_size)
 {
-    const size_t buffer_size = sizeof(TCPPacket) + payload_size;
+    u8 options[40];
+    size_t options_size = build_options(flags, options);
+    const size_t header_size = sizeof(TCPPacket) + options_size;
+    const size_t buffer_size = header_size + payload_size;
     auto buffer = ByteBuffer::create_zeroed(buffer_size);
     auto& tcp_packet = *(TCPPacket*)(buffer.data());
     VERIFY(local_port());
     tcp_packet.set_source_port(local_port());
     tcp_packet.set_destination_port(peer_port());
-    tcp_packet.set_window_size(1024);
     tcp_packet.set_sequence_number(m_sequence_number);
-    tcp_packet.set_data_offset(sizeof(TCPPacket) / sizeof(u32));
+    tcp_packet.set_data_offset(header_size / sizeof(u32));
     tcp_packet.set_flags(flags);
-
-    if (flags & TCPFlags::ACK)
-        tcp_packet.set_ack_number(m_ack_number);
+    memcpy(tcp_packet.options(), options, options_size);
 
     if (payload && !payload->read(tcp_packet.payload(), payload_size))
         return EFAULT;
 
     if (flags & TCPFlags::SYN) {
+        m_send_unacknowledged = m_sequence_number;
         ++m_sequence_number;
     } else {
         m_sequence_number += payload_size;
     }
+    if (flags & TCPFlags::FIN)
+        ++m_sequence_number;
 
-    tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), tcp_packet, payload_size));
-
-    if (tcp_packet.has_syn() || payload_size > 0) {
+    if (tcp_packet.has_syn() || tcp_packet.has_fin() || payload_size > 0) {
         LOCKER(m_not_acked_lock);
         m_not_acked.append({ m_sequence_number, move(buffer) });
+        m_send_queue_bytes += payload_size;
         send_outgoing_packets();
         return KSuccess;
     }
@@ -219,7 +340,9 @@ KResult TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload,
     auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
     VERIFY(!routing_decision.is_zero());
 
-    auto packet_buffer = UserOrKernelBuffer::for_kernel_buffer(buffer.data());
+    OutgoingPacket packet { m_sequence_number, move(buffer) };
+    prepare_for_transmission(packet);
+    auto packet_buffer = UserOrKernelBuffer::for_kernel_buffer(packet.buffer.data());
     auto result = routing_decision.adapter->send_ipv4(
         routing_decision.next_hop, peer_address(), IPv4Protocol::TCP,
         packet_buffer, buffer_size, ttl());
@@ -231,90 +354,511 @@ KResult TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload,
     return KSuccess;
 }
 
+void TCPSocket::prepare_for_transmission(OutgoingPacket& packet)
+{
+    // The acknowledgement and window fields describe the receiver side at the time of sending, so they are
+    // filled in for every (re)transmission rather than when the segment is queued.
+    auto& tcp_packet = *(TCPPacket*)(packet.buffer.data());
+    u32 window = receive_window();
+    if (tcp_packet.has_syn()) {
+        tcp_packet.set_window_size(min(window, (u32)NumericLimits<u16>::max()));
+    } else {
+        window = min(window, (u32)NumericLimits<u16>::max() << receive_window_scale());
+        tcp_packet.set_window_size(window >> receive_window_scale());
+    }
+    m_last_advertised_window = window;
+
+    if (tcp_packet.has_ack()) {
+        tcp_packet.set_ack_number(m_ack_number);
+        m_delayed_ack_pending = false;
+        m_unacknowledged_segments = 0;
+    }
+
+    tcp_packet.set_checksum(0);
+    tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), tcp_packet, packet.payload_size()));
+}
+
+void TCPSocket::transmit(OutgoingPacket& packet, RoutingDecision& routing_decision)
+{
+    packet.tx_time = TimeManagement::the().monotonic_time();
+    packet.tx_counter++;
+    packet.lost = false;
+    if (packet.tx_counter > 1) {
+        ++m_retransmissions;
+        packet.retransmitted_in_recovery = m_in_fast_recovery;
+    }
+    prepare_for_transmission(packet);
+
+    if constexpr (TCP_SOCKET_DEBUG) {
+        auto& tcp_packet = packet.tcp_packet();
+        dbgln("Sending TCP packet from {}:{} to {}:{} with ({}{}{}{}) seq_no={}, ack_no={}, tx_counter={}, cwnd={}",
+            local_address(), local_port(),
+            peer_address(), peer_port(),
+            (tcp_packet.has_syn() ? "SYN " : ""),
+            (tcp_packet.has_ack() ? "ACK " : ""),
+            (tcp_packet.has_fin() ? "FIN " : ""),
+            (tcp_packet.has_rst() ? "RST " : ""),
+            tcp_packet.sequence_number(),
+            tcp_packet.ack_number(),
+            packet.tx_counter,
+            m_congestion_window);
+    }
+
+    auto packet_buffer = UserOrKernelBuffer::for_kernel_buffer(packet.buffer.data());
+    int err = routing_decision.adapter->send_ipv4(
+        routing_decision.next_hop, peer_address(), IPv4Protocol::TCP,
+        packet_buffer, packet.buffer.size(), ttl());
+    if (err < 0) {
+        auto& tcp_packet = packet.tcp_packet();
+        dmesgln("Error ({}) sending TCP packet from {}:{} to {}:{} with ({}{}{}{}) seq_no={}, ack_no={}, tx_counter={}",
+            err,
+            local_address(),
+            local_port(),
+            peer_address(),
+            peer_port(),
+            (tcp_packet.has_syn() ? "SYN " : ""),
+            (tcp_packet.has_ack() ? "ACK " : ""),
+            (tcp_packet.has_fin() ? "FIN " : ""),
+            (tcp_packet.has_rst() ? "RST " : ""),
+            tcp_packet.sequence_number(),
+            tcp_packet.ack_number(),
+            packet.tx_counter);
+    } else {
+        m_packets_out++;
+        m_bytes_out += packet.buffer.size();
+    }
+
+    if (!m_retransmission_timer_armed)
+        arm_retransmission_timer();
+}
+
+u32 TCPSocket::bytes_in_flight() const
+{
+    u32 bytes = 0;
+    for (auto& packet : m_not_acked) {
+        if (packet.tx_counter > 0 && !packet.sacked && !packet.lost)
+            bytes += packet.length();
+    }
+    return bytes;
+}
+
+u32 TCPSocket::highest_sent_sequence_number() const
+{
+    u32 highest = m_send_unacknowledged;
+    for (auto& packet : m_not_acked) {
+        if (packet.tx_counter == 0)
+            break;
+        highest = packet.ack_number;
+    }
+    return highest;
+}
+
 void TCPSocket::send_outgoing_packets()
 {
+    if (m_not_acked.is_empty())
+        return;
+
     auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
     VERIFY(!routing_decision.is_zero());
 
-    auto now = kgettimeofday();
-
     LOCKER(m_not_acked_lock, Lock::Mode::Shared);
+    u32 in_flight = bytes_in_flight();
     for (auto& packet : m_not_acked) {
-        auto diff = now - packet.tx_time;
-        if (diff <= Time::from_nanoseconds(500'000'000))
+        // Segments that are out in the network (or known to have arrived) are left to the ACK clock and the timers.
+        if (packet.tx_counter > 0 && !packet.lost)
             continue;
-        packet.tx_time = now;
-        packet.tx_counter++;
-
-        if constexpr (TCP_SOCKET_DEBUG) {
-            auto& tcp_packet = *(const TCPPacket*)(packet.buffer.data());
-            dbgln("Sending TCP packet from {}:{} to {}:{} with ({}{}{}{}) seq_no={}, ack_no={}, tx_counter={}",
-                local_address(), local_port(),
-                peer_address(), peer_port(),
-                (tcp_packet.has_syn() ? "SYN " : ""),
-                (tcp_packet.has_ack() ? "ACK " : ""),
-                (tcp_packet.has_fin() ? "FIN " : ""),
-                (tcp_packet.has_rst() ? "RST " : ""),
-                tcp_packet.sequence_number(),
-                tcp_packet.ack_number(),
-                packet.tx_counter);
+        if (in_flight > 0 && in_flight + packet.length() > m_congestion_window)
+            break;
+        // New data must also fit the peer's receive window; a zero window is probed from the retransmission timer.
+        if (packet.tx_counter == 0 && !packet.tcp_packet().has_syn()
+            && sequence_less_than(m_send_unacknowledged + m_send_window, packet.ack_number))
+            break;
+        transmit(packet, routing_decision);
+        in_flight += packet.length();
+    }
+}
+
+void TCPSocket::arm_retransmission_timer()
+{
+    // NetworkTask only ticks while some timer is armed, so make sure it notices this one.
+    if (!m_retransmission_timer_armed)
+        NetworkTask::wake();
+    m_retransmission_deadline = TimeManagement::the().monotonic_time() + Time::from_microseconds(m_retransmission_timeout_us);
+    m_retransmission_timer_armed = true;
+}
+
+void TCPSocket::update_round_trip_time(i64 sample_us)
+{
+    if (!m_has_rtt_sample) {
+        m_smoothed_rtt_us = sample_us;
+        m_rtt_variance_us = sample_us / 2;
+        m_has_rtt_sample = true;
+    } else {
+        i64 delta = m_smoothed_rtt_us - sample_us;
+        if (delta < 0)
+            delta = -delta;
+        m_rtt_variance_us = (3 * m_rtt_variance_us + delta) / 4;
+        m_smoothed_rtt_us = (7 * m_smoothed_rtt_us + sample_us) / 8;
+    }
+    i64 timeout = m_smoothed_rtt_us + max(clock_granularity_us, 4 * m_rtt_variance_us);
+    m_retransmission_timeout_us = clamp(timeout, min_retransmission_timeout_us, max_retransmission_timeout_us);
+}
+
+void TCPSocket::mark_sacked_segments(const TCPPacket& packet)
+{
+    packet.for_each_option([&](u8 kind, const u8* data, size_t length) {
+        if (kind != TCPOptionKind::SACK)
+            return;
+        for (size_t offset = 0; offset + 8 <= length; offset += 8) {
+            auto read_u32 = [&](size_t at) { return (u32)data[at] << 24 | (u32)data[at + 1] << 16 | (u32)data[at + 2] << 8 | (u32)data[at + 3]; };
+            u32 left = read_u32(offset);
+            u32 right = read_u32(offset + 4);
+            for (auto& segment : m_not_acked) {
+                if (segment.tx_counter == 0)
+                    break;
+                if (sequence_less_or_equal(left, segment.sequence_number()) && sequence_less_or_equal(segment.ack_number, right)) {
+                    segment.sacked = true;
+                    segment.lost = false;
+                }
+            }
         }
+    });
+}
 
-        auto packet_buffer = UserOrKernelBuffer::for_kernel_buffer(packet.buffer.data());
-        int err = routing_decision.adapter->send_ipv4(
-            routing_decision.next_hop, peer_address(), IPv4Protocol::TCP,
-            packet_buffer, packet.buffer.size(), ttl());
-        if (err < 0) {
-            auto& tcp_packet = *(const TCPPacket*)(packet.buffer.data());
-            dmesgln("Error ({}) sending TCP packet from {}:{} to {}:{} with ({}{}{}{}) seq_no={}, ack_no={}, tx_counter={}",
-                err,
-                local_address(),
-                local_port(),
-                peer_address(),
-                peer_port(),
-                (tcp_packet.has_syn() ? "SYN " : ""),
-                (tcp_packet.has_ack() ? "ACK " : ""),
-                (tcp_packet.has_fin() ? "FIN " : ""),
-                (tcp_packet.has_rst() ? "RST " : ""),
-                tcp_packet.sequence_number(),
-                tcp_packet.ack_number(),
-                packet.tx_counter);
-        } else {
-            m_packets_out++;
-            m_bytes_out += packet.buffer.size();
+void TCPSocket::mark_lost_segments()
+{
+    // RFC 6675's IsLost(): a hole with at least three SACKed segments above it has left the network.
+    size_t sacked_above = 0;
+    for (auto& segment : m_not_acked) {
+        if (segment.sacked)
+            ++sacked_above;
+    }
+    for (auto& segment : m_not_acked) {
+        if (segment.tx_counter == 0 || sacked_above < 3)
+            break;
+        if (segment.sacked) {
+            --sacked_above;
+            continue;
         }
+        if (!segment.lost && !segment.retransmitted_in_recovery)
+            segment.lost = true;
     }
 }
 
+void TCPSocket::enter_fast_recovery()
+{
+    dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}): entering fast recovery at {}, cwnd={}", this, m_send_unacknowledged, m_congestion_window);
+    m_slow_start_threshold = max(bytes_in_flight() / 2, 2u * m_send_mss);
+    m_recovery_point = highest_sent_sequence_number();
+    m_in_fast_recovery = true;
+    for (auto& segment : m_not_acked)
+        segment.retransmitted_in_recovery = false;
+    for (auto& segment : m_not_acked) {
+        if (!segment.sacked) {
+            segment.lost = true;
+            break;
+        }
+    }
+    // Without SACK the three duplicate ACKs stand for segments that left the network (RFC 6582).
+    m_congestion_window = m_slow_start_threshold + (m_sack_permitted ? 0 : 3 * m_send_mss);
+}
+
 void TCPSocket::receive_tcp_packet(const TCPPacket& packet, u16 size)
 {
+    size_t payload_size = size - packet.header_size();
     if (packet.has_ack()) {
         u32 ack_number = packet.ack_number();
+        u32 window = packet.window_size();
+        if (!packet.has_syn())
+            window <<= send_window_scale();
 
         dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet: {}", ack_number);
 
-        int removed = 0;
         LOCKER(m_not_acked_lock);
-        while (!m_not_acked.is_empty()) {
-            auto& packet = m_not_acked.first();
-
-            dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: iterate: {}", packet.ack_number);
-
-            if (packet.ack_number <= ack_number) {
+        if (m_sack_permitted)
+            mark_sacked_segments(packet);
+
+        if (sequence_less_than(m_send_unacknowledged, ack_number) && sequence_less_or_equal(ack_number, highest_sent_sequence_number())) {
+            u32 acknowledged = ack_number - m_send_unacknowledged;
+            Optional<i64> rtt_sample_us;
+            int removed = 0;
+            while (!m_not_acked.is_empty()) {
+                auto& segment = m_not_acked.first();
+                if (sequence_less_than(ack_number, segment.ack_number))
+                    break;
+                // Karn's algorithm: an ACK for a retransmitted segment is ambiguous and says nothing about the RTT.
+                if (segment.tx_counter == 1)
+                    rtt_sample_us = (TimeManagement::the().monotonic_time() - segment.tx_time).to_microseconds();
+                m_send_queue_bytes -= segment.payload_size();
                 m_not_acked.take_first();
                 removed++;
+            }
+            dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet acknowledged {} packets", removed);
+
+            m_send_unacknowledged = ack_number;
+            m_duplicate_ack_count = 0;
+            if (rtt_sample_us.has_value())
+                update_round_trip_time(rtt_sample_us.value());
+
+            if (m_in_fast_recovery) {
+                if (sequence_less_or_equal(m_recovery_point, ack_number)) {
+                    m_congestion_window = m_slow_start_threshold;
+                    m_in_fast_recovery = false;
+                } else {
+                    // Partial ACK: the next hole was lost as well. Deflate by the amount acknowledged (RFC 6582).
+                    for (auto& segment : m_not_acked) {
+                        if (!segment.sacked) {
+                            if (!segment.retransmitted_in_recovery)
+                                segment.lost = true;
+                            break;
+                        }
+                    }
+                    m_congestion_window -= min(m_congestion_window, acknowledged);
+                    m_congestion_window += m_send_mss;
+                }
+            } else if (m_congestion_window < m_slow_start_threshold) {
+                m_congestion_window += min(acknowledged, (u32)m_send_mss);
             } else {
-                break;
+                m_congestion_window += max(1u, (u32)m_send_mss * m_send_mss / m_congestion_window);
             }
+
+            if (m_not_acked.is_empty() || m_not_acked.first().tx_counter == 0)
+                m_retransmission_timer_armed = false;
+            else
+                arm_retransmission_timer();
+
+            evaluate_block_conditions();
+        } else if (ack_number == m_send_unacknowledged && payload_size == 0 && !packet.has_syn() && !packet.has_fin()
+            && window == m_send_window && !m_not_acked.is_empty() && m_not_acked.first().tx_counter > 0) {
+            ++m_duplicate_ack_count;
+            if (!m_in_fast_recovery && m_duplicate_ack_count == 3)
+                enter_fast_recovery();
+            else if (m_in_fast_recovery && !m_sack_permitted)
+                m_congestion_window += m_send_mss;
         }
 
-        dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket: receive_tcp_packet acknowledged {} packets", removed);
+        if (m_in_fast_recovery && m_sack_permitted)
+            mark_lost_segments();
+
+        m_send_window = window;
+        send_outgoing_packets();
     }
 
     m_packets_in++;
     m_bytes_in += packet.header_size() + size;
 }
 
+void TCPSocket::apply_syn_options(const TCPPacket& packet)
+{
+    bool peer_sent_window_scale = false;
+    packet.for_each_option([&](u8 kind, const u8* data, size_t length) {
+        switch (kind) {
+        case TCPOptionKind::MSS:
+            if (length == 2)
+                m_send_mss = min((u16)(data[0] << 8 | data[1]), our_mss());
+            break;
+        case TCPOptionKind::WindowScale:
+            if (length == 1) {
+                peer_sent_window_scale = true;
+                m_send_window_scale = min(data[0], max_tcp_window_scale);
+            }
+            break;
+        case TCPOptionKind::SACKPermitted:
+            m_sack_permitted = true;
+            break;
+        default:
+            break;
+        }
+    });
+    // Scaling is only in effect if both sides asked for it. If the peer didn't, our SYN-ACK won't offer it either.
+    m_window_scaling_enabled = peer_sent_window_scale;
+    m_send_window = packet.window_size();
+    m_congestion_window = initial_congestion_window(m_send_mss);
+}
+
+void TCPSocket::send_ack_now()
+{
+    [[maybe_unused]] auto rc = send_tcp_packet(TCPFlags::ACK);
+}
+
+void TCPSocket::queue_out_of_order_segment(u32 sequence_number, PacketBuffer& packet, ReadonlyBytes payload)
+{
+    u32 length = payload.size();
+    m_last_out_of_order_sequence_number = sequence_number;
+
+    size_t index = 0;
+    for (; index < m_out_of_order_segments.size(); ++index) {
+        auto& segment = m_out_of_order_segments[index];
+        if (segment.sequence_number == sequence_number && segment.payload.size() >= length)
+            return;
+        if (sequence_less_than(sequence_number, segment.sequence_number))
+            break;
+    }
+    if (m_out_of_order_segments.size() >= max_out_of_order_segments || m_out_of_order_bytes + length > receive_buffer_space())
+        return;
+    m_out_of_order_bytes += length;
+    m_out_of_order_segments.insert(index, { sequence_number, packet, payload });
+}
+
+void TCPSocket::deliver_out_of_order_segments()
+{
+    while (!m_out_of_order_segments.is_empty()) {
+        auto& segment = m_out_of_order_segments.first();
+        if (sequence_less_than(m_ack_number, segment.sequence_number))
+            return;
+        u32 end = segment.sequence_number + segment.payload.size();
+        if (sequence_less_than(m_ack_number, end)) {
+            if (!did_receive_stream_data(segment.payload.slice(m_ack_number - segment.sequence_number)))
+                return;
+            m_ack_number = end;
+        }
+        m_out_of_order_bytes -= segment.payload.size();
+        m_out_of_order_segments.take_first();
+    }
+}
+
+bool TCPSocket::receive_data(PacketBuffer& packet, const TCPPacket& tcp_packet, size_t payload_size)
+{
+    ReadonlyBytes payload { (const u8*)tcp_packet.payload(), payload_size };
+    u32 sequence_number = tcp_packet.sequence_number();
+    u32 end = sequence_number + payload_size;
+
+    if (payload_size == 0)
+        return sequence_number == m_ack_number;
+
+    if (sequence_less_or_equal(end, m_ack_number)) {
+        // A retransmission of something we already have; our ACK must have been lost.
+        send_ack_now();
+        return end == m_ack_number;
+    }
+
+    if (sequence_less_than(m_ack_number, sequence_number)) {
+        // There is a hole before this segment. Hold on to the data and tell the peer right away (RFC 5681 4.2),
+        // the duplicate ACKs and SACK blocks drive its fast retransmit.
+        queue_out_of_order_segment(sequence_number, packet, payload);
+        send_ack_now();
+        return false;
+    }
+
+    if (is_shut_down_for_reading()) {
+        // Nobody will read this, but the peer still needs to see it acknowledged to finish sending.
+        m_ack_number = end;
+        send_ack_now();
+        return true;
+    }
+
+    // Part of the segment may be a retransmission of data we already have.
+    if (!did_receive_stream_data(payload.slice(m_ack_number - sequence_number))) {
+        // No room; advertise what we have so the peer backs off and retries.
+        send_ack_now();
+        return false;
+    }
+    m_ack_number = end;
+
+    bool had_out_of_order_segments = !m_out_of_order_segments.is_empty();
+    deliver_out_of_order_segments();
+
+    dbgln_if(TCP_DEBUG, "Got packet with ack_no={}, seq_no={}, payload_size={}, acking it with new ack_no={}, seq_no={}",
+        tcp_packet.ack_number(), tcp_packet.sequence_number(), payload_size, m_ack_number, m_sequence_number);
+
+    // Delayed ACKs (RFC 1122 4.2.3.2): acknowledge at least every second full segment, and immediately when a hole was filled.
+    if (had_out_of_order_segments || ++m_unacknowledged_segments >= 2) {
+        send_ack_now();
+    } else if (!m_delayed_ack_pending) {
+        m_delayed_ack_pending = true;
+        m_delayed_ack_deadline = TimeManagement::the().monotonic_time() + Time::from_milliseconds(delayed_ack_timeout_ms);
+        NetworkTask::wake();
+    }
+    return true;
+}
+
+void TCPSocket::protocol_did_read_from_receive_buffer()
+{
+    if (state() != State::Established && state() != State::FinWait1 && state() != State::FinWait2)
+        return;
+    // Avoid silly window syndrome: only announce a window that has grown by a meaningful amount (RFC 1122 4.2.3.3).
+    u32 window = receive_window();
+    u32 threshold = min((u32)stream_receive_buffer_size / 2, 2u * m_send_mss);
+    if (window > m_last_advertised_window && window - m_last_advertised_window >= threshold)
+        send_ack_now();
+}
+
+void TCPSocket::handle_expired_timers(const Time& now)
+{
+    if (state() == State::Closed || state() == State::Listen) {
+        m_retransmission_timer_armed = false;
+        m_delayed_ack_pending = false;
+        return;
+    }
+
+    if (m_delayed_ack_pending && now >= m_delayed_ack_deadline)
+        send_ack_now();
+
+    if (!m_retransmission_timer_armed || now < m_retransmission_deadline)
+        return;
+
+    auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+    if (routing_decision.is_zero())
+        return;
+
+    LOCKER(m_not_acked_lock);
+    if (m_not_acked.is_empty()) {
+        m_retransmission_timer_armed = false;
+        return;
+    }
+
+    m_retransmission_timeout_us = min(m_retransmission_timeout_us * 2, max_retransmission_timeout_us);
+
+    auto& first = m_not_acked.first();
+    if (first.tx_counter == 0) {
+        // Nothing is in flight, so the peer's window must be closed. Probe it with the next segment.
+        transmit(first, routing_decision);
+        arm_retransmission_timer();
+        return;
+    }
+
+    dbgln_if(TCP_SOCKET_DEBUG, "TCPSocket({}): retransmission timeout at {}, rto={}ms", this, m_send_unacknowledged, m_retransmission_timeout_us / 1000);
+
+    // RFC 5681 3.1: collapse to one segment and slow start from everything still outstanding.
+    m_slow_start_threshold = max(bytes_in_flight() / 2, 2u * m_send_mss);
+    m_congestion_window = m_send_mss;
+    m_in_fast_recovery = false;
+    m_duplicate_ack_count = 0;
+    for (auto& segment : m_not_acked) {
+        if (segment.tx_counter == 0)
+            break;
+        if (!segment.sacked)
+            segment.lost = true;
+    }
+    m_retransmission_timer_armed = false;
+    send_outgoing_packets();
+    if (!m_retransmission_timer_armed)
+        arm_retransmission_timer();
+}
+
+bool TCPSocket::process_timers()
+{
+    Vector<NonnullRefPtr<TCPSocket>, 16> sockets;
+    {
+        LOCKER(sockets_by_tuple().lock(), Lock::Mode::Shared);
+        for (auto& it : sockets_by_tuple().resource()) {
+            auto* socket = it.value;
+            if (socket->has_armed_timers() && socket->try_ref())
+                sockets.append(adopt(*socket));
+        }
+    }
+
+    // The socket lock is taken without holding the tuple lock, since connect() takes them in the opposite order.
+    auto now = TimeManagement::the().monotonic_time();
+    bool any_armed = false;
+    for (auto& socket : sockets) {
+        LOCKER(socket->lock());
+        socket->handle_expired_timers(now);
+        any_armed |= socket->has_armed_timers();
+    }
+    return any_armed;
+}
+
 NetworkOrdered<u16> TCPSocket::compute_tcp_checksum(const IPv4Address& source, const IPv4Address& destination, const TCPPacket& packet, u16 payload_size)
 {
     struct [[gnu::packed]] PseudoHeader {
@@ -325,7 +869,7 @@ NetworkOrdered<u16> TCPSocket::compute_tcp_checksum(const IPv4Address& source, c
         NetworkOrdered<u16> payload_size;
     };
 
-    PseudoHeader pseudo_header { source, destination, 0, (u8)IPv4Protocol::TCP, sizeof(TCPPacket) + payload_size };
+    PseudoHeader pseudo_header { source, destination, 0, (u8)IPv4Protocol::TCP, (u16)(packet.header_size() + payload_size) };
 
     u32 checksum = 0;
     auto* w = (const NetworkOrdered<u16>*)&pseudo_header;
@@ -335,12 +879,11 @@ NetworkOrdered<u16> TCPSocket::compute_tcp_checksum(const IPv4Address& source, c
             checksum = (checksum >> 16) + (checksum & 0xffff);
     }
     w = (const NetworkOrdered<u16>*)&packet;
-    for (size_t i = 0; i < sizeof(packet) / sizeof(u16); ++i) {
+    for (size_t i = 0; i < packet.header_size() / sizeof(u16); ++i) {
         checksum += w[i];
         if (checksum > 0xffff)
             checksum = (checksum >> 16) + (checksum & 0xffff);
     }
-    VERIFY(packet.data_offset() * 4 == sizeof(TCPPacket));
     w = (const NetworkOrdered<u16>*)packet.payload();
     for (size_t i = 0; i < payload_size / sizeof(u16); ++i) {
         checksum += w[i];
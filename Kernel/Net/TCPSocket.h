@@ -28,14 +28,22 @@
 
 #include <AK/Function.h>
 #include <AK/HashMap.h>
+#include <AK/NumericLimits.h>
 #include <AK/SinglyLinkedList.h>
+#include <AK/Vector.h>
 #include <AK/WeakPtr.h>
 #include <Kernel/Net/IPv4Socket.h>
+#include <Kernel/Net/TCP.h>
 
 namespace Kernel {
 
+struct RoutingDecision;
+
 class TCPSocket final : public IPv4Socket {
 public:
+    // RFC 1122 4.2.2.6
+    static constexpr u16 default_mss = 536;
+
     static void for_each(Function<void(const TCPSocket&)>);
     static NonnullRefPtr<TCPSocket> create(int protocol);
     virtual ~TCPSocket() override;
@@ -148,9 +156,28 @@ public:
     u32 packets_out() const { return m_packets_out; }
     u32 bytes_out() const { return m_bytes_out; }
 
+    u32 congestion_window() const { return m_congestion_window; }
+    u32 slow_start_threshold() const { return m_slow_start_threshold; }
+    u32 send_window() const { return m_send_window; }
+    u16 send_mss() const { return m_send_mss; }
+    u32 smoothed_rtt_ms() const { return m_smoothed_rtt_us / 1000; }
+    u32 retransmission_timeout_ms() const { return m_retransmission_timeout_us / 1000; }
+    u32 retransmissions() const { return m_retransmissions; }
+    bool is_sack_permitted() const { return m_sack_permitted; }
+    u8 send_window_scale() const { return m_window_scaling_enabled ? m_send_window_scale : 0; }
+    u8 receive_window_scale() const { return m_window_scaling_enabled ? m_receive_window_scale : 0; }
+
     KResult send_tcp_packet(u16 flags, const UserOrKernelBuffer* = nullptr, size_t = 0);
     void send_outgoing_packets();
     void receive_tcp_packet(const TCPPacket&, u16 size);
+    void apply_syn_options(const TCPPacket&);
+
+    // Handles the payload of a segment in a synchronized state. Returns true if everything up to the
+    // end of the segment has been received, i.e. a FIN carried by it can be processed.
+    bool receive_data(PacketBuffer&, const TCPPacket&, size_t payload_size);
+
+    // Runs expired retransmission and delayed ACK timers. Returns whether any socket still has a timer armed.
+    static bool process_timers();
 
     static Lockable<HashMap<IPv4SocketTuple, TCPSocket*>>& sockets_by_tuple();
     static RefPtr<TCPSocket> from_tuple(const IPv4SocketTuple& tuple);
@@ -165,6 +192,7 @@ public:
     void release_for_accept(RefPtr<TCPSocket>);
 
     virtual KResult close() override;
+    virtual bool can_write(const FileDescription&, size_t) const override;
 
 protected:
     void set_direction(Direction direction) { m_direction = direction; }
@@ -177,13 +205,33 @@ private:
 
     virtual void shut_down_for_writing() override;
 
-    virtual KResultOr<size_t> protocol_receive(ReadonlyBytes raw_ipv4_packet, UserOrKernelBuffer& buffer, size_t buffer_size, int flags) override;
     virtual KResultOr<size_t> protocol_send(const UserOrKernelBuffer&, size_t) override;
     virtual KResult protocol_connect(FileDescription&, ShouldBlock) override;
     virtual int protocol_allocate_local_port() override;
     virtual bool protocol_is_disconnected() const override;
     virtual KResult protocol_bind() override;
     virtual KResult protocol_listen() override;
+    virtual void protocol_did_read_from_receive_buffer() override;
+
+    struct OutgoingPacket;
+
+    u32 receive_window() const;
+    u16 our_mss() const;
+    size_t build_options(u16 flags, u8* options) const;
+    void prepare_for_transmission(OutgoingPacket&);
+    void transmit(OutgoingPacket&, RoutingDecision&);
+    u32 bytes_in_flight() const;
+    u32 highest_sent_sequence_number() const;
+    void update_round_trip_time(i64 sample_us);
+    void enter_fast_recovery();
+    void mark_sacked_segments(const TCPPacket&);
+    void mark_lost_segments();
+    void arm_retransmission_timer();
+    void handle_expired_timers(const Time& now);
+    bool has_armed_timers() const { return m_retransmission_timer_armed || m_delayed_ack_pending; }
+    void send_ack_now();
+    void queue_out_of_order_segment(u32 sequence_number, PacketBuffer&, ReadonlyBytes payload);
+    void deliver_out_of_order_segments();
 
     WeakPtr<TCPSocket> m_originator;
     HashMap<IPv4SocketTuple, NonnullRefPtr<TCPSocket>> m_pending_release_for_accept;
@@ -198,15 +246,63 @@ private:
     u32 m_packets_out { 0 };
     u32 m_bytes_out { 0 };
 
+    // Segments occupying sequence space (SYN, FIN and data), from the first unacknowledged one to the last queued one.
     struct OutgoingPacket {
         u32 ack_number { 0 };
         ByteBuffer buffer;
         int tx_counter { 0 };
         Time tx_time {};
+        bool sacked { false };
+        bool lost { false };
+        bool retransmitted_in_recovery { false };
+
+        const TCPPacket& tcp_packet() const { return *(const TCPPacket*)buffer.data(); }
+        u32 sequence_number() const { return tcp_packet().sequence_number(); }
+        u32 length() const { return ack_number - sequence_number(); }
+        size_t payload_size() const { return buffer.size() - tcp_packet().header_size(); }
     };
 
     Lock m_not_acked_lock { "TCPSocket unacked packets" };
     SinglyLinkedList<OutgoingPacket> m_not_acked;
+    size_t m_send_queue_bytes { 0 };
+
+    // Sender state: RFC 5681 congestion control with RFC 6582 NewReno recovery, RFC 2018 SACK and RFC 6298 timers.
+    u32 m_send_unacknowledged { 0 };
+    u32 m_send_window { 0 };
+    u16 m_send_mss { default_mss };
+    u32 m_congestion_window { 0 };
+    u32 m_slow_start_threshold { NumericLimits<u32>::max() };
+    u32 m_recovery_point { 0 };
+    bool m_in_fast_recovery { false };
+    u8 m_duplicate_ack_count { 0 };
+    i64 m_smoothed_rtt_us { 0 };
+    i64 m_rtt_variance_us { 0 };
+    i64 m_retransmission_timeout_us { 1'000'000 };
+    bool m_has_rtt_sample { false };
+    bool m_retransmission_timer_armed { false };
+    Time m_retransmission_deadline {};
+    u32 m_retransmissions { 0 };
+
+    // Options negotiated during the handshake.
+    bool m_window_scaling_enabled { false };
+    u8 m_send_window_scale { 0 };
+    u8 m_receive_window_scale { 0 };
+    bool m_sack_permitted { false };
+
+    // Receiver state.
+    // Segments received beyond a hole, keeping a reference to the frame their payload lives in.
+    struct OutOfOrderSegment {
+        u32 sequence_number { 0 };
+        NonnullRefPtr<PacketBuffer> packet;
+        ReadonlyBytes payload;
+    };
+    Vector<OutOfOrderSegment> m_out_of_order_segments;
+    size_t m_out_of_order_bytes { 0 };
+    u32 m_last_out_of_order_sequence_number { 0 };
+    u32 m_last_advertised_window { 0 };
+    u8 m_unacknowledged_segments { 0 };
+    bool m_delayed_ack_pending { false };
+    Time m_delayed_ack_deadline {};
 };
 
 }
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Debug.h>
+#include <Kernel/Net/VirtIONetworkAdapter.h>
+
+namespace Kernel {
+
+UNMAP_AFTER_INIT void VirtIONetworkAdapter::detect()
+{
+    PCI::enumerate([&](const PCI::Address& address, PCI::ID id) {
+        if (address.is_null())
+            return;
+        if (!VirtIODevice::is_virtio_device(id, VIRTIO_DEVICE_TYPE_NETWORK))
+            return;
+        auto adapter = adopt(*new VirtIONetworkAdapter(address));
+        if (!adapter->initialize_adapter())
+            return;
+        [[maybe_unused]] auto& unused = adapter.leak_ref();
+    });
+}
+
+UNMAP_AFTER_INIT VirtIONetworkAdapter::VirtIONetworkAdapter(PCI::Address address)
+    : VirtIODevice(address, "VirtIONetworkAdapter")
+{
+    set_interface_name("virtio");
+}
+
+UNMAP_AFTER_INIT VirtIONetworkAdapter::~VirtIONetworkAdapter()
+{
+}
+
+UNMAP_AFTER_INIT bool VirtIONetworkAdapter::initialize_adapter()
+{
+    if (!initialize())
+        return false;
+    // Without offloads or mergeable receive buffers, no packet is bigger than an Ethernet frame.
+    bool success = negotiate_features([](u64) {
+        return VIRTIO_NET_F_MAC | VIRTIO_NET_F_STATUS;
+    });
+    if (!success)
+        return false;
+    if (!setup_queues(2, max_queue_size))
+        return false;
+
+    if (is_feature_accepted(VIRTIO_NET_F_MAC)) {
+        set_mac_address({ config_read8(0), config_read8(1), config_read8(2), config_read8(3), config_read8(4), config_read8(5) });
+    } else {
+        dmesgln("VirtIONetworkAdapter: Device has no MAC address");
+    }
+    if (is_feature_accepted(VIRTIO_NET_F_STATUS))
+        m_link_up = config_read16(6) & VIRTIO_NET_S_LINK_UP;
+
+    auto& receive_queue = queue(receive_queue_index);
+    auto& transmit_queue = queue(transmit_queue_index);
+    size_t receive_buffer_count = min(max_receive_buffers, static_cast<size_t>(receive_queue.size()));
+    size_t transmit_buffer_count = min(max_transmit_buffers, static_cast<size_t>(transmit_queue.size()));
+    m_receive_buffers_region = MM.allocate_kernel_region(page_round_up(receive_buffer_count * buffer_size), "VirtIONetworkAdapter RX", Region::Access::Read | Region::Access::Write, AllocationStrategy::AllocateNow);
+    m_transmit_buffers_region = MM.allocate_kernel_region(page_round_up(transmit_buffer_count * buffer_size), "VirtIONetworkAdapter TX", Region::Access::Read | Region::Access::Write, AllocationStrategy::AllocateNow);
+    if (!m_receive_buffers_region || !m_transmit_buffers_region)
+        return false;
+
+    for (size_t i = 0; i < transmit_buffer_count; i++)
+        m_free_transmit_buffers.append(m_transmit_buffers_region->vaddr().offset(i * buffer_size).as_ptr());
+
+    {
+        ScopedSpinLock lock(receive_queue.lock());
+        for (size_t i = 0; i < receive_buffer_count; i++)
+            supply_receive_buffer(m_receive_buffers_region->vaddr().offset(i * buffer_size).as_ptr());
+    }
+    {
+        // We reclaim sent buffers whenever we send, so we only want transmit
+        // interrupts while waiting for the device to free up a buffer.
+        ScopedSpinLock lock(transmit_queue.lock());
+        transmit_queue.disable_interrupts();
+    }
+
+    finish_initialization();
+    notify_queue(receive_queue_index);
+
+    dmesgln("VirtIONetworkAdapter: MAC address: {}, link {}, {} RX / {} TX buffers", mac_address().to_string(), m_link_up ? "up" : "down", receive_buffer_count, transmit_buffer_count);
+    return true;
+}
+
+PhysicalAddress VirtIONetworkAdapter::buffer_physical_address(const Region& region, const u8* buffer) const
+{
+    size_t offset = buffer - region.vaddr().as_ptr();
+    VERIFY(offset < region.size());
+    // Buffers never straddle a page boundary, so each of them is physically contiguous.
+    return region.physical_page(offset / PAGE_SIZE)->paddr().offset(offset % PAGE_SIZE);
+}
+
+void VirtIONetworkAdapter::supply_receive_buffer(u8* buffer)
+{
+    VirtIOScatterEntry entry { buffer_physical_address(*m_receive_buffers_region, buffer), buffer_size, BufferType::DeviceWritable };
+    bool did_supply = queue(receive_queue_index).supply_buffers({ &entry, 1 }, buffer);
+    VERIFY(did_supply);
+}
+
+void VirtIONetworkAdapter::handle_device_config_change()
+{
+    if (!is_feature_accepted(VIRTIO_NET_F_STATUS))
+        return;
+    m_link_up = config_read16(6) & VIRTIO_NET_S_LINK_UP;
+    dbgln_if(VIRTIO_DEBUG, "VirtIONetworkAdapter: Link is now {}", m_link_up ? "up" : "down");
+}
+
+void VirtIONetworkAdapter::handle_queue_update(u16 queue_index)
+{
+    if (queue_index == receive_queue_index) {
+        receive();
+        return;
+    }
+    VERIFY(queue_index == transmit_queue_index);
+    auto& queue = this->queue(transmit_queue_index);
+    {
+        ScopedSpinLock lock(queue.lock());
+        if (!queue.new_data_available())
+            return;
+        queue.disable_interrupts();
+    }
+    m_wait_queue.wake_all();
+}
+
+void VirtIONetworkAdapter::receive()
+{
+    auto& queue = this->queue(receive_queue_index);
+    ScopedSpinLock lock(queue.lock());
+    size_t received_count = 0;
+    size_t used_length = 0;
+    // Take everything the device has for us, then hand all the buffers back with at most one notification.
+    for (;;) {
+        while (auto* buffer = static_cast<u8*>(queue.get_buffer(&used_length))) {
+            if (used_length > sizeof(VirtIONetHeader)) {
+                dbgln_if(VIRTIO_DEBUG, "VirtIONetworkAdapter: Received 1 packet @ {:p} ({} bytes)", buffer, used_length - sizeof(VirtIONetHeader));
+                did_receive({ buffer + sizeof(VirtIONetHeader), min(used_length, buffer_size) - sizeof(VirtIONetHeader) });
+            }
+            supply_receive_buffer(buffer);
+            received_count++;
+        }
+        // With event indices, the device only interrupts us again once it gets past the used event.
+        queue.enable_interrupts();
+        if (!queue.new_data_available())
+            break;
+    }
+    if (received_count > 0 && queue.should_notify())
+        notify_queue(receive_queue_index);
+}
+
+void VirtIONetworkAdapter::reclaim_transmit_buffers()
+{
+    auto& queue = this->queue(transmit_queue_index);
+    VERIFY(queue.lock().is_locked());
+    while (auto* buffer = static_cast<u8*>(queue.get_buffer(nullptr)))
+        m_free_transmit_buffers.append(buffer);
+}
+
+void VirtIONetworkAdapter::send_raw(ReadonlyBytes payload)
+{
+    if (payload.size() > buffer_size - sizeof(VirtIONetHeader)) {
+        dbgln("VirtIONetworkAdapter: Dropping oversized packet ({} bytes)", payload.size());
+        return;
+    }
+
+    auto& queue = this->queue(transmit_queue_index);
+    for (;;) {
+        {
+            ScopedSpinLock lock(queue.lock());
+            reclaim_transmit_buffers();
+            if (!m_free_transmit_buffers.is_empty()) {
+                auto* buffer = m_free_transmit_buffers.take_last();
+                memset(buffer, 0, sizeof(VirtIONetHeader));
+                memcpy(buffer + sizeof(VirtIONetHeader), payload.data(), payload.size());
+                dbgln_if(VIRTIO_DEBUG, "VirtIONetworkAdapter: Sending packet ({} bytes)", payload.size());
+
+                VirtIOScatterEntry entry { buffer_physical_address(*m_transmit_buffers_region, buffer), sizeof(VirtIONetHeader) + payload.size(), BufferType::DeviceReadable };
+                bool did_supply = queue.supply_buffers({ &entry, 1 }, buffer);
+                VERIFY(did_supply);
+                if (queue.should_notify())
+                    notify_queue(transmit_queue_index);
+                return;
+            }
+
+            // All buffers are in flight, so ask for an interrupt once the device is done with one.
+            queue.enable_interrupts();
+            if (queue.new_data_available())
+                continue;
+        }
+        m_wait_queue.wait_forever("VirtIONetworkAdapter");
+    }
+}
+
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/OwnPtr.h>
+#include <Kernel/Net/NetworkAdapter.h>
+#include <Kernel/VirtIO/VirtIO.h>
+#include <Kernel/WaitQueue.h>
+
+namespace Kernel {
+
+#define VIRTIO_NET_F_MAC ((u64)1 << 5)
+#define VIRTIO_NET_F_STATUS ((u64)1 << 16)
+
+#define VIRTIO_NET_S_LINK_UP 1
+
+class VirtIONetworkAdapter final : public NetworkAdapter
+    , public VirtIODevice {
+public:
+    static void detect();
+
+    explicit VirtIONetworkAdapter(PCI::Address);
+    virtual ~VirtIONetworkAdapter() override;
+
+    virtual void send_raw(ReadonlyBytes) override;
+    virtual bool link_up() override { return m_link_up; }
+
+    virtual const char* purpose() const override { return class_name(); }
+
+private:
+    virtual const char* class_name() const override { return "VirtIONetworkAdapter"; }
+
+    bool initialize_adapter();
+
+    virtual void handle_device_config_change() override;
+    virtual void handle_queue_update(u16 queue_index) override;
+
+    void receive();
+    void supply_receive_buffer(u8*);
+    void reclaim_transmit_buffers();
+    PhysicalAddress buffer_physical_address(const Region&, const u8* buffer) const;
+
+    // Every packet is preceded by this header, both ways.
+    struct [[gnu::packed]] VirtIONetHeader {
+        u8 flags;
+        u8 gso_type;
+        u16 header_length;
+        u16 gso_size;
+        u16 checksum_start;
+        u16 checksum_offset;
+        u16 buffer_count;
+    };
+
+    static constexpr u16 receive_queue_index = 0;
+    static constexpr u16 transmit_queue_index = 1;
+    static constexpr u16 max_queue_size = 256;
+    static constexpr size_t buffer_size = 2048;
+    static constexpr size_t max_receive_buffers = 128;
+    static constexpr size_t max_transmit_buffers = 64;
+    static_assert(PAGE_SIZE % buffer_size == 0);
+
+    OwnPtr<Region> m_receive_buffers_region;
+    OwnPtr<Region> m_transmit_buffers_region;
+    Vector<u8*, max_transmit_buffers> m_free_transmit_buffers;
+    bool m_link_up { true };
+    WaitQueue m_wait_queue;
+};
+
+}
@@ -37,9 +37,9 @@ static Access* s_access;
 inline void write8(Address address, u32 field, u8 value) { Access::the().write8_field(address, field, value); }
 inline void write16(Address address, u32 field, u16 value) { Access::the().write16_field(address, field, value); }
 inline void write32(Address address, u32 field, u32 value) { Access::the().write32_field(address, field, value); }
-inline u8 read8(Address address, u32 field) { return Access::the().read8_field(address, field); }
-inline u16 read16(Address address, u32 field) { return Access::the().read16_field(address, field); }
-inline u32 read32(Address address, u32 field) { return Access::the().read32_field(address, field); }
+u8 read8(Address address, u32 field) { return Access::the().read8_field(address, field); }
+u16 read16(Address address, u32 field) { return Access::the().read16_field(address, field); }
+u32 read32(Address address, u32 field) { return Access::the().read32_field(address, field); }
 
 Access& Access::the()
 {
@@ -176,10 +176,11 @@ Vector<Capability> get_capabilities(Address address)
     auto capability_pointer = capabilities_pointer.value();
     while (capability_pointer != 0) {
         dbgln_if(PCI_DEBUG, "PCI: Reading in capability at {:#02x} for {}", capability_pointer, address);
-        u16 capability_header = PCI::read16(address, capability_pointer);
+        u8 capability_offset = capability_pointer;
+        u16 capability_header = PCI::read16(address, capability_offset);
         u8 capability_id = capability_header & 0xff;
         capability_pointer = capability_header >> 8;
-        capabilities.append({ capability_id, capability_pointer });
+        capabilities.append({ capability_id, capability_pointer, capability_offset });
     }
     return capabilities;
 }
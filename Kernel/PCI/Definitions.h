@@ -174,6 +174,7 @@ struct ChangeableAddress : public Address {
 struct Capability {
     u8 m_id;
     u8 m_next_pointer;
+    u8 m_ptr; // Offset of this capability in the configuration space
 };
 
 class PhysicalID {
@@ -206,6 +207,9 @@ void disable_interrupt_line(Address);
 u8 get_interrupt_line(Address);
 void set_interrupt_line(Address, u8);
 void raw_access(Address, u32, size_t, u32);
+u8 read8(Address, u32 field);
+u16 read16(Address, u32 field);
+u32 read32(Address, u32 field);
 u32 get_BAR0(Address);
 u32 get_BAR1(Address);
 u32 get_BAR2(Address);
@@ -366,6 +366,7 @@ RefPtr<FileDescription> Process::file_description(int fd) const
 {
     if (fd < 0)
         return nullptr;
+    ScopedSpinLock lock(m_fds_lock);
     if (static_cast<size_t>(fd) < m_fds.size())
         return m_fds[fd].description();
     return nullptr;
@@ -375,6 +376,7 @@ int Process::fd_flags(int fd) const
 {
     if (fd < 0)
         return -1;
+    ScopedSpinLock lock(m_fds_lock);
     if (static_cast<size_t>(fd) < m_fds.size())
         return m_fds[fd].flags();
     return -1;
@@ -383,6 +385,7 @@ int Process::fd_flags(int fd) const
 int Process::number_of_open_file_descriptors() const
 {
     int count = 0;
+    ScopedSpinLock lock(m_fds_lock);
     for (auto& description : m_fds) {
         if (description)
             ++count;
@@ -392,6 +395,8 @@ int Process::number_of_open_file_descriptors() const
 
 int Process::alloc_fd(int first_candidate_fd)
 {
+    // NOTE: Only syscalls holding the big lock install new descriptions, so the slot stays free until the caller fills it.
+    ScopedSpinLock lock(m_fds_lock);
     for (int i = first_candidate_fd; i < (int)m_max_open_file_descriptors; ++i) {
         if (!m_fds[i])
             return i;
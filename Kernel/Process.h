@@ -314,6 +314,10 @@ public:
     KResultOr<int> sys$purge(int mode);
     KResultOr<int> sys$select(Userspace<const Syscall::SC_select_params*>);
     KResultOr<int> sys$poll(Userspace<const Syscall::SC_poll_params*>);
+    KResultOr<int> sys$epoll_create(int flags);
+    KResultOr<int> sys$epoll_ctl(Userspace<const Syscall::SC_epoll_ctl_params*>);
+    KResultOr<int> sys$epoll_wait(Userspace<const Syscall::SC_epoll_wait_params*>);
+    KResultOr<ssize_t> sys$sendfile(Userspace<const Syscall::SC_sendfile_params*>);
     KResultOr<ssize_t> sys$get_dir_entries(int fd, Userspace<void*>, ssize_t);
     KResultOr<int> sys$getcwd(Userspace<char*>, size_t);
     KResultOr<int> sys$chdir(Userspace<const char*>, size_t);
@@ -580,6 +584,9 @@ private:
         u32 m_flags { 0 };
     };
     Vector<FileDescriptionAndFlags> m_fds;
+    // Syscalls that don't take the big lock look up descriptions concurrently with the ones
+    // that change the table, so changes and lock-free lookups must hold this lock.
+    mutable SpinLock<u8> m_fds_lock;
 
     mutable RecursiveSpinLock m_thread_list_lock;
 
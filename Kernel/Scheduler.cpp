@@ -75,43 +75,80 @@ READONLY_AFTER_INIT static Process* s_colonel_process;
 struct ThreadReadyQueue {
     IntrusiveList<Thread, &Thread::m_ready_queue_node> thread_list;
 };
-static SpinLock<u8> g_ready_queues_lock;
-static u32 g_ready_queues_mask;
-static constexpr u32 g_ready_queue_buckets = sizeof(g_ready_queues_mask) * 8;
-READONLY_AFTER_INIT static ThreadReadyQueue* g_ready_queues; // g_ready_queue_buckets entries
+
+static constexpr u32 g_ready_queue_buckets = sizeof(u32) * 8;
+// One set of ready queues per processor. Affinity masks are 32 bits wide,
+// so that's also the maximum number of processors we need to care about.
+static constexpr u32 g_ready_queues_processors = sizeof(u32) * 8;
+
+class ThreadReadyQueues {
+    AK_MAKE_NONCOPYABLE(ThreadReadyQueues);
+    AK_MAKE_NONMOVABLE(ThreadReadyQueues);
+
+public:
+    ThreadReadyQueues() = default;
+
+    u32 thread_count() const { return m_thread_count.load(AK::MemoryOrder::memory_order_relaxed); }
+
+    Thread* pull_next(u32 processor, u32 affinity_mask);
+    void enqueue(Thread&, u32 processor, u32 priority);
+    bool dequeue(Thread&);
+
+private:
+    void remove_locked(Thread&, ThreadReadyQueue&, u32 priority);
+
+    SpinLock<u8> m_lock;
+    u32 m_mask { 0 };
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> m_thread_count { 0 };
+    ThreadReadyQueue m_queues[g_ready_queue_buckets];
+};
+
+READONLY_AFTER_INIT static ThreadReadyQueues* g_ready_queues; // g_ready_queues_processors entries
 
 static inline u32 thread_priority_to_priority_index(u32 thread_priority)
 {
     // Converts the priority in the range of THREAD_PRIORITY_MIN...THREAD_PRIORITY_MAX
-    // to a index into g_ready_queues where 0 is the highest priority bucket
+    // to a index into the ready queues where 0 is the highest priority bucket
     VERIFY(thread_priority >= THREAD_PRIORITY_MIN && thread_priority <= THREAD_PRIORITY_MAX);
     constexpr u32 thread_priority_count = THREAD_PRIORITY_MAX - THREAD_PRIORITY_MIN + 1;
     static_assert(thread_priority_count > 0);
-    auto priority_bucket = ((thread_priority_count - (thread_priority - THREAD_PRIORITY_MIN)) / thread_priority_count) * (g_ready_queue_buckets - 1);
+    // Spread the priorities evenly over the buckets, keeping their order. Multiplying first
+    // matters: dividing first would put everything but THREAD_PRIORITY_MIN into bucket 0.
+    auto priority_bucket = ((THREAD_PRIORITY_MAX - thread_priority) * g_ready_queue_buckets) / thread_priority_count;
     VERIFY(priority_bucket < g_ready_queue_buckets);
     return priority_bucket;
 }
 
-Thread& Scheduler::pull_next_runnable_thread()
+void ThreadReadyQueues::remove_locked(Thread& thread, ThreadReadyQueue& ready_queue, u32 priority)
 {
-    auto affinity_mask = 1u << Processor::current().id();
+    VERIFY(m_lock.is_locked());
+    thread.m_runnable_priority = -1;
+    thread.m_runnable_processor = -1;
+    ready_queue.thread_list.remove(thread);
+    if (ready_queue.thread_list.is_empty())
+        m_mask &= ~(1u << priority);
+    m_thread_count--;
+}
 
-    ScopedSpinLock lock(g_ready_queues_lock);
-    auto priority_mask = g_ready_queues_mask;
+Thread* ThreadReadyQueues::pull_next(u32 processor, u32 affinity_mask)
+{
+    if (thread_count() == 0)
+        return nullptr;
+
+    ScopedSpinLock lock(m_lock);
+    auto priority_mask = m_mask;
     while (priority_mask != 0) {
         auto priority = __builtin_ffsl(priority_mask);
         VERIFY(priority > 0);
-        auto& ready_queue = g_ready_queues[--priority];
+        auto& ready_queue = m_queues[--priority];
         for (auto& thread : ready_queue.thread_list) {
             VERIFY(thread.m_runnable_priority == (int)priority);
+            VERIFY(thread.m_runnable_processor == (int)processor);
             if (thread.is_active())
                 continue;
             if (!(thread.affinity() & affinity_mask))
                 continue;
-            thread.m_runnable_priority = -1;
-            ready_queue.thread_list.remove(thread);
-            if (ready_queue.thread_list.is_empty())
-                g_ready_queues_mask &= ~(1u << priority);
+            remove_locked(thread, ready_queue, priority);
             // Mark it as active because we are using this thread. This is similar
             // to comparing it with Processor::current_thread, but when there are
             // multiple processors there's no easy way to check whether the thread
@@ -123,10 +160,94 @@ Thread& Scheduler::pull_next_runnable_thread()
             // switching to it.
             // FIXME: Figure out a better way maybe?
             thread.set_active(true);
-            return thread;
+            return &thread;
         }
         priority_mask &= ~(1u << priority);
     }
+    return nullptr;
+}
+
+void ThreadReadyQueues::enqueue(Thread& thread, u32 processor, u32 priority)
+{
+    ScopedSpinLock lock(m_lock);
+    VERIFY(thread.m_runnable_priority < 0);
+    VERIFY(thread.m_runnable_processor < 0);
+    thread.m_runnable_priority = (int)priority;
+    thread.m_runnable_processor = (int)processor;
+    VERIFY(!thread.m_ready_queue_node.is_in_list());
+    auto& ready_queue = m_queues[priority];
+    bool was_empty = ready_queue.thread_list.is_empty();
+    ready_queue.thread_list.append(thread);
+    if (was_empty)
+        m_mask |= (1u << priority);
+    m_thread_count++;
+}
+
+bool ThreadReadyQueues::dequeue(Thread& thread)
+{
+    ScopedSpinLock lock(m_lock);
+    auto priority = thread.m_runnable_priority;
+    VERIFY(priority >= 0);
+    VERIFY(m_mask & (1u << priority));
+    remove_locked(thread, m_queues[priority], priority);
+    return true;
+}
+
+static Thread* steal_runnable_thread(u32 processor)
+{
+    // Our own ready queues have nothing we can run, so go and look for work
+    // on the other processors, starting with the one that has the most
+    // threads waiting. We may fail to take anything from a busy peer (e.g.
+    // because of affinity), in which case we move on to the next busiest.
+    auto affinity_mask = 1u << processor;
+    auto processor_count = min(Processor::count(), g_ready_queues_processors);
+    u32 tried_mask = affinity_mask;
+    for (;;) {
+        u32 busiest = 0;
+        u32 busiest_thread_count = 0;
+        for (u32 peer = 0; peer < processor_count; peer++) {
+            if (tried_mask & (1u << peer))
+                continue;
+            auto thread_count = g_ready_queues[peer].thread_count();
+            if (thread_count > busiest_thread_count) {
+                busiest = peer;
+                busiest_thread_count = thread_count;
+            }
+        }
+        if (busiest_thread_count == 0)
+            return nullptr;
+        tried_mask |= 1u << busiest;
+        if (auto* thread = g_ready_queues[busiest].pull_next(busiest, affinity_mask)) {
+            dbgln_if(SCHEDULER_DEBUG, "Scheduler[{}]: Stole {} from processor {}", processor, *thread, busiest);
+            return thread;
+        }
+    }
+}
+
+static u32 ready_queue_processor_for(const Thread& thread)
+{
+    // Keep the thread on the processor it last ran on so that its caches
+    // stay warm, unless its affinity no longer allows that. Idle processors
+    // will steal it from there if that processor stays busy.
+    auto affinity = thread.affinity();
+    auto last_processor = thread.cpu();
+    if (last_processor < g_ready_queues_processors && (affinity & (1u << last_processor)))
+        return last_processor;
+    auto processor_count = min(Processor::count(), g_ready_queues_processors);
+    auto online_mask = processor_count < 32 ? (1u << processor_count) - 1 : 0xffffffff;
+    auto allowed_mask = affinity & online_mask;
+    if (allowed_mask == 0)
+        return last_processor < g_ready_queues_processors ? last_processor : 0;
+    return __builtin_ffsl(allowed_mask) - 1;
+}
+
+Thread& Scheduler::pull_next_runnable_thread()
+{
+    auto processor = Processor::id();
+    if (auto* thread = g_ready_queues[processor].pull_next(processor, 1u << processor))
+        return *thread;
+    if (auto* thread = steal_runnable_thread(processor))
+        return *thread;
     return *Processor::current().idle_thread();
 }
 
@@ -134,9 +255,10 @@ bool Scheduler::dequeue_runnable_thread(Thread& thread, bool check_affinity)
 {
     if (&thread == Processor::current().idle_thread())
         return true;
-    ScopedSpinLock lock(g_ready_queues_lock);
-    auto priority = thread.m_runnable_priority;
-    if (priority < 0) {
+    VERIFY(g_scheduler_lock.own_lock());
+    auto processor = thread.m_runnable_processor;
+    if (processor < 0) {
+        VERIFY(thread.m_runnable_priority < 0);
         VERIFY(!thread.m_ready_queue_node.is_in_list());
         return false;
     }
@@ -144,13 +266,7 @@ bool Scheduler::dequeue_runnable_thread(Thread& thread, bool check_affinity)
     if (check_affinity && !(thread.affinity() & (1 << Processor::current().id())))
         return false;
 
-    VERIFY(g_ready_queues_mask & (1u << priority));
-    auto& ready_queue = g_ready_queues[priority];
-    thread.m_runnable_priority = -1;
-    ready_queue.thread_list.remove(thread);
-    if (ready_queue.thread_list.is_empty())
-        g_ready_queues_mask &= ~(1u << priority);
-    return true;
+    return g_ready_queues[processor].dequeue(thread);
 }
 
 void Scheduler::queue_runnable_thread(Thread& thread)
@@ -158,17 +274,9 @@ void Scheduler::queue_runnable_thread(Thread& thread)
     VERIFY(g_scheduler_lock.own_lock());
     if (&thread == Processor::current().idle_thread())
         return;
-    auto priority = thread_priority_to_priority_index(thread.priority());
-
-    ScopedSpinLock lock(g_ready_queues_lock);
-    VERIFY(thread.m_runnable_priority < 0);
-    thread.m_runnable_priority = (int)priority;
-    VERIFY(!thread.m_ready_queue_node.is_in_list());
-    auto& ready_queue = g_ready_queues[priority];
-    bool was_empty = ready_queue.thread_list.is_empty();
-    ready_queue.thread_list.append(thread);
-    if (was_empty)
-        g_ready_queues_mask |= (1u << priority);
+    auto priority = thread_priority_to_priority_index(thread.effective_priority());
+    auto processor = ready_queue_processor_for(thread);
+    g_ready_queues[processor].enqueue(thread, processor, priority);
 }
 
 UNMAP_AFTER_INIT void Scheduler::start()
@@ -497,7 +605,7 @@ UNMAP_AFTER_INIT void Scheduler::initialize()
 
     RefPtr<Thread> idle_thread;
     g_finalizer_wait_queue = new WaitQueue;
-    g_ready_queues = new ThreadReadyQueue[g_ready_queue_buckets];
+    g_ready_queues = new ThreadReadyQueues[g_ready_queues_processors];
 
     g_finalizer_has_work.store(false, AK::MemoryOrder::memory_order_release);
     s_colonel_process = Process::create_kernel_process(idle_thread, "colonel", idle_loop, nullptr, 1).leak_ref();
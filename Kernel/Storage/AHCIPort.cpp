@@ -36,17 +36,6 @@
 
 namespace Kernel {
 
-NonnullRefPtr<AHCIPort::ScatterList> AHCIPort::ScatterList::create(AsyncBlockDeviceRequest& request, NonnullRefPtrVector<PhysicalPage> allocated_pages, size_t device_block_size)
-{
-    return adopt(*new ScatterList(request, allocated_pages, device_block_size));
-}
-
-AHCIPort::ScatterList::ScatterList(AsyncBlockDeviceRequest& request, NonnullRefPtrVector<PhysicalPage> allocated_pages, size_t device_block_size)
-    : m_vm_object(AnonymousVMObject::create_with_physical_pages(allocated_pages))
-{
-    m_dma_region = MM.allocate_kernel_region_with_vmobject(m_vm_object, page_round_up((request.block_count() * device_block_size)), "AHCI Scattered DMA", Region::Access::Read | Region::Access::Write, Region::Cacheable::Yes);
-}
-
 NonnullRefPtr<AHCIPort> AHCIPort::create(const AHCIPortHandler& handler, volatile AHCI::PortRegisters& registers, u32 port_index)
 {
     return adopt(*new AHCIPort(handler, registers, port_index));
@@ -72,12 +61,7 @@ AHCIPort::AHCIPort(const AHCIPortHandler& handler, volatile AHCI::PortRegisters&
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: Command list page at {}", representative_port_index(), m_command_list_page->paddr());
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: FIS receive page at {}", representative_port_index(), m_command_list_page->paddr());
 
-    for (size_t index = 0; index < 1; index++) {
-        m_dma_buffers.append(MM.allocate_supervisor_physical_page().release_nonnull());
-    }
-    for (size_t index = 0; index < 1; index++) {
-        m_command_table_pages.append(MM.allocate_supervisor_physical_page().release_nonnull());
-    }
+    m_command_table_region = MM.allocate_contiguous_kernel_region(page_round_up(max_command_slots * command_table_size), "AHCI Port Command Tables", Region::Access::Read | Region::Access::Write, PAGE_SIZE, Region::Cacheable::No);
     m_command_list_region = MM.allocate_kernel_region(m_command_list_page->paddr(), PAGE_SIZE, "AHCI Port Command List", Region::Access::Read | Region::Access::Write, Region::Cacheable::No);
     dbgln_if(AHCI_DEBUG, "AHCI Port {}: Command list region at {}", representative_port_index(), m_command_list_region->vaddr());
 
@@ -108,37 +92,32 @@ void AHCIPort::handle_interrupt()
         });
         return;
     }
-    if (m_interrupt_status.is_set(AHCI::PortInterruptFlag::IF) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::TFE) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::HBD) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::HBF)) {
+    if (m_interrupt_status.is_set(AHCI::PortInterruptFlag::IF) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::HBD) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::HBF)) {
         g_io_work->queue([this]() {
             recover_from_fatal_error();
         });
         return;
     }
-    if (m_interrupt_status.is_set(AHCI::PortInterruptFlag::DHR) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::PS)) {
+    if (m_interrupt_status.is_set(AHCI::PortInterruptFlag::TFE)) {
+        // The device reported an error for one command. The port stops processing
+        // commands until we've sorted out which one it was.
+        g_io_work->queue([this]() {
+            recover_from_task_file_error();
+        });
+        return;
+    }
+    if (m_interrupt_status.is_set(AHCI::PortInterruptFlag::DHR) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::PS) || m_interrupt_status.is_set(AHCI::PortInterruptFlag::SDB)) {
         m_wait_for_completion = false;
 
-        // Now schedule reading/writing the buffer as soon as we leave the irq handler.
+        // Now schedule reading/writing the buffers as soon as we leave the irq handler.
         // This is important so that we can safely access the buffers, which could
-        // trigger page faults
-        if (!m_current_request) {
+        // trigger page faults. More commands may finish in the meantime, so the work
+        // item checks the command registers itself to find out which ones are done.
+        if (m_active_slots == 0) {
             dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request handled, probably identify request", representative_port_index());
-        } else {
+        } else if (!m_completion_work_queued.exchange(true)) {
             g_io_work->queue([this]() {
-                dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request handled", representative_port_index());
-                LOCKER(m_lock);
-                VERIFY(m_current_request);
-                VERIFY(m_current_scatter_list);
-                if (m_current_request->request_type() == AsyncBlockDeviceRequest::Read) {
-                    if (!m_current_request->write_to_buffer(m_current_request->buffer(), m_current_scatter_list->dma_region().as_ptr(), m_connected_device->block_size() * m_current_request->block_count())) {
-                        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure, memory fault occurred when reading in data.", representative_port_index());
-                        m_current_scatter_list = nullptr;
-                        complete_current_request(AsyncDeviceRequest::MemoryFault);
-                        return;
-                    }
-                }
-                m_current_scatter_list = nullptr;
-                dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request success", representative_port_index());
-                complete_current_request(AsyncDeviceRequest::Success);
+                finish_completed_commands();
             });
         }
     }
@@ -153,13 +132,196 @@ bool AHCIPort::is_interrupts_enabled() const
 
 void AHCIPort::recover_from_fatal_error()
 {
-    LOCKER(m_lock);
+    Vector<FinishedRequest> failed_requests;
+    {
+        LOCKER(m_lock);
+        {
+            ScopedSpinLock lock(m_hard_lock);
+            dmesgln("{}: AHCI Port {} fatal error, shutting down!", m_parent_handler->hba_controller()->pci_address(), representative_port_index());
+            dmesgln("{}: AHCI Port {} fatal error, SError {}", m_parent_handler->hba_controller()->pci_address(), representative_port_index(), (u32)m_port_registers.serr);
+            stop_command_list_processing();
+            stop_fis_receiving();
+            m_interrupt_enable.clear();
+        }
+        fail_all_requests(failed_requests);
+    }
+    for (auto& failed_request : failed_requests)
+        failed_request.request->complete(failed_request.result);
+}
+
+void AHCIPort::recover_from_task_file_error()
+{
+    Vector<FinishedRequest> finished_requests;
+    {
+        LOCKER(m_lock);
+        u32 outstanding_slots;
+        u32 completed_slots;
+        u8 current_slot;
+        u8 task_file_status;
+        bool command_list_stopped;
+        {
+            ScopedSpinLock lock(m_hard_lock);
+            // Clearing PxCMD.ST clears PxCI and PxSACT, so look at them first.
+            u32 issued_slots = m_port_registers.ci | m_port_registers.sact;
+            current_slot = (m_port_registers.cmd >> 8) & 0x1f;
+            task_file_status = m_port_registers.tfd & 0xff;
+            dmesgln("{}: AHCI Port {} task file error, TFD 0x{:08x}, SError 0x{:08x}", m_parent_handler->hba_controller()->pci_address(), representative_port_index(), (u32)m_port_registers.tfd, (u32)m_port_registers.serr);
+
+            stop_command_list_processing();
+            size_t retry = 0;
+            while ((m_port_registers.cmd & (1 << 15)) && retry < 500) {
+                IO::delay(1000);
+                retry++;
+            }
+            command_list_stopped = !(m_port_registers.cmd & (1 << 15));
+            completed_slots = m_active_slots & ~issued_slots;
+            outstanding_slots = m_active_slots & issued_slots;
+            m_active_slots = 0;
+
+            clear_sata_error_register();
+            m_interrupt_status.clear();
+        }
+
+        // Commands that finished before the error are fine.
+        for (size_t slot_index = 0; slot_index < m_command_slot_count; slot_index++) {
+            if (completed_slots & (1u << slot_index))
+                finish_slot(slot_index, finished_requests);
+        }
+
+        // If the command list engine won't stop, or the device is still busy, restarting the port isn't enough.
+        bool recovered = command_list_stopped && !(task_file_status & (ATA_SR_BSY | ATA_SR_DRQ));
+        Optional<u8> failed_slot;
+        if (recovered) {
+            {
+                ScopedSpinLock lock(m_hard_lock);
+                start_command_list_processing();
+            }
+
+            // Without queuing, the failed command is the one the port was working on. With queuing,
+            // the device has aborted every outstanding command and only tells us which one failed
+            // through the NCQ command error log. Reading that log also takes the device out of its
+            // error state.
+            if (!m_ncq_enabled) {
+                if (outstanding_slots & (1u << current_slot))
+                    failed_slot = current_slot;
+            } else if (outstanding_slots) {
+                recovered = read_ncq_error_log(__builtin_ctz(outstanding_slots), failed_slot);
+            }
+        }
+
+        if (!recovered) {
+            // The device is stuck, only a port reset would get it going again.
+            dmesgln("{}: AHCI Port {} did not recover from task file error, shutting down!", m_parent_handler->hba_controller()->pci_address(), representative_port_index());
+            {
+                ScopedSpinLock lock(m_hard_lock);
+                stop_command_list_processing();
+                stop_fis_receiving();
+                m_interrupt_enable.clear();
+            }
+            for (size_t slot_index = 0; slot_index < m_command_slot_count; slot_index++) {
+                if (!(outstanding_slots & (1u << slot_index)))
+                    continue;
+                for (auto& request : m_command_slots[slot_index].requests)
+                    finished_requests.append({ request, AsyncDeviceRequest::Failure });
+                m_command_slots[slot_index].requests.clear();
+            }
+            fail_all_requests(finished_requests);
+        } else {
+            if (failed_slot.has_value() && !(outstanding_slots & (1u << failed_slot.value())))
+                failed_slot = {};
+            if (!failed_slot.has_value())
+                dmesgln("{}: AHCI Port {} could not determine which command failed", m_parent_handler->hba_controller()->pci_address(), representative_port_index());
+
+            // Fail the command that caused the error, and put everything else back in line.
+            // If we couldn't tell which one it was, fail all of them so that no request can bounce forever.
+            NonnullRefPtrVector<AsyncBlockDeviceRequest> requeued_requests;
+            for (size_t slot_index = 0; slot_index < m_command_slot_count; slot_index++) {
+                if (!(outstanding_slots & (1u << slot_index)))
+                    continue;
+                auto& slot = m_command_slots[slot_index];
+                bool failed = !failed_slot.has_value() || failed_slot.value() == slot_index;
+                for (auto& request : slot.requests) {
+                    if (failed)
+                        finished_requests.append({ request, AsyncDeviceRequest::Failure });
+                    else
+                        requeued_requests.append(request);
+                }
+                slot.requests.clear();
+            }
+            dbgln_if(AHCI_DEBUG, "AHCI Port {}: Task file error in slot {}, requeueing {} requests", representative_port_index(), failed_slot.value_or(0xff), requeued_requests.size());
+            requeued_requests.append(move(m_pending_requests));
+            m_pending_requests = move(requeued_requests);
+            issue_pending_requests(finished_requests);
+        }
+    }
+    for (auto& finished_request : finished_requests)
+        finished_request.request->complete(finished_request.result);
+}
+
+bool AHCIPort::read_ncq_error_log(u8 slot_index, Optional<u8>& failed_tag)
+{
+    VERIFY(m_lock.is_locked());
+    auto& slot = m_command_slots[slot_index];
+    VERIFY(slot.dma_region);
+
+    // READ LOG EXT isn't a queued command, so it has the port to itself here.
+    auto* command_list_entries = (volatile AHCI::CommandHeader*)m_command_list_region->vaddr().as_ptr();
+    command_list_entries[slot_index].ctba = command_table_physical_address(slot_index).get();
+    command_list_entries[slot_index].ctbau = 0;
+    command_list_entries[slot_index].prdbc = 0;
+    command_list_entries[slot_index].prdtl = 1;
+    command_list_entries[slot_index].attributes = (size_t)FIS::DwordCount::RegisterHostToDevice;
+
+    auto& command_table = this->command_table(slot_index);
+    memset(const_cast<u8*>(command_table.command_fis), 0, 64);
+    memset(const_cast<u8*>(command_table.atapi_command), 0, 32);
+    command_table.descriptors[0].base_high = 0;
+    command_table.descriptors[0].base_low = slot.dma_region->physical_page(0)->paddr().get();
+    command_table.descriptors[0].byte_count = 512 - 1;
+
+    auto& fis = *(volatile FIS::HostToDevice::Register*)command_table.command_fis;
+    fis.header.fis_type = (u8)FIS::Type::RegisterHostToDevice;
+    fis.header.port_muliplier = (u8)FIS::HeaderAttributes::C;
+    fis.command = ATA_CMD_READ_LOG_EXT;
+    fis.lba_low[0] = ATA_LOG_NCQ_COMMAND_ERROR;
+    fis.count = 1;
+
+    full_memory_barrier();
+    m_port_registers.ci = 1u << slot_index;
+    full_memory_barrier();
+
+    size_t retry = 0;
+    while ((m_port_registers.ci & (1u << slot_index)) && retry < 1000) {
+        IO::delay(1000);
+        retry++;
+    }
+    if ((m_port_registers.ci & (1u << slot_index)) || (m_port_registers.tfd & ATA_SR_ERR)) {
+        dbgln("AHCI Port {}: Reading the NCQ command error log failed, TFD 0x{:08x}", representative_port_index(), (u32)m_port_registers.tfd);
+        return false;
+    }
+
+    full_memory_barrier();
+    auto* log = slot.dma_region->vaddr().as_ptr();
+    // Bit 7 (NQ) says the error wasn't for a queued command, bits 4:0 hold the tag otherwise.
+    if (!(log[0] & 0x80))
+        failed_tag = log[0] & 0x1f;
+    return true;
+}
+
+void AHCIPort::fail_all_requests(Vector<FinishedRequest>& failed_requests)
+{
+    VERIFY(m_lock.is_locked());
+    for (auto& slot : m_command_slots) {
+        for (auto& request : slot.requests)
+            failed_requests.append({ request, AsyncDeviceRequest::Failure });
+        slot.requests.clear();
+    }
+    for (auto& request : m_pending_requests)
+        failed_requests.append({ request, AsyncDeviceRequest::Failure });
+    m_pending_requests.clear();
+
     ScopedSpinLock lock(m_hard_lock);
-    dmesgln("{}: AHCI Port {} fatal error, shutting down!", m_parent_handler->hba_controller()->pci_address(), representative_port_index());
-    dmesgln("{}: AHCI Port {} fatal error, SError {}", m_parent_handler->hba_controller()->pci_address(), representative_port_index(), (u32)m_port_registers.serr);
-    stop_command_list_processing();
-    stop_fis_receiving();
-    m_interrupt_enable.clear();
+    m_active_slots = 0;
 }
 
 void AHCIPort::eject()
@@ -178,7 +340,7 @@ void AHCIPort::eject()
     auto unused_command_header = try_to_find_unused_command_header();
     VERIFY(unused_command_header.has_value());
     auto* command_list_entries = (volatile AHCI::CommandHeader*)m_command_list_region->vaddr().as_ptr();
-    command_list_entries[unused_command_header.value()].ctba = m_command_table_pages[unused_command_header.value()].paddr().get();
+    command_list_entries[unused_command_header.value()].ctba = command_table_physical_address(unused_command_header.value()).get();
     command_list_entries[unused_command_header.value()].ctbau = 0;
     command_list_entries[unused_command_header.value()].prdbc = 0;
     command_list_entries[unused_command_header.value()].prdtl = 0;
@@ -189,8 +351,7 @@ void AHCIPort::eject()
     // handshake error bit in PxSERR register if CFL is incorrect.
     command_list_entries[unused_command_header.value()].attributes = (size_t)FIS::DwordCount::RegisterHostToDevice | AHCI::CommandHeaderAttributes::P | AHCI::CommandHeaderAttributes::C | AHCI::CommandHeaderAttributes::A;
 
-    auto command_table_region = MM.allocate_kernel_region(m_command_table_pages[unused_command_header.value()].paddr().page_base(), page_round_up(sizeof(AHCI::CommandTable)), "AHCI Command Table", Region::Access::Read | Region::Access::Write, Region::Cacheable::No);
-    auto& command_table = *(volatile AHCI::CommandTable*)command_table_region->vaddr().as_ptr();
+    auto& command_table = this->command_table(unused_command_header.value());
     memset(const_cast<u8*>(command_table.command_fis), 0, 64);
     auto& fis = *(volatile FIS::HostToDevice::Register*)command_table.command_fis;
     fis.header.fis_type = (u8)FIS::Type::RegisterHostToDevice;
@@ -315,6 +476,15 @@ bool AHCIPort::initialize(ScopedSpinLock<SpinLock<u8>>& main_lock)
             m_port_registers.cmd = m_port_registers.cmd | (1 << 24);
         }
 
+        // With native command queuing, we can keep several commands in flight and let the drive complete them in whatever order suits it.
+        m_ncq_enabled = false;
+        m_command_slot_count = 1;
+        if (m_parent_handler->hba_capabilities().native_command_queuing_supported && (identify_block->serial_ata_capabilities & (1 << 8)) && !is_atapi_attached()) {
+            m_ncq_enabled = true;
+            m_command_slot_count = min(min(static_cast<size_t>(identify_block->queue_depth & 0x1f) + 1, static_cast<size_t>(m_parent_handler->hba_capabilities().max_command_list_entries_count)), max_command_slots);
+        }
+        dmesgln("AHCI Port {}: Native command queuing {}, using {} command slot(s)", representative_port_index(), m_ncq_enabled ? "enabled" : "disabled", m_command_slot_count);
+
         dmesgln("AHCI Port {}: Device found, Capacity={}, Bytes per logical sector={}, Bytes per physical sector={}", representative_port_index(), max_addressable_sector * logical_sector_size, logical_sector_size, physical_sector_size);
 
         // FIXME: We don't support ATAPI devices yet, so for now we don't "create" them
@@ -445,65 +615,181 @@ void AHCIPort::set_sleep_state() const
     m_port_registers.cmd = (m_port_registers.cmd & 0x0ffffff) | (0b1000 << 28);
 }
 
-size_t AHCIPort::calculate_descriptors_count(size_t block_count) const
+size_t AHCIPort::max_blocks_per_command() const
 {
     VERIFY(m_connected_device);
-    size_t needed_dma_regions_count = page_round_up((block_count * m_connected_device->block_size())) / PAGE_SIZE;
-    VERIFY(needed_dma_regions_count <= m_dma_buffers.size());
-    return needed_dma_regions_count;
+    return dma_pages_per_command * PAGE_SIZE / m_connected_device->block_size();
 }
 
-Optional<AsyncDeviceRequest::RequestResult> AHCIPort::prepare_and_set_scatter_list(AsyncBlockDeviceRequest& request)
+volatile AHCI::CommandTable& AHCIPort::command_table(u8 slot_index) const
 {
-    VERIFY(m_lock.is_locked());
-    VERIFY(request.block_count() > 0);
+    VERIFY(slot_index < max_command_slots);
+    return *(volatile AHCI::CommandTable*)m_command_table_region->vaddr().offset(slot_index * command_table_size).as_ptr();
+}
 
-    NonnullRefPtrVector<PhysicalPage> allocated_dma_regions;
-    for (size_t index = 0; index < calculate_descriptors_count(request.block_count()); index++) {
-        allocated_dma_regions.append(m_dma_buffers.at(index));
-    }
+PhysicalAddress AHCIPort::command_table_physical_address(u8 slot_index) const
+{
+    VERIFY(slot_index < max_command_slots);
+    return m_command_table_region->physical_page(0)->paddr().offset(slot_index * command_table_size);
+}
 
-    m_current_scatter_list = ScatterList::create(request, allocated_dma_regions, m_connected_device->block_size());
-    if (request.request_type() == AsyncBlockDeviceRequest::Write) {
-        if (!request.read_from_buffer(request.buffer(), m_current_scatter_list->dma_region().as_ptr(), m_connected_device->block_size() * request.block_count())) {
-            return AsyncDeviceRequest::MemoryFault;
-        }
+Optional<u8> AHCIPort::try_to_find_unused_command_slot() const
+{
+    VERIFY(m_lock.is_locked());
+    for (size_t index = 0; index < m_command_slot_count; index++) {
+        if (!(m_active_slots & (1u << index)))
+            return index;
     }
     return {};
 }
 
 void AHCIPort::start_request(AsyncBlockDeviceRequest& request)
 {
-    LOCKER(m_lock);
-    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request start", representative_port_index());
-    VERIFY(!m_current_request);
-    VERIFY(!m_current_scatter_list);
-
-    m_current_request = request;
+    Vector<FinishedRequest> finished_requests;
+    {
+        LOCKER(m_lock);
+        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request start", representative_port_index());
+        m_pending_requests.append(request);
+        issue_pending_requests(finished_requests);
+    }
+    for (auto& finished_request : finished_requests)
+        finished_request.request->complete(finished_request.result);
+}
 
-    auto result = prepare_and_set_scatter_list(request);
-    if (result.has_value()) {
-        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure.", representative_port_index());
-        m_lock.unlock();
-        complete_current_request(result.value());
+void AHCIPort::issue_pending_requests(Vector<FinishedRequest>& finished_requests)
+{
+    VERIFY(m_lock.is_locked());
+    VERIFY(m_connected_device);
+    if (!is_operable()) {
+        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure, port is not operable.", representative_port_index());
+        fail_all_requests(finished_requests);
         return;
     }
 
-    auto success = access_device(request.request_type(), request.block_index(), request.block_count());
-    if (!success) {
-        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure.", representative_port_index());
-        m_lock.unlock();
-        complete_current_request(AsyncDeviceRequest::Failure);
-        return;
+    size_t block_size = m_connected_device->block_size();
+    while (!m_pending_requests.is_empty()) {
+        auto slot_index = try_to_find_unused_command_slot();
+        if (!slot_index.has_value())
+            return;
+        auto& slot = m_command_slots[slot_index.value()];
+        VERIFY(slot.requests.is_empty());
+
+        if (!slot.dma_region) {
+            slot.dma_region = MM.allocate_kernel_region(dma_pages_per_command * PAGE_SIZE, "AHCI Port DMA", Region::Access::Read | Region::Access::Write, AllocationStrategy::AllocateNow);
+            if (!slot.dma_region) {
+                // Wait for a command in flight to hand back its slot, if there is one.
+                if (m_active_slots != 0)
+                    return;
+                for (auto& request : m_pending_requests)
+                    finished_requests.append({ request, AsyncDeviceRequest::Failure });
+                m_pending_requests.clear();
+                return;
+            }
+        }
+
+        slot.block_count = 0;
+        auto add_request_to_slot = [&](size_t pending_index) {
+            auto request = m_pending_requests.take(pending_index);
+            if (request->request_type() == AsyncBlockDeviceRequest::Write) {
+                auto* dma_buffer = slot.dma_region->vaddr().offset(slot.block_count * block_size).as_ptr();
+                if (!request->read_from_buffer(request->buffer(), dma_buffer, request->block_count() * block_size)) {
+                    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure, memory fault occurred when writing out data.", representative_port_index());
+                    finished_requests.append({ move(request), AsyncDeviceRequest::MemoryFault });
+                    return;
+                }
+            }
+            if (slot.requests.is_empty()) {
+                slot.direction = request->request_type();
+                slot.lba = request->block_index();
+            }
+            slot.block_count += request->block_count();
+            slot.requests.append(move(request));
+        };
+
+        auto& first_request = m_pending_requests.first();
+        if (first_request.block_count() == 0 || first_request.block_count() > max_blocks_per_command()) {
+            finished_requests.append({ m_pending_requests.take_first(), AsyncDeviceRequest::Failure });
+            continue;
+        }
+        add_request_to_slot(0);
+        if (slot.requests.is_empty())
+            continue;
+
+        // Pull in queued requests that continue where this command ends on disk,
+        // so they can be transferred together.
+        for (;;) {
+            Optional<size_t> next_index;
+            for (size_t index = 0; index < m_pending_requests.size(); index++) {
+                auto& candidate = m_pending_requests[index];
+                if (candidate.request_type() != slot.direction || candidate.block_index() != slot.lba + slot.block_count)
+                    continue;
+                if (candidate.block_count() == 0 || slot.block_count + candidate.block_count() > max_blocks_per_command())
+                    continue;
+                next_index = index;
+                break;
+            }
+            if (!next_index.has_value())
+                break;
+            add_request_to_slot(next_index.value());
+        }
+
+        if (!access_device(slot_index.value())) {
+            dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure.", representative_port_index());
+            for (auto& request : slot.requests)
+                finished_requests.append({ request, AsyncDeviceRequest::Failure });
+            slot.requests.clear();
+        }
+    }
+}
+
+void AHCIPort::finish_completed_commands()
+{
+    Vector<FinishedRequest> finished_requests;
+    {
+        LOCKER(m_lock);
+        // Any interrupt from here on has to queue another round, as we might miss the commands it reports.
+        m_completion_work_queued = false;
+
+        u32 finished_slots;
+        {
+            ScopedSpinLock lock(m_hard_lock);
+            finished_slots = m_active_slots & ~(m_port_registers.ci | m_port_registers.sact);
+        }
+        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Requests handled, finished slots 0x{:08x}", representative_port_index(), finished_slots);
+
+        for (size_t slot_index = 0; slot_index < m_command_slot_count; slot_index++) {
+            if (!(finished_slots & (1u << slot_index)))
+                continue;
+            finish_slot(slot_index, finished_requests);
+
+            ScopedSpinLock lock(m_hard_lock);
+            m_active_slots &= ~(1u << slot_index);
+        }
+
+        issue_pending_requests(finished_requests);
     }
+    for (auto& finished_request : finished_requests)
+        finished_request.request->complete(finished_request.result);
 }
 
-void AHCIPort::complete_current_request(AsyncDeviceRequest::RequestResult result)
+void AHCIPort::finish_slot(size_t slot_index, Vector<FinishedRequest>& finished_requests)
 {
-    VERIFY(m_current_request);
-    auto current_request = m_current_request;
-    m_current_request.clear();
-    current_request->complete(result);
+    VERIFY(m_lock.is_locked());
+    auto& slot = m_command_slots[slot_index];
+    size_t offset = 0;
+    for (auto& request : slot.requests) {
+        size_t transfer_size = request.block_count() * m_connected_device->block_size();
+        auto result = AsyncDeviceRequest::Success;
+        if (slot.direction == AsyncBlockDeviceRequest::Read) {
+            if (!request.write_to_buffer(request.buffer(), slot.dma_region->vaddr().offset(offset).as_ptr(), transfer_size)) {
+                dbgln_if(AHCI_DEBUG, "AHCI Port {}: Request failure, memory fault occurred when reading in data.", representative_port_index());
+                result = AsyncDeviceRequest::MemoryFault;
+            }
+        }
+        finished_requests.append({ request, result });
+        offset += transfer_size;
+    }
+    slot.requests.clear();
 }
 
 bool AHCIPort::spin_until_ready() const
@@ -522,59 +808,55 @@ bool AHCIPort::spin_until_ready() const
     return true;
 }
 
-bool AHCIPort::access_device(AsyncBlockDeviceRequest::RequestType direction, u64 lba, u8 block_count)
+bool AHCIPort::access_device(u8 slot_index)
 {
     VERIFY(m_connected_device);
     VERIFY(is_operable());
     VERIFY(m_lock.is_locked());
-    VERIFY(m_current_scatter_list);
+    auto& slot = m_command_slots[slot_index];
+    VERIFY(!slot.requests.is_empty());
+    VERIFY(slot.block_count <= max_blocks_per_command());
+    auto direction = slot.direction;
+    auto lba = slot.lba;
+    auto block_count = slot.block_count;
     ScopedSpinLock lock(m_hard_lock);
 
-    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Do a {}, lba {}, block count {}", representative_port_index(), direction == AsyncBlockDeviceRequest::RequestType::Write ? "write" : "read", lba, block_count);
-    if (!spin_until_ready())
+    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Do a {}, lba {}, block count {} in slot {}", representative_port_index(), direction == AsyncBlockDeviceRequest::RequestType::Write ? "write" : "read", lba, block_count, slot_index);
+    // A queued command may be issued while others are still in flight, so there's no point in waiting for the port here.
+    if (!m_ncq_enabled && !spin_until_ready())
         return false;
 
-    auto unused_command_header = try_to_find_unused_command_header();
-    VERIFY(unused_command_header.has_value());
+    size_t data_transfer_count = block_count * m_connected_device->block_size();
+    size_t descriptors_count = page_round_up(data_transfer_count) / PAGE_SIZE;
+
     auto* command_list_entries = (volatile AHCI::CommandHeader*)m_command_list_region->vaddr().as_ptr();
-    command_list_entries[unused_command_header.value()].ctba = m_command_table_pages[unused_command_header.value()].paddr().get();
-    command_list_entries[unused_command_header.value()].ctbau = 0;
-    command_list_entries[unused_command_header.value()].prdbc = 0;
-    command_list_entries[unused_command_header.value()].prdtl = m_current_scatter_list->scatters_count();
+    command_list_entries[slot_index].ctba = command_table_physical_address(slot_index).get();
+    command_list_entries[slot_index].ctbau = 0;
+    command_list_entries[slot_index].prdbc = 0;
+    command_list_entries[slot_index].prdtl = descriptors_count;
 
     // Note: we must set the correct Dword count in this register. Real hardware
     // AHCI controllers do care about this field! QEMU doesn't care if we don't
     // set the correct CFL field in this register, real hardware will set an
     // handshake error bit in PxSERR register if CFL is incorrect.
-    command_list_entries[unused_command_header.value()].attributes = (size_t)FIS::DwordCount::RegisterHostToDevice | AHCI::CommandHeaderAttributes::P | AHCI::CommandHeaderAttributes::C | (is_atapi_attached() ? AHCI::CommandHeaderAttributes::A : 0) | (direction == AsyncBlockDeviceRequest::RequestType::Write ? AHCI::CommandHeaderAttributes::W : 0);
+    // Queued commands must not have the prefetchable or clear busy bits set.
+    u16 attributes = (size_t)FIS::DwordCount::RegisterHostToDevice | (direction == AsyncBlockDeviceRequest::RequestType::Write ? AHCI::CommandHeaderAttributes::W : 0);
+    if (!m_ncq_enabled)
+        attributes |= AHCI::CommandHeaderAttributes::P | AHCI::CommandHeaderAttributes::C;
+    command_list_entries[slot_index].attributes = attributes;
 
-    dbgln_if(AHCI_DEBUG, "AHCI Port {}: CLE: ctba=0x{:08x}, ctbau=0x{:08x}, prdbc=0x{:08x}, prdtl=0x{:04x}, attributes=0x{:04x}", representative_port_index(), (u32)command_list_entries[unused_command_header.value()].ctba, (u32)command_list_entries[unused_command_header.value()].ctbau, (u32)command_list_entries[unused_command_header.value()].prdbc, (u16)command_list_entries[unused_command_header.value()].prdtl, (u16)command_list_entries[unused_command_header.value()].attributes);
-
-    auto command_table_region = MM.allocate_kernel_region(m_command_table_pages[unused_command_header.value()].paddr().page_base(), page_round_up(sizeof(AHCI::CommandTable)), "AHCI Command Table", Region::Access::Read | Region::Access::Write, Region::Cacheable::No);
-    auto& command_table = *(volatile AHCI::CommandTable*)command_table_region->vaddr().as_ptr();
-
-    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Allocated command table at {}", representative_port_index(), command_table_region->vaddr());
+    dbgln_if(AHCI_DEBUG, "AHCI Port {}: CLE: ctba=0x{:08x}, ctbau=0x{:08x}, prdbc=0x{:08x}, prdtl=0x{:04x}, attributes=0x{:04x}", representative_port_index(), (u32)command_list_entries[slot_index].ctba, (u32)command_list_entries[slot_index].ctbau, (u32)command_list_entries[slot_index].prdbc, (u16)command_list_entries[slot_index].prdtl, (u16)command_list_entries[slot_index].attributes);
 
+    auto& command_table = this->command_table(slot_index);
     memset(const_cast<u8*>(command_table.command_fis), 0, 64);
 
-    size_t scatter_entry_index = 0;
-    size_t data_transfer_count = (block_count * m_connected_device->block_size());
-    for (auto scatter_page : m_current_scatter_list->vmobject().physical_pages()) {
-        VERIFY(data_transfer_count != 0);
-        VERIFY(scatter_page);
-        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Add a transfer scatter entry @ {}", representative_port_index(), scatter_page->paddr());
-        command_table.descriptors[scatter_entry_index].base_high = 0;
-        command_table.descriptors[scatter_entry_index].base_low = scatter_page->paddr().get();
-        if (data_transfer_count <= PAGE_SIZE) {
-            command_table.descriptors[scatter_entry_index].byte_count = data_transfer_count - 1;
-            data_transfer_count = 0;
-        } else {
-            command_table.descriptors[scatter_entry_index].byte_count = PAGE_SIZE - 1;
-            data_transfer_count -= PAGE_SIZE;
-        }
-        scatter_entry_index++;
+    for (size_t descriptor_index = 0; descriptor_index < descriptors_count; descriptor_index++) {
+        auto dma_page_address = slot.dma_region->physical_page(descriptor_index)->paddr();
+        dbgln_if(AHCI_DEBUG, "AHCI Port {}: Add a transfer scatter entry @ {}", representative_port_index(), dma_page_address);
+        command_table.descriptors[descriptor_index].base_high = 0;
+        command_table.descriptors[descriptor_index].base_low = dma_page_address.get();
+        command_table.descriptors[descriptor_index].byte_count = min(data_transfer_count - descriptor_index * PAGE_SIZE, static_cast<size_t>(PAGE_SIZE)) - 1;
     }
-    command_table.descriptors[scatter_entry_index].byte_count = (PAGE_SIZE - 1) | (1 << 31);
 
     memset(const_cast<u8*>(command_table.atapi_command), 0, 32);
 
@@ -583,6 +865,11 @@ bool AHCIPort::access_device(AsyncBlockDeviceRequest::RequestType direction, u64
     if (is_atapi_attached()) {
         fis.command = ATA_CMD_PACKET;
         TODO();
+    } else if (m_ncq_enabled) {
+        if (direction == AsyncBlockDeviceRequest::RequestType::Write)
+            fis.command = ATA_CMD_WRITE_FPDMA_QUEUED;
+        else
+            fis.command = ATA_CMD_READ_FPDMA_QUEUED;
     } else {
         if (direction == AsyncBlockDeviceRequest::RequestType::Write)
             fis.command = ATA_CMD_WRITE_DMA_EXT;
@@ -601,17 +888,23 @@ bool AHCIPort::access_device(AsyncBlockDeviceRequest::RequestType direction, u64
     fis.lba_low[0] = lba & 0xff;
     fis.lba_low[1] = (lba >> 8) & 0xff;
     fis.lba_low[2] = (lba >> 16) & 0xff;
-    fis.count = (block_count);
-
-    // The below loop waits until the port is no longer busy before issuing a new command
-    if (!spin_until_ready())
-        return false;
+    if (m_ncq_enabled) {
+        // Queued commands carry the sector count in the features registers, and the tag in the count register.
+        fis.features_low = block_count & 0xff;
+        fis.features_high = (block_count >> 8) & 0xff;
+        fis.count = slot_index << 3;
+    } else {
+        fis.count = block_count;
+    }
 
     full_memory_barrier();
-    mark_command_header_ready_to_process(unused_command_header.value());
+    m_active_slots |= 1u << slot_index;
+    if (m_ncq_enabled)
+        m_port_registers.sact = 1u << slot_index;
+    m_port_registers.ci = 1u << slot_index;
     full_memory_barrier();
 
-    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Do a {}, lba {}, block count {} @ {}, ended", representative_port_index(), direction == AsyncBlockDeviceRequest::RequestType::Write ? "write" : "read", lba, block_count, m_dma_buffers[0].paddr());
+    dbgln_if(AHCI_DEBUG, "AHCI Port {}: Do a {}, lba {}, block count {} in slot {}, ended", representative_port_index(), direction == AsyncBlockDeviceRequest::RequestType::Write ? "write" : "read", lba, block_count, slot_index);
     return true;
 }
 
@@ -625,7 +918,7 @@ bool AHCIPort::identify_device(ScopedSpinLock<SpinLock<u8>>& main_lock)
     auto unused_command_header = try_to_find_unused_command_header();
     VERIFY(unused_command_header.has_value());
     auto* command_list_entries = (volatile AHCI::CommandHeader*)m_command_list_region->vaddr().as_ptr();
-    command_list_entries[unused_command_header.value()].ctba = m_command_table_pages[unused_command_header.value()].paddr().get();
+    command_list_entries[unused_command_header.value()].ctba = command_table_physical_address(unused_command_header.value()).get();
     command_list_entries[unused_command_header.value()].ctbau = 0;
     command_list_entries[unused_command_header.value()].prdbc = 512;
     command_list_entries[unused_command_header.value()].prdtl = 1;
@@ -634,8 +927,7 @@ bool AHCIPort::identify_device(ScopedSpinLock<SpinLock<u8>>& main_lock)
     // QEMU doesn't care if we don't set the correct CFL field in this register, real hardware will set an handshake error bit in PxSERR register.
     command_list_entries[unused_command_header.value()].attributes = (size_t)FIS::DwordCount::RegisterHostToDevice | AHCI::CommandHeaderAttributes::P | AHCI::CommandHeaderAttributes::C;
 
-    auto command_table_region = MM.allocate_kernel_region(m_command_table_pages[unused_command_header.value()].paddr().page_base(), page_round_up(sizeof(AHCI::CommandTable)), "AHCI Command Table", Region::Access::Read | Region::Access::Write);
-    auto& command_table = *(volatile AHCI::CommandTable*)command_table_region->vaddr().as_ptr();
+    auto& command_table = this->command_table(unused_command_header.value());
     memset(const_cast<u8*>(command_table.command_fis), 0, 64);
     command_table.descriptors[0].base_high = 0;
     command_table.descriptors[0].base_low = m_parent_handler->get_identify_metadata_physical_region(m_port_index).get();
@@ -52,20 +52,6 @@ class AHCIPort : public RefCounted<AHCIPort> {
     friend class AHCIPortHandler;
     friend class SATADiskDevice;
 
-private:
-    class ScatterList : public RefCounted<ScatterList> {
-    public:
-        static NonnullRefPtr<ScatterList> create(AsyncBlockDeviceRequest&, NonnullRefPtrVector<PhysicalPage> allocated_pages, size_t device_block_size);
-        const VMObject& vmobject() const { return m_vm_object; }
-        VirtualAddress dma_region() const { return m_dma_region->vaddr(); }
-        size_t scatters_count() const { return m_vm_object->physical_pages().size(); }
-
-    private:
-        ScatterList(AsyncBlockDeviceRequest&, NonnullRefPtrVector<PhysicalPage> allocated_pages, size_t device_block_size);
-        NonnullRefPtr<AnonymousVMObject> m_vm_object;
-        OwnPtr<Region> m_dma_region;
-    };
-
 public:
     UNMAP_AFTER_INIT static NonnullRefPtr<AHCIPort> create(const AHCIPortHandler&, volatile AHCI::PortRegisters&, u32 port_index);
 
@@ -81,6 +67,11 @@ public:
     UNMAP_AFTER_INIT bool initialize_without_reset();
     void handle_interrupt();
 
+    // Each command slot owns a DMA buffer of this size, which is also the largest transfer we issue at once.
+    static constexpr size_t dma_pages_per_command = 16;
+    size_t max_blocks_per_command() const;
+    size_t command_slot_count() const { return m_command_slot_count; }
+
 private:
     bool is_phy_enabled() const { return (m_port_registers.ssts & 0xf) == 3; }
     bool initialize(ScopedSpinLock<SpinLock<u8>>&);
@@ -97,15 +88,26 @@ private:
     bool initiate_sata_reset(ScopedSpinLock<SpinLock<u8>>&);
     void rebase();
     void recover_from_fatal_error();
+    void recover_from_task_file_error();
+    bool read_ncq_error_log(u8 slot_index, Optional<u8>& failed_tag);
     bool shutdown();
     ALWAYS_INLINE void spin_up() const;
     ALWAYS_INLINE void power_on() const;
 
+    struct FinishedRequest {
+        NonnullRefPtr<AsyncBlockDeviceRequest> request;
+        AsyncDeviceRequest::RequestResult result;
+    };
+
     void start_request(AsyncBlockDeviceRequest&);
-    void complete_current_request(AsyncDeviceRequest::RequestResult);
-    bool access_device(AsyncBlockDeviceRequest::RequestType, u64 lba, u8 block_count);
-    size_t calculate_descriptors_count(size_t block_count) const;
-    [[nodiscard]] Optional<AsyncDeviceRequest::RequestResult> prepare_and_set_scatter_list(AsyncBlockDeviceRequest& request);
+    void issue_pending_requests(Vector<FinishedRequest>&);
+    void finish_completed_commands();
+    void finish_slot(size_t slot_index, Vector<FinishedRequest>&);
+    void fail_all_requests(Vector<FinishedRequest>&);
+    bool access_device(u8 slot_index);
+    Optional<u8> try_to_find_unused_command_slot() const;
+    volatile AHCI::CommandTable& command_table(u8 slot_index) const;
+    PhysicalAddress command_table_physical_address(u8 slot_index) const;
 
     ALWAYS_INLINE bool is_interrupts_enabled() const;
 
@@ -131,16 +133,37 @@ private:
 
     // Data members
 
+    static constexpr size_t max_command_slots = 32;
+    // Room for the command FIS, the ATAPI command and one PRD per DMA page, rounded up to the required 128-byte alignment.
+    static constexpr size_t command_table_size = 512;
+    static_assert(sizeof(AHCI::CommandTable) + dma_pages_per_command * sizeof(AHCI::PhysicalRegionDescriptor) <= command_table_size);
+
+    // A command slot carries one or more requests for adjacent blocks, transferred with a single command.
+    struct CommandSlot {
+        OwnPtr<Region> dma_region;
+        NonnullRefPtrVector<AsyncBlockDeviceRequest> requests;
+        AsyncBlockDeviceRequest::RequestType direction { AsyncBlockDeviceRequest::Read };
+        u64 lba { 0 };
+        size_t block_count { 0 };
+    };
+
     EntropySource m_entropy_source;
-    RefPtr<AsyncBlockDeviceRequest> m_current_request;
+    CommandSlot m_command_slots[max_command_slots];
+    size_t m_command_slot_count { 1 };
+    bool m_ncq_enabled { false };
+    NonnullRefPtrVector<AsyncBlockDeviceRequest> m_pending_requests;
+
+    // Protected by m_hard_lock.
+    u32 m_active_slots { 0 };
+    Atomic<bool> m_completion_work_queued { false };
+
     SpinLock<u8> m_hard_lock;
     Lock m_lock { "AHCIPort" };
 
     mutable bool m_wait_for_completion { false };
     bool m_wait_connect_for_completion { false };
 
-    NonnullRefPtrVector<PhysicalPage> m_dma_buffers;
-    NonnullRefPtrVector<PhysicalPage> m_command_table_pages;
+    OwnPtr<Region> m_command_table_region;
     RefPtr<PhysicalPage> m_command_list_page;
     OwnPtr<Region> m_command_list_region;
     RefPtr<PhysicalPage> m_fis_receive_page;
@@ -152,7 +175,6 @@ private:
     AHCI::PortInterruptStatusBitField m_interrupt_status;
     AHCI::PortInterruptEnableBitField m_interrupt_enable;
 
-    RefPtr<AHCIPort::ScatterList> m_current_scatter_list;
     bool m_disabled_by_firmware { false };
 };
 }
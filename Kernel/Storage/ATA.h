@@ -52,12 +52,17 @@
 #define ATA_CMD_WRITE_PIO_EXT 0x34
 #define ATA_CMD_WRITE_DMA 0xCA
 #define ATA_CMD_WRITE_DMA_EXT 0x35
+#define ATA_CMD_READ_FPDMA_QUEUED 0x60
+#define ATA_CMD_WRITE_FPDMA_QUEUED 0x61
+#define ATA_CMD_READ_LOG_EXT 0x2F
 #define ATA_CMD_CACHE_FLUSH 0xE7
 #define ATA_CMD_CACHE_FLUSH_EXT 0xEA
 #define ATA_CMD_PACKET 0xA0
 #define ATA_CMD_IDENTIFY_PACKET 0xA1
 #define ATA_CMD_IDENTIFY 0xEC
 
+#define ATA_LOG_NCQ_COMMAND_ERROR 0x10
+
 #define ATAPI_CMD_READ 0xA8
 #define ATAPI_CMD_EJECT 0x1B
 
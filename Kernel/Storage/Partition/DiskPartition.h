@@ -38,6 +38,7 @@ public:
     virtual ~DiskPartition();
 
     virtual void start_request(AsyncBlockDeviceRequest&) override;
+    virtual size_t max_blocks_per_request() const override { return m_device->max_blocks_per_request(); }
 
     // ^BlockDevice
     virtual KResultOr<size_t> read(FileDescription&, u64, UserOrKernelBuffer&, size_t) override;
@@ -48,6 +49,8 @@ public:
     // ^Device
     virtual mode_t required_mode() const override { return 0600; }
     virtual String device_name() const override;
+    // Requests are queued and scheduled on the disk itself.
+    virtual size_t max_requests_in_flight() const override { return m_device->max_requests_in_flight(); }
 
     const DiskPartitionMetadata& metadata() const;
 
@@ -58,6 +58,17 @@ void SATADiskDevice::start_request(AsyncBlockDeviceRequest& request)
     m_port->start_request(request);
 }
 
+size_t SATADiskDevice::max_blocks_per_request() const
+{
+    return m_port->max_blocks_per_command();
+}
+
+size_t SATADiskDevice::max_requests_in_flight() const
+{
+    // Hand the port more requests than it has command slots, so it can merge adjacent ones while waiting for a free slot.
+    return m_port->command_slot_count() * 2;
+}
+
 String SATADiskDevice::device_name() const
 {
     return String::formatted("hd{:c}", 'a' + minor());
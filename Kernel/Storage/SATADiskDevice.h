@@ -49,9 +49,12 @@ public:
 
     // ^StorageDevice
     virtual Type type() const override { return StorageDevice::Type::SATA; }
+    virtual size_t max_blocks_per_request() const override;
     // ^BlockDevice
     virtual void start_request(AsyncBlockDeviceRequest&) override;
     virtual String device_name() const override;
+    // ^Device
+    virtual size_t max_requests_in_flight() const override;
 
 private:
     SATADiskDevice(const AHCIController&, const AHCIPort&, size_t sector_size, u64 max_addressable_block);
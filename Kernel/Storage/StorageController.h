@@ -49,7 +49,8 @@ public:
         Ramdisk,
         IDE,
         AHCI,
-        NVMe
+        NVMe,
+        VirtIO
     };
 
     virtual ~StorageController() = default;
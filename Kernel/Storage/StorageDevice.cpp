@@ -60,15 +60,11 @@ NonnullRefPtr<StorageController> StorageDevice::controller() const
 KResultOr<size_t> StorageDevice::read(FileDescription&, u64 offset, UserOrKernelBuffer& outbuf, size_t len)
 {
     unsigned index = offset / block_size();
-    u16 whole_blocks = len / block_size();
+    size_t whole_blocks = len / block_size();
     ssize_t remaining = len % block_size();
 
-    unsigned blocks_per_page = PAGE_SIZE / block_size();
-
-    // PATAChannel will chuck a wobbly if we try to read more than PAGE_SIZE
-    // at a time, because it uses a single page for its DMA buffer.
-    if (whole_blocks >= blocks_per_page) {
-        whole_blocks = blocks_per_page;
+    if (whole_blocks >= max_blocks_per_request()) {
+        whole_blocks = max_blocks_per_request();
         remaining = 0;
     }
 
@@ -125,15 +121,11 @@ bool StorageDevice::can_read(const FileDescription&, size_t offset) const
 KResultOr<size_t> StorageDevice::write(FileDescription&, u64 offset, const UserOrKernelBuffer& inbuf, size_t len)
 {
     unsigned index = offset / block_size();
-    u16 whole_blocks = len / block_size();
+    size_t whole_blocks = len / block_size();
     ssize_t remaining = len % block_size();
 
-    unsigned blocks_per_page = PAGE_SIZE / block_size();
-
-    // PATAChannel will chuck a wobbly if we try to write more than PAGE_SIZE
-    // at a time, because it uses a single page for its DMA buffer.
-    if (whole_blocks >= blocks_per_page) {
-        whole_blocks = blocks_per_page;
+    if (whole_blocks >= max_blocks_per_request()) {
+        whole_blocks = max_blocks_per_request();
         remaining = 0;
     }
 
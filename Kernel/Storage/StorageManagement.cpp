@@ -37,6 +37,7 @@
 #include <Kernel/Storage/Partition/MBRPartitionTable.h>
 #include <Kernel/Storage/RamdiskController.h>
 #include <Kernel/Storage/StorageManagement.h>
+#include <Kernel/Storage/VirtIOBlockController.h>
 
 namespace Kernel {
 
@@ -77,6 +78,12 @@ UNMAP_AFTER_INIT NonnullRefPtrVector<StorageController> StorageManagement::enume
             controllers.append(AHCIController::initialize(address));
         }
     });
+    PCI::enumerate([&](const PCI::Address& address, PCI::ID id) {
+        if (VirtIODevice::is_virtio_device(id, VIRTIO_DEVICE_TYPE_BLOCK)) {
+            if (auto controller = VirtIOBlockController::initialize(address))
+                controllers.append(controller.release_nonnull());
+        }
+    });
     controllers.append(RamdiskController::initialize());
     return controllers;
 }
@@ -90,6 +97,9 @@ UNMAP_AFTER_INIT NonnullRefPtrVector<StorageDevice> StorageManagement::enumerate
             auto device = controller.device(device_index);
             if (device.is_null())
                 continue;
+            // Ramdisks don't benefit from fewer, larger transfers.
+            if (device->type() != StorageDevice::Type::Ramdisk)
+                device->io_scheduler().enable_request_merging();
             devices.append(device.release_nonnull());
         }
     }
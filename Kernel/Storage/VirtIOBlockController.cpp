@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Storage/VirtIOBlockController.h>
+
+namespace Kernel {
+
+UNMAP_AFTER_INIT RefPtr<VirtIOBlockController> VirtIOBlockController::initialize(PCI::Address address)
+{
+    auto block = VirtIOBlock::try_create(address);
+    if (!block)
+        return {};
+    return adopt(*new VirtIOBlockController(block.release_nonnull()));
+}
+
+UNMAP_AFTER_INIT VirtIOBlockController::VirtIOBlockController(NonnullOwnPtr<VirtIOBlock> block)
+    : StorageController()
+    , m_block(move(block))
+    , m_device(VirtIOBlockDevice::create(*this, *m_block))
+{
+}
+
+VirtIOBlockController::~VirtIOBlockController()
+{
+}
+
+RefPtr<StorageDevice> VirtIOBlockController::device(u32 index) const
+{
+    if (index != 0)
+        return {};
+    return m_device;
+}
+
+bool VirtIOBlockController::reset()
+{
+    TODO();
+}
+
+bool VirtIOBlockController::shutdown()
+{
+    TODO();
+}
+
+void VirtIOBlockController::start_request(const StorageDevice&, AsyncBlockDeviceRequest& request)
+{
+    m_block->start_request(request);
+}
+
+void VirtIOBlockController::complete_current_request(AsyncDeviceRequest::RequestResult)
+{
+    VERIFY_NOT_REACHED();
+}
+
+}
@@ -24,6 +24,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <AK/ScopeGuard.h>
 #include <Kernel/API/Syscall.h>
 #include <Kernel/Arch/x86/CPU.h>
 #include <Kernel/Panic.h>
@@ -86,8 +87,14 @@ UNMAP_AFTER_INIT void initialize()
 #pragma GCC diagnostic ignored "-Wcast-function-type"
 typedef KResultOr<FlatPtr> (Process::*Handler)(FlatPtr, FlatPtr, FlatPtr);
 typedef KResultOr<FlatPtr> (Process::*HandlerWithRegisterState)(RegisterState&);
-#define __ENUMERATE_SYSCALL(x) reinterpret_cast<Handler>(&Process::sys$##x),
-static Handler s_syscall_table[] = {
+
+struct HandlerMetadata {
+    Handler handler;
+    NeedsBigProcessLock needs_lock;
+};
+
+#define __ENUMERATE_SYSCALL(sys_call, needs_lock) { reinterpret_cast<Handler>(&Process::sys$##sys_call), needs_lock },
+static const HandlerMetadata s_syscall_table[] = {
     ENUMERATE_SYSCALLS(__ENUMERATE_SYSCALL)
 };
 #undef __ENUMERATE_SYSCALL
@@ -99,6 +106,19 @@ KResultOr<FlatPtr> handle(RegisterState& regs, FlatPtr function, FlatPtr arg1, F
     auto& process = current_thread->process();
     current_thread->did_syscall();
 
+    if (function >= Function::__Count) {
+        dbgln("Unknown syscall {} requested ({:08x}, {:08x}, {:08x})", function, arg1, arg2, arg3);
+        return ENOSYS;
+    }
+
+    auto& syscall_metadata = s_syscall_table[function];
+    if (syscall_metadata.needs_lock == NeedsBigProcessLock::Yes)
+        process.big_lock().lock();
+    ScopeGuard unlock_big_lock_guard = [&] {
+        if (syscall_metadata.needs_lock == NeedsBigProcessLock::Yes)
+            process.big_lock().unlock();
+    };
+
     if (function == SC_abort || function == SC_exit || function == SC_exit_thread) {
         // These syscalls need special handling since they never return to the caller.
 
@@ -125,20 +145,15 @@ KResultOr<FlatPtr> handle(RegisterState& regs, FlatPtr function, FlatPtr arg1, F
 
     if (function == SC_fork || function == SC_sigreturn) {
         // These syscalls want the RegisterState& rather than individual parameters.
-        auto handler = (HandlerWithRegisterState)s_syscall_table[function];
+        auto handler = (HandlerWithRegisterState)syscall_metadata.handler;
         return (process.*(handler))(regs);
     }
 
-    if (function >= Function::__Count) {
-        dbgln("Unknown syscall {} requested ({:08x}, {:08x}, {:08x})", function, arg1, arg2, arg3);
-        return ENOSYS;
-    }
-
-    if (s_syscall_table[function] == nullptr) {
+    if (syscall_metadata.handler == nullptr) {
         dbgln("Null syscall {} requested, you probably need to rebuild this program!", function);
         return ENOSYS;
     }
-    return (process.*(s_syscall_table[function]))(arg1, arg2, arg3);
+    return (process.*(syscall_metadata.handler))(arg1, arg2, arg3);
 }
 
 }
@@ -176,29 +191,32 @@ void syscall_handler(TrapFrame* trap)
         PANIC("Syscall from process with IOPL != 0");
     }
 
-    // NOTE: We take the big process lock before inspecting memory regions.
-    process.big_lock().lock();
-
-    if (!MM.validate_user_stack(process, VirtualAddress(regs.userspace_esp))) {
-        dbgln("Invalid stack pointer: {:p}", regs.userspace_esp);
-        handle_crash(regs, "Bad stack on syscall entry", SIGSTKFLT);
-    }
-
-    auto* calling_region = MM.find_region_from_vaddr(process.space(), VirtualAddress(regs.eip));
-    if (!calling_region) {
-        dbgln("Syscall from {:p} which has no associated region", regs.eip);
-        handle_crash(regs, "Syscall from unknown region", SIGSEGV);
-    }
-
-    if (calling_region->is_writable()) {
-        dbgln("Syscall from writable memory at {:p}", regs.eip);
-        handle_crash(regs, "Syscall from writable memory", SIGSEGV);
-    }
-
-    if (process.space().enforces_syscall_regions() && !calling_region->is_syscall_region()) {
-        dbgln("Syscall from non-syscall region");
-        handle_crash(regs, "Syscall from non-syscall region", SIGSEGV);
+    // NOTE: We hold the address space lock while inspecting memory regions, so they can't go away under us.
+    //       We must not crash while holding it, though.
+    const char* crash_description = nullptr;
+    int crash_signal = SIGSEGV;
+    {
+        auto& space = process.space();
+        ScopedSpinLock lock(space.get_lock());
+        auto* stack_region = is_user_address(VirtualAddress(regs.userspace_esp)) ? space.find_region_containing({ VirtualAddress(regs.userspace_esp), 1 }) : nullptr;
+        auto* calling_region = space.find_region_containing({ VirtualAddress(regs.eip), 1 });
+        if (!stack_region || !stack_region->is_user() || !stack_region->is_stack()) {
+            dbgln("Invalid stack pointer: {:p}", regs.userspace_esp);
+            crash_description = "Bad stack on syscall entry";
+            crash_signal = SIGSTKFLT;
+        } else if (!calling_region) {
+            dbgln("Syscall from {:p} which has no associated region", regs.eip);
+            crash_description = "Syscall from unknown region";
+        } else if (calling_region->is_writable()) {
+            dbgln("Syscall from writable memory at {:p}", regs.eip);
+            crash_description = "Syscall from writable memory";
+        } else if (space.enforces_syscall_regions() && !calling_region->is_syscall_region()) {
+            dbgln("Syscall from non-syscall region");
+            crash_description = "Syscall from non-syscall region";
+        }
     }
+    if (crash_description)
+        handle_crash(regs, crash_description, crash_signal);
 
     auto function = regs.eax;
     auto arg1 = regs.edx;
@@ -211,8 +229,6 @@ void syscall_handler(TrapFrame* trap)
     else
         regs.eax = result.value();
 
-    process.big_lock().unlock();
-
     if (auto tracer = process.tracer(); tracer && tracer->is_tracing_syscalls()) {
         tracer->set_trace_syscalls(false);
         process.tracer_trap(*current_thread, regs); // this triggers SIGTRAP and stops the thread!
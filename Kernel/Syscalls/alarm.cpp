@@ -45,9 +45,10 @@ KResultOr<unsigned> Process::sys$alarm(unsigned seconds)
     }
 
     if (seconds > 0) {
-        auto deadline = TimeManagement::the().current_time(CLOCK_REALTIME_COARSE).value();
+        // The alarm is relative, so it shouldn't move when the realtime clock is changed.
+        auto deadline = TimeManagement::the().current_time(CLOCK_MONOTONIC_COARSE).value();
         deadline = deadline + Time::from_seconds(seconds);
-        m_alarm_timer = TimerQueue::the().add_timer_without_id(CLOCK_REALTIME_COARSE, deadline, [this]() {
+        m_alarm_timer = TimerQueue::the().add_timer_without_id(CLOCK_MONOTONIC_COARSE, deadline, [this]() {
             [[maybe_unused]] auto rc = send_signal(SIGALRM, nullptr);
         });
     }
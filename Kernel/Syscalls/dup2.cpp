@@ -39,7 +39,15 @@ KResultOr<int> Process::sys$dup2(int old_fd, int new_fd)
         return 0;
     if (new_fd < 0 || new_fd >= m_max_open_file_descriptors)
         return EINVAL;
-    m_fds[new_fd].set(*description);
+    // Keep the description we replace alive until we've dropped the lock.
+    RefPtr<FileDescription> replaced_description;
+    {
+        ScopedSpinLock lock(m_fds_lock);
+        replaced_description = m_fds[new_fd].description();
+        m_fds[new_fd].set(*description);
+    }
+    if (replaced_description)
+        replaced_description->remove_epoll_interests_for_fd({}, new_fd);
     return new_fd;
 }
 
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/ScopeGuard.h>
+#include <AK/Time.h>
+#include <Kernel/FileSystem/EPoll.h>
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/Process.h>
+
+namespace Kernel {
+
+// Waits return at most this many events at a time, the rest are picked up by the next wait.
+static constexpr int max_epoll_events_per_wait = 256;
+
+KResultOr<int> Process::sys$epoll_create(int flags)
+{
+    REQUIRE_PROMISE(stdio);
+    // Reject flags other than O_CLOEXEC.
+    if ((flags & O_CLOEXEC) != flags)
+        return EINVAL;
+
+    int fd = alloc_fd();
+    if (fd < 0)
+        return fd;
+
+    auto description = FileDescription::create(*EPoll::create());
+    if (description.is_error())
+        return description.error();
+
+    ScopedSpinLock lock(m_fds_lock);
+    m_fds[fd].set(description.release_value(), (flags & O_CLOEXEC) ? FD_CLOEXEC : 0);
+    m_fds[fd].description()->set_readable(true);
+    return fd;
+}
+
+KResultOr<int> Process::sys$epoll_ctl(Userspace<const Syscall::SC_epoll_ctl_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_epoll_ctl_params params;
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+
+    auto epoll_description = file_description(params.epfd);
+    if (!epoll_description)
+        return EBADF;
+    if (!epoll_description->file().is_epoll())
+        return EINVAL;
+    auto& epoll = static_cast<EPoll&>(epoll_description->file());
+
+    auto description = file_description(params.fd);
+    if (!description)
+        return EBADF;
+    if (description == epoll_description)
+        return EINVAL;
+
+    epoll_event event {};
+    if (params.op != EPOLL_CTL_DEL && !copy_from_user(&event, params.event))
+        return EFAULT;
+
+    KResult result = KSuccess;
+    switch (params.op) {
+    case EPOLL_CTL_ADD:
+        result = epoll.add_interest(params.fd, *description, event);
+        break;
+    case EPOLL_CTL_MOD:
+        result = epoll.modify_interest(params.fd, *description, event);
+        break;
+    case EPOLL_CTL_DEL:
+        result = epoll.remove_interest(params.fd, *description);
+        break;
+    default:
+        return EINVAL;
+    }
+    if (result.is_error())
+        return result;
+    return 0;
+}
+
+KResultOr<int> Process::sys$epoll_wait(Userspace<const Syscall::SC_epoll_wait_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_epoll_wait_params params;
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+
+    if (params.maxevents <= 0)
+        return EINVAL;
+
+    auto epoll_description = file_description(params.epfd);
+    if (!epoll_description)
+        return EBADF;
+    if (!epoll_description->file().is_epoll())
+        return EINVAL;
+    auto& epoll = static_cast<EPoll&>(epoll_description->file());
+
+    Thread::BlockTimeout timeout;
+    if (params.timeout) {
+        auto timeout_time = copy_time_from_user(params.timeout);
+        if (!timeout_time.has_value())
+            return EFAULT;
+        timeout = Thread::BlockTimeout(false, &timeout_time.value());
+        timeout.set_slack(TimerQueue::default_slack_for(timeout_time.value()));
+    }
+
+    sigset_t sigmask = {};
+    if (params.sigmask && !copy_from_user(&sigmask, params.sigmask))
+        return EFAULT;
+
+    auto current_thread = Thread::current();
+
+    u32 previous_signal_mask = 0;
+    if (params.sigmask)
+        previous_signal_mask = current_thread->update_signal_mask(sigmask);
+    ScopeGuard rollback_signal_mask([&]() {
+        if (params.sigmask)
+            current_thread->update_signal_mask(previous_signal_mask);
+    });
+
+    Vector<epoll_event> events;
+    events.resize(min(params.maxevents, max_epoll_events_per_wait));
+
+    for (;;) {
+        auto count = epoll.collect_ready_events(events.data(), events.size());
+        if (count > 0) {
+            if (!copy_to_user(params.events, events.data(), count * sizeof(epoll_event)))
+                return EFAULT;
+            return count;
+        }
+
+        // The EPoll becomes readable once any of its interests reports being ready.
+        // Since the timeout is absolute, waiting again after a spurious wakeup doesn't extend it.
+        Thread::SelectBlocker::FDVector fds_info;
+        fds_info.append({ *epoll_description, Thread::FileBlocker::BlockFlags::Read });
+        auto block_result = current_thread->block<Thread::SelectBlocker>(timeout, fds_info);
+        if (block_result.was_interrupted())
+            return EINTR;
+        if (block_result.timed_out())
+            return 0;
+    }
+}
+
+}
@@ -60,7 +60,7 @@ struct LoadResult {
     WeakPtr<Region> stack_region;
 };
 
-static Vector<ELF::AuxiliaryValue> generate_auxiliary_vector(FlatPtr load_base, FlatPtr entry_eip, uid_t uid, uid_t euid, gid_t gid, gid_t egid, String executable_path, int main_program_fd);
+static Vector<ELF::AuxiliaryValue> generate_auxiliary_vector(FlatPtr load_base, FlatPtr entry_eip, uid_t uid, uid_t euid, gid_t gid, gid_t egid, String executable_path, int main_program_fd, FlatPtr time_page_address);
 
 static bool validate_stack_size(const Vector<String>& arguments, const Vector<String>& environment)
 {
@@ -501,6 +501,12 @@ KResult Process::do_exec(NonnullRefPtr<FileDescription> main_program_description
         return ENOMEM;
     }
 
+    auto time_page_range = load_result_or_error.value().space->allocate_range({}, TimeManagement::the().time_page_mapping_size());
+    if (!time_page_range.has_value()) {
+        dbgln("do_exec: Failed to allocate VM for time page");
+        return ENOMEM;
+    }
+
     // We commit to the new executable at this point. There is no turning back!
 
     // Prevent other processes from attaching to us with ptrace while we're doing this.
@@ -541,6 +547,11 @@ KResult Process::do_exec(NonnullRefPtr<FileDescription> main_program_description
 
     signal_trampoline_region.value()->set_syscall_region(true);
 
+    auto time_page_address = TimeManagement::the().map_time_page(*m_space, time_page_range.value());
+    if (time_page_address.is_error()) {
+        VERIFY_NOT_REACHED();
+    }
+
     m_executable = main_program_description->custody();
     m_arguments = arguments;
     m_environment = environment;
@@ -555,11 +566,22 @@ KResult Process::do_exec(NonnullRefPtr<FileDescription> main_program_description
 
     clear_futex_queues_on_exec();
 
-    for (size_t i = 0; i < m_fds.size(); ++i) {
-        auto& description_and_flags = m_fds[i];
-        if (description_and_flags.description() && description_and_flags.flags() & FD_CLOEXEC)
-            description_and_flags = {};
+    // Keep the descriptions we close alive until we've dropped the lock.
+    NonnullRefPtrVector<FileDescription> closed_descriptions;
+    Vector<int> closed_fds;
+    {
+        ScopedSpinLock lock(m_fds_lock);
+        for (size_t i = 0; i < m_fds.size(); ++i) {
+            auto& description_and_flags = m_fds[i];
+            if (description_and_flags.description() && description_and_flags.flags() & FD_CLOEXEC) {
+                closed_descriptions.append(*description_and_flags.description());
+                closed_fds.append(i);
+                description_and_flags = {};
+            }
+        }
     }
+    for (size_t i = 0; i < closed_descriptions.size(); ++i)
+        closed_descriptions[i].remove_epoll_interests_for_fd({}, closed_fds[i]);
 
     int main_program_fd = -1;
     if (interpreter_description) {
@@ -568,6 +590,7 @@ KResult Process::do_exec(NonnullRefPtr<FileDescription> main_program_description
         auto seek_result = main_program_description->seek(0, SEEK_SET);
         VERIFY(!seek_result.is_error());
         main_program_description->set_readable(true);
+        ScopedSpinLock lock(m_fds_lock);
         m_fds[main_program_fd].set(move(main_program_description), FD_CLOEXEC);
     }
 
@@ -582,7 +605,7 @@ KResult Process::do_exec(NonnullRefPtr<FileDescription> main_program_description
     }
     VERIFY(new_main_thread);
 
-    auto auxv = generate_auxiliary_vector(load_result.load_base, load_result.entry_eip, uid(), euid(), gid(), egid(), path, main_program_fd);
+    auto auxv = generate_auxiliary_vector(load_result.load_base, load_result.entry_eip, uid(), euid(), gid(), egid(), path, main_program_fd, time_page_address.value());
 
     // NOTE: We create the new stack before disabling interrupts since it will zero-fault
     //       and we don't want to deal with faults after this point.
@@ -655,7 +678,7 @@ KResult Process::do_exec(NonnullRefPtr<FileDescription> main_program_description
     return KSuccess;
 }
 
-static Vector<ELF::AuxiliaryValue> generate_auxiliary_vector(FlatPtr load_base, FlatPtr entry_eip, uid_t uid, uid_t euid, gid_t gid, gid_t egid, String executable_path, int main_program_fd)
+static Vector<ELF::AuxiliaryValue> generate_auxiliary_vector(FlatPtr load_base, FlatPtr entry_eip, uid_t uid, uid_t euid, gid_t gid, gid_t egid, String executable_path, int main_program_fd, FlatPtr time_page_address)
 {
     Vector<ELF::AuxiliaryValue> auxv;
     // PHDR/EXECFD
@@ -688,6 +711,8 @@ static Vector<ELF::AuxiliaryValue> generate_auxiliary_vector(FlatPtr load_base,
 
     auxv.append({ ELF::AuxiliaryValue::ExecFileDescriptor, main_program_fd });
 
+    auxv.append({ ELF::AuxiliaryValue::TimePage, (void*)time_page_address });
+
     auxv.append({ ELF::AuxiliaryValue::Null, 0L });
     return auxv;
 }
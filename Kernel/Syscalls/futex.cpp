@@ -51,6 +51,8 @@ FutexQueue::FutexQueue(FlatPtr user_address_or_offset, VMObject* vmobject)
 
 FutexQueue::~FutexQueue()
 {
+    if (m_pi_owner)
+        m_pi_owner->set_inherited_priority(*this, 0);
     if (m_is_global) {
         if (auto vmobject = m_vmobject.strong_ref())
             vmobject->unregister_on_deleted_handler(*this);
@@ -115,8 +117,7 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
     switch (cmd) {
     case FUTEX_WAIT:
     case FUTEX_WAIT_BITSET:
-    case FUTEX_REQUEUE:
-    case FUTEX_CMP_REQUEUE: {
+    case FUTEX_LOCK_PI: {
         if (params.timeout) {
             auto timeout_time = copy_time_from_user(params.timeout);
             if (!timeout_time.has_value())
@@ -144,6 +145,8 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
     // acquiring the queue lock
     RefPtr<VMObject> vmobject, vmobject2;
     if (!is_private) {
+        // NOTE: We don't hold the big lock, so keep the regions from going away while we look at them.
+        ScopedSpinLock lock(space().get_lock());
         auto region = space().find_region_containing(Range { VirtualAddress { user_address_or_offset }, sizeof(u32) });
         if (!region)
             return EFAULT;
@@ -158,7 +161,7 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
             if (!region2)
                 return EFAULT;
             vmobject2 = region2->vmobject();
-            user_address_or_offset2 = region->offset_in_vmobject_from_vaddr(VirtualAddress(user_address_or_offset2));
+            user_address_or_offset2 = region2->offset_in_vmobject_from_vaddr(VirtualAddress(user_address_or_offset2));
             break;
         }
         }
@@ -197,10 +200,14 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
         return {};
     };
 
-    auto remove_futex_queue = [&](VMObject* vmobject, FlatPtr user_address_or_offset) {
+    auto remove_futex_queue = [&](VMObject* vmobject, FlatPtr user_address_or_offset, FutexQueue& futex_queue) {
         auto* queues = is_private ? &m_futex_queues : find_global_futex_queues(*vmobject, false);
         if (queues) {
-            queues->remove(user_address_or_offset);
+            // Someone else may have removed this queue already while we were blocked, and set up a new one.
+            auto it = queues->find(user_address_or_offset);
+            if (it == queues->end() || it->value.ptr() != &futex_queue)
+                return;
+            queues->remove(it);
             if (!is_private && queues->is_empty())
                 g_global_futex_queues->remove(vmobject);
         }
@@ -216,7 +223,7 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
         u32 woke_count = futex_queue->wake_n(count, bitmask, is_empty);
         if (is_empty) {
             // If there are no more waiters, we want to get rid of the futex!
-            remove_futex_queue(vmobject, user_address_or_offset);
+            remove_futex_queue(vmobject, user_address_or_offset, *futex_queue);
         }
         return (int)woke_count;
     };
@@ -236,16 +243,26 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
         auto futex_queue = find_futex_queue(vmobject.ptr(), user_address_or_offset, true);
         VERIFY(futex_queue);
 
-        // We need to release the lock before blocking. But we have a reference
-        // to the FutexQueue so that we can keep it alive.
+        // We need to release the lock before blocking, so wakes that happen in between have to
+        // know about us. Only then can we be sure that the value we compare against is still current.
+        futex_queue->queue_imminent_wait();
+        user_value = user_atomic_load_relaxed(params.userspace_address);
+        if (!user_value.has_value() || user_value.value() != params.val) {
+            futex_queue->cancel_imminent_wait();
+            if (futex_queue->is_empty_and_no_imminent_waits())
+                remove_futex_queue(vmobject, user_address_or_offset, *futex_queue);
+            return user_value.has_value() ? EAGAIN : EFAULT;
+        }
+
+        // We have a reference to the FutexQueue so that we can keep it alive.
         lock.unlock();
 
         Thread::BlockResult block_result = futex_queue->wait_on(timeout, bitset);
 
         lock.lock();
-        if (futex_queue->is_empty()) {
+        if (futex_queue->is_empty_and_no_imminent_waits()) {
             // If there are no more waiters, we want to get rid of the futex!
-            remove_futex_queue(vmobject, user_address_or_offset);
+            remove_futex_queue(vmobject, user_address_or_offset, *futex_queue);
         }
         if (block_result == Thread::BlockResult::InterruptedByTimeout) {
             return ETIMEDOUT;
@@ -275,16 +292,149 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
                 },
                 params.val2, is_empty, is_target_empty);
             if (is_empty)
-                remove_futex_queue(vmobject, user_address_or_offset);
+                remove_futex_queue(vmobject, user_address_or_offset, *futex_queue);
             if (is_target_empty && target_futex_queue)
-                remove_futex_queue(vmobject2, user_address_or_offset2);
+                remove_futex_queue(vmobject2, user_address_or_offset2, *target_futex_queue);
         }
         return woken_or_requeued;
     };
 
+    // Priority inheritance futexes hold the thread id of their owner, along with FUTEX_WAITERS
+    // if the owner has to call FUTEX_UNLOCK_PI to hand the futex over to one of the waiters.
+    auto do_lock_pi = [&](bool try_lock) -> int {
+        auto* current_thread = Thread::current();
+        u32 tid = current_thread->tid().value();
+        for (;;) {
+            auto user_value = user_atomic_load_relaxed(params.userspace_address);
+            if (!user_value.has_value())
+                return EFAULT;
+            u32 value = user_value.value();
+            u32 owner_tid = value & FUTEX_TID_MASK;
+            if (owner_tid == tid)
+                return EDEADLK;
+
+            RefPtr<Thread> owner;
+            if (owner_tid != 0) {
+                owner = Thread::from_tid(owner_tid);
+                if (owner && is_private && owner->pid() != pid())
+                    owner = nullptr;
+            }
+
+            if (!owner) {
+                // The futex is unlocked, or its owner went away without unlocking it.
+                auto futex_queue = find_futex_queue(vmobject.ptr(), user_address_or_offset, false);
+                u32 new_value = tid;
+                if (owner_tid != 0)
+                    new_value |= FUTEX_OWNER_DIED;
+                if (futex_queue && !futex_queue->is_empty_and_no_imminent_waits())
+                    new_value |= FUTEX_WAITERS;
+                auto did_exchange = user_atomic_compare_exchange_relaxed(params.userspace_address, value, new_value);
+                if (!did_exchange.has_value())
+                    return EFAULT;
+                if (!did_exchange.value())
+                    continue;
+                atomic_thread_fence(AK::MemoryOrder::memory_order_acquire);
+                if (futex_queue)
+                    futex_queue->set_pi_owner(current_thread);
+                return 0;
+            }
+
+            if (try_lock)
+                return EAGAIN;
+
+            if (!(value & FUTEX_WAITERS)) {
+                auto did_exchange = user_atomic_compare_exchange_relaxed(params.userspace_address, value, value | FUTEX_WAITERS);
+                if (!did_exchange.has_value())
+                    return EFAULT;
+                if (!did_exchange.value())
+                    continue;
+            }
+
+            auto futex_queue = find_futex_queue(vmobject.ptr(), user_address_or_offset, true);
+            VERIFY(futex_queue);
+            futex_queue->set_pi_owner(owner);
+            // We're not on the queue until we block, so account for our own priority here.
+            futex_queue->update_pi_owner_priority(current_thread->effective_priority());
+
+            // Make sure an unlock between dropping the queue lock and blocking finds us, and that
+            // the futex is still held the way we saw it once it can.
+            futex_queue->queue_imminent_wait();
+            user_value = user_atomic_load_relaxed(params.userspace_address);
+            if (!user_value.has_value() || user_value.value() != (value | FUTEX_WAITERS)) {
+                futex_queue->cancel_imminent_wait();
+                if (futex_queue->is_empty_and_no_imminent_waits()) {
+                    futex_queue->set_pi_owner(nullptr);
+                    remove_futex_queue(vmobject, user_address_or_offset, *futex_queue);
+                } else {
+                    futex_queue->update_pi_owner_priority();
+                }
+                if (!user_value.has_value())
+                    return EFAULT;
+                continue;
+            }
+
+            lock.unlock();
+            Thread::BlockResult block_result = futex_queue->wait_on(timeout, FUTEX_BITSET_MATCH_ANY);
+            lock.lock();
+
+            // Whoever unlocked the futex may have handed it over to us.
+            user_value = user_atomic_load_relaxed(params.userspace_address);
+            if (!user_value.has_value())
+                return EFAULT;
+            if ((user_value.value() & FUTEX_TID_MASK) == tid) {
+                atomic_thread_fence(AK::MemoryOrder::memory_order_acquire);
+                return 0;
+            }
+
+            if (futex_queue->is_empty_and_no_imminent_waits()) {
+                futex_queue->set_pi_owner(nullptr);
+                remove_futex_queue(vmobject, user_address_or_offset, *futex_queue);
+            } else {
+                futex_queue->update_pi_owner_priority();
+            }
+            if (block_result == Thread::BlockResult::InterruptedByTimeout)
+                return ETIMEDOUT;
+            if (block_result.was_interrupted())
+                return EINTR;
+        }
+    };
+
+    auto do_unlock_pi = [&]() -> int {
+        u32 tid = Thread::current()->tid().value();
+        auto user_value = user_atomic_load_relaxed(params.userspace_address);
+        if (!user_value.has_value())
+            return EFAULT;
+        if ((user_value.value() & FUTEX_TID_MASK) != tid)
+            return EPERM;
+
+        auto futex_queue = find_futex_queue(vmobject.ptr(), user_address_or_offset, false);
+        RefPtr<Thread> new_owner;
+        bool has_more_waiters = false;
+        if (futex_queue)
+            new_owner = futex_queue->wake_highest_priority_waiter(has_more_waiters);
+
+        // Waiters only change the futex while holding the queue lock, so we can simply
+        // store the new owner. The woken thread will check it once it gets the lock.
+        u32 new_value = 0;
+        if (new_owner)
+            new_value = new_owner->tid().value() | (has_more_waiters ? FUTEX_WAITERS : 0);
+        atomic_thread_fence(AK::MemoryOrder::memory_order_release);
+        if (!user_atomic_store_relaxed(params.userspace_address, new_value))
+            return EFAULT;
+
+        if (futex_queue) {
+            futex_queue->set_pi_owner(new_owner.ptr());
+            if (futex_queue->is_empty_and_no_imminent_waits()) {
+                futex_queue->set_pi_owner(nullptr);
+                remove_futex_queue(vmobject, user_address_or_offset, *futex_queue);
+            }
+        }
+        return 0;
+    };
+
     switch (cmd) {
     case FUTEX_WAIT:
-        return do_wait(0);
+        return do_wait(FUTEX_BITSET_MATCH_ANY);
 
     case FUTEX_WAKE:
         return do_wake(vmobject.ptr(), user_address_or_offset, params.val, {});
@@ -295,7 +445,7 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
         auto op = _FUTEX_OP(params.val3);
         if (op & FUTEX_OP_ARG_SHIFT) {
             op_arg = 1 << op_arg;
-            op &= FUTEX_OP_ARG_SHIFT;
+            op &= ~FUTEX_OP_ARG_SHIFT;
         }
         atomic_thread_fence(AK::MemoryOrder::memory_order_release);
         switch (op) {
@@ -354,6 +504,15 @@ KResultOr<int> Process::sys$futex(Userspace<const Syscall::SC_futex_params*> use
     case FUTEX_REQUEUE:
         return do_requeue({});
 
+    case FUTEX_LOCK_PI:
+        return do_lock_pi(false);
+
+    case FUTEX_TRYLOCK_PI:
+        return do_lock_pi(true);
+
+    case FUTEX_UNLOCK_PI:
+        return do_unlock_pi();
+
     case FUTEX_CMP_REQUEUE:
         return do_requeue(params.val3);
 
@@ -193,6 +193,8 @@ KResultOr<FlatPtr> Process::sys$mmap(Userspace<const Syscall::SC_mmap_params*> u
     bool map_fixed = flags & MAP_FIXED;
     bool map_noreserve = flags & MAP_NORESERVE;
     bool map_randomized = flags & MAP_RANDOMIZED;
+    bool map_huge = flags & MAP_HUGE;
+    bool map_populate = flags & MAP_POPULATE;
 
     if (map_shared && map_private)
         return EINVAL;
@@ -209,6 +211,16 @@ KResultOr<FlatPtr> Process::sys$mmap(Userspace<const Syscall::SC_mmap_params*> u
     if (map_stack && (!map_private || !map_anonymous))
         return EINVAL;
 
+    if (map_huge && (map_stack || map_noreserve))
+        return EINVAL;
+
+    // Large pages can only be used for 2 MiB chunks that are aligned the same way in virtual memory.
+    if (map_huge && !map_fixed && alignment < large_page_size)
+        alignment = large_page_size;
+
+    // NOTE: We don't hold the big lock, so this is what keeps other threads from unmapping our region before we're done with it.
+    LOCKER(space().mapping_lock());
+
     Region* region = nullptr;
     Optional<Range> range;
 
@@ -229,6 +241,8 @@ KResultOr<FlatPtr> Process::sys$mmap(Userspace<const Syscall::SC_mmap_params*> u
 
     if (map_anonymous) {
         auto strategy = map_noreserve ? AllocationStrategy::None : AllocationStrategy::Reserve;
+        if (map_huge)
+            strategy = AllocationStrategy::AllocateLargePages;
         auto region_or_error = space().allocate_region(range.value(), !name.is_null() ? name : "mmap", prot, strategy);
         if (region_or_error.is_error())
             return region_or_error.error().error();
@@ -270,6 +284,12 @@ KResultOr<FlatPtr> Process::sys$mmap(Userspace<const Syscall::SC_mmap_params*> u
         region->set_stack(true);
     if (!name.is_null())
         region->set_name(name);
+    if (map_populate) {
+        // Like on other systems, failing to prefault isn't fatal; the pages will just be faulted in later.
+        auto result = region->populate(0, region->page_count());
+        if (result.is_error())
+            dbgln("sys$mmap: Failed to populate {}: {}", region->vaddr(), result.error());
+    }
     return region->vaddr().get();
 }
 
@@ -293,6 +313,7 @@ static KResultOr<Range> expand_range_to_page_boundaries(FlatPtr address, size_t
 KResultOr<int> Process::sys$mprotect(Userspace<void*> addr, size_t size, int prot)
 {
     REQUIRE_PROMISE(stdio);
+    LOCKER(space().mapping_lock());
 
     if (prot & PROT_EXEC) {
         REQUIRE_PROMISE(prot_exec);
@@ -371,6 +392,7 @@ KResultOr<int> Process::sys$mprotect(Userspace<void*> addr, size_t size, int pro
 KResultOr<int> Process::sys$madvise(Userspace<void*> address, size_t size, int advice)
 {
     REQUIRE_PROMISE(stdio);
+    LOCKER(space().mapping_lock());
 
     auto range_or_error = expand_range_to_page_boundaries(address, size);
     if (range_or_error.is_error())
@@ -384,6 +406,19 @@ KResultOr<int> Process::sys$madvise(Userspace<void*> address, size_t size, int a
     if (!is_user_range(range_to_madvise))
         return EFAULT;
 
+    if (advice & MADV_WILLNEED) {
+        if (advice != MADV_WILLNEED)
+            return EINVAL;
+        auto* region = space().find_region_containing(range_to_madvise);
+        if (!region)
+            return ENOMEM;
+        auto first_page = (range_to_madvise.base().get() - region->vaddr().get()) / PAGE_SIZE;
+        auto result = region->populate(first_page, range_to_madvise.size() / PAGE_SIZE);
+        if (result.is_error())
+            return result;
+        return 0;
+    }
+
     auto* region = space().find_region_from_range(range_to_madvise);
     if (!region)
         return EINVAL;
@@ -420,6 +455,7 @@ KResultOr<int> Process::sys$madvise(Userspace<void*> address, size_t size, int a
 KResultOr<int> Process::sys$set_mmap_name(Userspace<const Syscall::SC_set_mmap_name_params*> user_params)
 {
     REQUIRE_PROMISE(stdio);
+    LOCKER(space().mapping_lock());
 
     Syscall::SC_set_mmap_name_params params;
     if (!copy_from_user(&params, user_params))
@@ -450,6 +486,7 @@ KResultOr<int> Process::sys$set_mmap_name(Userspace<const Syscall::SC_set_mmap_n
 KResultOr<int> Process::sys$munmap(Userspace<void*> addr, size_t size)
 {
     REQUIRE_PROMISE(stdio);
+    LOCKER(space().mapping_lock());
 
     if (!size)
         return EINVAL;
@@ -533,6 +570,7 @@ KResultOr<int> Process::sys$munmap(Userspace<void*> addr, size_t size)
 KResultOr<FlatPtr> Process::sys$mremap(Userspace<const Syscall::SC_mremap_params*> user_params)
 {
     REQUIRE_PROMISE(stdio);
+    LOCKER(space().mapping_lock());
 
     Syscall::SC_mremap_params params {};
     if (!copy_from_user(&params, user_params))
@@ -578,6 +616,7 @@ KResultOr<FlatPtr> Process::sys$mremap(Userspace<const Syscall::SC_mremap_params
 KResultOr<FlatPtr> Process::sys$allocate_tls(size_t size)
 {
     REQUIRE_PROMISE(stdio);
+    LOCKER(space().mapping_lock());
 
     if (!size)
         return EINVAL;
@@ -620,6 +659,7 @@ KResultOr<FlatPtr> Process::sys$allocate_tls(size_t size)
 
 KResultOr<int> Process::sys$msyscall(Userspace<void*> address)
 {
+    LOCKER(space().mapping_lock());
     if (space().enforces_syscall_regions())
         return EPERM;
 
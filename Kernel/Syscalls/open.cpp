@@ -91,6 +91,7 @@ KResultOr<int> Process::sys$open(Userspace<const Syscall::SC_open_params*> user_
         return ENXIO;
 
     u32 fd_flags = (options & O_CLOEXEC) ? FD_CLOEXEC : 0;
+    ScopedSpinLock lock(m_fds_lock);
     m_fds[fd].set(move(description), fd_flags);
     return fd;
 }
@@ -103,7 +104,12 @@ KResultOr<int> Process::sys$close(int fd)
     if (!description)
         return EBADF;
     int rc = description->close();
-    m_fds[fd] = {};
+    {
+        // NOTE: We still hold a reference to the description, so it won't be destroyed while we hold the lock.
+        ScopedSpinLock lock(m_fds_lock);
+        m_fds[fd] = {};
+    }
+    description->remove_epoll_interests_for_fd({}, fd);
     return rc;
 }
 
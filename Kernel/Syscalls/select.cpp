@@ -51,6 +51,7 @@ KResultOr<int> Process::sys$select(Userspace<const Syscall::SC_select_params*> u
         if (!timeout_time.has_value())
             return EFAULT;
         timeout = Thread::BlockTimeout(false, &timeout_time.value());
+        timeout.set_slack(TimerQueue::default_slack_for(timeout_time.value()));
     }
 
     auto current_thread = Thread::current();
@@ -157,6 +158,7 @@ KResultOr<int> Process::sys$poll(Userspace<const Syscall::SC_poll_params*> user_
         if (!timeout_time.has_value())
             return EFAULT;
         timeout = Thread::BlockTimeout(false, &timeout_time.value());
+        timeout.set_slack(TimerQueue::default_slack_for(timeout_time.value()));
     }
 
     sigset_t sigmask = {};
@@ -78,6 +78,7 @@ KResultOr<int> Process::sys$recvfd(int sockfd, int options)
     if (options & O_CLOEXEC)
         fd_flags |= FD_CLOEXEC;
 
+    ScopedSpinLock lock(m_fds_lock);
     m_fds[new_fd].set(*received_descriptor_or_error.value(), fd_flags);
     return new_fd;
 }
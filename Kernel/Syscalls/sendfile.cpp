@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Checked.h>
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/KBuffer.h>
+#include <Kernel/Process.h>
+#include <Kernel/VM/MemoryManager.h>
+
+namespace Kernel {
+
+// Data is moved through a kernel buffer of this size, so this is also the largest chunk handed to the output file at once.
+static constexpr size_t sendfile_chunk_size = 32 * KiB;
+
+KResultOr<ssize_t> Process::sys$sendfile(Userspace<const Syscall::SC_sendfile_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_sendfile_params params;
+    if (!copy_from_user(&params, user_params))
+        return EFAULT;
+
+    auto in_description = file_description(params.in_fd);
+    if (!in_description)
+        return EBADF;
+    if (!in_description->is_readable())
+        return EBADF;
+    auto out_description = file_description(params.out_fd);
+    if (!out_description)
+        return EBADF;
+    if (!out_description->is_writable())
+        return EBADF;
+
+    // We read from the input at an explicit offset, which only makes sense for regular files.
+    if (!in_description->file().is_inode() || in_description->is_directory())
+        return EINVAL;
+    if (out_description->should_append())
+        return EINVAL;
+
+    off_t offset;
+    if (params.offset) {
+        if (!copy_from_user(&offset, params.offset))
+            return EFAULT;
+        if (offset < 0)
+            return EINVAL;
+    } else {
+        offset = in_description->offset();
+    }
+
+    size_t count = min(params.count, static_cast<size_t>(NumericLimits<ssize_t>::max()));
+    if (Checked<off_t>::addition_would_overflow(offset, count))
+        return EOVERFLOW;
+    if (count == 0)
+        return 0;
+
+    auto buffer = KBuffer::try_create_with_size(page_round_up(min(count, sendfile_chunk_size)), Region::Access::Read | Region::Access::Write, "sendfile");
+    if (!buffer)
+        return ENOMEM;
+    auto kernel_buffer = UserOrKernelBuffer::for_kernel_buffer(buffer->data());
+
+    size_t total_nwritten = 0;
+    KResult error = KSuccess;
+    while (total_nwritten < count) {
+        size_t chunk_size = min(count - total_nwritten, buffer->size());
+        auto nread_or_error = in_description->file().read(*in_description, offset + total_nwritten, kernel_buffer, chunk_size);
+        if (nread_or_error.is_error()) {
+            error = nread_or_error.error();
+            break;
+        }
+        size_t nread = nread_or_error.value();
+        if (nread == 0)
+            break;
+
+        auto nwritten_or_error = do_write(*out_description, kernel_buffer, nread);
+        if (nwritten_or_error.is_error()) {
+            error = nwritten_or_error.error();
+            break;
+        }
+        total_nwritten += nwritten_or_error.value();
+
+        // A short write means a non-blocking output is full. Whatever we've read past
+        // that point is simply read again by the next call.
+        if (static_cast<size_t>(nwritten_or_error.value()) < nread)
+            break;
+    }
+
+    off_t new_offset = offset + total_nwritten;
+    if (params.offset) {
+        if (!copy_to_user(params.offset, &new_offset))
+            return EFAULT;
+    } else if (total_nwritten) {
+        auto seek_result = in_description->seek(new_offset, SEEK_SET);
+        if (seek_result.is_error())
+            return seek_result.error();
+    }
+
+    if (total_nwritten == 0 && error.is_error())
+        return error;
+    return total_nwritten;
+}
+
+}
@@ -41,7 +41,7 @@ KResultOr<int> Process::sys$reboot()
     dbgln("acquiring FS locks...");
     FS::lock_all();
     dbgln("syncing mounted filesystems...");
-    FS::sync();
+    (void)FS::sync();
     dbgln("attempting reboot via ACPI");
     if (ACPI::is_enabled())
         ACPI::Parser::the()->try_acpi_reboot();
@@ -61,7 +61,7 @@ KResultOr<int> Process::sys$halt()
     dbgln("acquiring FS locks...");
     FS::lock_all();
     dbgln("syncing mounted filesystems...");
-    FS::sync();
+    (void)FS::sync();
     dbgln("attempting system shutdown...");
     // QEMU Shutdown
     IO::out16(0x604, 0x2000);
@@ -62,6 +62,7 @@ KResultOr<int> Process::sys$socket(int domain, int type, int protocol)
         flags |= FD_CLOEXEC;
     if (type & SOCK_NONBLOCK)
         description_result.value()->set_blocking(false);
+    ScopedSpinLock lock(m_fds_lock);
     m_fds[fd].set(description_result.release_value(), flags);
     return fd;
 }
@@ -143,7 +144,10 @@ KResultOr<int> Process::sys$accept(int accepting_socket_fd, Userspace<sockaddr*>
     // NOTE: The accepted socket inherits fd flags from the accepting socket.
     //       I'm not sure if this matches other systems but it makes sense to me.
     accepted_socket_description_result.value()->set_blocking(accepting_socket_description->is_blocking());
-    m_fds[accepted_socket_fd].set(accepted_socket_description_result.release_value(), m_fds[accepting_socket_fd].flags());
+    {
+        ScopedSpinLock lock(m_fds_lock);
+        m_fds[accepted_socket_fd].set(accepted_socket_description_result.release_value(), m_fds[accepting_socket_fd].flags());
+    }
 
     // NOTE: Moving this state to Completed is what causes connect() to unblock on the client side.
     accepted_socket->set_setup_state(Socket::SetupState::Completed);
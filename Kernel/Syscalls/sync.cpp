@@ -32,7 +32,9 @@ namespace Kernel {
 KResultOr<int> Process::sys$sync()
 {
     REQUIRE_PROMISE(stdio);
-    VFS::the().sync();
+    auto result = VFS::the().sync();
+    if (result.is_error())
+        return result;
     return 0;
 }
 
@@ -56,6 +56,7 @@ KResultOr<int> Process::sys$watch_file(Userspace<const char*> user_path, size_t
     if (description.is_error())
         return description.error();
 
+    ScopedSpinLock lock(m_fds_lock);
     m_fds[fd].set(description.release_value());
     m_fds[fd].description()->set_readable(true);
     return fd;
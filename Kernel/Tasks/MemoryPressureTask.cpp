@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Debug.h>
+#include <Kernel/FileSystem/FileSystem.h>
+#include <Kernel/Process.h>
+#include <Kernel/Tasks/MemoryPressureTask.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/SharedInodeVMObject.h>
+
+namespace Kernel {
+
+void MemoryPressureTask::spawn()
+{
+    RefPtr<Thread> thread;
+    Process::create_kernel_process(thread, "MemoryPressureTask", [] {
+        for (;;) {
+            MM.wait_for_memory_pressure();
+            dbgln_if(MEMORY_PRESSURE_DEBUG, "MemoryPressureTask: {} of {} user physical pages uncommitted, releasing caches", MM.user_physical_pages_uncommitted(), MM.user_physical_pages());
+            FS::release_all_cached_memory();
+            auto released_page_count = SharedInodeVMObject::release_all_clean_page_cache_pages();
+            dbgln_if(MEMORY_PRESSURE_DEBUG, "MemoryPressureTask: Released {} clean page cache pages", released_page_count);
+        }
+    });
+}
+
+}
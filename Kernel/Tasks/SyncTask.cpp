@@ -37,7 +37,8 @@ void SyncTask::spawn()
     Process::create_kernel_process(syncd_thread, "SyncTask", [] {
         dbgln("SyncTask is running");
         for (;;) {
-            VFS::the().sync();
+            // Whatever fails to be written back stays dirty and is retried next time around.
+            (void)VFS::the().sync();
             (void)Thread::current()->sleep(Time::from_seconds(1));
         }
     });
@@ -1049,6 +1049,37 @@ RefPtr<Thread> Thread::from_tid(ThreadID tid)
     return found_thread;
 }
 
+void Thread::set_inherited_priority(const FutexQueue& futex_queue, u32 priority)
+{
+    u32 inherited_priority = 0;
+    {
+        ScopedSpinLock lock(m_inherited_priorities_lock);
+        bool found = false;
+        for (size_t i = 0; i < m_inherited_priorities.size(); i++) {
+            if (m_inherited_priorities[i].futex_queue != &futex_queue)
+                continue;
+            if (priority != 0)
+                m_inherited_priorities[i].priority = priority;
+            else
+                m_inherited_priorities.remove(i);
+            found = true;
+            break;
+        }
+        if (!found && priority != 0)
+            m_inherited_priorities.append({ &futex_queue, priority });
+        for (auto& inherited : m_inherited_priorities)
+            inherited_priority = max(inherited_priority, inherited.priority);
+    }
+
+    if (m_inherited_priority.exchange(inherited_priority) == inherited_priority)
+        return;
+
+    // If we're sitting in a ready queue, move over to the one matching our new priority
+    ScopedSpinLock lock(g_scheduler_lock);
+    if (Scheduler::dequeue_runnable_thread(*this))
+        Scheduler::queue_runnable_thread(*this);
+}
+
 void Thread::reset_fpu_state()
 {
     memcpy(m_fpu_state, &Processor::current().clean_fpu_state(), sizeof(FPUState));
@@ -89,6 +89,7 @@ class Thread
     friend class ProtectedProcessBase;
     friend class Scheduler;
     friend class ThreadReadyQueue;
+    friend class ThreadReadyQueues;
 
     static SpinLock<u8> g_tid_map_lock;
     static HashMap<ThreadID, Thread*>* g_tid_map;
@@ -113,6 +114,11 @@ public:
     void set_priority(u32 p) { m_priority = p; }
     u32 priority() const { return m_priority; }
 
+    // The priority the scheduler uses, which includes the priority inherited
+    // from threads waiting on a priority inheritance futex owned by us.
+    u32 effective_priority() const { return max(m_priority, m_inherited_priority.load(AK::MemoryOrder::memory_order_relaxed)); }
+    void set_inherited_priority(const FutexQueue&, u32 priority);
+
     void detach()
     {
         ScopedSpinLock lock(m_lock);
@@ -218,9 +224,15 @@ public:
         bool is_infinite() const { return m_infinite; }
         bool should_block() const { return m_infinite || m_should_block; };
 
+        // Allow the wakeup to be delayed by up to this much, so that it can
+        // be batched together with other timers.
+        const Time& slack() const { return m_slack; }
+        void set_slack(const Time& slack) { m_slack = slack; }
+
     private:
         Time m_time {};
         Time m_start_time {};
+        Time m_slack {};
         clockid_t m_clock_id { CLOCK_MONOTONIC_COARSE };
         bool m_infinite { false };
         bool m_should_block { false };
@@ -412,6 +424,14 @@ public:
             return m_blockers.is_empty();
         }
 
+        template<typename Callback>
+        void do_for_each_blocker(Callback callback) const
+        {
+            VERIFY(m_lock.is_locked());
+            for (auto& info : m_blockers)
+                callback(*info.blocker, info.data);
+        }
+
         virtual bool should_add_blocker(Blocker&, void*) { return true; }
 
         struct BlockerInfo {
@@ -430,7 +450,7 @@ public:
             Vector<BlockerInfo, 4> taken_blockers;
             taken_blockers.ensure_capacity(move_count);
             for (size_t i = 0; i < move_count; i++)
-                taken_blockers.append(m_blockers.take(i));
+                taken_blockers.append(m_blockers[i]);
             m_blockers.remove(0, move_count);
             return taken_blockers;
         }
@@ -444,8 +464,8 @@ public:
                 return;
             }
             m_blockers.ensure_capacity(m_blockers.size() + blockers_to_append.size());
-            for (size_t i = 0; i < blockers_to_append.size(); i++)
-                m_blockers.append(blockers_to_append.take(i));
+            for (auto& info : blockers_to_append)
+                m_blockers.append(info);
             blockers_to_append.clear();
         }
 
@@ -833,16 +853,18 @@ public:
             if (!block_timeout.is_infinite()) {
                 // Process::kill_all_threads may be called at any time, which will mark all
                 // threads to die. In that case
-                timer = TimerQueue::the().add_timer_without_id(block_timeout.clock_id(), block_timeout.absolute_time(), [&]() {
-                    VERIFY(!Processor::current().in_irq());
-                    VERIFY(!g_scheduler_lock.own_lock());
-                    VERIFY(!m_block_lock.own_lock());
-                    // NOTE: this may execute on the same or any other processor!
-                    ScopedSpinLock scheduler_lock(g_scheduler_lock);
-                    ScopedSpinLock block_lock(m_block_lock);
-                    if (m_blocker && timeout_unblocked.exchange(true) == false)
-                        unblock();
-                });
+                timer = TimerQueue::the().add_timer_without_id(
+                    block_timeout.clock_id(), block_timeout.absolute_time(), [&]() {
+                        VERIFY(!Processor::current().in_irq());
+                        VERIFY(!g_scheduler_lock.own_lock());
+                        VERIFY(!m_block_lock.own_lock());
+                        // NOTE: this may execute on the same or any other processor!
+                        ScopedSpinLock scheduler_lock(g_scheduler_lock);
+                        ScopedSpinLock block_lock(m_block_lock);
+                        if (m_blocker && timeout_unblocked.exchange(true) == false)
+                            unblock();
+                    },
+                    block_timeout.slack());
                 if (!timer) {
                     // Timeout is already in the past
                     blocker.not_blocking(true);
@@ -1131,6 +1153,7 @@ private:
 
     IntrusiveListNode m_process_thread_list_node;
     int m_runnable_priority { -1 };
+    int m_runnable_processor { -1 };
 
     friend class WaitQueue;
 
@@ -1254,6 +1277,13 @@ private:
     State m_state { Invalid };
     String m_name;
     u32 m_priority { THREAD_PRIORITY_NORMAL };
+    Atomic<u32> m_inherited_priority { 0 };
+    struct InheritedPriority {
+        const FutexQueue* futex_queue;
+        u32 priority;
+    };
+    SpinLock<u8> m_inherited_priorities_lock;
+    Vector<InheritedPriority, 2> m_inherited_priorities;
 
     State m_stop_state { Invalid };
 
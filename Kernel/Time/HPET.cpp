@@ -286,6 +286,16 @@ u64 HPET::read_main_counter() const
     return read_register_safe64(registers().main_counter_value);
 }
 
+bool HPET::is_main_counter_64_bit() const
+{
+    return registers().capabilities.attributes & (u32)HPETFlags::Attributes::Counter64BitCapable;
+}
+
+PhysicalAddress HPET::main_counter_physical_address() const
+{
+    return m_physical_acpi_hpet_registers.offset(__builtin_offsetof(HPETRegistersBlock, main_counter_value));
+}
+
 void HPET::enable_periodic_interrupt(const HPETComparator& comparator)
 {
     dbgln_if(HPET_DEBUG, "HPET: Set comparator {} to be periodic.", comparator.comparator_number());
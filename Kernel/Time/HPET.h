@@ -64,6 +64,9 @@ public:
     u64 update_time(u64& seconds_since_boot, u32& ticks_this_second, bool query_only);
     u64 read_main_counter_unsafe() const;
     u64 read_main_counter() const;
+    u64 main_counter_last_read() const { return m_main_counter_last_read; }
+    bool is_main_counter_64_bit() const;
+    PhysicalAddress main_counter_physical_address() const;
 
     Vector<unsigned> capable_interrupt_numbers(u8 comparator_number);
     Vector<unsigned> capable_interrupt_numbers(const HPETComparator&);
@@ -28,6 +28,7 @@
 #include <AK/StdLibExtras.h>
 #include <AK/Time.h>
 #include <Kernel/ACPI/Parser.h>
+#include <Kernel/API/TimePage.h>
 #include <Kernel/CommandLine.h>
 #include <Kernel/Interrupts/APIC.h>
 #include <Kernel/Scheduler.h>
@@ -39,7 +40,9 @@
 #include <Kernel/Time/RTC.h>
 #include <Kernel/Time/TimeManagement.h>
 #include <Kernel/TimerQueue.h>
+#include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/Space.h>
 
 namespace Kernel {
 
@@ -93,6 +96,7 @@ void TimeManagement::set_epoch_time(Time ts)
     // FIXME: Should use AK::Time internally
     m_epoch_time = ts.to_timespec();
     m_remaining_epoch_time_adjustment = { 0, 0 };
+    update_time_page();
 }
 
 Time TimeManagement::monotonic_time(TimePrecision precision) const
@@ -166,6 +170,8 @@ UNMAP_AFTER_INIT void TimeManagement::initialize(u32 cpu)
         VERIFY(s_the.is_initialized());
         if (auto* apic_timer = APIC::the().get_timer()) {
             dmesgln("Time: Enable APIC timer on CPU #{}", cpu);
+            // This processor gets its own timer ticks, so let it expire its own timers
+            TimerQueue::the().initialize_processor_wheel();
             apic_timer->enable_local_timer();
         }
     }
@@ -212,6 +218,65 @@ UNMAP_AFTER_INIT TimeManagement::TimeManagement()
     } else if (!probe_and_set_legacy_hardware_timers()) {
         VERIFY_NOT_REACHED();
     }
+    initialize_time_page();
+}
+
+UNMAP_AFTER_INIT void TimeManagement::initialize_time_page()
+{
+    m_time_page_region = MM.allocate_kernel_region(PAGE_SIZE, "Time page", Region::Access::Read | Region::Access::Write, AllocationStrategy::AllocateNow);
+    VERIFY(m_time_page_region);
+    auto& page = *reinterpret_cast<TimePage*>(m_time_page_region->vaddr().as_ptr());
+    __builtin_memset(&page, 0, sizeof(page));
+
+    // Userspace can only interpolate between updates if it can read the counter we keep time with.
+    // The HPET's registers are read-only for userspace, and reading them reveals nothing that
+    // clock_gettime(CLOCK_MONOTONIC) doesn't already tell it.
+    if (m_can_query_precise_time) {
+        auto& hpet = HPET::the();
+        auto counter_address = hpet.main_counter_physical_address();
+        m_time_counter_vmobject = AnonymousVMObject::create_for_physical_range(counter_address.page_base(), PAGE_SIZE);
+        if (m_time_counter_vmobject) {
+            page.counter_frequency = hpet.frequency();
+            page.counter_mask = hpet.is_main_counter_64_bit() ? NumericLimits<u64>::max() : NumericLimits<u32>::max();
+            page.counter_offset = PAGE_SIZE + counter_address.offset_in_page();
+        }
+    }
+    update_time_page();
+}
+
+void TimeManagement::update_time_page()
+{
+    if (!m_time_page_region)
+        return;
+
+    // The timer interrupt handler isn't the only writer (see set_epoch_time()), so unlike readers,
+    // writers have to exclude each other.
+    ScopedSpinLock lock(m_time_page_lock);
+    auto& page = *reinterpret_cast<TimePage*>(m_time_page_region->vaddr().as_ptr());
+    u32 update_iteration = AK::atomic_fetch_add(&page.update1, 1u, AK::MemoryOrder::memory_order_relaxed);
+    // Readers must not see any of the new values before the bumped update1.
+    AK::atomic_thread_fence(AK::MemoryOrder::memory_order_release);
+    page.monotonic_seconds = m_seconds_since_boot;
+    page.monotonic_nanoseconds = ((u64)m_ticks_this_second * 1000000000ull) / m_time_ticks_per_second;
+    page.epoch_seconds = m_epoch_time.tv_sec;
+    page.epoch_nanoseconds = m_epoch_time.tv_nsec;
+    if (page.counter_frequency)
+        page.counter_at_update = HPET::the().main_counter_last_read();
+    AK::atomic_store(&page.update2, update_iteration + 1, AK::MemoryOrder::memory_order_release);
+}
+
+KResultOr<FlatPtr> TimeManagement::map_time_page(Space& space, const Range& range)
+{
+    VERIFY(range.size() == time_page_mapping_size());
+    auto page_region = space.allocate_region_with_vmobject({ range.base(), PAGE_SIZE }, m_time_page_region->vmobject(), 0, "Time page", PROT_READ, true);
+    if (page_region.is_error())
+        return page_region.error();
+    if (m_time_counter_vmobject) {
+        auto counter_region = space.allocate_region_with_vmobject({ range.base().offset(PAGE_SIZE), PAGE_SIZE }, *m_time_counter_vmobject, 0, "Time counter", PROT_READ, true, Region::Cacheable::No);
+        if (counter_region.is_error())
+            return counter_region.error();
+    }
+    return range.base().get();
 }
 
 Time TimeManagement::now()
@@ -357,6 +422,8 @@ void TimeManagement::increment_time_since_boot_hpet()
     // TODO: Apply m_remaining_epoch_time_adjustment
     timespec_add(m_epoch_time, { (time_t)(delta_ns / 1000000000), (long)(delta_ns % 1000000000) }, m_epoch_time);
     m_update2.store(update_iteration + 1, AK::MemoryOrder::memory_order_release);
+
+    update_time_page();
 }
 
 void TimeManagement::increment_time_since_boot()
@@ -387,6 +454,8 @@ void TimeManagement::increment_time_since_boot()
         m_ticks_this_second = 0;
     }
     m_update2.store(update_iteration + 1, AK::MemoryOrder::memory_order_release);
+
+    update_time_page();
 }
 
 void TimeManagement::system_timer_tick(const RegisterState& regs)
@@ -27,10 +27,13 @@
 #pragma once
 
 #include <AK/NonnullRefPtrVector.h>
+#include <AK/OwnPtr.h>
 #include <AK/RefPtr.h>
 #include <AK/Time.h>
 #include <AK/Types.h>
+#include <Kernel/Forward.h>
 #include <Kernel/KResult.h>
+#include <Kernel/SpinLock.h>
 #include <Kernel/UnixTypes.h>
 
 namespace Kernel {
@@ -87,6 +90,10 @@ public:
 
     bool can_query_precise_time() const { return m_can_query_precise_time; }
 
+    // Maps the time page (see Kernel/API/TimePage.h) and the counter that goes with it, if any, into a process.
+    size_t time_page_mapping_size() const { return m_time_counter_vmobject ? 2 * PAGE_SIZE : PAGE_SIZE; }
+    KResultOr<FlatPtr> map_time_page(Space&, const Range&);
+
 private:
     bool probe_and_set_legacy_hardware_timers();
     bool probe_and_set_non_legacy_hardware_timers();
@@ -95,6 +102,8 @@ private:
     NonnullRefPtrVector<HardwareTimerBase> m_hardware_timers;
     void set_system_timer(HardwareTimerBase&);
     static void system_timer_tick(const RegisterState&);
+    void initialize_time_page();
+    void update_time_page();
 
     // Variables between m_update1 and m_update2 are synchronized
     Atomic<u32> m_update1 { 0 };
@@ -110,6 +119,10 @@ private:
 
     RefPtr<HardwareTimerBase> m_system_timer;
     RefPtr<HardwareTimerBase> m_time_keeper_timer;
+
+    OwnPtr<Region> m_time_page_region;
+    RefPtr<VMObject> m_time_counter_vmobject;
+    SpinLock<u8> m_time_page_lock;
 };
 
 }
@@ -67,6 +67,58 @@ Time Timer::now(bool is_firing) const
     return TimeManagement::the().current_time(clock_id).value();
 }
 
+void TimerWheel::insert(Timer& timer)
+{
+    VERIFY(m_lock.is_locked());
+
+    // Timers that are already due go into the next slot to be expired.
+    u64 tick = max(timer.m_wheel_tick, m_next_tick);
+    u64 delta = tick - m_next_tick;
+
+    size_t level = 0;
+    while (level < levels - 1 && delta >= (1ull << ((level + 1) * slot_bits)))
+        level++;
+
+    // Timers beyond the range of the top level are parked in its furthest
+    // slot. They are put in their real place once that slot is cascaded.
+    constexpr u64 max_delta = (1ull << (levels * slot_bits)) - 1;
+    if (delta > max_delta)
+        tick = m_next_tick + max_delta;
+
+    auto& list = m_slots[level][(tick >> (level * slot_bits)) & (slots - 1)];
+    list.append(&timer);
+    timer.m_list = &list;
+}
+
+void TimerWheel::cascade(size_t level)
+{
+    auto& list = m_slots[level][(m_next_tick >> (level * slot_bits)) & (slots - 1)];
+    while (auto* timer = list.remove_head())
+        insert(*timer);
+}
+
+void TimerWheel::expire_next_tick()
+{
+    VERIFY(m_lock.is_locked());
+
+    if ((m_next_tick & (slots - 1)) == 0) {
+        // Level 0 wrapped around, pull the timers of the next slot of each
+        // level down. A level only wraps if the one below it did as well.
+        for (size_t level = 1; level < levels; level++) {
+            cascade(level);
+            if (((m_next_tick >> (level * slot_bits)) & (slots - 1)) != 0)
+                break;
+        }
+    }
+
+    auto& list = m_slots[0][m_next_tick & (slots - 1)];
+    while (auto* timer = list.remove_head()) {
+        m_expired.append(timer);
+        timer->m_list = &m_expired;
+    }
+    m_next_tick++;
+}
+
 TimerQueue& TimerQueue::the()
 {
     return *s_the;
@@ -75,9 +127,37 @@ TimerQueue& TimerQueue::the()
 UNMAP_AFTER_INIT TimerQueue::TimerQueue()
 {
     m_ticks_per_second = TimeManagement::the().ticks_per_second();
+    // The boot processor always receives timer ticks, so everything that
+    // doesn't have a wheel of its own falls back to this one.
+    m_wheels[0] = make<TimerWheel>(TimerWheel::tick_for(TimeManagement::the().monotonic_time(TimePrecision::Coarse)));
+}
+
+UNMAP_AFTER_INIT void TimerQueue::initialize_processor_wheel()
+{
+    auto cpu = Processor::id();
+    VERIFY(cpu < max_wheels);
+    if (!m_wheels[cpu])
+        m_wheels[cpu] = make<TimerWheel>(TimerWheel::tick_for(TimeManagement::the().monotonic_time(TimePrecision::Coarse)));
+}
+
+TimerWheel& TimerQueue::wheel_for_current_processor()
+{
+    auto cpu = Processor::id();
+    if (cpu < max_wheels && m_wheels[cpu])
+        return *m_wheels[cpu];
+    return *m_wheels[0];
 }
 
-RefPtr<Timer> TimerQueue::add_timer_without_id(clockid_t clock_id, const Time& deadline, Function<void()>&& callback)
+Time TimerQueue::default_slack_for(const Time& timeout)
+{
+    constexpr i64 max_slack_ns = 100'000'000;
+    auto slack_ns = timeout.to_nanoseconds() / 1000;
+    if (slack_ns <= 0)
+        return {};
+    return Time::from_nanoseconds(min(slack_ns, max_slack_ns));
+}
+
+RefPtr<Timer> TimerQueue::add_timer_without_id(clockid_t clock_id, const Time& deadline, Function<void()>&& callback, Time slack)
 {
     if (deadline <= TimeManagement::the().current_time(clock_id).value())
         return {};
@@ -87,9 +167,7 @@ RefPtr<Timer> TimerQueue::add_timer_without_id(clockid_t clock_id, const Time& d
     // *must* be a RefPtr<Timer>. Otherwise calling cancel_timer() could
     // inadvertently cancel another timer that has been created between
     // returning from the timer handler and a call to cancel_timer().
-    auto timer = adopt(*new Timer(clock_id, deadline, move(callback)));
-
-    ScopedSpinLock lock(g_timerqueue_lock);
+    auto timer = adopt(*new Timer(clock_id, deadline, move(callback), slack));
     timer->m_id = 0; // Don't generate a timer id
     add_timer_locked(timer);
     return timer;
@@ -97,42 +175,67 @@ RefPtr<Timer> TimerQueue::add_timer_without_id(clockid_t clock_id, const Time& d
 
 TimerId TimerQueue::add_timer(NonnullRefPtr<Timer>&& timer)
 {
-    ScopedSpinLock lock(g_timerqueue_lock);
-
-    timer->m_id = ++m_timer_id_count;
-    VERIFY(timer->m_id != 0); // wrapped
+    {
+        ScopedSpinLock lock(g_timerqueue_lock);
+        timer->m_id = ++m_timer_id_count;
+        VERIFY(timer->m_id != 0); // wrapped
+        m_timers_with_id.set(timer->m_id, timer.ptr());
+    }
+    auto id = timer->m_id;
     add_timer_locked(move(timer));
-    return timer->m_id;
+    return id;
 }
 
 void TimerQueue::add_timer_locked(NonnullRefPtr<Timer> timer)
 {
-    Time timer_expiration = timer->m_expires;
-
     VERIFY(!timer->is_queued());
 
-    auto& queue = queue_for_timer(*timer);
-    if (queue.list.is_empty()) {
-        queue.list.append(&timer.leak_ref());
-        queue.next_timer_due = timer_expiration;
-    } else {
-        Timer* following_timer = nullptr;
-        queue.list.for_each([&](Timer& t) {
-            if (t.m_expires > timer_expiration) {
-                following_timer = &t;
-                return IterationDecision::Break;
-            }
-            return IterationDecision::Continue;
-        });
-        if (following_timer) {
-            bool next_timer_needs_update = queue.list.head() == following_timer;
-            queue.list.insert_before(following_timer, &timer.leak_ref());
-            if (next_timer_needs_update)
-                queue.next_timer_due = timer_expiration;
-        } else {
-            queue.list.append(&timer.leak_ref());
+    if (!timer->is_monotonic()) {
+        ScopedSpinLock lock(g_timerqueue_lock);
+        timer->set_queued(true);
+        add_realtime_timer_locked(timer.leak_ref());
+        return;
+    }
+
+    // Pick a tick within [expires, expires + slack] that is aligned as much
+    // as possible, so that timers with some slack end up sharing a slot and
+    // get woken up together.
+    u64 tick = TimerWheel::tick_for(timer->m_expires);
+    if (timer->m_slack > Time::zero()) {
+        u64 latest_tick = (u64)(timer->m_expires + timer->m_slack).to_nanoseconds() >> TimerWheel::tick_shift;
+        if (latest_tick > tick) {
+            u64 differing_bit = 1ull << (63 - __builtin_clzll(tick ^ latest_tick));
+            tick = latest_tick & ~(differing_bit - 1);
         }
     }
+    timer->m_wheel_tick = tick;
+
+    auto& wheel = wheel_for_current_processor();
+    ScopedSpinLock lock(wheel.m_lock);
+    timer->m_wheel = &wheel;
+    timer->set_queued(true);
+    wheel.insert(timer.leak_ref());
+}
+
+void TimerQueue::add_realtime_timer_locked(Timer& timer)
+{
+    VERIFY(g_timerqueue_lock.is_locked());
+
+    // Realtime timers are kept sorted because the realtime clock may be
+    // changed at any moment. They are rare, so this is not a problem.
+    Timer* following_timer = nullptr;
+    m_realtime_timers.for_each([&](Timer& t) {
+        if (t.m_expires > timer.m_expires) {
+            following_timer = &t;
+            return IterationDecision::Break;
+        }
+        return IterationDecision::Continue;
+    });
+    if (following_timer)
+        m_realtime_timers.insert_before(following_timer, &timer);
+    else
+        m_realtime_timers.append(&timer);
+    timer.m_list = &m_realtime_timers;
 }
 
 TimerId TimerQueue::add_timer(clockid_t clock_id, const Time& deadline, Function<void()>&& callback)
@@ -144,75 +247,32 @@ TimerId TimerQueue::add_timer(clockid_t clock_id, const Time& deadline, Function
 
 bool TimerQueue::cancel_timer(TimerId id)
 {
-    Timer* found_timer = nullptr;
-    Queue* timer_queue = nullptr;
-
-    ScopedSpinLock lock(g_timerqueue_lock);
-    if (m_timer_queue_monotonic.list.for_each([&](Timer& timer) {
-            if (timer.m_id == id) {
-                found_timer = &timer;
-                timer_queue = &m_timer_queue_monotonic;
-                return IterationDecision::Break;
-            }
-            return IterationDecision::Continue;
-        })
-        != IterationDecision::Break) {
-        m_timer_queue_realtime.list.for_each([&](Timer& timer) {
-            if (timer.m_id == id) {
-                found_timer = &timer;
-                timer_queue = &m_timer_queue_realtime;
-                return IterationDecision::Break;
-            }
-            return IterationDecision::Continue;
-        });
-    }
-
-    if (!found_timer) {
-        // The timer may be executing right now, if it is then it should
-        // be in m_timers_executing. If it is then release the lock
-        // briefly to allow it to finish by removing itself
-        // NOTE: This can only happen with multiple processors!
-        while (m_timers_executing.for_each([&](Timer& timer) {
-            if (timer.m_id == id)
-                return IterationDecision::Break;
-            return IterationDecision::Continue;
-        }) == IterationDecision::Break) {
-            // NOTE: This isn't the most efficient way to wait, but
-            // it should only happen when multiple processors are used.
-            // Also, the timers should execute pretty quickly, so it
-            // should not loop here for very long. But we can't yield.
-            lock.unlock();
-            Processor::wait_check();
-            lock.lock();
-        }
-        // We were not able to cancel the timer, but at this point
-        // the handler should have completed if it was running!
-        return false;
+    RefPtr<Timer> timer;
+    {
+        ScopedSpinLock lock(g_timerqueue_lock);
+        auto it = m_timers_with_id.find(id);
+        if (it == m_timers_with_id.end())
+            return false;
+        timer = it->value;
     }
-
-    VERIFY(found_timer);
-    VERIFY(timer_queue);
-    remove_timer_locked(*timer_queue, *found_timer);
-    return true;
+    return cancel_timer(*timer);
 }
 
 bool TimerQueue::cancel_timer(Timer& timer)
 {
-    auto& timer_queue = queue_for_timer(timer);
-    ScopedSpinLock lock(g_timerqueue_lock);
-    if (!timer_queue.list.contains_slow(&timer)) {
-        // The timer may be executing right now, if it is then it should
-        // be in m_timers_executing. If it is then release the lock
-        // briefly to allow it to finish by removing itself
+    auto& lock = timer.m_wheel ? timer.m_wheel->m_lock : g_timerqueue_lock;
+    ScopedSpinLock locker(lock);
+    if (!timer.m_list) {
+        locker.unlock();
+        // The timer may be executing right now. If it is then wait for
+        // it to finish, but don't touch it in any other way.
         // NOTE: This can only happen with multiple processors!
-        while (m_timers_executing.contains_slow(&timer)) {
+        while (timer.m_executing) {
             // NOTE: This isn't the most efficient way to wait, but
             // it should only happen when multiple processors are used.
             // Also, the timers should execute pretty quickly, so it
             // should not loop here for very long. But we can't yield.
-            lock.unlock();
             Processor::wait_check();
-            lock.lock();
         }
         // We were not able to cancel the timer, but at this point
         // the handler should have completed if it was running!
@@ -220,74 +280,93 @@ bool TimerQueue::cancel_timer(Timer& timer)
     }
 
     VERIFY(timer.ref_count() > 1);
-    remove_timer_locked(timer_queue, timer);
+    remove_timer_locked(timer);
+    locker.unlock();
+
+    if (timer.m_id != 0) {
+        ScopedSpinLock lock(g_timerqueue_lock);
+        m_timers_with_id.remove(timer.m_id);
+    }
+
+    // Whenever we remove a timer that was still queued (but hasn't been
+    // fired) we added a reference to it. So, when removing it from the
+    // queue we need to drop that reference.
+    timer.unref();
     return true;
 }
 
-void TimerQueue::remove_timer_locked(Queue& queue, Timer& timer)
+void TimerQueue::remove_timer_locked(Timer& timer)
 {
-    bool was_next_timer = (queue.list.head() == &timer);
-    queue.list.remove(&timer);
+    timer.m_list->remove(&timer);
+    timer.m_list = nullptr;
     timer.set_queued(false);
     auto now = timer.now(false);
     if (timer.m_expires > now)
         timer.m_remaining = timer.m_expires - now;
-
-    if (was_next_timer)
-        update_next_timer_due(queue);
-    // Whenever we remove a timer that was still queued (but hasn't been
-    // fired) we added a reference to it. So, when removing it from the
-    // queue we need to drop that reference.
-    timer.unref();
 }
 
-void TimerQueue::fire()
+void TimerQueue::mark_executing_locked(Timer& timer)
 {
-    ScopedSpinLock lock(g_timerqueue_lock);
-
-    auto fire_timers = [&](Queue& queue) {
-        auto* timer = queue.list.head();
-        VERIFY(timer);
-        VERIFY(queue.next_timer_due == timer->m_expires);
-
-        while (timer && timer->now(true) > timer->m_expires) {
-            queue.list.remove(timer);
-            timer->set_queued(false);
+    // This lets cancel_timer() know that it has to wait for the callback
+    // to finish, as the timer isn't on any list anymore.
+    timer.m_list = nullptr;
+    timer.set_queued(false);
+    timer.m_executing = true;
+}
 
-            m_timers_executing.append(timer);
+void TimerQueue::execute_deferred(Timer& timer)
+{
+    // Defer executing the timer outside of the irq handler
+    Processor::current().deferred_call_queue([this, timer = &timer]() {
+        timer->m_callback();
+        if (timer->m_id != 0) {
+            ScopedSpinLock lock(g_timerqueue_lock);
+            m_timers_with_id.remove(timer->m_id);
+        }
+        timer->m_executing = false;
+        // Drop the reference we added when queueing the timer
+        timer->unref();
+    });
+}
 
-            update_next_timer_due(queue);
+void TimerQueue::fire_expired(TimerWheel& wheel)
+{
+    ScopedSpinLock lock(wheel.m_lock);
 
-            lock.unlock();
+    auto now_tick = (u64)TimeManagement::the().monotonic_time(TimePrecision::Coarse).to_nanoseconds() >> TimerWheel::tick_shift;
+    while (wheel.m_next_tick <= now_tick)
+        wheel.expire_next_tick();
 
-            // Defer executing the timer outside of the irq handler
-            Processor::current().deferred_call_queue([this, timer]() {
-                timer->m_callback();
-                ScopedSpinLock lock(g_timerqueue_lock);
-                m_timers_executing.remove(timer);
-                // Drop the reference we added when queueing the timer
-                timer->unref();
-            });
+    while (auto* timer = wheel.m_expired.remove_head()) {
+        mark_executing_locked(*timer);
+        lock.unlock();
+        execute_deferred(*timer);
+        lock.lock();
+    }
+}
 
-            lock.lock();
-            timer = queue.list.head();
-        }
-    };
+void TimerQueue::fire_realtime()
+{
+    ScopedSpinLock lock(g_timerqueue_lock);
 
-    if (!m_timer_queue_monotonic.list.is_empty())
-        fire_timers(m_timer_queue_monotonic);
-    if (!m_timer_queue_realtime.list.is_empty())
-        fire_timers(m_timer_queue_realtime);
+    auto* timer = m_realtime_timers.head();
+    while (timer && timer->now(true) > timer->m_expires) {
+        m_realtime_timers.remove(timer);
+        mark_executing_locked(*timer);
+        lock.unlock();
+        execute_deferred(*timer);
+        lock.lock();
+        timer = m_realtime_timers.head();
+    }
 }
 
-void TimerQueue::update_next_timer_due(Queue& queue)
+void TimerQueue::fire()
 {
-    VERIFY(g_timerqueue_lock.is_locked());
-
-    if (auto* next_timer = queue.list.head())
-        queue.next_timer_due = next_timer->m_expires;
-    else
-        queue.next_timer_due = {};
+    auto cpu = Processor::id();
+    if (cpu < max_wheels && m_wheels[cpu])
+        fire_expired(*m_wheels[cpu]);
+    if (cpu == 0)
+        fire_realtime();
 }
 
 }
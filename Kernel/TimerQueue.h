@@ -26,27 +26,34 @@
 
 #pragma once
 
+#include <AK/Array.h>
 #include <AK/Function.h>
+#include <AK/HashMap.h>
 #include <AK/InlineLinkedList.h>
 #include <AK/NonnullRefPtr.h>
 #include <AK/OwnPtr.h>
 #include <AK/RefCounted.h>
 #include <AK/Time.h>
+#include <Kernel/SpinLock.h>
 #include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
 TYPEDEF_DISTINCT_ORDERED_ID(u64, TimerId);
 
+class TimerWheel;
+
 class Timer : public RefCounted<Timer>
     , public InlineLinkedListNode<Timer> {
     friend class TimerQueue;
+    friend class TimerWheel;
     friend class InlineLinkedListNode<Timer>;
 
 public:
-    Timer(clockid_t clock_id, Time expires, Function<void()>&& callback)
+    Timer(clockid_t clock_id, Time expires, Function<void()>&& callback, Time slack = {})
         : m_clock_id(clock_id)
         , m_expires(expires)
+        , m_slack(slack)
         , m_callback(move(callback))
     {
     }
@@ -61,11 +68,19 @@ private:
     TimerId m_id;
     clockid_t m_clock_id;
     Time m_expires;
+    Time m_slack;
     Time m_remaining {};
     Function<void()> m_callback;
     Timer* m_next { nullptr };
     Timer* m_prev { nullptr };
+    // The wheel this timer was added to (null for realtime timers), and the
+    // list it is currently linked into. m_list is only valid while holding
+    // the lock protecting that wheel (or g_timerqueue_lock).
+    TimerWheel* m_wheel { nullptr };
+    InlineLinkedList<Timer>* m_list { nullptr };
+    u64 m_wheel_tick { 0 };
     Atomic<bool, AK::MemoryOrder::memory_order_relaxed> m_queued { false };
+    Atomic<bool> m_executing { false };
 
     bool operator<(const Timer& rhs) const
     {
@@ -81,9 +96,48 @@ private:
     }
     bool is_queued() const { return m_queued; }
     void set_queued(bool queued) { m_queued = queued; }
+    bool is_monotonic() const { return m_clock_id != CLOCK_REALTIME && m_clock_id != CLOCK_REALTIME_COARSE; }
     Time now(bool) const;
 };
 
+// A cascading hierarchical timing wheel for the monotonic clocks. Level 0
+// has one slot per wheel tick, and each following level has slots that are
+// wheel_slots times as wide. Timers are hashed into the slot matching their
+// expiration, making adding and cancelling a timer O(1). Whenever level 0
+// wraps around, the next slot of the level above is cascaded down.
+class TimerWheel {
+    friend class TimerQueue;
+
+public:
+    static constexpr size_t tick_shift = 20; // ~1.05ms per wheel tick
+    static constexpr size_t slot_bits = 6;
+    static constexpr size_t slots = 1 << slot_bits;
+    static constexpr size_t levels = 6;
+
+    explicit TimerWheel(u64 now_tick)
+        : m_next_tick(now_tick)
+    {
+    }
+
+    static u64 tick_for(const Time& time)
+    {
+        auto nanoseconds = time.to_nanoseconds();
+        if (nanoseconds <= 0)
+            return 0;
+        return ((u64)nanoseconds + (1ull << tick_shift) - 1) >> tick_shift;
+    }
+
+private:
+    void insert(Timer&);
+    void cascade(size_t level);
+    void expire_next_tick();
+
+    SpinLock<u8> m_lock;
+    u64 m_next_tick { 0 };
+    InlineLinkedList<Timer> m_slots[levels][slots];
+    InlineLinkedList<Timer> m_expired;
+};
+
 class TimerQueue {
     friend class Timer;
 
@@ -92,7 +146,7 @@ public:
     static TimerQueue& the();
 
     TimerId add_timer(NonnullRefPtr<Timer>&&);
-    RefPtr<Timer> add_timer_without_id(clockid_t, const Time&, Function<void()>&&);
+    RefPtr<Timer> add_timer_without_id(clockid_t, const Time&, Function<void()>&&, Time slack = {});
     TimerId add_timer(clockid_t, const Time& timeout, Function<void()>&& callback);
     bool cancel_timer(TimerId id);
     bool cancel_timer(Timer&);
@@ -102,35 +156,32 @@ public:
     }
     void fire();
 
+    // Sets up a wheel for the current processor, which must be receiving
+    // its own timer ticks from now on.
+    void initialize_processor_wheel();
+
+    // How late a timer with the given relative timeout may fire so that
+    // its wakeup can be batched with others (0.1% of it, at most 100ms).
+    static Time default_slack_for(const Time& timeout);
+
 private:
-    struct Queue {
-        InlineLinkedList<Timer> list;
-        Time next_timer_due {};
-    };
-    void remove_timer_locked(Queue&, Timer&);
-    void update_next_timer_due(Queue&);
-    void add_timer_locked(NonnullRefPtr<Timer>);
+    // Processor::s_idle_cpu_mask limits us to 32 processors anyway.
+    static constexpr size_t max_wheels = 32;
 
-    Queue& queue_for_timer(Timer& timer)
-    {
-        switch (timer.m_clock_id) {
-        case CLOCK_MONOTONIC:
-        case CLOCK_MONOTONIC_COARSE:
-        case CLOCK_MONOTONIC_RAW:
-            return m_timer_queue_monotonic;
-        case CLOCK_REALTIME:
-        case CLOCK_REALTIME_COARSE:
-            return m_timer_queue_realtime;
-        default:
-            VERIFY_NOT_REACHED();
-        }
-    }
+    TimerWheel& wheel_for_current_processor();
+    void add_timer_locked(NonnullRefPtr<Timer>);
+    void add_realtime_timer_locked(Timer&);
+    void remove_timer_locked(Timer&);
+    void fire_expired(TimerWheel&);
+    void fire_realtime();
+    void mark_executing_locked(Timer&);
+    void execute_deferred(Timer&);
 
     u64 m_timer_id_count { 0 };
     u64 m_ticks_per_second { 0 };
-    Queue m_timer_queue_monotonic;
-    Queue m_timer_queue_realtime;
-    InlineLinkedList<Timer> m_timers_executing;
+    Array<OwnPtr<TimerWheel>, max_wheels> m_wheels;
+    InlineLinkedList<Timer> m_realtime_timers;
+    HashMap<TimerId, Timer*> m_timers_with_id;
 };
 
 }
@@ -98,6 +98,8 @@ enum {
 #define MAP_STACK 0x40
 #define MAP_NORESERVE 0x80
 #define MAP_RANDOMIZED 0x100
+#define MAP_HUGE 0x200
+#define MAP_POPULATE 0x400
 
 #define PROT_READ 0x1
 #define PROT_WRITE 0x2
@@ -107,6 +109,7 @@ enum {
 #define MADV_SET_VOLATILE 0x100
 #define MADV_SET_NONVOLATILE 0x200
 #define MADV_GET_VOLATILE 0x400
+#define MADV_WILLNEED 0x800
 
 #define F_DUPFD 0
 #define F_GETFD 1
@@ -150,6 +153,9 @@ enum {
 #define FUTEX_REQUEUE 3
 #define FUTEX_CMP_REQUEUE 4
 #define FUTEX_WAKE_OP 5
+#define FUTEX_LOCK_PI 6
+#define FUTEX_UNLOCK_PI 7
+#define FUTEX_TRYLOCK_PI 8
 #define FUTEX_WAIT_BITSET 9
 #define FUTEX_WAKE_BITSET 10
 
@@ -159,6 +165,11 @@ enum {
 
 #define FUTEX_BITSET_MATCH_ANY 0xffffffff
 
+// The futex word of a priority inheritance futex holds the owner's thread id
+#define FUTEX_WAITERS 0x80000000
+#define FUTEX_OWNER_DIED 0x40000000
+#define FUTEX_TID_MASK 0x3fffffff
+
 #define S_IFMT 0170000
 #define S_IFDIR 0040000
 #define S_IFCHR 0020000
@@ -481,6 +492,31 @@ struct pollfd {
     short revents;
 };
 
+#define EPOLLIN (1u << 0)
+#define EPOLLPRI (1u << 1)
+#define EPOLLOUT (1u << 2)
+#define EPOLLERR (1u << 3)
+#define EPOLLHUP (1u << 4)
+#define EPOLLRDHUP (1u << 13)
+#define EPOLLONESHOT (1u << 30)
+#define EPOLLET (1u << 31)
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+typedef union epoll_data {
+    void* ptr;
+    int fd;
+    uint32_t u32;
+    uint64_t u64;
+} epoll_data_t;
+
+struct epoll_event {
+    uint32_t events;
+    epoll_data_t data;
+};
+
 #define AF_MASK 0xff
 #define AF_UNSPEC 0
 #define AF_LOCAL 1
@@ -31,6 +31,9 @@ namespace Kernel {
 enum class AllocationStrategy {
     Reserve = 0,
     AllocateNow,
+    // Like AllocateNow, but tries to back every 2 MiB of the object with a
+    // single physically contiguous block so it can be mapped with large pages.
+    AllocateLargePages,
     None
 };
 
@@ -72,7 +72,7 @@ RefPtr<VMObject> AnonymousVMObject::clone()
 
 RefPtr<AnonymousVMObject> AnonymousVMObject::create_with_size(size_t size, AllocationStrategy commit)
 {
-    if (commit == AllocationStrategy::Reserve || commit == AllocationStrategy::AllocateNow) {
+    if (commit != AllocationStrategy::None) {
         // We need to attempt to commit before actually creating the object
         if (!MM.commit_user_physical_pages(ceil_div(size, static_cast<size_t>(PAGE_SIZE))))
             return {};
@@ -103,8 +103,24 @@ AnonymousVMObject::AnonymousVMObject(size_t size, AllocationStrategy strategy)
     : VMObject(size)
     , m_volatile_ranges_cache({ 0, page_count() })
     , m_unused_committed_pages(strategy == AllocationStrategy::Reserve ? page_count() : 0)
-{
-    if (strategy == AllocationStrategy::AllocateNow) {
+    , m_may_use_large_pages(strategy == AllocationStrategy::AllocateLargePages)
+{
+    if (strategy == AllocationStrategy::AllocateLargePages) {
+        // We committed all pages, so whatever chunk we can't get contiguously
+        // is simply allocated one page at a time.
+        size_t i = 0;
+        while (i < page_count()) {
+            if (page_count() - i >= pages_per_large_page) {
+                auto chunk = MM.allocate_committed_contiguous_user_physical_pages(pages_per_large_page, large_page_size);
+                if (!chunk.is_empty()) {
+                    for (auto& page : chunk)
+                        physical_pages()[i++] = page;
+                    continue;
+                }
+            }
+            physical_pages()[i++] = MM.allocate_committed_user_physical_page(MemoryManager::ShouldZeroFill::Yes);
+        }
+    } else if (strategy == AllocationStrategy::AllocateNow) {
         // Allocate all pages right now. We know we can get all because we committed the amount needed
         for (size_t i = 0; i < page_count(); ++i)
             physical_pages()[i] = MM.allocate_committed_user_physical_page(MemoryManager::ShouldZeroFill::Yes);
@@ -118,6 +134,7 @@ AnonymousVMObject::AnonymousVMObject(size_t size, AllocationStrategy strategy)
 AnonymousVMObject::AnonymousVMObject(PhysicalAddress paddr, size_t size)
     : VMObject(size)
     , m_volatile_ranges_cache({ 0, page_count() })
+    , m_may_use_large_pages(true)
 {
     VERIFY(paddr.page_base() == paddr);
     for (size_t i = 0; i < page_count(); ++i)
@@ -459,27 +476,36 @@ bool AnonymousVMObject::is_nonvolatile(size_t page_index)
 PageFaultResponse AnonymousVMObject::handle_cow_fault(size_t page_index, VirtualAddress vaddr)
 {
     VERIFY_INTERRUPTS_DISABLED();
-    ScopedSpinLock lock(m_lock);
-    auto& page_slot = physical_pages()[page_index];
-    bool have_committed = m_shared_committed_cow_pages && is_nonvolatile(page_index);
-    if (page_slot->ref_count() == 1) {
+    // Serialize with other faults on this VMObject. We can't hold m_lock
+    // across the allocation below, as the allocator may need s_mm_lock.
+    LOCKER(m_paging_lock);
+
+    RefPtr<CommittedCowPages> committed_cow_pages;
+    {
+        ScopedSpinLock lock(m_lock);
+        auto& page_slot = physical_pages()[page_index];
+        bool have_committed = m_shared_committed_cow_pages && is_nonvolatile(page_index);
+        if (page_slot->ref_count() == 1) {
 #if PAGE_FAULT_DEBUG
-        dbgln("    >> It's a COW page but nobody is sharing it anymore. Remap r/w");
+            dbgln("    >> It's a COW page but nobody is sharing it anymore. Remap r/w");
 #endif
-        set_should_cow(page_index, false);
-        if (have_committed) {
-            if (m_shared_committed_cow_pages->return_one())
-                m_shared_committed_cow_pages = nullptr;
+            set_should_cow(page_index, false);
+            if (have_committed) {
+                if (m_shared_committed_cow_pages->return_one())
+                    m_shared_committed_cow_pages = nullptr;
+            }
+            return PageFaultResponse::Continue;
         }
-        return PageFaultResponse::Continue;
+        if (have_committed)
+            committed_cow_pages = m_shared_committed_cow_pages;
     }
 
     RefPtr<PhysicalPage> page;
-    if (have_committed) {
+    if (committed_cow_pages) {
 #if PAGE_FAULT_DEBUG
         dbgln("    >> It's a committed COW page and it's time to COW!");
 #endif
-        page = m_shared_committed_cow_pages->allocate_one();
+        page = committed_cow_pages->allocate_one();
     } else {
 #if PAGE_FAULT_DEBUG
         dbgln("    >> It's a COW page and it's time to COW!");
@@ -491,25 +517,35 @@ PageFaultResponse AnonymousVMObject::handle_cow_fault(size_t page_index, Virtual
         }
     }
 
+    // The old page stays mapped read-only at vaddr while we copy it.
     u8* dest_ptr = MM.quickmap_page(*page);
-    dbgln_if(PAGE_FAULT_DEBUG, "      >> COW {} <- {}", page->paddr(), page_slot->paddr());
+    dbgln_if(PAGE_FAULT_DEBUG, "      >> COW {} <- {}", page->paddr(), vaddr);
     {
         SmapDisabler disabler;
         void* fault_at;
         if (!safe_memcpy(dest_ptr, vaddr.as_ptr(), PAGE_SIZE, fault_at)) {
             if ((u8*)fault_at >= dest_ptr && (u8*)fault_at <= dest_ptr + PAGE_SIZE)
-                dbgln("      >> COW: error copying page {}/{} to {}/{}: failed to write to page at {}",
-                    page_slot->paddr(), vaddr, page->paddr(), VirtualAddress(dest_ptr), VirtualAddress(fault_at));
+                dbgln("      >> COW: error copying page {} to {}/{}: failed to write to page at {}",
+                    vaddr, page->paddr(), VirtualAddress(dest_ptr), VirtualAddress(fault_at));
             else if ((u8*)fault_at >= vaddr.as_ptr() && (u8*)fault_at <= vaddr.as_ptr() + PAGE_SIZE)
-                dbgln("      >> COW: error copying page {}/{} to {}/{}: failed to read from page at {}",
-                    page_slot->paddr(), vaddr, page->paddr(), VirtualAddress(dest_ptr), VirtualAddress(fault_at));
+                dbgln("      >> COW: error copying page {} to {}/{}: failed to read from page at {}",
+                    vaddr, page->paddr(), VirtualAddress(dest_ptr), VirtualAddress(fault_at));
             else
                 VERIFY_NOT_REACHED();
         }
     }
-    page_slot = move(page);
     MM.unquickmap_page();
-    set_should_cow(page_index, false);
+
+    RefPtr<PhysicalPage> old_page;
+    {
+        ScopedSpinLock lock(m_lock);
+        auto& page_slot = physical_pages()[page_index];
+        old_page = move(page_slot);
+        page_slot = move(page);
+        set_should_cow(page_index, false);
+    }
+    // Drop our reference to the old page only after releasing m_lock.
+    old_page = nullptr;
     return PageFaultResponse::Continue;
 }
 
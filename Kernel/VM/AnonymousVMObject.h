@@ -140,6 +140,7 @@ private:
     AnonymousVMObject(AnonymousVMObject&&) = delete;
 
     virtual bool is_anonymous() const override { return true; }
+    virtual bool may_use_large_pages() const override { return m_may_use_large_pages; }
 
     Bitmap& ensure_cow_map();
     void ensure_or_reset_cow_map();
@@ -148,6 +149,7 @@ private:
     bool m_volatile_ranges_cache_dirty { true };
     Vector<PurgeablePageRanges*> m_purgeable_ranges;
     size_t m_unused_committed_pages { 0 };
+    bool m_may_use_large_pages { false };
 
     Bitmap m_cow_map;
 
@@ -49,6 +49,7 @@ private:
     ContiguousVMObject(ContiguousVMObject&&) = delete;
 
     virtual bool is_contiguous() const override { return true; }
+    virtual bool may_use_large_pages() const override { return true; }
 };
 
 }
@@ -80,11 +80,14 @@ int InodeVMObject::release_all_clean_pages()
 int InodeVMObject::release_all_clean_pages_impl()
 {
     int count = 0;
-    InterruptDisabler disabler;
-    for (size_t i = 0; i < page_count(); ++i) {
-        if (!m_dirty_pages.get(i) && m_physical_pages[i]) {
-            m_physical_pages[i] = nullptr;
-            ++count;
+    {
+        // A page fault may be marking a page dirty on another processor.
+        ScopedSpinLock lock(m_lock);
+        for (size_t i = 0; i < page_count(); ++i) {
+            if (!m_dirty_pages.get(i) && m_physical_pages[i]) {
+                m_physical_pages[i] = nullptr;
+                ++count;
+            }
         }
     }
     for_each_region([](auto& region) {
@@ -40,6 +40,7 @@
 #include <Kernel/VM/PageDirectory.h>
 #include <Kernel/VM/PhysicalRegion.h>
 #include <Kernel/VM/SharedInodeVMObject.h>
+#include <Kernel/WaitQueue.h>
 
 extern u8* start_of_kernel_image;
 extern u8* end_of_kernel_image;
@@ -79,6 +80,7 @@ bool MemoryManager::is_initialized()
 UNMAP_AFTER_INIT MemoryManager::MemoryManager()
 {
     ScopedSpinLock lock(s_mm_lock);
+    m_memory_pressure_wait_queue = new WaitQueue;
     m_kernel_page_directory = PageDirectory::create_kernel_page_directory();
     parse_memory_map();
     write_cr3(kernel_page_directory().cr3());
@@ -327,12 +329,33 @@ PageTableEntry* MemoryManager::pte(PageDirectory& page_directory, VirtualAddress
 
     auto* pd = quickmap_pd(const_cast<PageDirectory&>(page_directory), page_directory_table_index);
     const PageDirectoryEntry& pde = pd[page_directory_index];
-    if (!pde.is_present())
+    if (!pde.is_present() || pde.is_huge())
         return nullptr;
 
     return &quickmap_pt(PhysicalAddress((FlatPtr)pde.page_table_base()))[page_table_index];
 }
 
+PageTableEntry* MemoryManager::existing_pte(PageDirectory& page_directory, VirtualAddress vaddr)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(page_directory.get_lock().own_lock());
+    u32 page_directory_table_index = (vaddr.get() >> 30) & 0x3;
+    u32 page_directory_index = (vaddr.get() >> 21) & 0x1ff;
+    u32 page_table_index = (vaddr.get() >> 12) & 0x1ff;
+
+    // Unlike pte(), this maps the paging structures through this processor's
+    // own quickmap slots, so holding the page directory lock is enough.
+    auto pd_paddr = page_directory.m_directory_pages[page_directory_table_index]->paddr();
+    auto* pd = (PageDirectoryEntry*)quickmap_page_table_local(pd_paddr, 0);
+    const PageDirectoryEntry& pde = pd[page_directory_index];
+    // Large pages have to be split first, which needs s_mm_lock.
+    if (!pde.is_present() || pde.is_huge())
+        return nullptr;
+
+    auto* pt = (PageTableEntry*)quickmap_page_table_local(PhysicalAddress((FlatPtr)pde.page_table_base()), 1);
+    return &pt[page_table_index];
+}
+
 PageTableEntry* MemoryManager::ensure_pte(PageDirectory& page_directory, VirtualAddress vaddr)
 {
     VERIFY_INTERRUPTS_DISABLED();
@@ -343,6 +366,13 @@ PageTableEntry* MemoryManager::ensure_pte(PageDirectory& page_directory, Virtual
     u32 page_table_index = (vaddr.get() >> 12) & 0x1ff;
 
     auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+    if (pd[page_directory_index].is_huge()) {
+        // Someone wants to change a single page inside a large page, so we
+        // have to break it up into a page table first.
+        if (!split_large_page(page_directory, vaddr))
+            return nullptr;
+        pd = quickmap_pd(page_directory, page_directory_table_index);
+    }
     PageDirectoryEntry& pde = pd[page_directory_index];
     if (!pde.is_present()) {
         bool did_purge = false;
@@ -385,6 +415,12 @@ void MemoryManager::release_pte(PageDirectory& page_directory, VirtualAddress va
 
     auto* pd = quickmap_pd(page_directory, page_directory_table_index);
     PageDirectoryEntry& pde = pd[page_directory_index];
+    if (pde.is_huge()) {
+        // A large page never spans more than one region, so whoever releases
+        // one of its pages is unmapping all of them.
+        pde.clear();
+        return;
+    }
     if (pde.is_present()) {
         auto* page_table = quickmap_pt(PhysicalAddress((FlatPtr)pde.page_table_base()));
         auto& pte = page_table[page_table_index];
@@ -410,6 +446,81 @@ void MemoryManager::release_pte(PageDirectory& page_directory, VirtualAddress va
     }
 }
 
+PageDirectoryEntry* MemoryManager::ensure_large_page_pde(PageDirectory& page_directory, VirtualAddress vaddr)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(s_mm_lock.own_lock());
+    VERIFY(page_directory.get_lock().own_lock());
+    VERIFY(!(vaddr.get() % large_page_size));
+    u32 page_directory_table_index = (vaddr.get() >> 30) & 0x3;
+    u32 page_directory_index = (vaddr.get() >> 21) & 0x1ff;
+
+    auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+    PageDirectoryEntry& pde = pd[page_directory_index];
+    if (pde.is_present() && !pde.is_huge()) {
+        // The caller maps the whole 2 MiB, so any page table we have here only
+        // holds entries for that same mapping and can go.
+        pde.clear();
+        auto result = page_directory.m_page_tables.remove(vaddr.get());
+        VERIFY(result);
+    }
+    return &pde;
+}
+
+bool MemoryManager::split_large_page(PageDirectory& page_directory, VirtualAddress vaddr)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(s_mm_lock.own_lock());
+    VERIFY(page_directory.get_lock().own_lock());
+    u32 page_directory_table_index = (vaddr.get() >> 30) & 0x3;
+    u32 page_directory_index = (vaddr.get() >> 21) & 0x1ff;
+    auto large_page_base = vaddr.get() & ~(large_page_size - 1);
+
+    auto page_table = allocate_user_physical_page(ShouldZeroFill::No);
+    if (!page_table) {
+        dbgln("MM: Unable to allocate page table to split large page at {}", VirtualAddress(large_page_base));
+        return false;
+    }
+
+    // Allocating may have purged memory and touched the page directory, so look at the entry only now.
+    auto* pd = quickmap_pd(page_directory, page_directory_table_index);
+    auto pde = pd[page_directory_index];
+    if (!pde.is_huge())
+        return true;
+
+    // Map the same memory with the same permissions, just 4 KiB at a time.
+    auto* ptes = quickmap_pt(page_table->paddr());
+    auto paddr = (FlatPtr)pde.page_table_base();
+    for (size_t i = 0; i < pages_per_large_page; ++i) {
+        auto& pte = ptes[i];
+        pte.clear();
+        pte.set_physical_page_base(paddr + i * PAGE_SIZE);
+        pte.set_present(true);
+        pte.set_writable(pde.is_writable());
+        pte.set_user_allowed(pde.is_user_allowed());
+        pte.set_cache_disabled(pde.is_cache_disabled());
+        pte.set_write_through(pde.is_write_through());
+        pte.set_execute_disabled(pde.is_execute_disabled());
+        pte.set_global(pde.is_global());
+    }
+
+    pd = quickmap_pd(page_directory, page_directory_table_index);
+    auto& new_pde = pd[page_directory_index];
+    new_pde.clear();
+    new_pde.set_page_table_base(page_table->paddr().get());
+    new_pde.set_user_allowed(true);
+    new_pde.set_present(true);
+    new_pde.set_writable(true);
+    new_pde.set_global(&page_directory == m_kernel_page_directory.ptr());
+    auto result = page_directory.m_page_tables.set(large_page_base, move(page_table));
+    VERIFY(result == AK::HashSetResult::InsertedNewEntry);
+
+    // The page table maps exactly what the large page did, so stale TLB entries
+    // are harmless. Whoever changes one of the pages next flushes it.
+    dbgln_if(PAGE_FAULT_DEBUG, "MM: Split large page at {}", VirtualAddress(large_page_base));
+    return true;
+}
+
 UNMAP_AFTER_INIT void MemoryManager::initialize(u32 cpu)
 {
     auto mm_data = new MemoryManagerData;
@@ -465,7 +576,6 @@ Region* MemoryManager::find_region_from_vaddr(VirtualAddress vaddr)
 PageFaultResponse MemoryManager::handle_page_fault(const PageFault& fault)
 {
     VERIFY_INTERRUPTS_DISABLED();
-    ScopedSpinLock lock(s_mm_lock);
     if (Processor::current().in_irq()) {
         dbgln("CPU[{}] BUG! Page fault while handling IRQ! code={}, vaddr={}, irq level: {}",
             Processor::id(), fault.code(), fault.vaddr(), Processor::current().in_irq());
@@ -473,19 +583,44 @@ PageFaultResponse MemoryManager::handle_page_fault(const PageFault& fault)
         return PageFaultResponse::ShouldCrash;
     }
     dbgln_if(PAGE_FAULT_DEBUG, "MM: CPU[{}] handle_page_fault({:#04x}) at {}", Processor::id(), fault.code(), fault.vaddr());
-    auto* region = find_region_from_vaddr(fault.vaddr());
-    if (!region) {
+
+    // Kernel regions stay alive for as long as anyone is using them.
+    if (auto* region = kernel_region_from_vaddr(fault.vaddr()))
+        return region->handle_fault(fault);
+
+    // User regions may be unmapped by another thread at any time, so we
+    // pin the region while resolving the fault. Everything after this
+    // only takes the VMObject's and the page directory's locks, plus
+    // s_mm_lock if a page table has to be allocated.
+    auto page_directory = PageDirectory::find_by_cr3(read_cr3());
+    if (!page_directory || !page_directory->space())
         return PageFaultResponse::ShouldCrash;
+    auto& space = *page_directory->space();
+    Region* region = nullptr;
+    {
+        ScopedSpinLock lock(space.get_lock());
+        region = user_region_from_vaddr(space, fault.vaddr());
+        if (region)
+            region->pin_for_fault();
     }
+    if (!region)
+        return PageFaultResponse::ShouldCrash;
 
-    return region->handle_fault(fault, lock);
+    auto response = region->handle_fault(fault);
+    region->unpin_after_fault();
+    return response;
+}
+
+static size_t virtual_alignment_for_large_pages(size_t size)
+{
+    return size >= large_page_size ? large_page_size : PAGE_SIZE;
 }
 
 OwnPtr<Region> MemoryManager::allocate_contiguous_kernel_region(size_t size, String name, Region::Access access, size_t physical_alignment, Region::Cacheable cacheable)
 {
     VERIFY(!(size % PAGE_SIZE));
     ScopedSpinLock lock(s_mm_lock);
-    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size);
+    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size, virtual_alignment_for_large_pages(size));
     if (!range.has_value())
         return {};
     auto vmobject = ContiguousVMObject::create_with_size(size, physical_alignment);
@@ -509,7 +644,8 @@ OwnPtr<Region> MemoryManager::allocate_kernel_region(PhysicalAddress paddr, size
 {
     VERIFY(!(size % PAGE_SIZE));
     ScopedSpinLock lock(s_mm_lock);
-    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size);
+    // Physical ranges are usually framebuffers and other big MMIO areas, which benefit from large pages.
+    auto range = kernel_page_directory().range_allocator().allocate_anywhere(size, virtual_alignment_for_large_pages(size));
     if (!range.has_value())
         return {};
     auto vmobject = AnonymousVMObject::create_for_physical_range(paddr, size);
@@ -550,93 +686,263 @@ OwnPtr<Region> MemoryManager::allocate_kernel_region_with_vmobject(VMObject& vmo
     return allocate_kernel_region_with_vmobject(range.value(), vmobject, move(name), access, cacheable);
 }
 
+void PhysicalAllocatorLatencyHistogram::record(u64 start_cycles)
+{
+    u64 cycles = read_tsc() - start_cycles;
+    size_t bucket = 63 - __builtin_clzll(cycles | 1);
+    buckets[min(bucket, bucket_count - 1)]++;
+}
+
 bool MemoryManager::commit_user_physical_pages(size_t page_count)
 {
     VERIFY(page_count > 0);
-    ScopedSpinLock lock(s_mm_lock);
-    if (m_user_physical_pages_uncommitted < page_count)
-        return false;
+    auto uncommitted = m_user_physical_pages_uncommitted.load();
+    do {
+        if (uncommitted < page_count) {
+            notify_if_under_memory_pressure();
+            return false;
+        }
+    } while (!m_user_physical_pages_uncommitted.compare_exchange_strong(uncommitted, uncommitted - page_count));
 
-    m_user_physical_pages_uncommitted -= page_count;
     m_user_physical_pages_committed += page_count;
+    notify_if_under_memory_pressure();
     return true;
 }
 
+void MemoryManager::notify_if_under_memory_pressure()
+{
+    if (!is_under_memory_pressure())
+        return;
+    // Only the first allocation to notice the shortage wakes the waiter, the rest
+    // is covered until it has done its thing and waits again.
+    if (m_memory_pressure_pending.exchange(true, AK::MemoryOrder::memory_order_acq_rel))
+        return;
+    m_memory_pressure_wait_queue->wake_all();
+}
+
+void MemoryManager::wait_for_memory_pressure()
+{
+    // The next allocation that finds memory tight will wake us up again. If one
+    // already did so since we cleared the flag, the wake-up stays pending in the queue.
+    m_memory_pressure_pending.store(false, AK::MemoryOrder::memory_order_release);
+    m_memory_pressure_wait_queue->wait_forever("MemoryPressure");
+}
+
 void MemoryManager::uncommit_user_physical_pages(size_t page_count)
 {
     VERIFY(page_count > 0);
-    ScopedSpinLock lock(s_mm_lock);
-    VERIFY(m_user_physical_pages_committed >= page_count);
+    auto previously_committed = m_user_physical_pages_committed.fetch_sub(page_count);
+    VERIFY(previously_committed >= page_count);
 
     m_user_physical_pages_uncommitted += page_count;
-    m_user_physical_pages_committed -= page_count;
 }
 
-void MemoryManager::deallocate_user_physical_page(const PhysicalPage& page)
+size_t MemoryManager::take_pages_from_user_regions(PhysicalAddress* pages, size_t count)
 {
-    ScopedSpinLock lock(s_mm_lock);
+    VERIFY(s_mm_lock.own_lock());
+    size_t taken = 0;
     for (auto& region : m_user_physical_regions) {
-        if (!region.contains(page))
-            continue;
-
-        region.return_page(page);
-        --m_user_physical_pages_used;
+        while (taken < count) {
+            auto paddr = region.take_free_page_address();
+            if (!paddr.has_value())
+                break;
+            pages[taken++] = paddr.value();
+        }
+    }
+    return taken;
+}
 
-        // Always return pages to the uncommitted pool. Pages that were
-        // committed and allocated are only freed upon request. Once
-        // returned there is no guarantee being able to get them back.
-        ++m_user_physical_pages_uncommitted;
-        return;
+void MemoryManager::return_page_to_user_regions(PhysicalAddress paddr)
+{
+    VERIFY(s_mm_lock.own_lock());
+    for (auto& region : m_user_physical_regions) {
+        if (region.contains(paddr)) {
+            region.return_page_at(paddr);
+            return;
+        }
     }
 
-    dmesgln("MM: deallocate_user_physical_page couldn't figure out region for user page @ {}", page.paddr());
+    dmesgln("MM: deallocate_user_physical_page couldn't figure out region for user page @ {}", paddr);
     VERIFY_NOT_REACHED();
 }
 
+void MemoryManager::drain_magazines()
+{
+    VERIFY(s_mm_lock.own_lock());
+    for_each_processor_data([&](MemoryManagerData& data) {
+        auto& magazine = data.m_user_page_magazine;
+        ScopedSpinLock magazine_lock(magazine.lock);
+        for (size_t i = 0; i < magazine.count; ++i)
+            return_page_to_user_regions(magazine.pages[i]);
+        magazine.count = 0;
+    });
+}
+
+Optional<PhysicalAddress> MemoryManager::take_page_from_magazine()
+{
+    auto& data = get_data();
+    auto& magazine = data.m_user_page_magazine;
+    ScopedSpinLock lock(magazine.lock);
+    if (!magazine.count)
+        return {};
+    data.m_allocator_statistics.magazine_hits++;
+    return magazine.pages[--magazine.count];
+}
+
+bool MemoryManager::put_page_in_magazine(PhysicalAddress paddr)
+{
+    auto& magazine = get_data().m_user_page_magazine;
+    ScopedSpinLock lock(magazine.lock);
+    if (magazine.count == PhysicalPageMagazine::capacity)
+        return false;
+    magazine.pages[magazine.count++] = paddr;
+    return true;
+}
+
+Optional<PhysicalAddress> MemoryManager::refill_magazine_and_take_page()
+{
+    // Pages only ever move between the regions and the magazines while
+    // holding s_mm_lock, so whoever holds it sees every free page.
+    ScopedSpinLock lock(s_mm_lock);
+    auto& data = get_data();
+    auto& magazine = data.m_user_page_magazine;
+    ScopedSpinLock magazine_lock(magazine.lock);
+    if (!magazine.count) {
+        magazine.count = take_pages_from_user_regions(magazine.pages, PhysicalPageMagazine::batch_size);
+        if (!magazine.count) {
+            // The pages we've accounted for may be sitting in other processors' magazines.
+            magazine_lock.unlock();
+            drain_magazines();
+            magazine_lock.lock();
+            magazine.count = take_pages_from_user_regions(magazine.pages, PhysicalPageMagazine::batch_size);
+            if (!magazine.count)
+                return {};
+        }
+        data.m_allocator_statistics.magazine_refills++;
+    }
+    return magazine.pages[--magazine.count];
+}
+
+void MemoryManager::deallocate_user_physical_page(const PhysicalPage& page)
+{
+    auto start_cycles = read_tsc();
+    if (!put_page_in_magazine(page.paddr())) {
+        ScopedSpinLock lock(s_mm_lock);
+        auto& data = get_data();
+        auto& magazine = data.m_user_page_magazine;
+        ScopedSpinLock magazine_lock(magazine.lock);
+        if (magazine.count == PhysicalPageMagazine::capacity) {
+            // Hand the oldest pages back to the regions, keeping the recently freed (and cache-hot) ones.
+            constexpr size_t flush_count = PhysicalPageMagazine::batch_size;
+            for (size_t i = 0; i < flush_count; ++i)
+                return_page_to_user_regions(magazine.pages[i]);
+            for (size_t i = flush_count; i < magazine.count; ++i)
+                magazine.pages[i - flush_count] = magazine.pages[i];
+            magazine.count -= flush_count;
+            data.m_allocator_statistics.magazine_flushes++;
+        }
+        magazine.pages[magazine.count++] = page.paddr();
+    }
+
+    --m_user_physical_pages_used;
+
+    // Always return pages to the uncommitted pool. Pages that were
+    // committed and allocated are only freed upon request. Once
+    // returned there is no guarantee being able to get them back.
+    // This must only happen once the page can actually be found again.
+    ++m_user_physical_pages_uncommitted;
+
+    get_data().m_allocator_statistics.free_latency.record(start_cycles);
+}
+
 RefPtr<PhysicalPage> MemoryManager::find_free_user_physical_page(bool committed)
 {
-    VERIFY(s_mm_lock.is_locked());
-    RefPtr<PhysicalPage> page;
     if (committed) {
         // Draw from the committed pages pool. We should always have these pages available
-        VERIFY(m_user_physical_pages_committed > 0);
-        m_user_physical_pages_committed--;
+        auto previously_committed = m_user_physical_pages_committed.fetch_sub(1);
+        VERIFY(previously_committed > 0);
     } else {
         // We need to make sure we don't touch pages that we have committed to
-        if (m_user_physical_pages_uncommitted == 0)
-            return {};
-        m_user_physical_pages_uncommitted--;
-    }
-    for (auto& region : m_user_physical_regions) {
-        page = region.take_free_page(false);
-        if (!page.is_null()) {
-            ++m_user_physical_pages_used;
-            break;
-        }
+        auto uncommitted = m_user_physical_pages_uncommitted.load();
+        do {
+            if (uncommitted == 0) {
+                notify_if_under_memory_pressure();
+                return {};
+            }
+        } while (!m_user_physical_pages_uncommitted.compare_exchange_strong(uncommitted, uncommitted - 1));
+        notify_if_under_memory_pressure();
     }
-    VERIFY(!committed || !page.is_null());
-    return page;
+
+    auto paddr = take_page_from_magazine();
+    if (!paddr.has_value())
+        paddr = refill_magazine_and_take_page();
+    VERIFY(paddr.has_value());
+
+    ++m_user_physical_pages_used;
+    return PhysicalPage::create(paddr.value(), false);
 }
 
 NonnullRefPtr<PhysicalPage> MemoryManager::allocate_committed_user_physical_page(ShouldZeroFill should_zero_fill)
 {
-    ScopedSpinLock lock(s_mm_lock);
+    auto start_cycles = read_tsc();
     auto page = find_free_user_physical_page(true);
     if (should_zero_fill == ShouldZeroFill::Yes) {
+        InterruptDisabler disabler;
         auto* ptr = quickmap_page(*page);
         memset(ptr, 0, PAGE_SIZE);
         unquickmap_page();
     }
+    get_data().m_allocator_statistics.allocate_latency.record(start_cycles);
     return page.release_nonnull();
 }
 
+NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_committed_contiguous_user_physical_pages(size_t page_count, size_t physical_alignment)
+{
+    auto start_cycles = read_tsc();
+    NonnullRefPtrVector<PhysicalPage> physical_pages;
+    {
+        ScopedSpinLock lock(s_mm_lock);
+        auto try_regions = [&] {
+            for (auto& region : m_user_physical_regions) {
+                physical_pages = region.take_contiguous_free_pages(page_count, false, physical_alignment);
+                if (!physical_pages.is_empty())
+                    return;
+            }
+        };
+        try_regions();
+        if (physical_pages.is_empty()) {
+            // Pages sitting in the magazines may be what keeps a block from coalescing.
+            drain_magazines();
+            try_regions();
+        }
+    }
+
+    // Callers fall back to allocating single pages, so running out of large blocks is fine.
+    if (physical_pages.is_empty())
+        return {};
+
+    auto previously_committed = m_user_physical_pages_committed.fetch_sub(page_count);
+    VERIFY(previously_committed >= page_count);
+    m_user_physical_pages_used += page_count;
+
+    for (auto& page : physical_pages) {
+        InterruptDisabler disabler;
+        auto* ptr = quickmap_page(page);
+        memset(ptr, 0, PAGE_SIZE);
+        unquickmap_page();
+    }
+    get_data().m_allocator_statistics.contiguous_allocate_latency.record(start_cycles);
+    return physical_pages;
+}
+
 RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill should_zero_fill, bool* did_purge)
 {
-    ScopedSpinLock lock(s_mm_lock);
+    auto start_cycles = read_tsc();
     auto page = find_free_user_physical_page(false);
     bool purged_pages = false;
 
     if (!page) {
+        ScopedSpinLock lock(s_mm_lock);
         // We didn't have a single free physical page. Let's try to free something up!
         // First, we look for a purgeable VMObject in the volatile state.
         for_each_vmobject([&](auto& vmobject) {
@@ -659,6 +965,7 @@ RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill s
     }
 
     if (should_zero_fill == ShouldZeroFill::Yes) {
+        InterruptDisabler disabler;
         auto* ptr = quickmap_page(*page);
         memset(ptr, 0, PAGE_SIZE);
         unquickmap_page();
@@ -666,6 +973,7 @@ RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill s
 
     if (did_purge)
         *did_purge = purged_pages;
+    get_data().m_allocator_statistics.allocate_latency.record(start_cycles);
     return page;
 }
 
@@ -690,6 +998,7 @@ void MemoryManager::deallocate_supervisor_physical_page(const PhysicalPage& page
 NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_contiguous_supervisor_physical_pages(size_t size, size_t physical_alignment)
 {
     VERIFY(!(size % PAGE_SIZE));
+    auto start_cycles = read_tsc();
     ScopedSpinLock lock(s_mm_lock);
     size_t count = ceil_div(size, static_cast<size_t>(PAGE_SIZE));
     NonnullRefPtrVector<PhysicalPage> physical_pages;
@@ -697,7 +1006,7 @@ NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_contiguous_supervisor_
     for (auto& region : m_super_physical_regions) {
         physical_pages = region.take_contiguous_free_pages(count, true, physical_alignment);
         if (!physical_pages.is_empty())
-            continue;
+            break;
     }
 
     if (physical_pages.is_empty()) {
@@ -713,6 +1022,7 @@ NonnullRefPtrVector<PhysicalPage> MemoryManager::allocate_contiguous_supervisor_
     auto cleanup_region = MM.allocate_kernel_region(physical_pages[0].paddr(), PAGE_SIZE * count, "MemoryManager Allocation Sanitization", Region::Access::Read | Region::Access::Write);
     fast_u32_fill((u32*)cleanup_region->vaddr().as_ptr(), 0, (PAGE_SIZE * count) / sizeof(u32));
     m_super_physical_pages_used += count;
+    get_data().m_allocator_statistics.contiguous_allocate_latency.record(start_cycles);
     return physical_pages;
 }
 
@@ -769,6 +1079,30 @@ void MemoryManager::flush_tlb(const PageDirectory* page_directory, VirtualAddres
 
 extern "C" PageTableEntry boot_pd3_pt1023[1024];
 
+// Each processor gets two slots right after the global quickmap slots to map
+// a page directory and a page table without holding s_mm_lock.
+static constexpr u32 local_page_table_quickmap_base = 0x100;
+
+u8* MemoryManager::quickmap_page_table_local(PhysicalAddress paddr, size_t slot)
+{
+    VERIFY_INTERRUPTS_DISABLED();
+    VERIFY(slot < 2);
+    u32 pte_idx = local_page_table_quickmap_base + Processor::id() * 2 + slot;
+    VERIFY(pte_idx < 0x200);
+    VirtualAddress vaddr(0xffe00000 + pte_idx * PAGE_SIZE);
+
+    auto& pte = boot_pd3_pt1023[pte_idx];
+    if (pte.physical_page_base() != paddr.as_ptr()) {
+        pte.set_physical_page_base(paddr.get());
+        pte.set_present(true);
+        pte.set_writable(true);
+        pte.set_user_allowed(false);
+        // Nobody else ever uses this slot, so a local flush is all we need.
+        flush_tlb_local(vaddr);
+    }
+    return vaddr.as_ptr();
+}
+
 PageDirectoryEntry* MemoryManager::quickmap_pd(PageDirectory& directory, size_t pdpt_index)
 {
     VERIFY(s_mm_lock.own_lock());
@@ -825,8 +1159,8 @@ u8* MemoryManager::quickmap_page(PhysicalPage& physical_page)
     VERIFY_INTERRUPTS_DISABLED();
     auto& mm_data = get_data();
     mm_data.m_quickmap_prev_flags = mm_data.m_quickmap_in_use.lock();
-    ScopedSpinLock lock(s_mm_lock);
 
+    // Each processor has its own quickmap slot, so holding m_quickmap_in_use is enough.
     u32 pte_idx = 8 + Processor::id();
     VirtualAddress vaddr(0xffe00000 + pte_idx * PAGE_SIZE);
 
@@ -844,7 +1178,6 @@ u8* MemoryManager::quickmap_page(PhysicalPage& physical_page)
 void MemoryManager::unquickmap_page()
 {
     VERIFY_INTERRUPTS_DISABLED();
-    ScopedSpinLock lock(s_mm_lock);
     auto& mm_data = get_data();
     VERIFY(mm_data.m_quickmap_in_use.is_locked());
     u32 pte_idx = 8 + Processor::id();
@@ -57,6 +57,10 @@ constexpr FlatPtr page_round_down(FlatPtr x)
     return ((FlatPtr)(x)) & ~(PAGE_SIZE - 1);
 }
 
+// With PAE, a page directory entry can map 2 MiB directly instead of pointing to a page table.
+constexpr size_t large_page_size = 2 * MiB;
+constexpr size_t pages_per_large_page = large_page_size / PAGE_SIZE;
+
 inline FlatPtr low_physical_to_virtual(FlatPtr physical)
 {
     return physical + 0xc0000000;
@@ -107,12 +111,47 @@ struct PhysicalMemoryRange {
 
 #define MM Kernel::MemoryManager::the()
 
+// A small per-CPU stash of free user pages. Allocating or freeing a page
+// only touches the local magazine, and only falls back to the physical
+// regions (and s_mm_lock) when the magazine runs empty or overflows.
+struct PhysicalPageMagazine {
+    static constexpr size_t capacity = 64;
+    static constexpr size_t batch_size = capacity / 2;
+
+    // Pages move between a magazine and the regions only while holding
+    // s_mm_lock, which must be taken before this one.
+    SpinLock<u8> lock;
+    size_t count { 0 };
+    PhysicalAddress pages[capacity];
+};
+
+// Log2 histogram of physical page allocator latencies, in TSC cycles.
+struct PhysicalAllocatorLatencyHistogram {
+    static constexpr size_t bucket_count = 24;
+
+    void record(u64 start_cycles);
+
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> buckets[bucket_count] {};
+};
+
+struct PhysicalAllocatorStatistics {
+    PhysicalAllocatorLatencyHistogram allocate_latency;
+    PhysicalAllocatorLatencyHistogram free_latency;
+    PhysicalAllocatorLatencyHistogram contiguous_allocate_latency;
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> magazine_hits { 0 };
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> magazine_refills { 0 };
+    Atomic<u32, AK::MemoryOrder::memory_order_relaxed> magazine_flushes { 0 };
+};
+
 struct MemoryManagerData {
     SpinLock<u8> m_quickmap_in_use;
     u32 m_quickmap_prev_flags;
 
     PhysicalAddress m_last_quickmap_pd;
     PhysicalAddress m_last_quickmap_pt;
+
+    PhysicalPageMagazine m_user_page_magazine;
+    PhysicalAllocatorStatistics m_allocator_statistics;
 };
 
 extern RecursiveSpinLock s_mm_lock;
@@ -125,6 +164,7 @@ class MemoryManager {
     friend class AnonymousVMObject;
     friend class Region;
     friend class VMObject;
+    friend class SharedInodeVMObject;
 
 public:
     static MemoryManager& the();
@@ -157,6 +197,7 @@ public:
     bool commit_user_physical_pages(size_t);
     void uncommit_user_physical_pages(size_t);
     NonnullRefPtr<PhysicalPage> allocate_committed_user_physical_page(ShouldZeroFill = ShouldZeroFill::Yes);
+    NonnullRefPtrVector<PhysicalPage> allocate_committed_contiguous_user_physical_pages(size_t page_count, size_t physical_alignment);
     RefPtr<PhysicalPage> allocate_user_physical_page(ShouldZeroFill = ShouldZeroFill::Yes, bool* did_purge = nullptr);
     RefPtr<PhysicalPage> allocate_supervisor_physical_page();
     NonnullRefPtrVector<PhysicalPage> allocate_contiguous_supervisor_physical_pages(size_t size, size_t physical_alignment = PAGE_SIZE);
@@ -177,6 +218,29 @@ public:
     unsigned super_physical_pages() const { return m_super_physical_pages; }
     unsigned super_physical_pages_used() const { return m_super_physical_pages_used; }
 
+    // Less than an eighth of user physical memory is left uncommitted.
+    bool is_under_memory_pressure() const { return m_user_physical_pages_uncommitted < m_user_physical_pages / 8; }
+
+    // Blocks until the physical page allocator runs short, so that the caller can give memory back.
+    void wait_for_memory_pressure();
+
+    template<typename Callback>
+    void for_each_user_physical_region(Callback callback) const
+    {
+        for (auto& region : m_user_physical_regions)
+            callback(region);
+    }
+
+    template<typename Callback>
+    static void for_each_processor_data(Callback callback)
+    {
+        Processor::for_each([&](Processor& processor) {
+            if (processor.has_mm_data())
+                callback(processor.get_mm_data());
+            return IterationDecision::Continue;
+        });
+    }
+
     template<typename Callback>
     static void for_each_vmobject(Callback callback)
     {
@@ -220,15 +284,27 @@ private:
     static Region* find_region_from_vaddr(VirtualAddress);
 
     RefPtr<PhysicalPage> find_free_user_physical_page(bool);
+    Optional<PhysicalAddress> take_page_from_magazine();
+    Optional<PhysicalAddress> refill_magazine_and_take_page();
+    bool put_page_in_magazine(PhysicalAddress);
+    size_t take_pages_from_user_regions(PhysicalAddress*, size_t);
+    void return_page_to_user_regions(PhysicalAddress);
+    void drain_magazines();
+    void notify_if_under_memory_pressure();
     u8* quickmap_page(PhysicalPage&);
     void unquickmap_page();
 
     PageDirectoryEntry* quickmap_pd(PageDirectory&, size_t pdpt_index);
     PageTableEntry* quickmap_pt(PhysicalAddress);
 
+    u8* quickmap_page_table_local(PhysicalAddress, size_t slot);
+
     PageTableEntry* pte(PageDirectory&, VirtualAddress);
+    PageTableEntry* existing_pte(PageDirectory&, VirtualAddress);
     PageTableEntry* ensure_pte(PageDirectory&, VirtualAddress);
     void release_pte(PageDirectory&, VirtualAddress, bool);
+    PageDirectoryEntry* ensure_large_page_pde(PageDirectory&, VirtualAddress);
+    bool split_large_page(PageDirectory&, VirtualAddress);
 
     RefPtr<PageDirectory> m_kernel_page_directory;
 
@@ -242,6 +318,9 @@ private:
     Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_super_physical_pages { 0 };
     Atomic<unsigned, AK::MemoryOrder::memory_order_relaxed> m_super_physical_pages_used { 0 };
 
+    WaitQueue* m_memory_pressure_wait_queue { nullptr };
+    Atomic<bool> m_memory_pressure_pending { false };
+
     NonnullRefPtrVector<PhysicalRegion> m_user_physical_regions;
     NonnullRefPtrVector<PhysicalRegion> m_super_physical_regions;
 
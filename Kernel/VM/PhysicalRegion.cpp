@@ -24,17 +24,29 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <AK/Bitmap.h>
 #include <AK/NonnullRefPtr.h>
 #include <AK/RefPtr.h>
 #include <AK/Vector.h>
 #include <Kernel/Assertions.h>
-#include <Kernel/Random.h>
 #include <Kernel/VM/PhysicalPage.h>
 #include <Kernel/VM/PhysicalRegion.h>
 
 namespace Kernel {
 
+static u8 chunk_value(u8 used_bits)
+{
+    // Find the largest naturally aligned run of free pages within the chunk.
+    for (size_t order = 3; order > 0; --order) {
+        size_t run = 1 << order;
+        u8 mask = (1 << run) - 1;
+        for (size_t offset = 0; offset < 8; offset += run) {
+            if (!(used_bits & (mask << offset)))
+                return order + 1;
+        }
+    }
+    return used_bits != 0xff ? 1 : 0;
+}
+
 NonnullRefPtr<PhysicalRegion> PhysicalRegion::create(PhysicalAddress lower, PhysicalAddress upper)
 {
     return adopt(*new PhysicalRegion(lower, upper));
@@ -59,133 +71,180 @@ unsigned PhysicalRegion::finalize_capacity()
     VERIFY(!m_pages);
 
     m_pages = (m_upper.get() - m_lower.get()) / PAGE_SIZE;
-    m_bitmap.grow(m_pages, false);
 
-    return size();
-}
+    constexpr FlatPtr max_aligned_block_size = PAGE_SIZE << max_aligned_order;
+    m_base = PhysicalAddress(m_lower.get() & ~(max_aligned_block_size - 1));
+    auto first_page = (m_lower.get() - m_base.get()) / PAGE_SIZE;
+    auto total_chunks = ceil_div(first_page + m_pages, pages_per_chunk);
 
-NonnullRefPtrVector<PhysicalPage> PhysicalRegion::take_contiguous_free_pages(size_t count, bool supervisor, size_t physical_alignment)
-{
-    VERIFY(m_pages);
-    VERIFY(m_used != m_pages);
+    m_chunk_count = 1;
+    while (m_chunk_count < total_chunks) {
+        m_chunk_count *= 2;
+        m_tree_height++;
+    }
 
-    NonnullRefPtrVector<PhysicalPage> physical_pages;
-    physical_pages.ensure_capacity(count);
+    m_chunk_bitmaps.resize(m_chunk_count);
+    m_tree.resize(m_chunk_count * 2);
+    for (auto& bits : m_chunk_bitmaps)
+        bits = 0xff;
+    set_pages_used(first_page, m_pages, false);
+    update_tree(0, m_chunk_count * pages_per_chunk);
 
-    auto first_contiguous_page = find_contiguous_free_pages(count, physical_alignment);
+    return size();
+}
 
-    for (size_t index = 0; index < count; index++)
-        physical_pages.append(PhysicalPage::create(m_lower.offset(PAGE_SIZE * (index + first_contiguous_page)), supervisor));
-    return physical_pages;
+u8 PhysicalRegion::node_value(size_t node, size_t height) const
+{
+    if (height == 0)
+        return chunk_value(m_chunk_bitmaps[node - m_chunk_count]);
+
+    u8 left = m_tree[node * 2];
+    u8 right = m_tree[node * 2 + 1];
+    // Two free buddies form one free block of twice their size.
+    u8 child_fully_free = height - 1 + chunk_order + 1;
+    if (left == child_fully_free && right == child_fully_free)
+        return child_fully_free + 1;
+    return max(left, right);
 }
 
-unsigned PhysicalRegion::find_contiguous_free_pages(size_t count, size_t physical_alignment)
+void PhysicalRegion::set_pages_used(size_t first_page, size_t count, bool used)
 {
-    VERIFY(count != 0);
-    VERIFY(physical_alignment % PAGE_SIZE == 0);
-    // search from the last page we allocated
-    auto range = find_and_allocate_contiguous_range(count, physical_alignment / PAGE_SIZE);
-    VERIFY(range.has_value());
-    return range.value();
+    for (size_t page = first_page; page < first_page + count; ++page) {
+        auto& bits = m_chunk_bitmaps[page / pages_per_chunk];
+        u8 bit = 1 << (page % pages_per_chunk);
+        VERIFY(!!(bits & bit) != used);
+        if (used)
+            bits |= bit;
+        else
+            bits &= ~bit;
+    }
 }
 
-Optional<unsigned> PhysicalRegion::find_one_free_page()
+void PhysicalRegion::update_tree(size_t first_page, size_t count)
 {
-    if (m_used == m_pages) {
-        // We know we don't have any free pages, no need to check the bitmap
-        // Check if we can draw one from the return queue
-        if (m_recently_returned.size() > 0) {
-            u8 index = get_fast_random<u8>() % m_recently_returned.size();
-            Checked<FlatPtr> local_offset = m_recently_returned[index].get();
-            local_offset -= m_lower.get();
-            m_recently_returned.remove(index);
-            VERIFY(!local_offset.has_overflow());
-            VERIFY(local_offset.value() < (FlatPtr)(m_pages * PAGE_SIZE));
-            return local_offset.value() / PAGE_SIZE;
-        }
-        return {};
+    VERIFY(count);
+    size_t first_node = m_chunk_count + first_page / pages_per_chunk;
+    size_t last_node = m_chunk_count + (first_page + count - 1) / pages_per_chunk;
+    for (size_t height = 0;; ++height) {
+        for (size_t node = first_node; node <= last_node; ++node)
+            m_tree[node] = node_value(node, height);
+        if (height == m_tree_height)
+            break;
+        first_node /= 2;
+        last_node /= 2;
     }
-    auto free_index = m_bitmap.find_one_anywhere_unset(m_free_hint);
-    if (!free_index.has_value())
-        return {};
+}
 
-    auto page_index = free_index.value();
-    m_bitmap.set(page_index, true);
-    m_used++;
-    m_free_hint = free_index.value() + 1; // Just a guess
-    if (m_free_hint >= m_bitmap.size())
-        m_free_hint = 0;
-    return page_index;
+size_t PhysicalRegion::largest_free_block() const
+{
+    if (!m_tree[1])
+        return 0;
+    return 1 << (m_tree[1] - 1);
 }
 
-Optional<unsigned> PhysicalRegion::find_and_allocate_contiguous_range(size_t count, unsigned alignment)
+Optional<size_t> PhysicalRegion::allocate_block(size_t order)
 {
-    VERIFY(count != 0);
-    size_t found_pages_count = 0;
-    // TODO: Improve how we deal with alignment != 1
-    auto first_index = m_bitmap.find_longest_range_of_unset_bits(count + alignment - 1, found_pages_count);
-    if (!first_index.has_value())
+    u8 wanted = order + 1;
+    if (m_tree[1] < wanted)
         return {};
 
-    auto page = first_index.value();
-    if (alignment != 1) {
-        auto lower_page = m_lower.get() / PAGE_SIZE;
-        page = ((lower_page + page + alignment - 1) & ~(alignment - 1)) - lower_page;
+    // Walk down to a node the size of the block we want, or to a chunk if the
+    // block is smaller than that. Where both children would do, pick the one
+    // with the smaller free block so that larger blocks stay intact.
+    size_t node = 1;
+    size_t height = m_tree_height;
+    while (height > 0 && height + chunk_order > order) {
+        size_t left = node * 2;
+        size_t right = left + 1;
+        if (m_tree[left] >= wanted && (m_tree[right] < wanted || m_tree[left] <= m_tree[right]))
+            node = left;
+        else
+            node = right;
+        --height;
     }
-    if (found_pages_count >= count) {
-        m_bitmap.set_range<true>(page, count);
-        m_used += count;
-        m_free_hint = first_index.value() + count + 1; // Just a guess
-        if (m_free_hint >= m_bitmap.size())
-            m_free_hint = 0;
-        return page;
+
+    size_t first_page = ((node << height) - m_chunk_count) * pages_per_chunk;
+    size_t count = 1 << order;
+    if (order < chunk_order) {
+        u8 bits = m_chunk_bitmaps[node - m_chunk_count];
+        u8 mask = (1 << count) - 1;
+        size_t offset = 0;
+        while (bits & (mask << offset)) {
+            offset += count;
+            VERIFY(offset < pages_per_chunk);
+        }
+        first_page += offset;
     }
-    return {};
+
+    set_pages_used(first_page, count, true);
+    update_tree(first_page, count);
+    return first_page;
 }
 
-RefPtr<PhysicalPage> PhysicalRegion::take_free_page(bool supervisor)
+Optional<PhysicalAddress> PhysicalRegion::take_free_page_address()
 {
     VERIFY(m_pages);
 
-    auto free_index = find_one_free_page();
-    if (!free_index.has_value())
+    auto page = allocate_block(0);
+    if (!page.has_value())
+        return {};
+
+    m_used++;
+    return m_base.offset(page.value() * PAGE_SIZE);
+}
+
+RefPtr<PhysicalPage> PhysicalRegion::take_free_page(bool supervisor)
+{
+    auto paddr = take_free_page_address();
+    if (!paddr.has_value())
         return nullptr;
 
-    return PhysicalPage::create(m_lower.offset(free_index.value() * PAGE_SIZE), supervisor);
+    return PhysicalPage::create(paddr.value(), supervisor);
 }
 
-void PhysicalRegion::free_page_at(PhysicalAddress addr)
+NonnullRefPtrVector<PhysicalPage> PhysicalRegion::take_contiguous_free_pages(size_t count, bool supervisor, size_t physical_alignment)
 {
     VERIFY(m_pages);
+    VERIFY(count != 0);
+    VERIFY(physical_alignment % PAGE_SIZE == 0);
+    VERIFY(physical_alignment <= (PAGE_SIZE << max_aligned_order));
 
-    if (m_used == 0) {
-        VERIFY_NOT_REACHED();
-    }
+    // Buddy blocks are aligned to their size, so a block big enough for both
+    // the size and the alignment satisfies both.
+    size_t wanted_pages = max(count, physical_alignment / PAGE_SIZE);
+    size_t order = 0;
+    while ((1u << order) < wanted_pages)
+        ++order;
 
-    Checked<FlatPtr> local_offset = addr.get();
-    local_offset -= m_lower.get();
-    VERIFY(!local_offset.has_overflow());
-    VERIFY(local_offset.value() < (FlatPtr)(m_pages * PAGE_SIZE));
+    auto first_page = allocate_block(order);
+    if (!first_page.has_value())
+        return {};
 
-    auto page = local_offset.value() / PAGE_SIZE;
-    m_bitmap.set(page, false);
-    m_free_hint = page; // We know we can find one here for sure
-    m_used--;
+    // Give back the tail of the block that we don't need.
+    size_t block_pages = 1 << order;
+    if (count < block_pages) {
+        set_pages_used(first_page.value() + count, block_pages - count, false);
+        update_tree(first_page.value() + count, block_pages - count);
+    }
+    m_used += count;
+
+    NonnullRefPtrVector<PhysicalPage> physical_pages;
+    physical_pages.ensure_capacity(count);
+    for (size_t index = 0; index < count; index++)
+        physical_pages.append(PhysicalPage::create(m_base.offset(PAGE_SIZE * (first_page.value() + index)), supervisor));
+    return physical_pages;
 }
 
-void PhysicalRegion::return_page(const PhysicalPage& page)
+void PhysicalRegion::return_page_at(PhysicalAddress paddr)
 {
-    auto returned_count = m_recently_returned.size();
-    if (returned_count >= m_recently_returned.capacity()) {
-        // Return queue is full, pick a random entry and free that page
-        // and replace the entry with this page
-        auto& entry = m_recently_returned[get_fast_random<u8>()];
-        free_page_at(entry);
-        entry = page.paddr();
-    } else {
-        // Still filling the return queue, just append it
-        m_recently_returned.append(page.paddr());
-    }
+    VERIFY(m_pages);
+    VERIFY(m_used);
+    VERIFY(contains(paddr));
+
+    auto page = (paddr.get() - m_base.get()) / PAGE_SIZE;
+    set_pages_used(page, 1, false);
+    update_tree(page, 1);
+    m_used--;
 }
 
 }
@@ -26,18 +26,28 @@
 
 #pragma once
 
-#include <AK/Bitmap.h>
 #include <AK/NonnullRefPtrVector.h>
 #include <AK/Optional.h>
 #include <AK/RefCounted.h>
+#include <AK/Vector.h>
 #include <Kernel/VM/PhysicalPage.h>
 
 namespace Kernel {
 
+// A binary buddy allocator for a contiguous range of physical pages.
+//
+// The pages are grouped into chunks of 8, whose allocation state lives in a
+// byte-sized bitmap each. On top of the chunks sits a complete binary tree in
+// which every node records the largest free block in its subtree, so blocks
+// of any power-of-two size are found and released in O(log n) while using
+// less than a byte of bookkeeping per page.
 class PhysicalRegion : public RefCounted<PhysicalRegion> {
     AK_MAKE_ETERNAL
 
 public:
+    // Blocks of up to 2^max_aligned_order pages are naturally aligned in physical memory.
+    static constexpr size_t max_aligned_order = 10;
+
     static NonnullRefPtr<PhysicalRegion> create(PhysicalAddress lower, PhysicalAddress upper);
     ~PhysicalRegion() = default;
 
@@ -47,19 +57,26 @@ public:
     PhysicalAddress lower() const { return m_lower; }
     PhysicalAddress upper() const { return m_upper; }
     unsigned size() const { return m_pages; }
-    unsigned used() const { return m_used - m_recently_returned.size(); }
-    unsigned free() const { return m_pages - m_used + m_recently_returned.size(); }
-    bool contains(const PhysicalPage& page) const { return page.paddr() >= m_lower && page.paddr() <= m_upper; }
+    unsigned used() const { return m_used; }
+    unsigned free() const { return m_pages - m_used; }
+    size_t largest_free_block() const;
+    bool contains(const PhysicalPage& page) const { return contains(page.paddr()); }
+    bool contains(PhysicalAddress paddr) const { return paddr >= m_lower && paddr < m_lower.offset(m_pages * PAGE_SIZE); }
 
+    Optional<PhysicalAddress> take_free_page_address();
     RefPtr<PhysicalPage> take_free_page(bool supervisor);
     NonnullRefPtrVector<PhysicalPage> take_contiguous_free_pages(size_t count, bool supervisor, size_t physical_alignment = PAGE_SIZE);
-    void return_page(const PhysicalPage& page);
+    void return_page(const PhysicalPage& page) { return_page_at(page.paddr()); }
+    void return_page_at(PhysicalAddress);
 
 private:
-    unsigned find_contiguous_free_pages(size_t count, size_t physical_alignment = PAGE_SIZE);
-    Optional<unsigned> find_and_allocate_contiguous_range(size_t count, unsigned alignment = 1);
-    Optional<unsigned> find_one_free_page();
-    void free_page_at(PhysicalAddress addr);
+    static constexpr size_t chunk_order = 3;
+    static constexpr size_t pages_per_chunk = 1 << chunk_order;
+
+    Optional<size_t> allocate_block(size_t order);
+    void set_pages_used(size_t first_page, size_t count, bool used);
+    void update_tree(size_t first_page, size_t count);
+    u8 node_value(size_t node, size_t height) const;
 
     PhysicalRegion(PhysicalAddress lower, PhysicalAddress upper);
 
@@ -67,9 +84,17 @@ private:
     PhysicalAddress m_upper;
     unsigned m_pages { 0 };
     unsigned m_used { 0 };
-    Bitmap m_bitmap;
-    size_t m_free_hint { 0 };
-    Vector<PhysicalAddress, 256> m_recently_returned;
+
+    // Page indices are relative to m_base, which is m_lower rounded down to a
+    // max_aligned_order boundary. Pages outside the region are marked as used.
+    PhysicalAddress m_base;
+    size_t m_chunk_count { 0 };
+    size_t m_tree_height { 0 };
+    // One bit per page, set if the page is in use.
+    Vector<u8> m_chunk_bitmaps;
+    // Heap-ordered tree with the chunks as leaves. Each node holds 1 + the order
+    // of the largest free block below it, or 0 if nothing below it is free.
+    Vector<u8> m_tree;
 };
 
 }
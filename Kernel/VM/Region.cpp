@@ -24,12 +24,14 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <AK/ByteBuffer.h>
 #include <AK/Memory.h>
 #include <AK/StringView.h>
 #include <Kernel/Debug.h>
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/Panic.h>
 #include <Kernel/Process.h>
+#include <Kernel/Scheduler.h>
 #include <Kernel/Thread.h>
 #include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
@@ -60,6 +62,14 @@ Region::Region(const Range& range, NonnullRefPtr<VMObject> vmobject, size_t offs
 
 Region::~Region()
 {
+    // A fault handler may still be working on this region after it was removed from its Space.
+    while (m_in_flight_faults.load(AK::MemoryOrder::memory_order_acquire) != 0) {
+        if (Processor::current().in_critical())
+            Processor::wait_check();
+        else
+            Scheduler::yield();
+    }
+
     m_vmobject->unref_region();
     unregister_purgeable_page_ranges();
 
@@ -241,6 +251,14 @@ NonnullOwnPtr<Region> Region::create_kernel_only(const Range& range, NonnullRefP
     return adopt_own(*new Region(range, move(vmobject), offset_in_vmobject, move(name), access, cacheable, false));
 }
 
+bool Region::should_track_writes(size_t page_index) const
+{
+    // Shared file mappings stay read-only until written to, so we know which pages to write back.
+    if (!m_shared || !vmobject().is_shared_inode())
+        return false;
+    return !static_cast<const SharedInodeVMObject&>(vmobject()).is_page_dirty(translate_to_vmobject_page(page_index));
+}
+
 bool Region::should_cow(size_t page_index) const
 {
     if (!vmobject().is_anonymous())
@@ -255,6 +273,27 @@ void Region::set_should_cow(size_t page_index, bool cow)
         static_cast<AnonymousVMObject&>(vmobject()).set_should_cow(first_page_index() + page_index, cow);
 }
 
+void Region::update_pte(PageTableEntry& pte, size_t page_index)
+{
+    auto page_vaddr = vaddr_from_page_index(page_index);
+    bool user_allowed = page_vaddr.get() >= 0x00800000 && is_user_address(page_vaddr);
+    auto* page = physical_page(page_index);
+    if (!page || (!is_readable() && !is_writable())) {
+        pte.clear();
+    } else {
+        pte.set_cache_disabled(!m_cacheable);
+        pte.set_physical_page_base(page->paddr().get());
+        pte.set_present(true);
+        if (page->is_shared_zero_page() || page->is_lazy_committed_page() || should_cow(page_index) || should_track_writes(page_index))
+            pte.set_writable(false);
+        else
+            pte.set_writable(is_writable());
+        if (Processor::current().has_feature(CPUFeature::NX))
+            pte.set_execute_disabled(!is_executable());
+        pte.set_user_allowed(user_allowed);
+    }
+}
+
 bool Region::map_individual_page_impl(size_t page_index)
 {
     VERIFY(m_page_directory->get_lock().own_lock());
@@ -268,24 +307,83 @@ bool Region::map_individual_page_impl(size_t page_index)
     auto* pte = MM.ensure_pte(*m_page_directory, page_vaddr);
     if (!pte)
         return false;
-    auto* page = physical_page(page_index);
-    if (!page || (!is_readable() && !is_writable())) {
-        pte->clear();
-    } else {
-        pte->set_cache_disabled(!m_cacheable);
-        pte->set_physical_page_base(page->paddr().get());
-        pte->set_present(true);
-        if (page->is_shared_zero_page() || page->is_lazy_committed_page() || should_cow(page_index))
-            pte->set_writable(false);
-        else
-            pte->set_writable(is_writable());
-        if (Processor::current().has_feature(CPUFeature::NX))
-            pte->set_execute_disabled(!is_executable());
-        pte->set_user_allowed(user_allowed);
+    update_pte(*pte, page_index);
+    return true;
+}
+
+bool Region::can_map_large_page(size_t page_index) const
+{
+    if (!vmobject().may_use_large_pages())
+        return false;
+    if (vaddr_from_page_index(page_index).get() % large_page_size || page_count() - page_index < pages_per_large_page)
+        return false;
+    if (!is_readable() && !is_writable())
+        return false;
+
+    // All the pages must be there, writable if the region is, and form one aligned physical block.
+    auto* first_page = physical_page(page_index);
+    if (!first_page || first_page->paddr().get() % large_page_size)
+        return false;
+    for (size_t i = 0; i < pages_per_large_page; ++i) {
+        auto* page = physical_page(page_index + i);
+        if (!page || page->paddr() != first_page->paddr().offset(i * PAGE_SIZE))
+            return false;
+        if (page->is_shared_zero_page() || page->is_lazy_committed_page() || should_cow(page_index + i))
+            return false;
     }
     return true;
 }
 
+void Region::map_large_page_impl(size_t page_index)
+{
+    VERIFY(m_page_directory->get_lock().own_lock());
+    auto page_vaddr = vaddr_from_page_index(page_index);
+    bool user_allowed = page_vaddr.get() >= 0x00800000 && is_user_address(page_vaddr);
+    auto& pde = *MM.ensure_large_page_pde(*m_page_directory, page_vaddr);
+    pde.clear();
+    pde.set_page_table_base(physical_page(page_index)->paddr().get());
+    pde.set_huge(true);
+    pde.set_present(true);
+    pde.set_cache_disabled(!m_cacheable);
+    pde.set_writable(is_writable());
+    if (Processor::current().has_feature(CPUFeature::NX))
+        pde.set_execute_disabled(!is_executable());
+    pde.set_user_allowed(user_allowed);
+    pde.set_global(m_page_directory == &MM.kernel_page_directory());
+}
+
+bool Region::map_page_after_fault(size_t page_index)
+{
+    VERIFY(!s_mm_lock.own_lock());
+    if (vmobject().is_shared_by_multiple_regions())
+        return remap_vmobject_page(translate_to_vmobject_page(page_index));
+
+    // If the page table already exists, this only needs the page directory's
+    // own lock. Unmapping the region clears m_page_directory under that same
+    // lock, so we check again once we're holding it.
+    auto* page_directory = m_page_directory.ptr();
+    if (!page_directory)
+        return true;
+    {
+        ScopedSpinLock page_lock(page_directory->get_lock());
+        if (m_page_directory.ptr() != page_directory)
+            return true;
+        auto page_vaddr = vaddr_from_page_index(page_index);
+        if (auto* pte = MM.existing_pte(*page_directory, page_vaddr)) {
+            bool was_present = pte->is_present();
+            update_pte(*pte, page_index);
+            // The TLB never caches non-present entries, so only a page that
+            // was already mapped needs to be shot down.
+            if (was_present)
+                MM.flush_tlb(page_directory, page_vaddr);
+            return true;
+        }
+    }
+
+    // Allocating a page table changes the page directory, which needs s_mm_lock.
+    return do_remap_vmobject_page(translate_to_vmobject_page(page_index));
+}
+
 bool Region::do_remap_vmobject_page_range(size_t page_index, size_t page_count)
 {
     bool success = true;
@@ -398,6 +496,11 @@ bool Region::map(PageDirectory& page_directory, ShouldFlushTLB should_flush_tlb)
     set_page_directory(page_directory);
     size_t page_index = 0;
     while (page_index < page_count()) {
+        if (can_map_large_page(page_index)) {
+            map_large_page_impl(page_index);
+            page_index += pages_per_large_page;
+            continue;
+        }
         if (!map_individual_page_impl(page_index))
             break;
         ++page_index;
@@ -416,7 +519,7 @@ void Region::remap()
     map(*m_page_directory);
 }
 
-PageFaultResponse Region::handle_fault(const PageFault& fault, ScopedSpinLock<RecursiveSpinLock>& mm_lock)
+PageFaultResponse Region::handle_fault(const PageFault& fault)
 {
     auto page_index_in_region = page_index_from_address(fault.vaddr());
     if (fault.type() == PageFault::Type::PageNotPresent) {
@@ -430,16 +533,12 @@ PageFaultResponse Region::handle_fault(const PageFault& fault, ScopedSpinLock<Re
         }
         if (vmobject().is_inode()) {
             dbgln_if(PAGE_FAULT_DEBUG, "NP(inode) fault in Region({})[{}]", this, page_index_in_region);
-            return handle_inode_fault(page_index_in_region, mm_lock);
+            return handle_inode_fault(page_index_in_region);
         }
 
         auto& page_slot = physical_page_slot(page_index_in_region);
-        if (page_slot->is_lazy_committed_page()) {
-            auto page_index_in_vmobject = translate_to_vmobject_page(page_index_in_region);
-            page_slot = static_cast<AnonymousVMObject&>(*m_vmobject).allocate_committed_page(page_index_in_vmobject);
-            remap_vmobject_page(page_index_in_vmobject);
-            return PageFaultResponse::Continue;
-        }
+        if (page_slot->is_lazy_committed_page())
+            return handle_zero_fault(page_index_in_region);
 #ifdef MAP_SHARED_ZERO_PAGE_LAZILY
         if (fault.is_read()) {
             page_slot = MM.shared_zero_page();
@@ -453,14 +552,27 @@ PageFaultResponse Region::handle_fault(const PageFault& fault, ScopedSpinLock<Re
 #endif
     }
     VERIFY(fault.type() == PageFault::Type::ProtectionViolation);
-    if (fault.access() == PageFault::Access::Write && is_writable() && should_cow(page_index_in_region)) {
-        dbgln_if(PAGE_FAULT_DEBUG, "PV(cow) fault in Region({})[{}] at {}", this, page_index_in_region, fault.vaddr());
+    if (fault.access() == PageFault::Access::Write && is_writable()) {
         auto* phys_page = physical_page(page_index_in_region);
-        if (phys_page->is_shared_zero_page() || phys_page->is_lazy_committed_page()) {
-            dbgln_if(PAGE_FAULT_DEBUG, "NP(zero) fault in Region({})[{}] at {}", this, page_index_in_region, fault.vaddr());
-            return handle_zero_fault(page_index_in_region);
+        if (should_cow(page_index_in_region)) {
+            dbgln_if(PAGE_FAULT_DEBUG, "PV(cow) fault in Region({})[{}] at {}", this, page_index_in_region, fault.vaddr());
+            if (phys_page->is_shared_zero_page() || phys_page->is_lazy_committed_page()) {
+                dbgln_if(PAGE_FAULT_DEBUG, "NP(zero) fault in Region({})[{}] at {}", this, page_index_in_region, fault.vaddr());
+                return handle_zero_fault(page_index_in_region);
+            }
+            return handle_cow_fault(page_index_in_region);
+        }
+        if (phys_page && vmobject().is_shared_inode() && m_shared) {
+            dbgln_if(PAGE_FAULT_DEBUG, "PV(dirty) fault in Region({})[{}] at {}", this, page_index_in_region, fault.vaddr());
+            return handle_inode_write_fault(page_index_in_region);
+        }
+        if (phys_page && !phys_page->is_shared_zero_page() && !phys_page->is_lazy_committed_page() && vmobject().is_anonymous()) {
+            // Another processor resolved this fault while we were on our way here,
+            // and we faulted on a TLB entry that was about to be shot down.
+            dbgln_if(PAGE_FAULT_DEBUG, "PV(stale) fault in Region({})[{}] at {}", this, page_index_in_region, fault.vaddr());
+            Processor::flush_tlb_local(fault.vaddr().page_base(), 1);
+            return PageFaultResponse::Continue;
         }
-        return handle_cow_fault(page_index_in_region);
     }
     dbgln("PV(error) fault in Region({})[{}] at {}", this, page_index_in_region, fault.vaddr());
     return PageFaultResponse::ShouldCrash;
@@ -471,38 +583,52 @@ PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region)
     VERIFY_INTERRUPTS_DISABLED();
     VERIFY(vmobject().is_anonymous());
 
+    // Faults on the same VMObject are serialized by its paging lock; faults
+    // elsewhere proceed in parallel.
     LOCKER(vmobject().m_paging_lock);
 
-    auto& page_slot = physical_page_slot(page_index_in_region);
+    auto& anonymous_vmobject = static_cast<AnonymousVMObject&>(vmobject());
     auto page_index_in_vmobject = translate_to_vmobject_page(page_index_in_region);
 
-    if (!page_slot.is_null() && !page_slot->is_shared_zero_page() && !page_slot->is_lazy_committed_page()) {
-#if PAGE_FAULT_DEBUG
-        dbgln("MM: zero_page() but page already present. Fine with me!");
-#endif
-        if (!remap_vmobject_page(page_index_in_vmobject))
-            return PageFaultResponse::OutOfMemory;
-        return PageFaultResponse::Continue;
+    bool is_lazy_committed;
+    {
+        ScopedSpinLock lock(anonymous_vmobject.m_lock);
+        auto& page_slot = physical_page_slot(page_index_in_region);
+        if (!page_slot.is_null() && !page_slot->is_shared_zero_page() && !page_slot->is_lazy_committed_page()) {
+            lock.unlock();
+            dbgln_if(PAGE_FAULT_DEBUG, "MM: zero_page() but page already present. Fine with me!");
+            if (!map_page_after_fault(page_index_in_region))
+                return PageFaultResponse::OutOfMemory;
+            return PageFaultResponse::Continue;
+        }
+        is_lazy_committed = page_slot->is_lazy_committed_page();
     }
 
     auto current_thread = Thread::current();
     if (current_thread != nullptr)
         current_thread->did_zero_fault();
 
-    if (page_slot->is_lazy_committed_page()) {
-        page_slot = static_cast<AnonymousVMObject&>(*m_vmobject).allocate_committed_page(page_index_in_vmobject);
-        dbgln_if(PAGE_FAULT_DEBUG, "      >> ALLOCATED COMMITTED {}", page_slot->paddr());
+    // Allocate without holding the VMObject's spinlock, as the allocator may need s_mm_lock.
+    RefPtr<PhysicalPage> new_page;
+    if (is_lazy_committed) {
+        new_page = anonymous_vmobject.allocate_committed_page(page_index_in_vmobject);
+        dbgln_if(PAGE_FAULT_DEBUG, "      >> ALLOCATED COMMITTED {}", new_page->paddr());
     } else {
-        page_slot = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::Yes);
-        if (page_slot.is_null()) {
+        new_page = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::Yes);
+        if (new_page.is_null()) {
             dmesgln("MM: handle_zero_fault was unable to allocate a physical page");
             return PageFaultResponse::OutOfMemory;
         }
-        dbgln_if(PAGE_FAULT_DEBUG, "      >> ALLOCATED {}", page_slot->paddr());
+        dbgln_if(PAGE_FAULT_DEBUG, "      >> ALLOCATED {}", new_page->paddr());
+    }
+
+    {
+        ScopedSpinLock lock(anonymous_vmobject.m_lock);
+        physical_page_slot(page_index_in_region) = new_page;
     }
 
-    if (!remap_vmobject_page(page_index_in_vmobject)) {
-        dmesgln("MM: handle_zero_fault was unable to allocate a page table to map {}", page_slot);
+    if (!map_page_after_fault(page_index_in_region)) {
+        dmesgln("MM: handle_zero_fault was unable to allocate a page table to map {}", new_page);
         return PageFaultResponse::OutOfMemory;
     }
     return PageFaultResponse::Continue;
@@ -520,83 +646,218 @@ PageFaultResponse Region::handle_cow_fault(size_t page_index_in_region)
 
     auto page_index_in_vmobject = translate_to_vmobject_page(page_index_in_region);
     auto response = reinterpret_cast<AnonymousVMObject&>(vmobject()).handle_cow_fault(page_index_in_vmobject, vaddr().offset(page_index_in_region * PAGE_SIZE));
-    if (!remap_vmobject_page(page_index_in_vmobject))
+    if (!map_page_after_fault(page_index_in_region))
         return PageFaultResponse::OutOfMemory;
     return response;
 }
 
-PageFaultResponse Region::handle_inode_fault(size_t page_index_in_region, ScopedSpinLock<RecursiveSpinLock>& mm_lock)
+PageFaultResponse Region::handle_inode_fault(size_t page_index_in_region)
 {
     VERIFY_INTERRUPTS_DISABLED();
     VERIFY(vmobject().is_inode());
-
-    mm_lock.unlock();
     VERIFY(!s_mm_lock.own_lock());
     VERIFY(!g_scheduler_lock.own_lock());
 
     LOCKER(vmobject().m_paging_lock);
 
-    mm_lock.lock();
-
-    VERIFY_INTERRUPTS_DISABLED();
     auto& inode_vmobject = static_cast<InodeVMObject&>(vmobject());
     auto page_index_in_vmobject = translate_to_vmobject_page(page_index_in_region);
-    auto& vmobject_physical_page_entry = inode_vmobject.physical_pages()[page_index_in_vmobject];
 
     dbgln_if(PAGE_FAULT_DEBUG, "Inode fault in {} page index: {}", name(), page_index_in_region);
 
-    if (!vmobject_physical_page_entry.is_null()) {
+    if (inode_vmobject.physical_pages()[page_index_in_vmobject].is_null()) {
+        auto current_thread = Thread::current();
+        if (current_thread)
+            current_thread->did_inode_fault();
+
+        // Programs mostly touch their mappings sequentially, so read ahead
+        // while we're going to the inode anyway.
+        auto result = read_inode_pages(page_index_in_region, inode_fault_readahead_pages);
+        if (result.is_error()) {
+            dmesgln("MM: handle_inode_fault had error ({}) while reading!", result.error());
+            return result.error() == -ENOMEM ? PageFaultResponse::OutOfMemory : PageFaultResponse::ShouldCrash;
+        }
+    } else {
         dbgln_if(PAGE_FAULT_DEBUG, "MM: page_in_from_inode() but page already present. Fine with me!");
-        if (!remap_vmobject_page(page_index_in_vmobject))
-            return PageFaultResponse::OutOfMemory;
-        return PageFaultResponse::Continue;
     }
 
-    auto current_thread = Thread::current();
-    if (current_thread)
-        current_thread->did_inode_fault();
+    if (!map_page_after_fault(page_index_in_region))
+        return PageFaultResponse::OutOfMemory;
+    map_resident_pages_around(page_index_in_region);
+    return PageFaultResponse::Continue;
+}
+
+PageFaultResponse Region::handle_inode_write_fault(size_t page_index_in_region)
+{
+    auto& inode_vmobject = static_cast<SharedInodeVMObject&>(vmobject());
+    auto page_index_in_vmobject = translate_to_vmobject_page(page_index_in_region);
+    inode_vmobject.set_page_dirty(page_index_in_vmobject);
+    if (!remap_vmobject_page(page_index_in_vmobject))
+        return PageFaultResponse::OutOfMemory;
+    return PageFaultResponse::Continue;
+}
+
+KResult Region::read_inode_pages(size_t page_index_in_region, size_t max_page_count)
+{
+    VERIFY(vmobject().is_inode());
+    VERIFY(vmobject().m_paging_lock.is_locked());
+    VERIFY(max_page_count > 0);
 
-    u8 page_buffer[PAGE_SIZE];
+    auto& inode_vmobject = static_cast<InodeVMObject&>(vmobject());
     auto& inode = inode_vmobject.inode();
+    auto first_page_in_vmobject = translate_to_vmobject_page(page_index_in_region);
+    VERIFY(inode_vmobject.physical_pages()[first_page_in_vmobject].is_null());
 
-    // Reading the page may block, so release the MM lock temporarily
-    mm_lock.unlock();
-    auto buffer = UserOrKernelBuffer::for_kernel_buffer(page_buffer);
-    auto nread = inode.read_bytes(page_index_in_vmobject * PAGE_SIZE, PAGE_SIZE, buffer, nullptr);
-    mm_lock.lock();
+    // Read the run of missing pages starting at the first one, but not past the
+    // end of the region or the file. The paging lock keeps the run missing.
+    size_t pages_in_file = ceil_div(inode.size(), static_cast<size_t>(PAGE_SIZE));
+    size_t page_count = 1;
+    {
+        ScopedSpinLock lock(inode_vmobject.m_lock);
+        while (page_count < max_page_count
+            && page_index_in_region + page_count < this->page_count()
+            && first_page_in_vmobject + page_count < pages_in_file
+            && inode_vmobject.physical_pages()[first_page_in_vmobject + page_count].is_null())
+            ++page_count;
+    }
 
-    if (nread < 0) {
-        dmesgln("MM: handle_inode_fault had error ({}) while reading!", nread);
-        return PageFaultResponse::ShouldCrash;
+    // The shared object is the inode's page cache and fills itself.
+    if (inode_vmobject.is_shared_inode())
+        return static_cast<SharedInodeVMObject&>(inode_vmobject).read_pages_from_inode(first_page_in_vmobject, page_count);
+
+    auto buffer = ByteBuffer::create_uninitialized(page_count * PAGE_SIZE);
+    if (buffer.is_null())
+        return ENOMEM;
+
+    // Private mappings can take their initial contents from the inode's page
+    // cache, which may be newer than what's on disk.
+    auto shared_vmobject = inode_vmobject.is_private_inode() ? inode.shared_vmobject() : nullptr;
+    Vector<bool, inode_fault_readahead_pages> page_was_cached;
+    size_t cached_page_count = 0;
+    for (size_t i = 0; i < page_count; ++i) {
+        bool cached = shared_vmobject && shared_vmobject->copy_cached_page(first_page_in_vmobject + i, buffer.data() + i * PAGE_SIZE);
+        page_was_cached.append(cached);
+        if (cached)
+            ++cached_page_count;
     }
-    if (nread < PAGE_SIZE) {
-        // If we read less than a page, zero out the rest to avoid leaking uninitialized data.
-        memset(page_buffer + nread, 0, PAGE_SIZE - nread);
+    shared_vmobject = nullptr;
+
+    if (cached_page_count < page_count) {
+        // One read for the whole run; the pages we already had are put back afterwards.
+        auto cached_contents = ByteBuffer::create_uninitialized(cached_page_count * PAGE_SIZE);
+        for (size_t i = 0, j = 0; i < page_count; ++i) {
+            if (page_was_cached[i])
+                memcpy(cached_contents.data() + j++ * PAGE_SIZE, buffer.data() + i * PAGE_SIZE, PAGE_SIZE);
+        }
+        auto user_buffer = UserOrKernelBuffer::for_kernel_buffer(buffer.data());
+        ssize_t nread = inode.read_bytes(first_page_in_vmobject * PAGE_SIZE, buffer.size(), user_buffer, nullptr);
+        if (nread < 0)
+            return KResult((ErrnoCode)-nread);
+        // If we read less than we asked for, zero out the rest to avoid leaking uninitialized data.
+        if (static_cast<size_t>(nread) < buffer.size())
+            memset(buffer.data() + nread, 0, buffer.size() - nread);
+        for (size_t i = 0, j = 0; i < page_count; ++i) {
+            if (page_was_cached[i])
+                memcpy(buffer.data() + i * PAGE_SIZE, cached_contents.data() + j++ * PAGE_SIZE, PAGE_SIZE);
+        }
     }
 
-    vmobject_physical_page_entry = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::No);
-    if (vmobject_physical_page_entry.is_null()) {
-        dmesgln("MM: handle_inode_fault was unable to allocate a physical page");
-        return PageFaultResponse::OutOfMemory;
+    for (size_t i = 0; i < page_count; ++i) {
+        auto new_page = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::No);
+        if (new_page.is_null()) {
+            // Only the page that was asked for is mandatory.
+            if (i == 0) {
+                dmesgln("MM: read_inode_pages was unable to allocate a physical page");
+                return ENOMEM;
+            }
+            break;
+        }
+        {
+            InterruptDisabler disabler;
+            u8* dest_ptr = MM.quickmap_page(*new_page);
+            memcpy(dest_ptr, buffer.data() + i * PAGE_SIZE, PAGE_SIZE);
+            MM.unquickmap_page();
+        }
+        ScopedSpinLock lock(inode_vmobject.m_lock);
+        inode_vmobject.physical_pages()[first_page_in_vmobject + i] = move(new_page);
     }
+    return KSuccess;
+}
 
-    u8* dest_ptr = MM.quickmap_page(*vmobject_physical_page_entry);
-    {
-        void* fault_at;
-        if (!safe_memcpy(dest_ptr, page_buffer, PAGE_SIZE, fault_at)) {
-            if ((u8*)fault_at >= dest_ptr && (u8*)fault_at <= dest_ptr + PAGE_SIZE)
-                dbgln("      >> inode fault: error copying data to {}/{}, failed at {}",
-                    vmobject_physical_page_entry->paddr(),
-                    VirtualAddress(dest_ptr),
-                    VirtualAddress(fault_at));
+void Region::map_resident_pages_around(size_t page_index_in_region)
+{
+    // Pages that are already resident cost nothing to map, so map the
+    // neighbours of a faulting page instead of taking a fault for each one.
+    // This only fills in missing entries of an existing page table, so all
+    // it needs is the page directory's lock and no TLB flush.
+    auto* page_directory = m_page_directory.ptr();
+    if (!page_directory)
+        return;
+    size_t first_page = page_index_in_region & ~(fault_around_pages - 1);
+    size_t end_page = min(first_page + fault_around_pages, page_count());
+
+    ScopedSpinLock page_lock(page_directory->get_lock());
+    if (m_page_directory.ptr() != page_directory)
+        return;
+    for (size_t page_index = first_page; page_index < end_page; ++page_index) {
+        if (page_index == page_index_in_region || !physical_page(page_index))
+            continue;
+        auto* pte = MM.existing_pte(*page_directory, vaddr_from_page_index(page_index));
+        if (!pte)
+            return;
+        if (!pte->is_present())
+            update_pte(*pte, page_index);
+    }
+}
+
+KResult Region::populate(size_t page_index_in_region, size_t page_count)
+{
+    VERIFY(page_index_in_region + page_count <= this->page_count());
+    if (vmobject().is_inode()) {
+        {
+            LOCKER(vmobject().m_paging_lock);
+            auto& inode_vmobject = static_cast<InodeVMObject&>(vmobject());
+            for (size_t page_index = page_index_in_region; page_index < page_index_in_region + page_count; ++page_index) {
+                if (!inode_vmobject.physical_pages()[translate_to_vmobject_page(page_index)].is_null())
+                    continue;
+                auto result = read_inode_pages(page_index, min(page_index_in_region + page_count - page_index, populate_batch_pages));
+                if (result.is_error())
+                    return result;
+            }
+        }
+    } else if (vmobject().is_anonymous()) {
+        LOCKER(vmobject().m_paging_lock);
+        auto& anonymous_vmobject = static_cast<AnonymousVMObject&>(vmobject());
+        for (size_t page_index = page_index_in_region; page_index < page_index_in_region + page_count; ++page_index) {
+            auto page_index_in_vmobject = translate_to_vmobject_page(page_index);
+            bool is_lazy_committed;
+            {
+                ScopedSpinLock lock(anonymous_vmobject.m_lock);
+                auto& page_slot = physical_page_slot(page_index);
+                if (!page_slot->is_shared_zero_page() && !page_slot->is_lazy_committed_page())
+                    continue;
+                // Leave pages alone that are shared with a clone; they'll be copied when written.
+                if (should_cow(page_index) && page_slot->is_shared_zero_page())
+                    continue;
+                is_lazy_committed = page_slot->is_lazy_committed_page();
+            }
+            RefPtr<PhysicalPage> new_page;
+            if (is_lazy_committed)
+                new_page = anonymous_vmobject.allocate_committed_page(page_index_in_vmobject);
             else
-                VERIFY_NOT_REACHED();
+                new_page = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::Yes);
+            if (!new_page)
+                return ENOMEM;
+            ScopedSpinLock lock(anonymous_vmobject.m_lock);
+            physical_page_slot(page_index) = move(new_page);
         }
+    } else {
+        return KSuccess;
     }
-    MM.unquickmap_page();
 
-    remap_vmobject_page(page_index_in_vmobject);
-    return PageFaultResponse::Continue;
+    if (!remap_vmobject_page_range(translate_to_vmobject_page(page_index_in_region), page_count))
+        return ENOMEM;
+    return KSuccess;
 }
 
 RefPtr<Process> Region::get_owner()
@@ -33,6 +33,7 @@
 #include <AK/Weakable.h>
 #include <Kernel/Arch/x86/CPU.h>
 #include <Kernel/Heap/SlabAllocator.h>
+#include <Kernel/KResult.h>
 #include <Kernel/VM/PageFaultResponse.h>
 #include <Kernel/VM/PurgeablePageRanges.h>
 #include <Kernel/VM/RangeAllocator.h>
@@ -109,7 +110,15 @@ public:
     bool is_user() const { return !is_kernel(); }
     bool is_kernel() const { return vaddr().get() < 0x00800000 || vaddr().get() >= 0xc0000000; }
 
-    PageFaultResponse handle_fault(const PageFault&, ScopedSpinLock<RecursiveSpinLock>&);
+    PageFaultResponse handle_fault(const PageFault&);
+
+    // Page faults are handled without s_mm_lock, so a region that is being
+    // faulted on is pinned to keep it from being destroyed underneath us.
+    void pin_for_fault() { m_in_flight_faults.fetch_add(1, AK::MemoryOrder::memory_order_acquire); }
+    void unpin_after_fault() { m_in_flight_faults.fetch_sub(1, AK::MemoryOrder::memory_order_release); }
+
+    // Makes the given pages resident and maps them, like touching each of them would.
+    KResult populate(size_t page_index, size_t page_count);
 
     OwnPtr<Region> clone(Process&);
 
@@ -213,6 +222,7 @@ public:
     size_t amount_dirty() const;
 
     bool should_cow(size_t page_index) const;
+    bool should_track_writes(size_t page_index) const;
     void set_should_cow(size_t page_index, bool);
 
     size_t cow_pages() const;
@@ -267,10 +277,22 @@ private:
     bool remap_vmobject_page(size_t index, bool with_flush = true);
 
     PageFaultResponse handle_cow_fault(size_t page_index);
-    PageFaultResponse handle_inode_fault(size_t page_index, ScopedSpinLock<RecursiveSpinLock>&);
+    PageFaultResponse handle_inode_fault(size_t page_index);
+    PageFaultResponse handle_inode_write_fault(size_t page_index);
     PageFaultResponse handle_zero_fault(size_t page_index);
 
     bool map_individual_page_impl(size_t page_index);
+    bool can_map_large_page(size_t page_index) const;
+    void map_large_page_impl(size_t page_index);
+    void update_pte(PageTableEntry&, size_t page_index);
+    bool map_page_after_fault(size_t page_index);
+    KResult read_inode_pages(size_t page_index, size_t max_page_count);
+    void map_resident_pages_around(size_t page_index);
+
+    static constexpr size_t inode_fault_readahead_pages = 16;
+    static constexpr size_t fault_around_pages = 16;
+    static constexpr size_t populate_batch_pages = 64;
+    static_assert((fault_around_pages & (fault_around_pages - 1)) == 0);
 
     void register_purgeable_page_ranges();
     void unregister_purgeable_page_ranges();
@@ -287,6 +309,7 @@ private:
     bool m_mmap : 1 { false };
     bool m_syscall_region : 1 { false };
     WeakPtr<Process> m_owner;
+    Atomic<u32> m_in_flight_faults { 0 };
 };
 
 AK_ENUM_BITWISE_OPERATORS(Region::Access)
@@ -24,7 +24,11 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <AK/Singleton.h>
 #include <Kernel/FileSystem/Inode.h>
+#include <Kernel/KBuffer.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageDirectory.h>
 #include <Kernel/VM/SharedInodeVMObject.h>
 
 namespace Kernel {
@@ -54,4 +58,344 @@ SharedInodeVMObject::SharedInodeVMObject(const SharedInodeVMObject& other)
 {
 }
 
+// The most pages we read from the inode with a single request when filling the page cache.
+static constexpr size_t max_pages_per_inode_read = 32;
+
+static SpinLock<u8> s_dirty_vmobjects_lock;
+static AK::Singleton<NonnullRefPtrVector<SharedInodeVMObject>> s_dirty_vmobjects;
+
+OwnPtr<Region> SharedInodeVMObject::map_pages_into_kernel(size_t page_index, size_t page_count)
+{
+    ScopedSpinLock lock(s_mm_lock);
+    auto range = MM.kernel_page_directory().range_allocator().allocate_anywhere(page_count * PAGE_SIZE);
+    if (!range.has_value())
+        return {};
+    auto region = Region::create_kernel_only(range.value(), *this, page_index * PAGE_SIZE, "Page cache", Region::Access::Read | Region::Access::Write);
+    region->map(MM.kernel_page_directory());
+    return region;
+}
+
+KResult SharedInodeVMObject::read_pages_from_inode(size_t page_index, size_t page_count)
+{
+    LOCKER(m_paging_lock);
+    size_t end_page_index = min(page_index + page_count, this->page_count());
+    while (page_index < end_page_index) {
+        size_t run_length = 0;
+        u32 write_generation;
+        {
+            ScopedSpinLock lock(m_lock);
+            if (!m_physical_pages[page_index].is_null()) {
+                ++page_index;
+                continue;
+            }
+            while (page_index + run_length < end_page_index
+                && run_length < max_pages_per_inode_read
+                && m_physical_pages[page_index + run_length].is_null())
+                ++run_length;
+            write_generation = m_write_generation;
+        }
+
+        // Read into pages of our own and only hand them out once they're filled.
+        // They come zero-filled, which takes care of anything past the end of the file.
+        auto fill_region = MM.allocate_kernel_region(run_length * PAGE_SIZE, "Page cache fill", Region::Access::Read | Region::Access::Write, AllocationStrategy::AllocateNow);
+        if (!fill_region)
+            return ENOMEM;
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(fill_region->vaddr().as_ptr());
+        auto nread = m_inode->read_bytes_uncached(page_index * PAGE_SIZE, run_length * PAGE_SIZE, buffer);
+        if (nread < 0)
+            return KResult((ErrnoCode)-nread);
+
+        ScopedSpinLock lock(m_lock);
+        // A write() went by while we were reading, so what we have may predate it. Try again.
+        if (write_generation != m_write_generation)
+            continue;
+        auto& fill_pages = fill_region->vmobject().physical_pages();
+        for (size_t i = 0; i < run_length; ++i) {
+            if (m_physical_pages[page_index + i].is_null())
+                m_physical_pages[page_index + i] = fill_pages[i];
+        }
+        page_index += run_length;
+    }
+    return KSuccess;
+}
+
+ssize_t SharedInodeVMObject::read(u64 offset, UserOrKernelBuffer& buffer, size_t count)
+{
+    // Pages past the end of the VMObject (the file has grown since it was created) aren't cached.
+    u64 end = min(static_cast<u64>(m_inode->size()), static_cast<u64>(size()));
+    if (offset >= end)
+        return 0;
+    count = min(static_cast<u64>(count), end - offset);
+    if (count == 0)
+        return 0;
+
+    size_t first_page_index = offset / PAGE_SIZE;
+    size_t last_page_index = (offset + count - 1) / PAGE_SIZE;
+    auto result = read_pages_from_inode(first_page_index, last_page_index - first_page_index + 1);
+    if (result.is_error())
+        return result.error();
+
+    if (!buffer.is_kernel_buffer()) {
+        // Copying to userspace may fault and block, so it can't be done through a quickmap.
+        // Map the pages into the kernel instead. If memory pressure releases a page meanwhile,
+        // the kernel mapping simply faults it back in.
+        auto region = map_pages_into_kernel(first_page_index, last_page_index - first_page_index + 1);
+        if (!region)
+            return -ENOMEM;
+        if (!buffer.write(region->vaddr().offset(offset % PAGE_SIZE).as_ptr(), count))
+            return -EFAULT;
+        return count;
+    }
+
+    size_t nread = 0;
+    while (nread < count) {
+        u64 position = offset + nread;
+        size_t page_index = position / PAGE_SIZE;
+        size_t offset_in_page = position % PAGE_SIZE;
+        size_t chunk_size = min(PAGE_SIZE - offset_in_page, count - nread);
+        RefPtr<PhysicalPage> page;
+        {
+            ScopedSpinLock lock(m_lock);
+            page = m_physical_pages[page_index];
+        }
+        if (!page) {
+            // Released by release_all_clean_page_cache_pages() since we brought it in.
+            result = read_pages_from_inode(page_index, 1);
+            if (result.is_error())
+                return nread > 0 ? static_cast<ssize_t>(nread) : result.error();
+            continue;
+        }
+        InterruptDisabler disabler;
+        u8* page_ptr = MM.quickmap_page(*page);
+        bool did_write = buffer.write(page_ptr + offset_in_page, nread, chunk_size);
+        MM.unquickmap_page();
+        VERIFY(did_write);
+        nread += chunk_size;
+    }
+    return nread;
+}
+
+bool SharedInodeVMObject::copy_cached_page(size_t page_index, u8* buffer)
+{
+    RefPtr<PhysicalPage> page;
+    {
+        ScopedSpinLock lock(m_lock);
+        if (page_index >= page_count())
+            return false;
+        page = m_physical_pages[page_index];
+    }
+    if (!page || page->is_shared_zero_page() || page->is_lazy_committed_page())
+        return false;
+    InterruptDisabler disabler;
+    u8* page_ptr = MM.quickmap_page(*page);
+    memcpy(buffer, page_ptr, PAGE_SIZE);
+    MM.unquickmap_page();
+    return true;
+}
+
+void SharedInodeVMObject::update_cached_pages(u64 offset, const UserOrKernelBuffer& data, size_t count)
+{
+    if (count == 0 || offset >= size())
+        return;
+    count = min(static_cast<u64>(count), size() - offset);
+    size_t first_page_index = offset / PAGE_SIZE;
+    size_t last_page_index = (offset + count - 1) / PAGE_SIZE;
+
+    // Copy the new data into every resident page it covers. Missing pages are left
+    // alone, the next read brings them in from the inode, which already has the data.
+    size_t page_index = first_page_index;
+    while (page_index <= last_page_index) {
+        size_t run_length = 0;
+        {
+            ScopedSpinLock lock(m_lock);
+            ++m_write_generation;
+            while (page_index <= last_page_index && m_physical_pages[page_index].is_null())
+                ++page_index;
+            while (page_index + run_length <= last_page_index && !m_physical_pages[page_index + run_length].is_null())
+                ++run_length;
+        }
+        if (run_length == 0)
+            break;
+
+        u64 run_start = max(offset, static_cast<u64>(page_index) * PAGE_SIZE);
+        u64 run_end = min(offset + count, static_cast<u64>(page_index + run_length) * PAGE_SIZE);
+        auto region = map_pages_into_kernel(page_index, run_length);
+        if (!region || !data.read(region->vaddr().offset(run_start - page_index * PAGE_SIZE).as_ptr(), run_start - offset, run_end - run_start)) {
+            // We can't tell what made it into the pages, so drop them from the cache.
+            dmesgln("SharedInodeVMObject: Failed to update cached pages {}-{}", page_index, page_index + run_length - 1);
+            ScopedSpinLock lock(m_lock);
+            for (size_t i = 0; i < run_length; ++i) {
+                if (!m_dirty_pages.get(page_index + i))
+                    m_physical_pages[page_index + i] = nullptr;
+            }
+        }
+        page_index += run_length;
+    }
+    for_each_region([](auto& region) {
+        region.remap();
+    });
+}
+
+void SharedInodeVMObject::truncate(u64 new_size)
+{
+    LOCKER(m_paging_lock);
+    {
+        ScopedSpinLock lock(m_lock);
+        ++m_write_generation;
+        for (size_t i = ceil_div(new_size, static_cast<u64>(PAGE_SIZE)); i < page_count(); ++i) {
+            m_physical_pages[i] = nullptr;
+            m_dirty_pages.set(i, false);
+        }
+    }
+
+    // The rest of a partial last page must read back as zeroes if the file grows again.
+    size_t offset_in_page = new_size % PAGE_SIZE;
+    size_t page_index = new_size / PAGE_SIZE;
+    if (offset_in_page && page_index < page_count()) {
+        RefPtr<PhysicalPage> page;
+        {
+            ScopedSpinLock lock(m_lock);
+            page = m_physical_pages[page_index];
+        }
+        if (page) {
+            InterruptDisabler disabler;
+            u8* page_ptr = MM.quickmap_page(*page);
+            memset(page_ptr + offset_in_page, 0, PAGE_SIZE - offset_in_page);
+            MM.unquickmap_page();
+        }
+    }
+
+    for_each_region([](auto& region) {
+        region.remap();
+    });
+}
+
+bool SharedInodeVMObject::is_page_dirty(size_t page_index) const
+{
+    ScopedSpinLock lock(m_lock);
+    return m_dirty_pages.get(page_index);
+}
+
+void SharedInodeVMObject::set_page_dirty(size_t page_index)
+{
+    {
+        ScopedSpinLock lock(m_lock);
+        m_dirty_pages.set(page_index, true);
+        if (m_queued_for_write_back)
+            return;
+        m_queued_for_write_back = true;
+    }
+    // Keep ourselves alive until the dirty pages are written back, even if every mapping goes away.
+    ScopedSpinLock lock(s_dirty_vmobjects_lock);
+    s_dirty_vmobjects->append(*this);
+}
+
+KResult SharedInodeVMObject::write_back_dirty_pages()
+{
+    LOCKER(m_paging_lock);
+    Vector<size_t> dirty_page_indices;
+    NonnullRefPtrVector<PhysicalPage> dirty_pages;
+    {
+        // Clear the dirty bits first, so that a write coming in after we've
+        // taken our copy dirties the page again.
+        ScopedSpinLock lock(m_lock);
+        for (size_t i = 0; i < page_count(); ++i) {
+            if (!m_dirty_pages.get(i))
+                continue;
+            m_dirty_pages.set(i, false);
+            dirty_page_indices.append(i);
+            dirty_pages.append(*m_physical_pages[i]);
+        }
+    }
+    if (dirty_pages.is_empty())
+        return KSuccess;
+
+    // Write-protect the pages again before copying them out.
+    for_each_region([](auto& region) {
+        region.remap();
+    });
+
+    KResult result = KSuccess;
+    size_t i = 0;
+    while (i < dirty_pages.size()) {
+        size_t run_length = 1;
+        while (i + run_length < dirty_pages.size()
+            && run_length < max_pages_per_inode_read
+            && dirty_page_indices[i + run_length] == dirty_page_indices[i] + run_length)
+            ++run_length;
+
+        // Don't write anything past the end of the file.
+        u64 offset = static_cast<u64>(dirty_page_indices[i]) * PAGE_SIZE;
+        u64 inode_size = m_inode->size();
+        size_t length = offset < inode_size ? min(static_cast<u64>(run_length) * PAGE_SIZE, inode_size - offset) : 0;
+        if (length) {
+            auto buffer = KBuffer::try_create_with_size(run_length * PAGE_SIZE, Region::Access::Read | Region::Access::Write, "Page cache write-back");
+            if (!buffer) {
+                result = ENOMEM;
+                break;
+            }
+            for (size_t j = 0; j < run_length; ++j) {
+                InterruptDisabler disabler;
+                u8* page_ptr = MM.quickmap_page(dirty_pages[i + j]);
+                memcpy(buffer->data() + j * PAGE_SIZE, page_ptr, PAGE_SIZE);
+                MM.unquickmap_page();
+            }
+            auto data = UserOrKernelBuffer::for_kernel_buffer(buffer->data());
+            auto nwritten = m_inode->write_bytes(offset, length, data, nullptr);
+            if (nwritten < 0) {
+                result = KResult((ErrnoCode)-nwritten);
+                break;
+            }
+        }
+        i += run_length;
+    }
+
+    if (result.is_error()) {
+        // Whatever we didn't get to stays dirty.
+        ScopedSpinLock lock(m_lock);
+        for (; i < dirty_page_indices.size(); ++i)
+            m_dirty_pages.set(dirty_page_indices[i], true);
+    }
+    return result;
+}
+
+size_t SharedInodeVMObject::release_all_clean_page_cache_pages()
+{
+    NonnullRefPtrVector<SharedInodeVMObject> vmobjects;
+    {
+        ScopedSpinLock all_inodes_lock(Inode::all_inodes_lock());
+        for (auto& inode : Inode::all_with_lock()) {
+            if (auto vmobject = inode.shared_vmobject())
+                vmobjects.append(vmobject.release_nonnull());
+        }
+    }
+    size_t released_page_count = 0;
+    for (auto& vmobject : vmobjects)
+        released_page_count += vmobject.release_all_clean_pages();
+    return released_page_count;
+}
+
+void SharedInodeVMObject::write_back_all_dirty_pages()
+{
+    NonnullRefPtrVector<SharedInodeVMObject> vmobjects;
+    {
+        ScopedSpinLock lock(s_dirty_vmobjects_lock);
+        vmobjects = move(*s_dirty_vmobjects);
+    }
+    for (auto& vmobject : vmobjects) {
+        auto result = vmobject.write_back_dirty_pages();
+        if (result.is_error())
+            dmesgln("SharedInodeVMObject: Failed to write back dirty pages of inode {} ({})", vmobject.inode().identifier(), result.error());
+        {
+            ScopedSpinLock lock(vmobject.m_lock);
+            if (!vmobject.m_dirty_pages.find_first_set().has_value()) {
+                vmobject.m_queued_for_write_back = false;
+                continue;
+            }
+        }
+        ScopedSpinLock lock(s_dirty_vmobjects_lock);
+        s_dirty_vmobjects->append(vmobject);
+    }
+}
+
 }
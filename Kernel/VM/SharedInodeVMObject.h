@@ -39,6 +39,27 @@ public:
     static NonnullRefPtr<SharedInodeVMObject> create_with_inode(Inode&);
     virtual RefPtr<VMObject> clone() override;
 
+    // Every shared mapping and every open InodeFile of an inode use the same
+    // SharedInodeVMObject, so its resident pages are the inode's page cache.
+    // m_lock protects the page slots and dirty bits. m_paging_lock serializes
+    // bringing pages in from the inode, and is never held while touching user memory.
+    ssize_t read(u64 offset, UserOrKernelBuffer&, size_t count);
+    bool copy_cached_page(size_t page_index, u8* buffer);
+    void update_cached_pages(u64 offset, const UserOrKernelBuffer&, size_t count);
+    void truncate(u64 size);
+
+    // Reads the missing pages in the given range from the inode, bypassing the file system's block cache.
+    KResult read_pages_from_inode(size_t page_index, size_t page_count);
+
+    // Shared writable mappings are mapped read-only until the first write, which marks the page dirty.
+    bool is_page_dirty(size_t page_index) const;
+    void set_page_dirty(size_t page_index);
+    KResult write_back_dirty_pages();
+    static void write_back_all_dirty_pages();
+
+    // Drops the clean pages of every inode's page cache, to be read back in when they're needed again.
+    static size_t release_all_clean_page_cache_pages();
+
 private:
     virtual bool is_shared_inode() const override { return true; }
 
@@ -48,6 +69,12 @@ private:
     virtual const char* class_name() const override { return "SharedInodeVMObject"; }
 
     SharedInodeVMObject& operator=(const SharedInodeVMObject&) = delete;
+
+    OwnPtr<Region> map_pages_into_kernel(size_t page_index, size_t page_count);
+
+    // Bumped whenever write() updates the cache, so that a concurrent read from the inode can tell its data may be stale.
+    u32 m_write_generation { 0 };
+    bool m_queued_for_write_back { false };
 };
 
 }
@@ -91,7 +91,7 @@ KResultOr<Region*> Space::allocate_region(const Range& range, const String& name
     return &add_region(move(region));
 }
 
-KResultOr<Region*> Space::allocate_region_with_vmobject(const Range& range, NonnullRefPtr<VMObject> vmobject, size_t offset_in_vmobject, const String& name, int prot, bool shared)
+KResultOr<Region*> Space::allocate_region_with_vmobject(const Range& range, NonnullRefPtr<VMObject> vmobject, size_t offset_in_vmobject, const String& name, int prot, bool shared, Region::Cacheable cacheable)
 {
     VERIFY(range.is_valid());
     size_t end_in_vmobject = offset_in_vmobject + range.size();
@@ -108,7 +108,7 @@ KResultOr<Region*> Space::allocate_region_with_vmobject(const Range& range, Nonn
         return EINVAL;
     }
     offset_in_vmobject &= PAGE_MASK;
-    auto& region = add_region(Region::create_user_accessible(m_process, range, move(vmobject), offset_in_vmobject, name, prot_to_region_access_flags(prot), Region::Cacheable::Yes, shared));
+    auto& region = add_region(Region::create_user_accessible(m_process, range, move(vmobject), offset_in_vmobject, name, prot_to_region_access_flags(prot), cacheable, shared));
     if (!region.map(page_directory())) {
         // FIXME: What is an appropriate error code here, really?
         return ENOMEM;
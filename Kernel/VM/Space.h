@@ -30,9 +30,11 @@
 #include <AK/NonnullOwnPtrVector.h>
 #include <AK/Vector.h>
 #include <AK/WeakPtr.h>
+#include <Kernel/Lock.h>
 #include <Kernel/UnixTypes.h>
 #include <Kernel/VM/AllocationStrategy.h>
 #include <Kernel/VM/PageDirectory.h>
+#include <Kernel/VM/Region.h>
 
 namespace Kernel {
 
@@ -55,7 +57,7 @@ public:
 
     Optional<Range> allocate_range(VirtualAddress, size_t, size_t alignment = PAGE_SIZE);
 
-    KResultOr<Region*> allocate_region_with_vmobject(const Range&, NonnullRefPtr<VMObject>, size_t offset_in_vmobject, const String& name, int prot, bool shared);
+    KResultOr<Region*> allocate_region_with_vmobject(const Range&, NonnullRefPtr<VMObject>, size_t offset_in_vmobject, const String& name, int prot, bool shared, Region::Cacheable = Region::Cacheable::Yes);
     KResultOr<Region*> allocate_region(const Range&, const String& name, int prot = PROT_READ | PROT_WRITE, AllocationStrategy strategy = AllocationStrategy::Reserve);
     bool deallocate_region(Region& region);
 
@@ -74,6 +76,10 @@ public:
 
     RecursiveSpinLock& get_lock() const { return m_lock; }
 
+    // Serializes the syscalls that add, remove or change regions, since some of them run without the big lock.
+    // Unlike m_lock, it can be held while blocking.
+    Lock& mapping_lock() { return m_mapping_lock; }
+
     size_t amount_clean_inode() const;
     size_t amount_dirty_private() const;
     size_t amount_virtual() const;
@@ -87,6 +93,7 @@ private:
 
     Process* m_process { nullptr };
     mutable RecursiveSpinLock m_lock;
+    Lock m_mapping_lock { "Space" };
 
     RefPtr<PageDirectory> m_page_directory;
 
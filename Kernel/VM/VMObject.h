@@ -62,6 +62,10 @@ public:
     virtual bool is_private_inode() const { return false; }
     virtual bool is_contiguous() const { return false; }
 
+    // Whether regions mapping this object should try to use large pages where
+    // the physical pages are suitably contiguous and aligned.
+    virtual bool may_use_large_pages() const { return false; }
+
     size_t page_count() const { return m_physical_pages.size(); }
     const Vector<RefPtr<PhysicalPage>>& physical_pages() const { return m_physical_pages; }
     Vector<RefPtr<PhysicalPage>>& physical_pages() { return m_physical_pages; }
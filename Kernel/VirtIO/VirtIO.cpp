@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Debug.h>
+#include <Kernel/VirtIO/VirtIO.h>
+
+namespace Kernel {
+
+#define PCI_CAPABILITY_VENDOR_SPECIFIC 0x09
+
+bool VirtIODevice::is_virtio_device(PCI::ID id, u16 device_type)
+{
+    if (id.vendor_id != VIRTIO_PCI_VENDOR_ID)
+        return false;
+    return id.device_id == VIRTIO_PCI_TRANSITIONAL_DEVICE_ID_BASE + device_type - 1 || id.device_id == VIRTIO_PCI_MODERN_DEVICE_ID_BASE + device_type;
+}
+
+UNMAP_AFTER_INIT VirtIODevice::VirtIODevice(PCI::Address address, const char* class_name)
+    : PCI::Device(address)
+    , m_class_name(class_name)
+{
+    dmesgln("{}: Found @ {}", m_class_name, pci_address());
+}
+
+VirtIODevice::~VirtIODevice()
+{
+}
+
+UNMAP_AFTER_INIT Optional<VirtIODevice::Configuration> VirtIODevice::find_configuration(u8 type) const
+{
+    // The first capability of each type is the one the device prefers us to use.
+    for (auto& capability : PCI::get_capabilities(pci_address())) {
+        if (capability.m_id != PCI_CAPABILITY_VENDOR_SPECIFIC)
+            continue;
+        if (PCI::read8(pci_address(), capability.m_ptr + 3) != type)
+            continue;
+        u8 bar = PCI::read8(pci_address(), capability.m_ptr + 4);
+        if (bar > 5)
+            continue;
+        u32 offset = PCI::read32(pci_address(), capability.m_ptr + 8);
+        u32 length = PCI::read32(pci_address(), capability.m_ptr + 12);
+        dbgln_if(VIRTIO_DEBUG, "{}: Configuration type {} in BAR{} at offset {:#x}, length {}", m_class_name, type, bar, offset, length);
+        return Configuration { capability.m_ptr, bar, offset, length };
+    }
+    return {};
+}
+
+UNMAP_AFTER_INIT u8* VirtIODevice::map_configuration(const Configuration& configuration)
+{
+    auto& region = m_bar_regions[configuration.bar];
+    if (!region) {
+        u32 bar_field = PCI_BAR0 + configuration.bar * 4;
+        u32 bar = PCI::read32(pci_address(), bar_field);
+        if (bar & 1) {
+            dmesgln("{}: BAR{} is an I/O space BAR, which we don't support", m_class_name, configuration.bar);
+            return nullptr;
+        }
+        if ((bar & 0x6) == 0x4 && (configuration.bar == 5 || PCI::read32(pci_address(), bar_field + 4) != 0)) {
+            dmesgln("{}: BAR{} is mapped above 4 GiB", m_class_name, configuration.bar);
+            return nullptr;
+        }
+        auto bar_size = PCI::get_BAR_space_size(pci_address(), configuration.bar);
+        region = MM.allocate_kernel_region(PhysicalAddress(page_base_of(bar & ~0xf)), page_round_up(bar_size), "VirtIO Configuration", Region::Access::Read | Region::Access::Write, Region::Cacheable::No);
+        if (!region)
+            return nullptr;
+    }
+    if ((u64)configuration.offset + configuration.length > region->size())
+        return nullptr;
+    return region->vaddr().offset(configuration.offset).as_ptr();
+}
+
+UNMAP_AFTER_INIT bool VirtIODevice::initialize()
+{
+    auto common_configuration = find_configuration(VIRTIO_PCI_CAP_COMMON_CFG);
+    auto notify_configuration = find_configuration(VIRTIO_PCI_CAP_NOTIFY_CFG);
+    auto isr_configuration = find_configuration(VIRTIO_PCI_CAP_ISR_CFG);
+    auto device_configuration = find_configuration(VIRTIO_PCI_CAP_DEVICE_CFG);
+    if (!common_configuration.has_value() || !notify_configuration.has_value() || !isr_configuration.has_value()) {
+        dmesgln("{}: Device doesn't implement the modern VirtIO interface", m_class_name);
+        return false;
+    }
+
+    m_common_config = (volatile VirtIOCommonConfig*)map_configuration(common_configuration.value());
+    m_notify_base = map_configuration(notify_configuration.value());
+    m_isr = map_configuration(isr_configuration.value());
+    if (device_configuration.has_value())
+        m_device_config = map_configuration(device_configuration.value());
+    if (!m_common_config || !m_notify_base || !m_isr) {
+        dmesgln("{}: Couldn't map the configuration structures", m_class_name);
+        return false;
+    }
+    m_notify_multiplier = PCI::read32(pci_address(), notify_configuration.value().capability_offset + 16);
+
+    enable_bus_mastering(pci_address());
+
+    // Writing zero resets the device, which is done once it reads back as zero.
+    m_common_config->device_status = 0;
+    while (read_status() != 0)
+        IO::delay(1);
+    set_status_bit(VIRTIO_STATUS_ACKNOWLEDGE);
+    set_status_bit(VIRTIO_STATUS_DRIVER);
+    return true;
+}
+
+UNMAP_AFTER_INIT bool VirtIODevice::negotiate_features(Function<u64(u64)> accept_features)
+{
+    m_common_config->device_feature_select = 0;
+    u64 device_features = m_common_config->device_feature;
+    m_common_config->device_feature_select = 1;
+    device_features |= (u64)m_common_config->device_feature << 32;
+    dbgln_if(VIRTIO_DEBUG, "{}: Device features: {:#016x}", m_class_name, device_features);
+
+    if (!(device_features & VIRTIO_F_VERSION_1)) {
+        dmesgln("{}: Device doesn't support VirtIO 1.0", m_class_name);
+        set_status_bit(VIRTIO_STATUS_FAILED);
+        return false;
+    }
+
+    u64 accepted_features = (accept_features(device_features) | VIRTIO_F_VERSION_1 | VIRTIO_F_RING_EVENT_IDX) & device_features;
+    m_common_config->driver_feature_select = 0;
+    m_common_config->driver_feature = accepted_features & 0xffffffff;
+    m_common_config->driver_feature_select = 1;
+    m_common_config->driver_feature = accepted_features >> 32;
+
+    set_status_bit(VIRTIO_STATUS_FEATURES_OK);
+    if (!(read_status() & VIRTIO_STATUS_FEATURES_OK)) {
+        dmesgln("{}: Device rejected our features", m_class_name);
+        set_status_bit(VIRTIO_STATUS_FAILED);
+        return false;
+    }
+    m_accepted_features = accepted_features;
+    dbgln_if(VIRTIO_DEBUG, "{}: Accepted features: {:#016x}", m_class_name, m_accepted_features);
+    return true;
+}
+
+UNMAP_AFTER_INIT bool VirtIODevice::setup_queues(u16 queue_count, u16 max_queue_size)
+{
+    VERIFY(max_queue_size && !(max_queue_size & (max_queue_size - 1)));
+    if (m_common_config->num_queues < queue_count) {
+        dmesgln("{}: Device only has {} queues, but we need {}", m_class_name, (u16)m_common_config->num_queues, queue_count);
+        set_status_bit(VIRTIO_STATUS_FAILED);
+        return false;
+    }
+
+    for (u16 queue_index = 0; queue_index < queue_count; queue_index++) {
+        m_common_config->queue_select = queue_index;
+        u16 queue_size = m_common_config->queue_size;
+        if (queue_size == 0) {
+            dmesgln("{}: Queue {} is not available", m_class_name, queue_index);
+            set_status_bit(VIRTIO_STATUS_FAILED);
+            return false;
+        }
+        queue_size = min(queue_size, max_queue_size);
+        m_common_config->queue_size = queue_size;
+
+        u16 notify_offset = m_common_config->queue_notify_off;
+        auto queue = make<VirtIOQueue>(queue_size, notify_offset, is_feature_accepted(VIRTIO_F_RING_EVENT_IDX));
+        if (queue->is_null()) {
+            set_status_bit(VIRTIO_STATUS_FAILED);
+            return false;
+        }
+        m_common_config->queue_desc_low = queue->descriptor_area().get();
+        m_common_config->queue_desc_high = 0;
+        m_common_config->queue_driver_low = queue->driver_area().get();
+        m_common_config->queue_driver_high = 0;
+        m_common_config->queue_device_low = queue->device_area().get();
+        m_common_config->queue_device_high = 0;
+        m_common_config->queue_msix_vector = VIRTIO_MSI_NO_VECTOR;
+        m_common_config->queue_enable = 1;
+        dbgln_if(VIRTIO_DEBUG, "{}: Queue {} has {} descriptors", m_class_name, queue_index, queue_size);
+        m_queues.append(move(queue));
+    }
+    return true;
+}
+
+UNMAP_AFTER_INIT void VirtIODevice::finish_initialization()
+{
+    set_status_bit(VIRTIO_STATUS_DRIVER_OK);
+    enable_irq();
+}
+
+void VirtIODevice::set_status_bit(u8 bit)
+{
+    m_common_config->device_status = read_status() | bit;
+}
+
+void VirtIODevice::notify_queue(u16 queue_index)
+{
+    auto& queue = this->queue(queue_index);
+    dbgln_if(VIRTIO_DEBUG, "{}: Notifying about queue {}", m_class_name, queue_index);
+    *(volatile u16*)(m_notify_base + queue.notify_offset() * m_notify_multiplier) = queue_index;
+}
+
+u8 VirtIODevice::config_read8(u32 offset) const
+{
+    VERIFY(m_device_config);
+    return m_device_config[offset];
+}
+
+u16 VirtIODevice::config_read16(u32 offset) const
+{
+    VERIFY(m_device_config);
+    return *(const volatile u16*)(m_device_config + offset);
+}
+
+u32 VirtIODevice::config_read32(u32 offset) const
+{
+    VERIFY(m_device_config);
+    return *(const volatile u32*)(m_device_config + offset);
+}
+
+u64 VirtIODevice::config_read64(u32 offset) const
+{
+    // The device may change the value between our two reads, in which case it bumps the generation.
+    u8 generation;
+    u64 value;
+    do {
+        generation = m_common_config->config_generation;
+        value = config_read32(offset) | ((u64)config_read32(offset + 4) << 32);
+    } while (generation != m_common_config->config_generation);
+    return value;
+}
+
+void VirtIODevice::handle_irq(const RegisterState&)
+{
+    // Reading the ISR status also acknowledges the interrupt.
+    u8 isr_type = *m_isr;
+    dbgln_if(VIRTIO_DEBUG, "{}: Handling interrupt, ISR status {:#02x}", m_class_name, isr_type);
+    if (isr_type & VIRTIO_ISR_DEVICE_CONFIG_INTERRUPT)
+        handle_device_config_change();
+    if (isr_type & VIRTIO_ISR_QUEUE_INTERRUPT) {
+        for (u16 queue_index = 0; queue_index < m_queues.size(); queue_index++)
+            handle_queue_update(queue_index);
+    }
+}
+
+}
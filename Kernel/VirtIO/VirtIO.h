@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Function.h>
+#include <AK/NonnullOwnPtrVector.h>
+#include <Kernel/IO.h>
+#include <Kernel/PCI/Access.h>
+#include <Kernel/PCI/Device.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VirtIO/VirtIOQueue.h>
+
+namespace Kernel {
+
+#define VIRTIO_PCI_VENDOR_ID 0x1AF4
+
+// Transitional devices use 0x1000 + (device type - 1), modern ones 0x1040 + device type.
+#define VIRTIO_PCI_TRANSITIONAL_DEVICE_ID_BASE 0x1000
+#define VIRTIO_PCI_MODERN_DEVICE_ID_BASE 0x1040
+
+#define VIRTIO_DEVICE_TYPE_NETWORK 1
+#define VIRTIO_DEVICE_TYPE_BLOCK 2
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 1
+#define VIRTIO_STATUS_DRIVER 2
+#define VIRTIO_STATUS_DRIVER_OK 4
+#define VIRTIO_STATUS_FEATURES_OK 8
+#define VIRTIO_STATUS_DEVICE_NEEDS_RESET 64
+#define VIRTIO_STATUS_FAILED 128
+
+#define VIRTIO_F_INDIRECT_DESC ((u64)1 << 28)
+#define VIRTIO_F_RING_EVENT_IDX ((u64)1 << 29)
+#define VIRTIO_F_VERSION_1 ((u64)1 << 32)
+
+#define VIRTIO_PCI_CAP_COMMON_CFG 1
+#define VIRTIO_PCI_CAP_NOTIFY_CFG 2
+#define VIRTIO_PCI_CAP_ISR_CFG 3
+#define VIRTIO_PCI_CAP_DEVICE_CFG 4
+
+#define VIRTIO_ISR_QUEUE_INTERRUPT 1
+#define VIRTIO_ISR_DEVICE_CONFIG_INTERRUPT 2
+
+#define VIRTIO_MSI_NO_VECTOR 0xffff
+
+struct [[gnu::packed]] VirtIOCommonConfig {
+    u32 device_feature_select;
+    u32 device_feature;
+    u32 driver_feature_select;
+    u32 driver_feature;
+    u16 msix_config;
+    u16 num_queues;
+    u8 device_status;
+    u8 config_generation;
+    u16 queue_select;
+    u16 queue_size;
+    u16 queue_msix_vector;
+    u16 queue_enable;
+    u16 queue_notify_off;
+    u32 queue_desc_low;
+    u32 queue_desc_high;
+    u32 queue_driver_low;
+    u32 queue_driver_high;
+    u32 queue_device_low;
+    u32 queue_device_high;
+};
+
+// The modern (VirtIO 1.0+) PCI transport. Subclasses negotiate features, set up
+// their queues and then get called back from the interrupt handler.
+class VirtIODevice : public PCI::Device {
+public:
+    virtual ~VirtIODevice() override;
+
+    static bool is_virtio_device(PCI::ID, u16 device_type);
+
+protected:
+    VirtIODevice(PCI::Address, const char* class_name);
+
+    // Maps the configuration structures and resets the device. Returns false
+    // if the device doesn't implement the modern interface.
+    bool initialize();
+
+    // Offers the device's features to the callback, which returns the subset we accept.
+    // VIRTIO_F_VERSION_1 is required, VIRTIO_F_RING_EVENT_IDX is accepted if offered.
+    bool negotiate_features(Function<u64(u64)> accept_features);
+    bool is_feature_accepted(u64 feature) const { return (m_accepted_features & feature) == feature; }
+
+    bool setup_queues(u16 queue_count, u16 max_queue_size);
+    void finish_initialization();
+
+    VirtIOQueue& queue(u16 queue_index)
+    {
+        VERIFY(queue_index < m_queues.size());
+        return m_queues[queue_index];
+    }
+    void notify_queue(u16 queue_index);
+
+    // Reads from the device-specific configuration structure.
+    u8 config_read8(u32 offset) const;
+    u16 config_read16(u32 offset) const;
+    u32 config_read32(u32 offset) const;
+    u64 config_read64(u32 offset) const;
+    bool has_device_config() const { return m_device_config; }
+
+    virtual void handle_device_config_change() = 0;
+    // Called from the interrupt handler for every queue, it's up to the subclass
+    // to check whether the device actually used any buffers.
+    virtual void handle_queue_update(u16 queue_index) = 0;
+
+private:
+    virtual void handle_irq(const RegisterState&) override;
+
+    struct Configuration {
+        u8 capability_offset;
+        u8 bar;
+        u32 offset;
+        u32 length;
+    };
+    Optional<Configuration> find_configuration(u8 type) const;
+    u8* map_configuration(const Configuration&);
+
+    void set_status_bit(u8);
+    u8 read_status() const { return m_common_config->device_status; }
+
+    const char* const m_class_name;
+    OwnPtr<Region> m_bar_regions[6];
+    volatile VirtIOCommonConfig* m_common_config { nullptr };
+    volatile u8* m_isr { nullptr };
+    volatile u8* m_notify_base { nullptr };
+    u32 m_notify_multiplier { 0 };
+    volatile u8* m_device_config { nullptr };
+    u64 m_accepted_features { 0 };
+    NonnullOwnPtrVector<VirtIOQueue> m_queues;
+};
+
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Debug.h>
+#include <Kernel/VirtIO/VirtIOBlock.h>
+#include <Kernel/WorkQueue.h>
+
+namespace Kernel {
+
+UNMAP_AFTER_INIT OwnPtr<VirtIOBlock> VirtIOBlock::try_create(PCI::Address address)
+{
+    auto block = adopt_own(*new VirtIOBlock(address));
+    if (!block->initialize_device())
+        return {};
+    return block;
+}
+
+UNMAP_AFTER_INIT VirtIOBlock::VirtIOBlock(PCI::Address address)
+    : VirtIODevice(address, "VirtIOBlock")
+{
+}
+
+VirtIOBlock::~VirtIOBlock()
+{
+}
+
+UNMAP_AFTER_INIT bool VirtIOBlock::initialize_device()
+{
+    if (!initialize())
+        return false;
+    bool success = negotiate_features([](u64) {
+        return VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_RO;
+    });
+    if (!success || !has_device_config())
+        return false;
+    if (!setup_queues(1, max_queue_size))
+        return false;
+
+    m_capacity = config_read64(0);
+    if (is_feature_accepted(VIRTIO_BLK_F_SEG_MAX)) {
+        u32 max_segments = config_read32(12);
+        m_max_data_pages_per_request = clamp<size_t>(max_segments, 1, dma_pages_per_request);
+    }
+
+    // Every request takes a descriptor for its header, one for its status, and one per data page.
+    // Only start as many requests as we can always find descriptors for.
+    m_request_slot_count = min(max_request_slots, queue(request_queue_index).size() / (m_max_data_pages_per_request + 2));
+    if (m_request_slot_count == 0) {
+        dmesgln("VirtIOBlock: Queue is too small");
+        return false;
+    }
+
+    m_header_region = MM.allocate_kernel_region(PAGE_SIZE, "VirtIOBlock Request Headers", Region::Access::Read | Region::Access::Write, AllocationStrategy::AllocateNow);
+    if (!m_header_region)
+        return false;
+
+    finish_initialization();
+    dmesgln("VirtIOBlock: Capacity={}, read-only={}, {} request(s) of up to {} bytes in flight", m_capacity * sector_size, is_read_only(), m_request_slot_count, m_max_data_pages_per_request * PAGE_SIZE);
+    return true;
+}
+
+void VirtIOBlock::handle_device_config_change()
+{
+    // FIXME: Resize the disk when the capacity changes.
+    dbgln_if(VIRTIO_DEBUG, "VirtIOBlock: Device configuration changed");
+}
+
+void VirtIOBlock::handle_queue_update(u16 queue_index)
+{
+    VERIFY(queue_index == request_queue_index);
+    auto& queue = this->queue(queue_index);
+    {
+        ScopedSpinLock lock(queue.lock());
+        if (!queue.new_data_available())
+            return;
+        // There's no point in more interrupts until the work item below has reaped what's there.
+        queue.disable_interrupts();
+    }
+    // Copying data into the request buffers can page fault, so we can't do it in the irq handler.
+    if (!m_completion_work_queued.exchange(true)) {
+        g_io_work->queue([this]() {
+            finish_completed_requests();
+        });
+    }
+}
+
+void VirtIOBlock::start_request(AsyncBlockDeviceRequest& request)
+{
+    Optional<AsyncDeviceRequest::RequestResult> failure;
+    {
+        LOCKER(m_lock);
+        failure = submit_request(request);
+    }
+    if (failure.has_value()) {
+        dbgln_if(VIRTIO_DEBUG, "VirtIOBlock: Request failure.");
+        request.complete(failure.value());
+    }
+}
+
+Optional<AsyncDeviceRequest::RequestResult> VirtIOBlock::submit_request(AsyncBlockDeviceRequest& request)
+{
+    VERIFY(m_lock.is_locked());
+    if (request.block_count() == 0 || request.block_count() > max_blocks_per_request())
+        return AsyncDeviceRequest::Failure;
+    bool is_write = request.request_type() == AsyncBlockDeviceRequest::Write;
+    if (is_write && is_read_only())
+        return AsyncDeviceRequest::Failure;
+
+    // The Device layer never starts more requests than max_requests_in_flight() at once.
+    Optional<size_t> slot_index;
+    for (size_t i = 0; i < m_request_slot_count; i++) {
+        if (!m_request_slots[i].request) {
+            slot_index = i;
+            break;
+        }
+    }
+    VERIFY(slot_index.has_value());
+    auto& slot = m_request_slots[slot_index.value()];
+
+    if (!slot.dma_region) {
+        slot.dma_region = MM.allocate_kernel_region(dma_pages_per_request * PAGE_SIZE, "VirtIOBlock DMA", Region::Access::Read | Region::Access::Write, AllocationStrategy::AllocateNow);
+        if (!slot.dma_region)
+            return AsyncDeviceRequest::Failure;
+    }
+
+    size_t transfer_size = request.block_count() * sector_size;
+    if (is_write && !request.read_from_buffer(request.buffer(), slot.dma_region->vaddr().as_ptr(), transfer_size))
+        return AsyncDeviceRequest::MemoryFault;
+
+    size_t header_offset = slot_index.value() * header_entry_size;
+    auto& header = *(RequestHeader*)m_header_region->vaddr().offset(header_offset).as_ptr();
+    header.type = is_write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    header.reserved = 0;
+    header.sector = request.block_index();
+    *(volatile u8*)m_header_region->vaddr().offset(header_offset + sizeof(RequestHeader)).as_ptr() = 0xff;
+    auto header_address = m_header_region->physical_page(0)->paddr().offset(header_offset);
+
+    Vector<VirtIOScatterEntry, dma_pages_per_request + 2> entries;
+    entries.append({ header_address, sizeof(RequestHeader), BufferType::DeviceReadable });
+    for (size_t offset = 0; offset < transfer_size; offset += PAGE_SIZE) {
+        auto data_address = slot.dma_region->physical_page(offset / PAGE_SIZE)->paddr();
+        entries.append({ data_address, min(transfer_size - offset, static_cast<size_t>(PAGE_SIZE)), is_write ? BufferType::DeviceReadable : BufferType::DeviceWritable });
+    }
+    entries.append({ header_address.offset(sizeof(RequestHeader)), 1, BufferType::DeviceWritable });
+
+    dbgln_if(VIRTIO_DEBUG, "VirtIOBlock: Do a {}, sector {}, count {} in slot {}", is_write ? "write" : "read", request.block_index(), request.block_count(), slot_index.value());
+    slot.request = request;
+
+    auto& queue = this->queue(request_queue_index);
+    ScopedSpinLock lock(queue.lock());
+    bool did_supply = queue.supply_buffers(entries.span(), &slot);
+    // The slot count is chosen so that this always fits.
+    VERIFY(did_supply);
+    if (queue.should_notify())
+        notify_queue(request_queue_index);
+    return {};
+}
+
+void VirtIOBlock::finish_completed_requests()
+{
+    Vector<FinishedRequest> finished_requests;
+    {
+        LOCKER(m_lock);
+        // Any interrupt from here on has to queue another round.
+        m_completion_work_queued = false;
+
+        Vector<RequestSlot*, max_request_slots> completed_slots;
+        {
+            auto& queue = this->queue(request_queue_index);
+            ScopedSpinLock lock(queue.lock());
+            for (;;) {
+                while (auto* token = queue.get_buffer(nullptr))
+                    completed_slots.append(static_cast<RequestSlot*>(token));
+                queue.enable_interrupts();
+                if (!queue.new_data_available())
+                    break;
+                queue.disable_interrupts();
+            }
+        }
+
+        for (auto* slot : completed_slots) {
+            size_t slot_index = slot - m_request_slots;
+            auto request = slot->request.release_nonnull();
+            u8 status = *(volatile u8*)m_header_region->vaddr().offset(slot_index * header_entry_size + sizeof(RequestHeader)).as_ptr();
+
+            auto result = AsyncDeviceRequest::Success;
+            if (status != VIRTIO_BLK_S_OK) {
+                dbgln("VirtIOBlock: Request for sector {} failed with status {}", request->block_index(), status);
+                result = AsyncDeviceRequest::Failure;
+            } else if (request->request_type() == AsyncBlockDeviceRequest::Read) {
+                if (!request->write_to_buffer(request->buffer(), slot->dma_region->vaddr().as_ptr(), request->block_count() * sector_size)) {
+                    dbgln_if(VIRTIO_DEBUG, "VirtIOBlock: Request failure, memory fault occurred when reading in data.");
+                    result = AsyncDeviceRequest::MemoryFault;
+                }
+            }
+            finished_requests.append({ move(request), result });
+        }
+    }
+    for (auto& finished_request : finished_requests)
+        finished_request.request->complete(finished_request.result);
+}
+
+}
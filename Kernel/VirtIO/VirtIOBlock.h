@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Atomic.h>
+#include <AK/OwnPtr.h>
+#include <Kernel/Devices/BlockDevice.h>
+#include <Kernel/Lock.h>
+#include <Kernel/VirtIO/VirtIO.h>
+
+namespace Kernel {
+
+#define VIRTIO_BLK_F_SEG_MAX ((u64)1 << 2)
+#define VIRTIO_BLK_F_RO ((u64)1 << 5)
+
+#define VIRTIO_BLK_T_IN 0
+#define VIRTIO_BLK_T_OUT 1
+
+#define VIRTIO_BLK_S_OK 0
+#define VIRTIO_BLK_S_IOERR 1
+#define VIRTIO_BLK_S_UNSUPP 2
+
+class VirtIOBlock final : public VirtIODevice {
+public:
+    static OwnPtr<VirtIOBlock> try_create(PCI::Address);
+    virtual ~VirtIOBlock() override;
+
+    static constexpr size_t sector_size = 512;
+
+    // The capacity is always given in 512-byte sectors.
+    u64 capacity() const { return m_capacity; }
+    bool is_read_only() const { return is_feature_accepted(VIRTIO_BLK_F_RO); }
+
+    size_t max_requests_in_flight() const { return m_request_slot_count; }
+    size_t max_blocks_per_request() const { return m_max_data_pages_per_request * PAGE_SIZE / sector_size; }
+
+    void start_request(AsyncBlockDeviceRequest&);
+
+    virtual const char* purpose() const override { return "VirtIO Block"; }
+
+private:
+    explicit VirtIOBlock(PCI::Address);
+    bool initialize_device();
+
+    virtual void handle_device_config_change() override;
+    virtual void handle_queue_update(u16 queue_index) override;
+
+    Optional<AsyncDeviceRequest::RequestResult> submit_request(AsyncBlockDeviceRequest&);
+    void finish_completed_requests();
+
+    static constexpr u16 request_queue_index = 0;
+    static constexpr u16 max_queue_size = 256;
+    static constexpr size_t dma_pages_per_request = 16;
+    static constexpr size_t max_request_slots = 32;
+
+    struct [[gnu::packed]] RequestHeader {
+        u32 type;
+        u32 reserved;
+        u64 sector;
+    };
+    // Each request slot gets one of these in m_header_region: the header, followed by the status byte the device writes.
+    static constexpr size_t header_entry_size = 32;
+    static_assert(sizeof(RequestHeader) + 1 <= header_entry_size);
+    static_assert(max_request_slots * header_entry_size <= PAGE_SIZE);
+
+    struct RequestSlot {
+        OwnPtr<Region> dma_region;
+        RefPtr<AsyncBlockDeviceRequest> request;
+    };
+
+    struct FinishedRequest {
+        NonnullRefPtr<AsyncBlockDeviceRequest> request;
+        AsyncDeviceRequest::RequestResult result;
+    };
+
+    RequestSlot m_request_slots[max_request_slots];
+    size_t m_request_slot_count { 0 };
+    size_t m_max_data_pages_per_request { dma_pages_per_request };
+    OwnPtr<Region> m_header_region;
+    u64 m_capacity { 0 };
+    Atomic<bool> m_completion_work_queued { false };
+    Lock m_lock { "VirtIOBlock" };
+};
+
+}
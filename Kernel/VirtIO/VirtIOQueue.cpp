@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Atomic.h>
+#include <Kernel/StdLib.h>
+#include <Kernel/VirtIO/VirtIOQueue.h>
+
+namespace Kernel {
+
+VirtIOQueue::VirtIOQueue(u16 queue_size, u16 notify_offset, bool event_index_enabled)
+    : m_queue_size(queue_size)
+    , m_notify_offset(notify_offset)
+    , m_event_index_enabled(event_index_enabled)
+    , m_free_descriptors(queue_size)
+{
+    // The three areas live in one physically contiguous allocation, laid out with
+    // the alignment the legacy interface demanded, which is stricter than needed.
+    size_t descriptors_size = sizeof(Descriptor) * queue_size;
+    size_t driver_size = sizeof(DriverArea) + sizeof(u16) * (queue_size + 1);
+    size_t device_offset = round_up_to_power_of_two(descriptors_size + driver_size, 4);
+    size_t device_size = sizeof(DeviceArea) + sizeof(UsedElement) * queue_size + sizeof(u16);
+    m_queue_region = MM.allocate_contiguous_kernel_region(page_round_up(device_offset + device_size), "VirtIO Queue", Region::Access::Read | Region::Access::Write);
+    if (!m_queue_region)
+        return;
+    memset(m_queue_region->vaddr().as_ptr(), 0, m_queue_region->size());
+
+    m_descriptors = (volatile Descriptor*)m_queue_region->vaddr().as_ptr();
+    m_driver = (volatile DriverArea*)m_queue_region->vaddr().offset(descriptors_size).as_ptr();
+    m_device = (volatile DeviceArea*)m_queue_region->vaddr().offset(device_offset).as_ptr();
+
+    // Unused descriptors form a free list, linked through their next fields.
+    for (u16 i = 0; i < queue_size; i++)
+        m_descriptors[i].next = (i + 1) % queue_size;
+    m_tokens.resize(queue_size);
+}
+
+VirtIOQueue::~VirtIOQueue()
+{
+}
+
+bool VirtIOQueue::supply_buffers(Span<const VirtIOScatterEntry> entries, void* token)
+{
+    VERIFY(m_lock.is_locked());
+    VERIFY(!entries.is_empty());
+    VERIFY(token);
+    if (entries.size() > m_free_descriptors)
+        return false;
+
+    u16 head = m_free_head;
+    u16 descriptor_index = head;
+    for (size_t i = 0; i < entries.size(); i++) {
+        auto& descriptor = m_descriptors[descriptor_index];
+        descriptor.address = entries[i].address.get();
+        descriptor.length = entries[i].length;
+        descriptor.flags = entries[i].type == BufferType::DeviceWritable ? VIRTQ_DESC_F_WRITE : 0;
+        if (i + 1 < entries.size())
+            descriptor.flags = descriptor.flags | VIRTQ_DESC_F_NEXT;
+        // The next field still links to the next free descriptor, which is exactly
+        // where both the chain and the free list continue.
+        descriptor_index = descriptor.next;
+    }
+    m_free_head = descriptor_index;
+    m_free_descriptors -= entries.size();
+    m_tokens[head] = token;
+
+    m_driver->rings[m_driver_index_shadow % m_queue_size] = head;
+    // The device must see the descriptors and the ring entry before the new index.
+    full_memory_barrier();
+    m_driver_index_shadow++;
+    m_driver->index = m_driver_index_shadow;
+    return true;
+}
+
+bool VirtIOQueue::should_notify()
+{
+    VERIFY(m_lock.is_locked());
+    // Make sure we read the device's suppression state after publishing the new index.
+    full_memory_barrier();
+    u16 new_index = m_driver_index_shadow;
+    u16 old_index = m_last_notified_index;
+    m_last_notified_index = new_index;
+    if (new_index == old_index)
+        return false;
+    if (m_event_index_enabled) {
+        // Only notify if the device asked to hear about one of the entries we just added.
+        u16 event = available_event();
+        return (u16)(new_index - event - 1) < (u16)(new_index - old_index);
+    }
+    return !(m_device->flags & VIRTQ_USED_F_NO_NOTIFY);
+}
+
+bool VirtIOQueue::new_data_available() const
+{
+    return m_device->index != m_used_tail;
+}
+
+void* VirtIOQueue::get_buffer(size_t* used_length)
+{
+    VERIFY(m_lock.is_locked());
+    if (!new_data_available())
+        return nullptr;
+    // Don't read the used element before we've seen the index that covers it.
+    full_memory_barrier();
+
+    auto& element = m_device->rings[m_used_tail % m_queue_size];
+    u16 head = element.index;
+    VERIFY(head < m_queue_size);
+    if (used_length)
+        *used_length = element.length;
+    m_used_tail++;
+
+    void* token = m_tokens[head];
+    VERIFY(token);
+    m_tokens[head] = nullptr;
+
+    // Put the whole chain back at the front of the free list.
+    u16 last = head;
+    size_t chain_length = 1;
+    while (m_descriptors[last].flags & VIRTQ_DESC_F_NEXT) {
+        last = m_descriptors[last].next;
+        chain_length++;
+    }
+    m_descriptors[last].next = m_free_head;
+    m_free_head = head;
+    m_free_descriptors += chain_length;
+    return token;
+}
+
+void VirtIOQueue::enable_interrupts()
+{
+    VERIFY(m_lock.is_locked());
+    if (m_event_index_enabled)
+        used_event() = m_used_tail;
+    else
+        m_driver->flags = 0;
+    // Callers have to check new_data_available() again after this, in case the
+    // device used a buffer before it could see that we want an interrupt.
+    full_memory_barrier();
+}
+
+void VirtIOQueue::disable_interrupts()
+{
+    VERIFY(m_lock.is_locked());
+    // With event indices the flag is ignored, and leaving the used event where it
+    // is means we get at most one more interrupt.
+    if (!m_event_index_enabled)
+        m_driver->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+}
+
+}
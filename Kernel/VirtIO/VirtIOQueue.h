@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Span.h>
+#include <AK/Vector.h>
+#include <Kernel/PhysicalAddress.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/VM/MemoryManager.h>
+
+namespace Kernel {
+
+#define VIRTQ_DESC_F_NEXT 1
+#define VIRTQ_DESC_F_WRITE 2
+#define VIRTQ_DESC_F_INDIRECT 4
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 1
+#define VIRTQ_USED_F_NO_NOTIFY 1
+
+enum class BufferType {
+    DeviceReadable,
+    DeviceWritable
+};
+
+struct VirtIOScatterEntry {
+    PhysicalAddress address;
+    size_t length { 0 };
+    BufferType type { BufferType::DeviceReadable };
+};
+
+// A split virtqueue, as described in section 2.6 of the VirtIO 1.1 specification.
+// All methods except the constructor must be called with lock() held.
+class VirtIOQueue {
+public:
+    VirtIOQueue(u16 queue_size, u16 notify_offset, bool event_index_enabled);
+    ~VirtIOQueue();
+
+    bool is_null() const { return !m_queue_region; }
+    u16 size() const { return m_queue_size; }
+    u16 notify_offset() const { return m_notify_offset; }
+    size_t free_descriptor_count() const { return m_free_descriptors; }
+
+    PhysicalAddress descriptor_area() const { return physical_address_of(m_descriptors); }
+    PhysicalAddress driver_area() const { return physical_address_of(m_driver); }
+    PhysicalAddress device_area() const { return physical_address_of(m_device); }
+
+    // Makes a descriptor chain available to the device. The device is not notified,
+    // so several chains can be supplied before a single call to should_notify().
+    bool supply_buffers(Span<const VirtIOScatterEntry>, void* token);
+
+    // Whether the device wants to be notified about the chains supplied since the last call.
+    bool should_notify();
+
+    bool new_data_available() const;
+    // Returns the token of the next chain the device is done with, or nullptr if there is none.
+    void* get_buffer(size_t* used_length);
+
+    void enable_interrupts();
+    void disable_interrupts();
+
+    SpinLock<u8>& lock() { return m_lock; }
+
+private:
+    struct Descriptor {
+        u64 address;
+        u32 length;
+        u16 flags;
+        u16 next;
+    };
+
+    struct DriverArea {
+        u16 flags;
+        u16 index;
+        u16 rings[];
+    };
+
+    struct UsedElement {
+        u32 index;
+        u32 length;
+    };
+
+    struct DeviceArea {
+        u16 flags;
+        u16 index;
+        UsedElement rings[];
+    };
+
+    PhysicalAddress physical_address_of(const volatile void* pointer) const
+    {
+        auto offset = (const volatile u8*)pointer - m_queue_region->vaddr().as_ptr();
+        return m_queue_region->physical_page(0)->paddr().offset(offset);
+    }
+
+    volatile u16& used_event() { return m_driver->rings[m_queue_size]; }
+    volatile u16& available_event() { return *(volatile u16*)((volatile u8*)m_device + sizeof(DeviceArea) + sizeof(UsedElement) * m_queue_size); }
+
+    const u16 m_queue_size;
+    const u16 m_notify_offset;
+    const bool m_event_index_enabled;
+    u16 m_free_descriptors { 0 };
+    u16 m_free_head { 0 };
+    u16 m_used_tail { 0 };
+    u16 m_driver_index_shadow { 0 };
+    u16 m_last_notified_index { 0 };
+
+    volatile Descriptor* m_descriptors { nullptr };
+    volatile DriverArea* m_driver { nullptr };
+    volatile DeviceArea* m_device { nullptr };
+    Vector<void*> m_tokens;
+    OwnPtr<Region> m_queue_region;
+    SpinLock<u8> m_lock;
+};
+
+}
@@ -32,10 +32,13 @@
 namespace Kernel {
 
 WorkQueue* g_io_work;
+WorkQueue* g_fs_work;
 
 void WorkQueue::initialize()
 {
     g_io_work = new WorkQueue("IO WorkQueue");
+    // NOTE: Work on this queue may block on I/O, which in turn may need g_io_work to complete.
+    g_fs_work = new WorkQueue("FS WorkQueue");
 }
 
 WorkQueue::WorkQueue(const char* name)
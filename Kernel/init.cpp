@@ -58,6 +58,7 @@
 #include <Kernel/Net/NE2000NetworkAdapter.h>
 #include <Kernel/Net/NetworkTask.h>
 #include <Kernel/Net/RTL8139NetworkAdapter.h>
+#include <Kernel/Net/VirtIONetworkAdapter.h>
 #include <Kernel/PCI/Access.h>
 #include <Kernel/PCI/Initializer.h>
 #include <Kernel/Panic.h>
@@ -69,6 +70,7 @@
 #include <Kernel/TTY/PTYMultiplexer.h>
 #include <Kernel/TTY/VirtualConsole.h>
 #include <Kernel/Tasks/FinalizerTask.h>
+#include <Kernel/Tasks/MemoryPressureTask.h>
 #include <Kernel/Tasks/SyncTask.h>
 #include <Kernel/Time/TimeManagement.h>
 #include <Kernel/VM/MemoryManager.h>
@@ -248,6 +250,7 @@ void init_stage2(void*)
 
     SyncTask::spawn();
     FinalizerTask::spawn();
+    MemoryPressureTask::spawn();
 
     PCI::initialize();
     auto boot_profiling = kernel_command_line().is_boot_profiling_enabled();
@@ -284,6 +287,7 @@ void init_stage2(void*)
     E1000NetworkAdapter::detect();
     NE2000NetworkAdapter::detect();
     RTL8139NetworkAdapter::detect();
+    VirtIONetworkAdapter::detect();
 
     LoopbackAdapter::the();
 
@@ -22,16 +22,20 @@ set(IOAPIC_DEBUG ON)
 set(IRQ_DEBUG ON)
 set(INTERRUPT_DEBUG ON)
 set(E1000_DEBUG ON)
+set(VIRTIO_DEBUG ON)
 set(IPV4_SOCKET_DEBUG ON)
 set(LOCAL_SOCKET_DEBUG ON)
+set(LOOPBACK_DEBUG ON)
 set(SOCKET_DEBUG ON)
 set(TCP_SOCKET_DEBUG ON)
 set(PCI_DEBUG ON)
 set(PATA_DEBUG ON)
 set(AHCI_DEBUG ON)
 set(IO_DEBUG ON)
+set(IO_SCHEDULER_DEBUG ON)
 set(FORK_DEBUG ON)
 set(POLL_SELECT_DEBUG ON)
+set(EPOLL_DEBUG ON)
 set(HPET_DEBUG ON)
 set(HPET_COMPARATOR_DEBUG ON)
 set(MASTERPTY_DEBUG ON)
@@ -140,6 +144,7 @@ set(LOOKUPSERVER_DEBUG ON)
 set(MALLOC_DEBUG ON)
 set(MBR_DEBUG ON)
 set(MEMORY_DEBUG ON)
+set(MEMORY_PRESSURE_DEBUG ON)
 set(MENU_DEBUG ON)
 set(NETWORK_TASK_DEBUG ON)
 set(OBJECT_DEBUG ON)
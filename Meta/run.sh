@@ -137,6 +137,26 @@ elif [ "$SERENITY_RUN" = "qcmd" ]; then
         -device e1000,netdev=breh \
         -kernel Kernel/Kernel \
         -append "${SERENITY_KERNEL_CMDLINE}"
+elif [ "$SERENITY_RUN" = "qvirtio" ]; then
+    # Meta/run.sh qvirtio: qemu with the disk and network on virtio devices
+    "$SERENITY_QEMU_BIN" \
+        $SERENITY_EXTRA_QEMU_ARGS \
+        -s -m $SERENITY_RAM_SIZE \
+        -cpu $SERENITY_QEMU_CPU \
+        -d guest_errors \
+        -smp 2 \
+        -device VGA,vgamem_mb=64 \
+        -drive file=${SERENITY_DISK_IMAGE},format=raw,id=disk,if=none \
+        -device virtio-blk-pci,drive=disk,disable-legacy=on \
+        -usb \
+        -debugcon stdio \
+        -soundhw pcspk \
+        -device sb16 \
+        $SERENITY_VIRT_TECH_ARG \
+        -netdev user,id=breh,hostfwd=tcp:127.0.0.1:8888-10.0.2.15:8888,hostfwd=tcp:127.0.0.1:8823-10.0.2.15:23 \
+        -device virtio-net-pci,netdev=breh,disable-legacy=on \
+        -kernel Kernel/Kernel \
+        -append "${SERENITY_KERNEL_CMDLINE}"
 elif [ "$SERENITY_RUN" = "ci" ]; then
     # Meta/run.sh ci: qemu in text mode
     echo "Running QEMU in CI"
@@ -155,6 +155,10 @@ private:
     int virt$getsockname(FlatPtr);
     int virt$getpeername(FlatPtr);
     int virt$select(FlatPtr);
+    int virt$epoll_create(int flags);
+    int virt$epoll_ctl(FlatPtr);
+    int virt$epoll_wait(FlatPtr);
+    int virt$sendfile(FlatPtr);
     int virt$get_stack_bounds(FlatPtr, FlatPtr);
     int virt$accept(int sockfd, FlatPtr address, FlatPtr address_length);
     int virt$bind(int sockfd, FlatPtr address, socklen_t address_length);
@@ -32,6 +32,8 @@
 #include <sched.h>
 #include <serenity.h>
 #include <strings.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/select.h>
@@ -206,6 +208,14 @@ u32 Emulator::virt_syscall(u32 function, u32 arg1, u32 arg2, u32 arg3)
         return virt$listen(arg1, arg2);
     case SC_select:
         return virt$select(arg1);
+    case SC_epoll_create:
+        return virt$epoll_create(arg1);
+    case SC_epoll_ctl:
+        return virt$epoll_ctl(arg1);
+    case SC_epoll_wait:
+        return virt$epoll_wait(arg1);
+    case SC_sendfile:
+        return virt$sendfile(arg1);
     case SC_recvmsg:
         return virt$recvmsg(arg1, arg2, arg3);
     case SC_sendmsg:
@@ -700,6 +710,72 @@ int Emulator::virt$select(FlatPtr params_addr)
     return rc;
 }
 
+int Emulator::virt$epoll_create(int flags)
+{
+    int rc = epoll_create1(flags);
+    if (rc < 0)
+        return -errno;
+    return rc;
+}
+
+int Emulator::virt$epoll_ctl(FlatPtr params_addr)
+{
+    Syscall::SC_epoll_ctl_params params;
+    mmu().copy_from_vm(&params, params_addr, sizeof(params));
+
+    epoll_event event {};
+    if (params.event)
+        mmu().copy_from_vm(&event, (FlatPtr)params.event, sizeof(event));
+
+    int rc = epoll_ctl(params.epfd, params.op, params.fd, params.event ? &event : nullptr);
+    if (rc < 0)
+        return -errno;
+    return rc;
+}
+
+int Emulator::virt$epoll_wait(FlatPtr params_addr)
+{
+    Syscall::SC_epoll_wait_params params;
+    mmu().copy_from_vm(&params, params_addr, sizeof(params));
+
+    if (params.maxevents <= 0)
+        return -EINVAL;
+
+    struct timespec timeout;
+    u32 sigmask;
+    if (params.timeout)
+        mmu().copy_from_vm(&timeout, (FlatPtr)params.timeout, sizeof(timeout));
+    if (params.sigmask)
+        mmu().copy_from_vm(&sigmask, (FlatPtr)params.sigmask, sizeof(sigmask));
+
+    Vector<epoll_event> events;
+    events.resize(params.maxevents);
+    Syscall::SC_epoll_wait_params host_params { params.epfd, events.data(), params.maxevents, params.timeout ? &timeout : nullptr, params.sigmask ? &sigmask : nullptr };
+    int rc = syscall(SC_epoll_wait, &host_params);
+    if (rc < 0)
+        return rc;
+
+    mmu().copy_to_vm((FlatPtr)params.events, events.data(), rc * sizeof(epoll_event));
+    return rc;
+}
+
+int Emulator::virt$sendfile(FlatPtr params_addr)
+{
+    Syscall::SC_sendfile_params params;
+    mmu().copy_from_vm(&params, params_addr, sizeof(params));
+
+    off_t offset = 0;
+    if (params.offset)
+        mmu().copy_from_vm(&offset, (FlatPtr)params.offset, sizeof(offset));
+
+    int rc = sendfile(params.out_fd, params.in_fd, params.offset ? &offset : nullptr, params.count);
+    if (rc < 0)
+        return -errno;
+    if (params.offset)
+        mmu().copy_to_vm((FlatPtr)params.offset, &offset, sizeof(offset));
+    return rc;
+}
+
 int Emulator::virt$getsockopt(FlatPtr params_addr)
 {
     Syscall::SC_getsockopt_params params;
@@ -29,7 +29,10 @@
 #include <LibELF/AuxiliaryVector.h>
 #include <LibELF/DynamicLinker.h>
 
-char* __static_environ[] = { nullptr }; // We don't get the environment without some libc workarounds..
+// We don't get the environment without some libc workarounds..
+// The extra null pointers after the terminator make up an empty (AT_NULL) auxiliary vector, so that
+// getauxval() in the static libc copy finds nothing rather than reading past the end of this array.
+char* __static_environ[] = { nullptr, nullptr, nullptr };
 
 static void init_libc()
 {
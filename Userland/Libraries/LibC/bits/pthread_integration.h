@@ -38,6 +38,8 @@ void __pthread_fork_atfork_register_parent(void (*)(void));
 void __pthread_fork_atfork_register_child(void (*)(void));
 
 int __pthread_mutex_lock(void*);
+int __pthread_mutex_trylock(void*);
+int __pthread_mutex_lock_pessimistic_np(void*);
 int __pthread_mutex_unlock(void*);
 int __pthread_mutex_init(void*, const void*);
 
@@ -45,9 +47,11 @@ int __pthread_self();
 
 #define __PTHREAD_MUTEX_NORMAL 0
 #define __PTHREAD_MUTEX_RECURSIVE 1
-#define __PTHREAD_MUTEX_INITIALIZER     \
-    {                                   \
-        0, 0, 0, __PTHREAD_MUTEX_NORMAL \
+#define __PTHREAD_PRIO_NONE 0
+#define __PTHREAD_PRIO_INHERIT 1
+#define __PTHREAD_MUTEX_INITIALIZER                          \
+    {                                                        \
+        0, 0, 0, __PTHREAD_MUTEX_NORMAL, __PTHREAD_PRIO_NONE \
     }
 
 __END_DECLS
@@ -29,7 +29,8 @@
 #include <AK/Types.h>
 #include <AK/Vector.h>
 #include <bits/pthread_integration.h>
-#include <sched.h>
+#include <errno.h>
+#include <serenity.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -110,36 +111,100 @@ int __pthread_self()
     return gettid();
 }
 
-int __pthread_mutex_lock(void* mutexp)
+// A normal mutex is 0 when it's unlocked, 1 when it's locked and 2 when it's locked and
+// there may be threads waiting on it. A priority inheritance mutex holds the thread id of
+// its owner instead, and leaves queueing up waiters and handing it over to the kernel.
+enum MutexState : u32 {
+    Unlocked = 0,
+    Locked = 1,
+    LockedWithWaiters = 2,
+};
+
+static int mutex_futex(pthread_mutex_t* mutex, int futex_op, u32 value)
+{
+    int saved_errno = errno;
+    int rc = futex(&mutex->lock, futex_op, value, nullptr, nullptr, 0);
+    if (rc < 0) {
+        rc = errno;
+        errno = saved_errno;
+    }
+    return rc;
+}
+
+static u32 locked_state(pthread_mutex_t* mutex, pthread_t this_thread)
+{
+    return mutex->protocol == __PTHREAD_PRIO_INHERIT ? (u32)this_thread : Locked;
+}
+
+int __pthread_mutex_trylock(void* mutexp)
 {
     auto* mutex = reinterpret_cast<pthread_mutex_t*>(mutexp);
     auto& atomic = reinterpret_cast<Atomic<u32>&>(mutex->lock);
     pthread_t this_thread = __pthread_self();
-    for (;;) {
-        u32 expected = false;
-        if (!atomic.compare_exchange_strong(expected, true, AK::memory_order_acq_rel)) {
-            if (mutex->type == __PTHREAD_MUTEX_RECURSIVE && mutex->owner == this_thread) {
-                mutex->level++;
-                return 0;
-            }
-            sched_yield();
-            continue;
+    u32 expected = Unlocked;
+    if (!atomic.compare_exchange_strong(expected, locked_state(mutex, this_thread), AK::memory_order_acquire)) {
+        if (mutex->type == __PTHREAD_MUTEX_RECURSIVE && mutex->owner == this_thread) {
+            mutex->level++;
+            return 0;
         }
-        mutex->owner = this_thread;
-        mutex->level = 0;
-        return 0;
+        return EBUSY;
     }
+    mutex->owner = this_thread;
+    mutex->level = 0;
+    return 0;
+}
+
+int __pthread_mutex_lock_pessimistic_np(void* mutexp)
+{
+    auto* mutex = reinterpret_cast<pthread_mutex_t*>(mutexp);
+    auto& atomic = reinterpret_cast<Atomic<u32>&>(mutex->lock);
+    pthread_t this_thread = __pthread_self();
+    if (mutex->protocol == __PTHREAD_PRIO_INHERIT) {
+        for (;;) {
+            u32 expected = Unlocked;
+            if (atomic.compare_exchange_strong(expected, this_thread, AK::memory_order_acquire))
+                break;
+            // The kernel boosts the owner's priority while we wait, and hands the mutex to us.
+            int rc = mutex_futex(mutex, FUTEX_LOCK_PI, 0);
+            if (rc == 0)
+                break;
+            VERIFY(rc == EINTR);
+        }
+    } else {
+        // Assume there are other waiters, so that whoever unlocks the mutex wakes them up.
+        while (atomic.exchange(LockedWithWaiters, AK::memory_order_acquire) != Unlocked)
+            mutex_futex(mutex, FUTEX_WAIT, LockedWithWaiters);
+    }
+    mutex->owner = this_thread;
+    mutex->level = 0;
+    return 0;
+}
+
+int __pthread_mutex_lock(void* mutexp)
+{
+    if (__pthread_mutex_trylock(mutexp) == 0)
+        return 0;
+    return __pthread_mutex_lock_pessimistic_np(mutexp);
 }
 
 int __pthread_mutex_unlock(void* mutexp)
 {
     auto* mutex = reinterpret_cast<pthread_mutex_t*>(mutexp);
+    auto& atomic = reinterpret_cast<Atomic<u32>&>(mutex->lock);
     if (mutex->type == __PTHREAD_MUTEX_RECURSIVE && mutex->level > 0) {
         mutex->level--;
         return 0;
     }
     mutex->owner = 0;
-    mutex->lock = 0;
+    if (mutex->protocol == __PTHREAD_PRIO_INHERIT) {
+        u32 expected = __pthread_self();
+        // If anyone is waiting, FUTEX_WAITERS is set and the kernel has to pick the next owner.
+        if (!atomic.compare_exchange_strong(expected, Unlocked, AK::memory_order_release))
+            mutex_futex(mutex, FUTEX_UNLOCK_PI, 0);
+        return 0;
+    }
+    if (atomic.exchange(Unlocked, AK::memory_order_release) == LockedWithWaiters)
+        mutex_futex(mutex, FUTEX_WAKE, 1);
     return 0;
 }
 
@@ -151,6 +216,7 @@ int __pthread_mutex_init(void* mutexp, const void* attrp)
     mutex->owner = 0;
     mutex->level = 0;
     mutex->type = attributes ? attributes->type : __PTHREAD_MUTEX_NORMAL;
+    mutex->protocol = attributes ? attributes->protocol : __PTHREAD_PRIO_NONE;
     return 0;
 }
 }
@@ -78,6 +78,9 @@ int profiling_disable(pid_t);
 #define FUTEX_REQUEUE 3
 #define FUTEX_CMP_REQUEUE 4
 #define FUTEX_WAKE_OP 5
+#define FUTEX_LOCK_PI 6
+#define FUTEX_UNLOCK_PI 7
+#define FUTEX_TRYLOCK_PI 8
 #define FUTEX_WAIT_BITSET 9
 #define FUTEX_WAKE_BITSET 10
 
@@ -87,6 +90,11 @@ int profiling_disable(pid_t);
 
 #define FUTEX_BITSET_MATCH_ANY 0xffffffff
 
+// The futex word of a priority inheritance futex holds the owner's thread id
+#define FUTEX_WAITERS 0x80000000
+#define FUTEX_OWNER_DIED 0x40000000
+#define FUTEX_TID_MASK 0x3fffffff
+
 int futex(uint32_t* userspace_address, int futex_op, uint32_t value, const struct timespec* timeout, uint32_t* userspace_address2, uint32_t value3);
 
 #define PURGE_ALL_VOLATILE 0x1
@@ -35,6 +35,7 @@ typedef void (*AtExitFunction)(void*);
 extern void __libc_init();
 extern void __malloc_init();
 extern void __stdio_init();
+extern void __time_init();
 extern void _init();
 extern bool __environ_is_malloced;
 extern bool __stdio_is_initialized;
@@ -24,21 +24,100 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <AK/Atomic.h>
 #include <AK/String.h>
 #include <AK/StringBuilder.h>
 #include <AK/Time.h>
+#include <Kernel/API/TimePage.h>
+#include <LibELF/AuxiliaryVector.h>
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/internals.h>
 #include <sys/time.h>
 #include <sys/times.h>
 #include <syscall.h>
 #include <time.h>
 #include <utime.h>
 
+static TimePage* s_time_page;
+
+static u64 read_time_counter(const TimePage& page)
+{
+    auto* counter = reinterpret_cast<const volatile u32*>(reinterpret_cast<const u8*>(&page) + page.counter_offset);
+    // Counters are read in two halves, so make sure the low half didn't carry into the high half in between.
+    u32 low;
+    u32 high = counter[1];
+    for (;;) {
+        low = counter[0];
+        u32 new_high = counter[1];
+        if (new_high == high)
+            break;
+        high = new_high;
+    }
+    return ((u64)high << 32) | low;
+}
+
+// Reads a clock from the time page the kernel maps into every process, without making a syscall.
+// Returns false if the clock has to be read by the kernel instead.
+static bool read_clock_from_time_page(clockid_t clock_id, timespec& ts)
+{
+    auto* page = s_time_page;
+    if (!page)
+        return false;
+
+    bool is_epoch_clock = clock_id == CLOCK_REALTIME || clock_id == CLOCK_REALTIME_COARSE;
+    bool is_precise_clock = clock_id == CLOCK_MONOTONIC || clock_id == CLOCK_MONOTONIC_RAW;
+    if (!is_epoch_clock && !is_precise_clock && clock_id != CLOCK_MONOTONIC_COARSE)
+        return false;
+
+    i64 seconds;
+    u64 nanoseconds;
+    u64 counter_frequency;
+    u64 elapsed_ticks = 0;
+    u32 update_iteration;
+    do {
+        // The kernel bumps update1 before it touches the fields and stores the same value into update2
+        // afterwards. So start with update2, and if update1 still matches it once the fields have been
+        // read, no update happened in between.
+        update_iteration = AK::atomic_load(&page->update2, AK::memory_order_acquire);
+        if (is_epoch_clock) {
+            seconds = page->epoch_seconds;
+            nanoseconds = page->epoch_nanoseconds;
+        } else {
+            seconds = page->monotonic_seconds;
+            nanoseconds = page->monotonic_nanoseconds;
+        }
+        counter_frequency = page->counter_frequency;
+        if (is_precise_clock && counter_frequency)
+            elapsed_ticks = (read_time_counter(*page) - page->counter_at_update) & page->counter_mask;
+        AK::atomic_thread_fence(AK::memory_order_acquire);
+    } while (update_iteration != AK::atomic_load(&page->update1, AK::memory_order_relaxed));
+
+    if (elapsed_ticks) {
+        // The kernel updates the page on every timer tick, so a delta this large means that the
+        // counter was reset since the last update.
+        if (elapsed_ticks >= counter_frequency)
+            return false;
+        nanoseconds += elapsed_ticks * 1'000'000'000ull / counter_frequency;
+        seconds += nanoseconds / 1'000'000'000;
+        nanoseconds %= 1'000'000'000;
+    }
+
+    ts.tv_sec = seconds;
+    ts.tv_nsec = nanoseconds;
+    return true;
+}
+
 extern "C" {
 
+void __time_init()
+{
+    s_time_page = reinterpret_cast<TimePage*>(getauxval(AT_TIME_PAGE));
+}
+
 time_t time(time_t* tloc)
 {
     struct timeval tv;
@@ -58,6 +137,11 @@ int adjtime(const struct timeval* delta, struct timeval* old_delta)
 
 int gettimeofday(struct timeval* __restrict__ tv, void* __restrict__)
 {
+    timespec ts;
+    if (tv && read_clock_from_time_page(CLOCK_REALTIME, ts)) {
+        TIMESPEC_TO_TIMEVAL(tv, &ts);
+        return 0;
+    }
     int rc = syscall(SC_gettimeofday, tv);
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
@@ -358,6 +442,8 @@ clock_t clock()
 
 int clock_gettime(clockid_t clock_id, struct timespec* ts)
 {
+    if (ts && read_clock_from_time_page(clock_id, *ts))
+        return 0;
     int rc = syscall(SC_clock_gettime, clock_id, ts);
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
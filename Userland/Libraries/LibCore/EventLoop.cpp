@@ -55,6 +55,10 @@
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __serenity__
+#    include <sys/epoll.h>
+#endif
+
 namespace Core {
 
 class RPCClient;
@@ -81,6 +85,14 @@ static NeverDestroyed<IDAllocator> s_id_allocator;
 static HashMap<int, NonnullOwnPtr<EventLoopTimer>>* s_timers;
 static HashTable<Notifier*>* s_notifiers;
 int EventLoop::s_wake_pipe_fds[2];
+#ifdef __serenity__
+// The notifiers are registered with the kernel once and stay registered, so waiting
+// for events doesn't cost anything for the (usually many) idle file descriptors.
+// The kernel only knows about each file descriptor once, so we keep track of all
+// the notifiers interested in it ourselves.
+static int s_epoll_fd = -1;
+static HashMap<int, Vector<Notifier*, 1>>* s_notifiers_by_fd;
+#endif
 static RefPtr<LocalServer> s_rpc_server;
 HashMap<int, RefPtr<RPCClient>> s_rpc_clients;
 
@@ -283,6 +295,9 @@ EventLoop::EventLoop()
         s_event_loop_stack = new Vector<EventLoop*>;
         s_timers = new HashMap<int, NonnullOwnPtr<EventLoopTimer>>;
         s_notifiers = new HashTable<Notifier*>;
+#ifdef __serenity__
+        s_notifiers_by_fd = new HashMap<int, Vector<Notifier*, 1>>;
+#endif
     }
 
     if (!s_main_event_loop) {
@@ -297,6 +312,15 @@ EventLoop::EventLoop()
 
 #endif
         VERIFY(rc == 0);
+#ifdef __serenity__
+        s_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        VERIFY(s_epoll_fd >= 0);
+        epoll_event wake_event {};
+        wake_event.events = EPOLLIN;
+        wake_event.data.fd = s_wake_pipe_fds[0];
+        rc = epoll_ctl(s_epoll_fd, EPOLL_CTL_ADD, s_wake_pipe_fds[0], &wake_event);
+        VERIFY(rc == 0);
+#endif
         s_event_loop_stack->append(this);
 
 #ifdef __serenity__
@@ -600,6 +624,12 @@ void EventLoop::notify_forked(ForkEvent event)
         s_event_loop_stack->clear();
         s_timers->clear();
         s_notifiers->clear();
+#ifdef __serenity__
+        // The epoll instance is shared with the parent, so get a new one along with the next main loop.
+        s_notifiers_by_fd->clear();
+        close(s_epoll_fd);
+        s_epoll_fd = -1;
+#endif
         if (auto* info = signals_info<false>()) {
             info->signal_handlers.clear();
             info->next_signal_id = 0;
@@ -617,6 +647,10 @@ void EventLoop::notify_forked(ForkEvent event)
 
 void EventLoop::wait_for_event(WaitMode mode)
 {
+#ifdef __serenity__
+    epoll_event ready_events[64];
+retry:
+#else
     fd_set rfds;
     fd_set wfds;
 retry:
@@ -641,6 +675,7 @@ retry:
         if (notifier->event_mask() & Notifier::Exceptional)
             VERIFY_NOT_REACHED();
     }
+#endif
 
     bool queued_events_is_empty;
     {
@@ -669,7 +704,12 @@ retry:
     }
 
 try_select_again:
+#ifdef __serenity__
+    int timeout_ms = should_wait_forever ? -1 : timeout.tv_sec * 1000 + (timeout.tv_usec + 999) / 1000;
+    int marked_fd_count = epoll_wait(s_epoll_fd, ready_events, array_size(ready_events), timeout_ms);
+#else
     int marked_fd_count = select(max_fd + 1, &rfds, &wfds, nullptr, should_wait_forever ? nullptr : &timeout);
+#endif
     if (marked_fd_count < 0) {
         int saved_errno = errno;
         if (saved_errno == EINTR) {
@@ -683,7 +723,16 @@ try_select_again:
         // Blow up, similar to Core::safe_syscall.
         VERIFY_NOT_REACHED();
     }
-    if (FD_ISSET(s_wake_pipe_fds[0], &rfds)) {
+#ifdef __serenity__
+    bool wake_pipe_is_readable = false;
+    for (int i = 0; i < marked_fd_count; ++i) {
+        if (ready_events[i].data.fd == s_wake_pipe_fds[0])
+            wake_pipe_is_readable = true;
+    }
+#else
+    bool wake_pipe_is_readable = FD_ISSET(s_wake_pipe_fds[0], &rfds);
+#endif
+    if (wake_pipe_is_readable) {
         int wake_events[8];
         auto nread = read(s_wake_pipe_fds[0], wake_events, sizeof(wake_events));
         if (nread < 0) {
@@ -736,6 +785,23 @@ try_select_again:
     if (!marked_fd_count)
         return;
 
+#ifdef __serenity__
+    for (int i = 0; i < marked_fd_count; ++i) {
+        int fd = ready_events[i].data.fd;
+        auto it = s_notifiers_by_fd->find(fd);
+        if (it == s_notifiers_by_fd->end())
+            continue;
+        // Errors and hangups are picked up by whoever reads or writes next, just like with select().
+        bool is_readable = ready_events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR);
+        bool is_writable = ready_events[i].events & (EPOLLOUT | EPOLLERR);
+        for (auto* notifier : it->value) {
+            if (is_readable && (notifier->event_mask() & Notifier::Event::Read))
+                post_event(*notifier, make<NotifierReadEvent>(fd));
+            if (is_writable && (notifier->event_mask() & Notifier::Event::Write))
+                post_event(*notifier, make<NotifierWriteEvent>(fd));
+        }
+    }
+#else
     for (auto& notifier : *s_notifiers) {
         if (FD_ISSET(notifier->fd(), &rfds)) {
             if (notifier->event_mask() & Notifier::Event::Read)
@@ -746,6 +812,7 @@ try_select_again:
                 post_event(*notifier, make<NotifierWriteEvent>(notifier->fd()));
         }
     }
+#endif
 }
 
 bool EventLoopTimer::has_expired(const timeval& now) const
@@ -806,14 +873,73 @@ bool EventLoop::unregister_timer(int timer_id)
     return true;
 }
 
+#ifdef __serenity__
+static void update_epoll_interest(int fd)
+{
+    if (s_epoll_fd < 0)
+        return;
+
+    u32 events = 0;
+    if (auto it = s_notifiers_by_fd->find(fd); it != s_notifiers_by_fd->end()) {
+        for (auto* notifier : it->value) {
+            if (notifier->event_mask() & Notifier::Read)
+                events |= EPOLLIN;
+            if (notifier->event_mask() & Notifier::Write)
+                events |= EPOLLOUT;
+            if (notifier->event_mask() & Notifier::Exceptional)
+                VERIFY_NOT_REACHED();
+        }
+    }
+
+    if (!events) {
+        // This fails if the fd has been closed already, but closing it dropped the interest as well.
+        (void)epoll_ctl(s_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        return;
+    }
+
+    epoll_event event {};
+    event.events = events;
+    event.data.fd = fd;
+    int rc = epoll_ctl(s_epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    if (rc < 0 && errno == ENOENT)
+        rc = epoll_ctl(s_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    if (rc < 0)
+        dbgln("Core::EventLoop: Failed to watch fd {}: {}", fd, strerror(errno));
+}
+#endif
+
 void EventLoop::register_notifier(Badge<Notifier>, Notifier& notifier)
 {
     s_notifiers->set(&notifier);
+#ifdef __serenity__
+    auto& notifiers = s_notifiers_by_fd->ensure(notifier.fd());
+    if (!notifiers.contains_slow(&notifier))
+        notifiers.append(&notifier);
+    update_epoll_interest(notifier.fd());
+#endif
 }
 
 void EventLoop::unregister_notifier(Badge<Notifier>, Notifier& notifier)
 {
     s_notifiers->remove(&notifier);
+#ifdef __serenity__
+    auto it = s_notifiers_by_fd->find(notifier.fd());
+    if (it == s_notifiers_by_fd->end())
+        return;
+    it->value.remove_first_matching([&](auto* entry) { return entry == &notifier; });
+    if (it->value.is_empty())
+        s_notifiers_by_fd->remove(it);
+    update_epoll_interest(notifier.fd());
+#endif
+}
+
+void EventLoop::notifier_event_mask_changed(Badge<Notifier>, Notifier& notifier)
+{
+    if (!s_notifiers->contains(&notifier))
+        return;
+#ifdef __serenity__
+    update_epoll_interest(notifier.fd());
+#endif
 }
 
 void EventLoop::wake()
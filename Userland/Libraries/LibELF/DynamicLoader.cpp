@@ -370,13 +370,14 @@ void DynamicLoader::load_program_headers()
     FlatPtr data_segment_offset_from_text = ph_data_base - ph_text_base;
 
     // Finally, we make an anonymous mapping for the data segment. Contents are then copied from the file.
+    // We're about to write to all of it, so have the kernel populate it up front instead of faulting in every page.
     auto* data_segment_address = (u8*)text_segment_begin + data_segment_offset_from_text;
 
     auto* data_segment = (u8*)mmap_with_name(
         data_segment_address,
         data_segment_size,
         PROT_READ | PROT_WRITE,
-        MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED,
+        MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED | MAP_POPULATE,
         0,
         0,
         String::formatted("{}: .data", m_filename).characters());
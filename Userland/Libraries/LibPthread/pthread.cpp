@@ -187,18 +187,7 @@ int pthread_mutex_lock(pthread_mutex_t* mutex)
 
 int pthread_mutex_trylock(pthread_mutex_t* mutex)
 {
-    auto& atomic = reinterpret_cast<Atomic<u32>&>(mutex->lock);
-    u32 expected = false;
-    if (!atomic.compare_exchange_strong(expected, true, AK::memory_order_acq_rel)) {
-        if (mutex->type == PTHREAD_MUTEX_RECURSIVE && mutex->owner == pthread_self()) {
-            mutex->level++;
-            return 0;
-        }
-        return EBUSY;
-    }
-    mutex->owner = pthread_self();
-    mutex->level = 0;
-    return 0;
+    return __pthread_mutex_trylock(mutex);
 }
 
 int pthread_mutex_unlock(pthread_mutex_t* mutex)
@@ -209,6 +198,7 @@ int pthread_mutex_unlock(pthread_mutex_t* mutex)
 int pthread_mutexattr_init(pthread_mutexattr_t* attr)
 {
     attr->type = PTHREAD_MUTEX_NORMAL;
+    attr->protocol = PTHREAD_PRIO_NONE;
     return 0;
 }
 
@@ -227,6 +217,24 @@ int pthread_mutexattr_settype(pthread_mutexattr_t* attr, int type)
     return 0;
 }
 
+int pthread_mutexattr_getprotocol(const pthread_mutexattr_t* attr, int* protocol)
+{
+    if (!attr || !protocol)
+        return EINVAL;
+    *protocol = attr->protocol;
+    return 0;
+}
+
+int pthread_mutexattr_setprotocol(pthread_mutexattr_t* attr, int protocol)
+{
+    if (!attr)
+        return EINVAL;
+    if (protocol != PTHREAD_PRIO_NONE && protocol != PTHREAD_PRIO_INHERIT)
+        return EINVAL;
+    attr->protocol = protocol;
+    return 0;
+}
+
 int pthread_attr_init(pthread_attr_t* attributes)
 {
     auto* impl = new PthreadAttrImpl {};
@@ -451,6 +459,8 @@ int pthread_cond_init(pthread_cond_t* cond, const pthread_condattr_t* attr)
     cond->value = 0;
     cond->previous = 0;
     cond->clockid = attr ? attr->clockid : CLOCK_MONOTONIC_COARSE;
+    cond->waiters = 0;
+    cond->mutex = nullptr;
     return 0;
 }
 
@@ -476,9 +486,18 @@ static int cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct
 {
     u32 value = cond->value;
     cond->previous = value;
+    // Remember the mutex, so that pthread_cond_broadcast() can move us over to it.
+    // Both of these are only touched while holding the mutex.
+    ++cond->waiters;
+    cond->mutex = mutex;
     pthread_mutex_unlock(mutex);
     int rc = futex_wait(cond->value, value, abstime);
-    pthread_mutex_lock(mutex);
+    // We may have been requeued onto the mutex along with other waiters, so make sure
+    // they will be woken up when we unlock it.
+    __pthread_mutex_lock_pessimistic_np(mutex);
+    // Once nobody is waiting anymore, the mutex may be destroyed, so forget about it.
+    if (--cond->waiters == 0)
+        cond->mutex = nullptr;
     return rc;
 }
 
@@ -524,6 +543,25 @@ int pthread_cond_broadcast(pthread_cond_t* cond)
 {
     u32 value = cond->previous + 1;
     cond->value = value;
+
+    // Waking up every waiter just to have all but one of them go right back to sleep on
+    // the mutex is wasteful. If we're holding the mutex, wake up one waiter and move the
+    // others over to the mutex instead. They will be woken one by one as it gets unlocked.
+    // Waiters only set and clear cond->mutex while holding it, so it can't go away while we hold it.
+    auto* mutex = cond->mutex;
+    if (mutex && mutex->protocol == PTHREAD_PRIO_NONE && mutex->owner == pthread_self()) {
+        // Make sure our pthread_mutex_unlock() wakes up whoever we requeue.
+        reinterpret_cast<Atomic<u32>&>(mutex->lock).store(2, AK::memory_order_relaxed);
+        int saved_errno = errno;
+        int rc = futex(&cond->value, FUTEX_CMP_REQUEUE, 1, (const timespec*)INT32_MAX, &mutex->lock, value);
+        bool value_changed = rc < 0 && errno == EAGAIN;
+        errno = saved_errno;
+        if (!value_changed)
+            return 0;
+        // Someone signalled the condition without holding the mutex in the meantime,
+        // so fall back to waking everyone up.
+    }
+
     int rc = futex(&cond->value, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
     VERIFY(rc >= 0);
     return 0;
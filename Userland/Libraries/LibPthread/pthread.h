@@ -81,9 +81,12 @@ int pthread_setschedparam(pthread_t thread, int policy, const struct sched_param
 #define PTHREAD_MUTEX_DEFAULT PTHREAD_MUTEX_NORMAL
 #define PTHREAD_MUTEX_INITIALIZER __PTHREAD_MUTEX_INITIALIZER
 
-#define PTHREAD_COND_INITIALIZER     \
-    {                                \
-        0, 0, CLOCK_MONOTONIC_COARSE \
+#define PTHREAD_PRIO_NONE __PTHREAD_PRIO_NONE
+#define PTHREAD_PRIO_INHERIT __PTHREAD_PRIO_INHERIT
+
+#define PTHREAD_COND_INITIALIZER              \
+    {                                         \
+        0, 0, CLOCK_MONOTONIC_COARSE, 0, NULL \
     }
 
 // FIXME: Actually implement this!
@@ -123,6 +126,8 @@ int pthread_detach(pthread_t);
 int pthread_equal(pthread_t, pthread_t);
 int pthread_mutexattr_init(pthread_mutexattr_t*);
 int pthread_mutexattr_settype(pthread_mutexattr_t*, int);
+int pthread_mutexattr_getprotocol(const pthread_mutexattr_t*, int*);
+int pthread_mutexattr_setprotocol(pthread_mutexattr_t*, int);
 int pthread_mutexattr_destroy(pthread_mutexattr_t*);
 
 int pthread_setname_np(pthread_t, const char*);
@@ -37,13 +37,17 @@
 #include <LibCore/FileStream.h>
 #include <LibCore/MimeData.h>
 #include <LibHTTP/HttpRequest.h>
+#include <errno.h>
 #include <stdio.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
 namespace WebServer {
 
+static constexpr size_t sendfile_chunk_size = 1 * MiB;
+
 Client::Client(NonnullRefPtr<Core::TCPSocket> socket, const String& root, Core::Object* parent)
     : Core::Object(parent)
     , m_socket(socket)
@@ -127,12 +131,10 @@ void Client::handle_request(ReadonlyBytes raw_request)
         return;
     }
 
-    Core::InputFileStream stream { file };
-
-    send_response(stream, request, Core::guess_mime_type_based_on_filename(real_path));
+    send_file_response(*file, request, Core::guess_mime_type_based_on_filename(real_path));
 }
 
-void Client::send_response(InputStream& response, const HTTP::HttpRequest& request, const String& content_type)
+void Client::send_response_header(const HTTP::HttpRequest& request, const String& content_type)
 {
     StringBuilder builder;
     builder.append("HTTP/1.0 200 OK\r\n");
@@ -146,7 +148,42 @@ void Client::send_response(InputStream& response, const HTTP::HttpRequest& reque
 
     m_socket->write(builder.to_string());
     log_response(200, request);
+}
 
+void Client::send_file_response(Core::File& file, const HTTP::HttpRequest& request, const String& content_type)
+{
+    send_response_header(request, content_type);
+
+    // Let the kernel move the file contents into the socket directly, instead of copying everything through our address space.
+    bool sent_anything = false;
+    for (;;) {
+        auto nsent = sendfile(m_socket->fd(), file.fd(), nullptr, sendfile_chunk_size);
+        if (nsent < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EINVAL && !sent_anything)
+                break;
+            perror("sendfile");
+            return;
+        }
+        if (nsent == 0)
+            return;
+        sent_anything = true;
+    }
+
+    // sendfile() only works on regular files, so fall back to copying for anything else.
+    Core::InputFileStream stream { file };
+    send_response_body(stream);
+}
+
+void Client::send_response(InputStream& response, const HTTP::HttpRequest& request, const String& content_type)
+{
+    send_response_header(request, content_type);
+    send_response_body(response);
+}
+
+void Client::send_response_body(InputStream& response)
+{
     char buffer[PAGE_SIZE];
     do {
         auto size = response.read({ buffer, sizeof(buffer) });
@@ -26,6 +26,7 @@
 
 #pragma once
 
+#include <LibCore/Forward.h>
 #include <LibCore/Object.h>
 #include <LibCore/TCPSocket.h>
 #include <LibHTTP/Forward.h>
@@ -43,6 +44,9 @@ private:
 
     void handle_request(ReadonlyBytes);
     void send_response(InputStream&, const HTTP::HttpRequest&, const String& content_type);
+    void send_file_response(Core::File&, const HTTP::HttpRequest&, const String& content_type);
+    void send_response_header(const HTTP::HttpRequest&, const String& content_type);
+    void send_response_body(InputStream&);
     void send_redirect(StringView redirect, const HTTP::HttpRequest& request);
     void send_error_response(unsigned code, const StringView& message, const HTTP::HttpRequest&);
     void die();
@@ -108,7 +108,7 @@ void Screen::on_change_resolution(int pitch, int new_physical_width, int new_phy
         int rc = fb_get_size_in_bytes(m_framebuffer_fd, &m_size_in_bytes);
         VERIFY(rc == 0);
 
-        m_framebuffer = (Gfx::RGBA32*)mmap(nullptr, m_size_in_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_framebuffer_fd, 0);
+        m_framebuffer = (Gfx::RGBA32*)mmap(nullptr, m_size_in_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_HUGE, m_framebuffer_fd, 0);
         VERIFY(m_framebuffer && m_framebuffer != (void*)-1);
     }
 
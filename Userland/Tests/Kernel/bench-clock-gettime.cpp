@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Types.h>
+#include <Kernel/API/Syscall.h>
+#include <LibCore/ArgsParser.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include <time.h>
+
+// Compares clock_gettime() as LibC implements it, reading the kernel's time page, with the
+// clock_gettime syscall, and checks that the two agree and that neither goes backwards.
+
+struct Clock {
+    const char* name;
+    clockid_t id;
+};
+
+static constexpr Clock clocks[] = {
+    { "MONOTONIC", CLOCK_MONOTONIC },
+    { "MONOTONIC_COARSE", CLOCK_MONOTONIC_COARSE },
+    { "MONOTONIC_RAW", CLOCK_MONOTONIC_RAW },
+    { "REALTIME", CLOCK_REALTIME },
+    { "REALTIME_COARSE", CLOCK_REALTIME_COARSE },
+};
+
+static i64 to_nanoseconds(const timespec& ts)
+{
+    return ts.tv_sec * 1'000'000'000ll + ts.tv_nsec;
+}
+
+static int clock_gettime_syscall(clockid_t clock_id, timespec* ts)
+{
+    return syscall(SC_clock_gettime, clock_id, ts);
+}
+
+static bool run(const Clock& clock, int iterations)
+{
+    timespec ts;
+    i64 previous = 0;
+    timespec start;
+    clock_gettime_syscall(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; ++i) {
+        if (clock_gettime(clock.id, &ts) < 0) {
+            perror("clock_gettime");
+            return false;
+        }
+        auto now = to_nanoseconds(ts);
+        if (now < previous) {
+            fprintf(stderr, "%s went backwards by %lld ns\n", clock.name, previous - now);
+            return false;
+        }
+        previous = now;
+    }
+    timespec middle;
+    clock_gettime_syscall(CLOCK_MONOTONIC, &middle);
+    for (int i = 0; i < iterations; ++i) {
+        if (clock_gettime_syscall(clock.id, &ts) < 0) {
+            perror("clock_gettime syscall");
+            return false;
+        }
+    }
+    timespec end;
+    clock_gettime_syscall(CLOCK_MONOTONIC, &end);
+
+    // Both ways of reading the clock must agree, give or take a timer tick.
+    timespec from_libc;
+    clock_gettime(clock.id, &from_libc);
+    auto difference = to_nanoseconds(from_libc) - to_nanoseconds(ts);
+    if (difference < 0 || difference > 100'000'000) {
+        fprintf(stderr, "%s: the time page and the syscall are %lld ns apart\n", clock.name, difference);
+        return false;
+    }
+
+    double libc_ns = (double)(to_nanoseconds(middle) - to_nanoseconds(start)) / iterations;
+    double syscall_ns = (double)(to_nanoseconds(end) - to_nanoseconds(middle)) / iterations;
+    printf("%-18s libc %8.1f ns/call, syscall %8.1f ns/call\n", clock.name, libc_ns, syscall_ns);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 1'000'000;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(iterations, "Number of calls to time for each clock", "iterations", 'n', "count");
+    args_parser.parse(argc, argv);
+
+    if (iterations <= 0) {
+        fprintf(stderr, "The number of iterations must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    for (auto& clock : clocks) {
+        if (!run(clock, iterations))
+            return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Types.h>
+#include <LibCore/ArgsParser.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures contended pthread mutexes, both plain and priority inheritance ones, and
+// pthread_cond_broadcast() waking up a crowd of waiters that all need the same mutex.
+
+static i64 monotonic_nanoseconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1'000'000'000ll + ts.tv_nsec;
+}
+
+static bool spawn_and_join(int thread_count, void* (*entry)(void*), void* argument)
+{
+    auto* threads = (pthread_t*)calloc(thread_count, sizeof(pthread_t));
+    for (int i = 0; i < thread_count; ++i) {
+        if (pthread_create(&threads[i], nullptr, entry, argument) != 0) {
+            perror("pthread_create");
+            return false;
+        }
+    }
+    for (int i = 0; i < thread_count; ++i)
+        pthread_join(threads[i], nullptr);
+    free(threads);
+    return true;
+}
+
+struct MutexBenchmark {
+    pthread_mutex_t mutex;
+    int iterations;
+    volatile u64 counter;
+};
+
+static void* mutex_worker(void* argument)
+{
+    auto& benchmark = *(MutexBenchmark*)argument;
+    for (int i = 0; i < benchmark.iterations; ++i) {
+        pthread_mutex_lock(&benchmark.mutex);
+        benchmark.counter = benchmark.counter + 1;
+        pthread_mutex_unlock(&benchmark.mutex);
+    }
+    return nullptr;
+}
+
+static bool run_mutex_benchmark(const char* name, int protocol, int thread_count, int iterations)
+{
+    MutexBenchmark benchmark;
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setprotocol(&attributes, protocol);
+    pthread_mutex_init(&benchmark.mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    benchmark.iterations = iterations;
+    benchmark.counter = 0;
+
+    auto start = monotonic_nanoseconds();
+    if (!spawn_and_join(thread_count, mutex_worker, &benchmark))
+        return false;
+    auto elapsed = monotonic_nanoseconds() - start;
+
+    u64 expected = (u64)thread_count * iterations;
+    if (benchmark.counter != expected) {
+        fprintf(stderr, "%s mutex: counted to %llu instead of %llu\n", name, benchmark.counter, expected);
+        return false;
+    }
+    printf("%-8s mutex: %d threads, %llu lock/unlock pairs in %lld ms (%.1f ns/pair)\n",
+        name, thread_count, expected, elapsed / 1'000'000, (double)elapsed / expected);
+    pthread_mutex_destroy(&benchmark.mutex);
+    return true;
+}
+
+struct BroadcastBenchmark {
+    pthread_mutex_t mutex;
+    pthread_cond_t round_started;
+    pthread_cond_t all_arrived;
+    int waiter_count;
+    int round;
+    int arrived;
+};
+
+static void* broadcast_waiter(void* argument)
+{
+    auto& benchmark = *(BroadcastBenchmark*)argument;
+    pthread_mutex_lock(&benchmark.mutex);
+    int seen_round = 0;
+    for (;;) {
+        while (benchmark.round == seen_round)
+            pthread_cond_wait(&benchmark.round_started, &benchmark.mutex);
+        seen_round = benchmark.round;
+        if (seen_round < 0)
+            break;
+        if (++benchmark.arrived == benchmark.waiter_count)
+            pthread_cond_signal(&benchmark.all_arrived);
+    }
+    pthread_mutex_unlock(&benchmark.mutex);
+    return nullptr;
+}
+
+static bool run_broadcast_benchmark(int waiter_count, int rounds)
+{
+    BroadcastBenchmark benchmark;
+    pthread_mutex_init(&benchmark.mutex, nullptr);
+    pthread_cond_init(&benchmark.round_started, nullptr);
+    pthread_cond_init(&benchmark.all_arrived, nullptr);
+    benchmark.waiter_count = waiter_count;
+    benchmark.round = 0;
+    benchmark.arrived = 0;
+
+    auto* threads = (pthread_t*)calloc(waiter_count, sizeof(pthread_t));
+    for (int i = 0; i < waiter_count; ++i) {
+        if (pthread_create(&threads[i], nullptr, broadcast_waiter, &benchmark) != 0) {
+            perror("pthread_create");
+            return false;
+        }
+    }
+
+    auto start = monotonic_nanoseconds();
+    for (int round = 1; round <= rounds; ++round) {
+        pthread_mutex_lock(&benchmark.mutex);
+        benchmark.arrived = 0;
+        benchmark.round = round;
+        pthread_cond_broadcast(&benchmark.round_started);
+        while (benchmark.arrived < waiter_count)
+            pthread_cond_wait(&benchmark.all_arrived, &benchmark.mutex);
+        pthread_mutex_unlock(&benchmark.mutex);
+    }
+    auto elapsed = monotonic_nanoseconds() - start;
+
+    pthread_mutex_lock(&benchmark.mutex);
+    benchmark.round = -1;
+    pthread_cond_broadcast(&benchmark.round_started);
+    pthread_mutex_unlock(&benchmark.mutex);
+    for (int i = 0; i < waiter_count; ++i)
+        pthread_join(threads[i], nullptr);
+    free(threads);
+
+    printf("broadcast: %d waiters, %d rounds in %lld ms (%.1f us/round)\n",
+        waiter_count, rounds, elapsed / 1'000'000, (double)elapsed / rounds / 1000);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int thread_count = 8;
+    int iterations = 100'000;
+    int rounds = 1000;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(thread_count, "Number of contending threads", "threads", 't', "count");
+    args_parser.add_option(iterations, "Number of lock/unlock pairs per thread", "iterations", 'n', "count");
+    args_parser.add_option(rounds, "Number of broadcast rounds", "rounds", 'r', "count");
+    args_parser.parse(argc, argv);
+
+    if (thread_count <= 0 || iterations <= 0 || rounds <= 0) {
+        fprintf(stderr, "All counts must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!run_mutex_benchmark("plain", PTHREAD_PRIO_NONE, thread_count, iterations))
+        return EXIT_FAILURE;
+    if (!run_mutex_benchmark("pi", PTHREAD_PRIO_INHERIT, thread_count, iterations))
+        return EXIT_FAILURE;
+    if (!run_broadcast_benchmark(thread_count, rounds))
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
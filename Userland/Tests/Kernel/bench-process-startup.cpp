@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <LibCore/ArgsParser.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures how long it takes to spawn a program and wait for it to exit.
+// Most of that time is spent by the dynamic loader faulting in the program
+// and its libraries, so this is a good way to see the effect of changes to
+// how file-backed mappings are paged in.
+
+static double elapsed_milliseconds(const timespec& start, const timespec& end)
+{
+    return (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1'000'000.0;
+}
+
+int main(int argc, char** argv)
+{
+    const char* program = "/bin/true";
+    int iterations = 20;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(iterations, "Number of times to start the program", "iterations", 'n', "count");
+    args_parser.add_positional_argument(program, "Program to start (defaults to /bin/true)", "program", Core::ArgsParser::Required::No);
+    args_parser.parse(argc, argv);
+
+    if (iterations <= 0) {
+        fprintf(stderr, "The number of iterations must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    double total = 0;
+    double fastest = 0;
+    double slowest = 0;
+    for (int i = 0; i < iterations; ++i) {
+        timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        pid_t pid;
+        const char* child_argv[] = { program, nullptr };
+        if ((errno = posix_spawn(&pid, program, nullptr, nullptr, const_cast<char**>(child_argv), environ))) {
+            perror("posix_spawn");
+            return EXIT_FAILURE;
+        }
+        int status;
+        if (waitpid(pid, &status, 0) < 0) {
+            perror("waitpid");
+            return EXIT_FAILURE;
+        }
+
+        timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double elapsed = elapsed_milliseconds(start, end);
+        total += elapsed;
+        if (i == 0 || elapsed < fastest)
+            fastest = elapsed;
+        if (i == 0 || elapsed > slowest)
+            slowest = elapsed;
+    }
+
+    printf("%s: %d runs, average %.2f ms, fastest %.2f ms, slowest %.2f ms\n", program, iterations, total / iterations, fastest, slowest);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Types.h>
+#include <LibCore/ArgsParser.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures how fast a file can be sent over a TCP connection on the loopback adapter,
+// once with a read()/write() loop through a userspace buffer and once with sendfile().
+
+static constexpr const char* file_path = "/tmp/bench-sendfile.dat";
+
+static double elapsed_seconds(const timespec& start, const timespec& end)
+{
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1'000'000'000.0;
+}
+
+static bool create_test_file(size_t size)
+{
+    int fd = open(file_path, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+    if (fd < 0) {
+        perror("open");
+        return false;
+    }
+    u8 buffer[PAGE_SIZE];
+    for (size_t i = 0; i < sizeof(buffer); ++i)
+        buffer[i] = i;
+    for (size_t written = 0; written < size; written += sizeof(buffer)) {
+        if (write(fd, buffer, sizeof(buffer)) != sizeof(buffer)) {
+            perror("write");
+            close(fd);
+            return false;
+        }
+    }
+    close(fd);
+    return true;
+}
+
+// Forks a child that connects to us and reads everything we send. Returns the connected socket.
+static int connect_to_sink(pid_t& sink_pid)
+{
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t address_length = sizeof(address);
+    if (bind(listen_fd, (const sockaddr*)&address, sizeof(address)) < 0 || listen(listen_fd, 1) < 0
+        || getsockname(listen_fd, (sockaddr*)&address, &address_length) < 0) {
+        perror("bind/listen");
+        close(listen_fd);
+        return -1;
+    }
+
+    sink_pid = fork();
+    if (sink_pid < 0) {
+        perror("fork");
+        close(listen_fd);
+        return -1;
+    }
+    if (sink_pid == 0) {
+        close(listen_fd);
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+            perror("connect");
+            _exit(1);
+        }
+        static u8 buffer[64 * KiB];
+        while (read(fd, buffer, sizeof(buffer)) > 0)
+            ;
+        _exit(0);
+    }
+
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0)
+        perror("accept");
+    close(listen_fd);
+    return fd;
+}
+
+static bool send_with_read_write(int socket_fd, int file_fd, size_t size)
+{
+    u8 buffer[PAGE_SIZE];
+    size_t total = 0;
+    while (total < size) {
+        auto nread = read(file_fd, buffer, sizeof(buffer));
+        if (nread <= 0)
+            return false;
+        if (write(socket_fd, buffer, nread) != nread)
+            return false;
+        total += nread;
+    }
+    return true;
+}
+
+static bool send_with_sendfile(int socket_fd, int file_fd, size_t size)
+{
+    size_t total = 0;
+    while (total < size) {
+        auto nsent = sendfile(socket_fd, file_fd, nullptr, size - total);
+        if (nsent <= 0)
+            return false;
+        total += nsent;
+    }
+    return true;
+}
+
+static bool run(const char* name, bool (*send)(int, int, size_t), size_t size)
+{
+    int file_fd = open(file_path, O_RDONLY);
+    if (file_fd < 0) {
+        perror("open");
+        return false;
+    }
+    pid_t sink_pid;
+    int socket_fd = connect_to_sink(sink_pid);
+    if (socket_fd < 0) {
+        close(file_fd);
+        return false;
+    }
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool ok = send(socket_fd, file_fd, size);
+    close(socket_fd);
+    waitpid(sink_pid, nullptr, 0);
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    close(file_fd);
+
+    if (!ok) {
+        fprintf(stderr, "%s: sending failed: %s\n", name, strerror(errno));
+        return false;
+    }
+    double seconds = elapsed_seconds(start, end);
+    printf("%-12s %zu MiB in %.3f s, %.2f MiB/s\n", name, static_cast<size_t>(size / MiB), seconds, size / MiB / seconds);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int size_in_mib = 32;
+    int iterations = 3;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(size_in_mib, "Size of the file to send in MiB", "size", 's', "MiB");
+    args_parser.add_option(iterations, "Number of times to send the file each way", "iterations", 'n', "count");
+    args_parser.parse(argc, argv);
+
+    if (size_in_mib <= 0 || iterations <= 0) {
+        fprintf(stderr, "The size and the number of iterations must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t size = size_in_mib * MiB;
+    if (!create_test_file(size))
+        return EXIT_FAILURE;
+
+    bool ok = true;
+    for (int i = 0; i < iterations && ok; ++i) {
+        ok = run("read/write", send_with_read_write, size)
+            && run("sendfile", send_with_sendfile, size);
+    }
+
+    unlink(file_path);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
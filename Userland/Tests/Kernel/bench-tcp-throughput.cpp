@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <AK/JsonArray.h>
+#include <AK/JsonObject.h>
+#include <AK/String.h>
+#include <AK/Types.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCore/File.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures TCP goodput over the loopback adapter, optionally with simulated packet loss, and
+// checks that every byte arrives intact and in order. The connection's congestion control state
+// is taken from /proc/net/tcp just before it is closed.
+
+static constexpr const char* packet_loss_path = "/proc/sys/loopback_packet_loss_permille";
+
+static u8 pattern_byte(size_t offset)
+{
+    return offset % 251;
+}
+
+static double elapsed_seconds(const timespec& start, const timespec& end)
+{
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1'000'000'000.0;
+}
+
+static bool set_packet_loss(int permille)
+{
+    auto file = Core::File::construct(packet_loss_path);
+    if (!file->open(Core::IODevice::WriteOnly)) {
+        fprintf(stderr, "%s: %s\n", packet_loss_path, file->error_string());
+        return false;
+    }
+    return file->write(String::number(permille));
+}
+
+// Forks a child that connects to us and verifies everything we send. Returns the connected socket.
+static int connect_to_sink(pid_t& sink_pid, size_t expected_size)
+{
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t address_length = sizeof(address);
+    if (bind(listen_fd, (const sockaddr*)&address, sizeof(address)) < 0 || listen(listen_fd, 1) < 0
+        || getsockname(listen_fd, (sockaddr*)&address, &address_length) < 0) {
+        perror("bind/listen");
+        close(listen_fd);
+        return -1;
+    }
+
+    sink_pid = fork();
+    if (sink_pid < 0) {
+        perror("fork");
+        close(listen_fd);
+        return -1;
+    }
+    if (sink_pid == 0) {
+        close(listen_fd);
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+            perror("connect");
+            _exit(1);
+        }
+        static u8 buffer[64 * KiB];
+        size_t received = 0;
+        for (;;) {
+            auto nread = read(fd, buffer, sizeof(buffer));
+            if (nread < 0) {
+                perror("read");
+                _exit(1);
+            }
+            if (nread == 0)
+                break;
+            for (ssize_t i = 0; i < nread; ++i) {
+                if (buffer[i] != pattern_byte(received + i)) {
+                    fprintf(stderr, "sink: corrupted byte at offset %zu\n", received + i);
+                    _exit(1);
+                }
+            }
+            received += nread;
+        }
+        if (received != expected_size) {
+            fprintf(stderr, "sink: received %zu bytes, expected %zu\n", received, expected_size);
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0)
+        perror("accept");
+    close(listen_fd);
+    return fd;
+}
+
+static void print_connection_state(int socket_fd)
+{
+    sockaddr_in address {};
+    socklen_t address_length = sizeof(address);
+    if (getsockname(socket_fd, (sockaddr*)&address, &address_length) < 0)
+        return;
+    auto local_port = ntohs(address.sin_port);
+
+    auto file = Core::File::construct("/proc/net/tcp");
+    if (!file->open(Core::IODevice::ReadOnly))
+        return;
+    auto json = JsonValue::from_string(file->read_all());
+    if (!json.has_value() || !json.value().is_array())
+        return;
+    json.value().as_array().for_each([&](auto& value) {
+        auto& socket = value.as_object();
+        // The accepted socket and the sink's socket share the port number; ours is the one sending.
+        if (socket.get("local_port").to_u32() != local_port || socket.get("bytes_out").to_u32() < socket.get("bytes_in").to_u32())
+            return;
+        printf("    cwnd=%u ssthresh=%u srtt=%ums rto=%ums retransmissions=%u sack=%s wscale=%u/%u\n",
+            socket.get("congestion_window").to_u32(),
+            socket.get("slow_start_threshold").to_u32(),
+            socket.get("srtt_ms").to_u32(),
+            socket.get("rto_ms").to_u32(),
+            socket.get("retransmissions").to_u32(),
+            socket.get("sack_permitted").to_bool() ? "yes" : "no",
+            socket.get("send_window_scale").to_u32(),
+            socket.get("receive_window_scale").to_u32());
+    });
+}
+
+static bool run(size_t size, int loss_permille)
+{
+    if (!set_packet_loss(loss_permille))
+        return false;
+
+    pid_t sink_pid;
+    int socket_fd = connect_to_sink(sink_pid, size);
+    if (socket_fd < 0)
+        return false;
+
+    static u8 buffer[64 * KiB];
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t sent = 0;
+    bool ok = true;
+    while (sent < size) {
+        size_t chunk = min(sizeof(buffer), size - sent);
+        for (size_t i = 0; i < chunk; ++i)
+            buffer[i] = pattern_byte(sent + i);
+        auto nwritten = write(socket_fd, buffer, chunk);
+        if (nwritten <= 0) {
+            perror("write");
+            ok = false;
+            break;
+        }
+        sent += nwritten;
+    }
+    print_connection_state(socket_fd);
+    close(socket_fd);
+    int status = 0;
+    waitpid(sink_pid, &status, 0);
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    set_packet_loss(0);
+
+    if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "loss %d/1000: transfer failed\n", loss_permille);
+        return false;
+    }
+    double seconds = elapsed_seconds(start, end);
+    printf("loss %3d/1000: %zu MiB in %.3f s, %.2f MiB/s\n", loss_permille, static_cast<size_t>(size / MiB), seconds, size / MiB / seconds);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int size_in_mib = 16;
+    int loss_permille = -1;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(size_in_mib, "Amount of data to send in MiB", "size", 's', "MiB");
+    args_parser.add_option(loss_permille, "Only run with this many packets out of 1000 dropped", "loss", 'l', "permille");
+    args_parser.parse(argc, argv);
+
+    if (size_in_mib <= 0 || loss_permille > 1000) {
+        fprintf(stderr, "The size must be positive and the loss rate at most 1000\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t size = size_in_mib * MiB;
+    if (loss_permille >= 0)
+        return run(size, loss_permille) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    for (int loss : { 0, 1, 10, 50 }) {
+        if (!run(size, loss))
+            return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
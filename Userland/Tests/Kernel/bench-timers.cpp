@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Types.h>
+#include <LibCore/ArgsParser.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Arms and cancels a large number of kernel timers through alarm(), while other threads keep
+// timers with long timeouts queued, and checks that short sleeps never wake up early.
+
+static i64 monotonic_nanoseconds(clockid_t clock_id = CLOCK_MONOTONIC)
+{
+    timespec ts;
+    clock_gettime(clock_id, &ts);
+    return ts.tv_sec * 1'000'000'000ll + ts.tv_nsec;
+}
+
+[[noreturn]] static void* sleeper(void*)
+{
+    for (;;)
+        poll(nullptr, 0, 1000 + rand() % 60'000);
+}
+
+static bool arm_and_cancel(int iterations)
+{
+    alarm(0);
+    auto start = monotonic_nanoseconds();
+    unsigned previous_seconds = 0;
+    for (int i = 0; i < iterations; ++i) {
+        unsigned seconds = 1000 + (unsigned)(rand() % 100'000);
+        // Every call cancels the previous alarm and arms a new one.
+        unsigned remaining = alarm(seconds);
+        if (previous_seconds != 0 && (remaining == 0 || remaining > previous_seconds)) {
+            fprintf(stderr, "alarm() returned %u, but the previous alarm was set to %u seconds\n", remaining, previous_seconds);
+            return false;
+        }
+        previous_seconds = seconds;
+    }
+    alarm(0);
+    auto elapsed = monotonic_nanoseconds() - start;
+    printf("Armed and cancelled %d timers in %lld ms (%.1f ns/timer)\n", iterations, elapsed / 1'000'000, (double)elapsed / iterations);
+    return true;
+}
+
+static bool check_sleep_accuracy(int iterations)
+{
+    constexpr i64 sleep_ns = 10'000'000;
+    i64 worst_lateness = 0;
+    for (int i = 0; i < iterations; ++i) {
+        // usleep() measures against the coarse clock, so that's the one that must not be early.
+        auto start = monotonic_nanoseconds(CLOCK_MONOTONIC_COARSE);
+        usleep(sleep_ns / 1000);
+        auto slept = monotonic_nanoseconds(CLOCK_MONOTONIC_COARSE) - start;
+        if (slept < sleep_ns) {
+            fprintf(stderr, "A %lld ms sleep woke up %lld ns early\n", sleep_ns / 1'000'000, sleep_ns - slept);
+            return false;
+        }
+        if (slept - sleep_ns > worst_lateness)
+            worst_lateness = slept - sleep_ns;
+    }
+    printf("%d sleeps of %lld ms, worst wakeup was %lld us late\n", iterations, sleep_ns / 1'000'000, worst_lateness / 1000);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 100'000;
+    int sleeper_count = 64;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(iterations, "Number of timers to arm and cancel", "iterations", 'n', "count");
+    args_parser.add_option(sleeper_count, "Number of threads keeping a timer queued", "sleepers", 's', "count");
+    args_parser.parse(argc, argv);
+
+    if (iterations <= 0 || sleeper_count < 0) {
+        fprintf(stderr, "Invalid number of iterations or sleepers\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(time(nullptr));
+
+    for (int i = 0; i < sleeper_count; ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, nullptr, sleeper, nullptr) != 0) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+    // Give the sleepers a chance to queue their timers.
+    usleep(100'000);
+
+    // Exiting takes the sleepers down with us.
+    if (!arm_and_cancel(iterations) || !check_sleep_accuracy(20))
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
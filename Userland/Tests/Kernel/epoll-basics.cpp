@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Format.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+static int s_failures = 0;
+
+#define EXPECT(condition)                                                     \
+    do {                                                                      \
+        if (!(condition)) {                                                   \
+            fprintf(stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            ++s_failures;                                                     \
+        }                                                                     \
+    } while (0)
+
+static int wait_for(int epfd, epoll_event* events, int max_events = 4)
+{
+    return epoll_wait(epfd, events, max_events, 0);
+}
+
+static void test_level_triggered()
+{
+    int fds[2];
+    EXPECT(pipe(fds) == 0);
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    EXPECT(epfd >= 0);
+
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.u32 = 1234;
+    EXPECT(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &event) == 0);
+    EXPECT(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &event) < 0);
+
+    epoll_event ready[4];
+    EXPECT(wait_for(epfd, ready) == 0);
+
+    EXPECT(write(fds[1], "x", 1) == 1);
+    EXPECT(wait_for(epfd, ready) == 1);
+    EXPECT(ready[0].data.u32 == 1234);
+    EXPECT(ready[0].events & EPOLLIN);
+
+    // Level-triggered interests keep reporting until the data is consumed.
+    EXPECT(wait_for(epfd, ready) == 1);
+    char c;
+    EXPECT(read(fds[0], &c, 1) == 1);
+    EXPECT(wait_for(epfd, ready) == 0);
+
+    close(epfd);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_edge_triggered_and_oneshot()
+{
+    int fds[2];
+    EXPECT(pipe(fds) == 0);
+    int epfd = epoll_create1(0);
+
+    epoll_event event {};
+    event.events = EPOLLIN | EPOLLET;
+    EXPECT(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &event) == 0);
+
+    epoll_event ready[4];
+    EXPECT(write(fds[1], "x", 1) == 1);
+    EXPECT(wait_for(epfd, ready) == 1);
+    EXPECT(wait_for(epfd, ready) == 0);
+    EXPECT(write(fds[1], "y", 1) == 1);
+    EXPECT(wait_for(epfd, ready) == 1);
+
+    event.events = EPOLLIN | EPOLLONESHOT;
+    EXPECT(epoll_ctl(epfd, EPOLL_CTL_MOD, fds[0], &event) == 0);
+    EXPECT(wait_for(epfd, ready) == 1);
+    EXPECT(wait_for(epfd, ready) == 0);
+
+    // Re-arming a one-shot interest reports the still pending data again.
+    EXPECT(epoll_ctl(epfd, EPOLL_CTL_MOD, fds[0], &event) == 0);
+    EXPECT(wait_for(epfd, ready) == 1);
+
+    EXPECT(epoll_ctl(epfd, EPOLL_CTL_DEL, fds[0], nullptr) == 0);
+    EXPECT(wait_for(epfd, ready) == 0);
+
+    close(epfd);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_close_removes_interest()
+{
+    int fds[2];
+    EXPECT(pipe(fds) == 0);
+    int epfd = epoll_create1(0);
+
+    epoll_event event {};
+    event.events = EPOLLIN;
+    EXPECT(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &event) == 0);
+    EXPECT(write(fds[1], "x", 1) == 1);
+    close(fds[0]);
+
+    epoll_event ready[4];
+    EXPECT(wait_for(epfd, ready) == 0);
+
+    close(epfd);
+    close(fds[1]);
+}
+
+static void test_close_removes_interest_of_duplicated_fd()
+{
+    int fds[2];
+    EXPECT(pipe(fds) == 0);
+    int epfd = epoll_create1(0);
+    int read_fd = dup(fds[0]);
+    EXPECT(read_fd >= 0);
+
+    epoll_event event {};
+    event.events = EPOLLIN;
+    EXPECT(epoll_ctl(epfd, EPOLL_CTL_ADD, read_fd, &event) == 0);
+    EXPECT(write(fds[1], "x", 1) == 1);
+
+    // fds[0] keeps the pipe open, but the fd we registered is gone.
+    close(read_fd);
+    epoll_event ready[4];
+    EXPECT(wait_for(epfd, ready) == 0);
+
+    // A new fd with the same number can be added right away.
+    EXPECT(dup2(fds[0], read_fd) == read_fd);
+    EXPECT(epoll_ctl(epfd, EPOLL_CTL_ADD, read_fd, &event) == 0);
+    EXPECT(wait_for(epfd, ready) == 1);
+
+    close(epfd);
+    close(read_fd);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_blocking_wait()
+{
+    int fds[2];
+    EXPECT(pipe(fds) == 0);
+    int epfd = epoll_create1(0);
+
+    epoll_event event {};
+    event.events = EPOLLIN;
+    EXPECT(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &event) == 0);
+
+    epoll_event ready[4];
+    EXPECT(epoll_wait(epfd, ready, 4, 50) == 0);
+
+    if (fork() == 0) {
+        usleep(20000);
+        write(fds[1], "x", 1);
+        _exit(0);
+    }
+    EXPECT(epoll_wait(epfd, ready, 4, -1) == 1);
+
+    close(epfd);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+int main()
+{
+    test_level_triggered();
+    test_edge_triggered_and_oneshot();
+    test_close_removes_interest();
+    test_close_removes_interest_of_duplicated_fd();
+    test_blocking_wait();
+
+    if (s_failures) {
+        outln("FAIL: {} expectation(s) failed", s_failures);
+        return 1;
+    }
+    outln("PASS");
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Types.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr size_t large_page_size = 2 * MiB;
+static constexpr size_t mapping_size = 4 * large_page_size;
+
+static u32* word_at_page(void* base, size_t page)
+{
+    return reinterpret_cast<u32*>(reinterpret_cast<u8*>(base) + page * PAGE_SIZE);
+}
+
+static bool verify_pattern(void* base, size_t first_page, size_t page_count)
+{
+    for (size_t page = first_page; page < first_page + page_count; ++page) {
+        if (*word_at_page(base, page) != page) {
+            fprintf(stderr, "Page %zu has %#x, expected %#zx\n", page, *word_at_page(base, page), page);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    constexpr size_t page_count = mapping_size / PAGE_SIZE;
+    constexpr size_t pages_per_large_page = large_page_size / PAGE_SIZE;
+
+    auto* map = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGE, 0, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    if ((FlatPtr)map % large_page_size) {
+        fprintf(stderr, "MAP_HUGE mapping at %p is not aligned to a large page\n", map);
+        return 1;
+    }
+
+    printf("Testing writes to large pages\n");
+    for (size_t page = 0; page < page_count; ++page)
+        *word_at_page(map, page) = page;
+    if (!verify_pattern(map, 0, page_count))
+        return 1;
+
+    printf("Testing mprotect inside a large page\n");
+    if (mprotect(word_at_page(map, pages_per_large_page + 1), PAGE_SIZE, PROT_READ) < 0) {
+        perror("mprotect");
+        return 1;
+    }
+    if (!verify_pattern(map, 0, page_count))
+        return 1;
+    *word_at_page(map, pages_per_large_page) = pages_per_large_page;
+    *word_at_page(map, pages_per_large_page + 2) = pages_per_large_page + 2;
+
+    printf("Testing munmap inside a large page\n");
+    if (munmap(word_at_page(map, 2 * pages_per_large_page + 3), 2 * PAGE_SIZE) < 0) {
+        perror("munmap");
+        return 1;
+    }
+    if (!verify_pattern(map, 0, 2 * pages_per_large_page + 3) || !verify_pattern(map, 2 * pages_per_large_page + 5, pages_per_large_page - 5)) {
+        return 1;
+    }
+
+    printf("Testing fork of a large page mapping\n");
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        *word_at_page(map, 0) = 0xdeadbeef;
+        _exit(verify_pattern(map, 1, pages_per_large_page - 1) ? 0 : 1);
+    }
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0) {
+        perror("waitpid");
+        return 1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !verify_pattern(map, 0, pages_per_large_page)) {
+        fprintf(stderr, "Child saw unexpected contents, or its writes leaked into the parent\n");
+        return 1;
+    }
+
+    printf("PASS\n");
+    return 0;
+}
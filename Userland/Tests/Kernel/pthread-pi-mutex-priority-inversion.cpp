@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Atomic.h>
+#include <AK/Types.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// A low priority thread holds a priority inheritance mutex that a high priority thread
+// wants, while medium priority threads keep every processor busy. The owner has to be
+// boosted above the spinners to ever get to unlock the mutex before they give up.
+
+static constexpr int low_priority = 10;
+static constexpr int medium_priority = 30;
+static constexpr int high_priority = 50;
+static constexpr i64 spin_nanoseconds = 3'000'000'000ll;
+
+static pthread_mutex_t s_mutex;
+static Atomic<bool> s_owner_has_mutex { false };
+static Atomic<int> s_spinners_running { 0 };
+static Atomic<bool> s_stop_spinning { false };
+static int s_spinner_count;
+
+static i64 monotonic_nanoseconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1'000'000'000ll + ts.tv_nsec;
+}
+
+static bool set_own_priority(int priority)
+{
+    sched_param param { priority };
+    if (sched_setparam(gettid(), &param) < 0) {
+        perror("sched_setparam");
+        return false;
+    }
+    return true;
+}
+
+static void* owner(void*)
+{
+    set_own_priority(low_priority);
+    pthread_mutex_lock(&s_mutex);
+    s_owner_has_mutex = true;
+    // Only let go once the spinners have taken over all processors, so that we
+    // have to be scheduled ahead of them to get here.
+    while (s_spinners_running.load() < s_spinner_count)
+        ;
+    pthread_mutex_unlock(&s_mutex);
+    return nullptr;
+}
+
+static void* spinner(void*)
+{
+    set_own_priority(medium_priority);
+    ++s_spinners_running;
+    auto deadline = monotonic_nanoseconds() + spin_nanoseconds;
+    while (!s_stop_spinning.load() && monotonic_nanoseconds() < deadline)
+        ;
+    return nullptr;
+}
+
+int main()
+{
+    if (!set_own_priority(high_priority))
+        return EXIT_FAILURE;
+
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setprotocol(&attributes, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&s_mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+
+    s_spinner_count = max(1l, sysconf(_SC_NPROCESSORS_ONLN));
+
+    pthread_t owner_thread;
+    if (pthread_create(&owner_thread, nullptr, owner, nullptr) != 0) {
+        perror("pthread_create");
+        return EXIT_FAILURE;
+    }
+    while (!s_owner_has_mutex.load())
+        usleep(1000);
+
+    auto* spinner_threads = (pthread_t*)calloc(s_spinner_count, sizeof(pthread_t));
+    for (int i = 0; i < s_spinner_count; ++i) {
+        if (pthread_create(&spinner_threads[i], nullptr, spinner, nullptr) != 0) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+    while (s_spinners_running.load() < s_spinner_count)
+        usleep(1000);
+
+    auto start = monotonic_nanoseconds();
+    pthread_mutex_lock(&s_mutex);
+    auto elapsed = monotonic_nanoseconds() - start;
+    pthread_mutex_unlock(&s_mutex);
+
+    s_stop_spinning = true;
+    for (int i = 0; i < s_spinner_count; ++i)
+        pthread_join(spinner_threads[i], nullptr);
+    pthread_join(owner_thread, nullptr);
+    free(spinner_threads);
+    pthread_mutex_destroy(&s_mutex);
+
+    printf("Got the mutex after %lld ms with %d spinners\n", elapsed / 1'000'000, s_spinner_count);
+    if (elapsed >= spin_nanoseconds / 2) {
+        printf("FAIL: The owner didn't run ahead of the spinners\n");
+        return EXIT_FAILURE;
+    }
+    printf("PASS\n");
+    return EXIT_SUCCESS;
+}
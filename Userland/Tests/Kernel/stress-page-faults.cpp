@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Atomic.h>
+#include <AK/Vector.h>
+#include <LibCore/ArgsParser.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures how well anonymous zero-fill faults scale across threads of the
+// same process. In the "private" pass every thread faults in pages of its own
+// mapping; in the "shared" pass all threads fault in disjoint slices of a
+// freshly mapped region, so they contend on the same VMObject. Faults on different
+// VMObjects don't share any locks, so the private rate should grow with the
+// number of processors.
+
+static constexpr size_t pages_per_thread = 256;
+static constexpr size_t pages_per_shared_slice = 4 * pages_per_thread;
+
+struct Worker {
+    pthread_t thread;
+    u8* shared_slice { nullptr };
+    u64 faults { 0 };
+    bool failed { false };
+};
+
+static Atomic<bool> s_stop { false };
+
+static void touch_pages(u8* base, Worker& worker)
+{
+    for (size_t i = 0; i < pages_per_thread; ++i)
+        *reinterpret_cast<volatile u8*>(base + i * PAGE_SIZE) = 1;
+    worker.faults += pages_per_thread;
+}
+
+static void* private_worker_main(void* arg)
+{
+    auto& worker = *reinterpret_cast<Worker*>(arg);
+    while (!s_stop.load(AK::MemoryOrder::memory_order_relaxed)) {
+        void* region = mmap(nullptr, pages_per_thread * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (region == MAP_FAILED) {
+            perror("mmap");
+            worker.failed = true;
+            break;
+        }
+        touch_pages(reinterpret_cast<u8*>(region), worker);
+        if (munmap(region, pages_per_thread * PAGE_SIZE) < 0) {
+            perror("munmap");
+            worker.failed = true;
+            break;
+        }
+    }
+    return nullptr;
+}
+
+static void* shared_worker_main(void* arg)
+{
+    auto& worker = *reinterpret_cast<Worker*>(arg);
+    for (size_t i = 0; i < pages_per_shared_slice; i += pages_per_thread)
+        touch_pages(worker.shared_slice + i * PAGE_SIZE, worker);
+    return nullptr;
+}
+
+static double elapsed_seconds(const timespec& start, const timespec& end)
+{
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1'000'000'000.0;
+}
+
+static bool run_private_workers(int thread_count, int duration, double& faults_per_second)
+{
+    Vector<Worker> workers;
+    workers.resize(thread_count);
+    s_stop.store(false);
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (auto& worker : workers) {
+        if (pthread_create(&worker.thread, nullptr, private_worker_main, &worker) != 0) {
+            perror("pthread_create");
+            return false;
+        }
+    }
+
+    sleep(duration);
+    s_stop.store(true);
+
+    u64 faults = 0;
+    bool failed = false;
+    for (auto& worker : workers) {
+        pthread_join(worker.thread, nullptr);
+        faults += worker.faults;
+        failed |= worker.failed;
+    }
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    faults_per_second = faults / elapsed_seconds(start, end);
+    return !failed;
+}
+
+static bool run_shared_workers(int thread_count, int duration, double& faults_per_second)
+{
+    size_t region_size = thread_count * pages_per_shared_slice * PAGE_SIZE;
+    u64 faults = 0;
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    timespec now = start;
+
+    // Every round maps a fresh region and lets all threads fault in their own slice of it.
+    while (elapsed_seconds(start, now) < duration) {
+        void* region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (region == MAP_FAILED) {
+            perror("mmap");
+            return false;
+        }
+
+        Vector<Worker> workers;
+        workers.resize(thread_count);
+        for (int i = 0; i < thread_count; ++i) {
+            workers[i].shared_slice = reinterpret_cast<u8*>(region) + i * pages_per_shared_slice * PAGE_SIZE;
+            if (pthread_create(&workers[i].thread, nullptr, shared_worker_main, &workers[i]) != 0) {
+                perror("pthread_create");
+                return false;
+            }
+        }
+        for (auto& worker : workers) {
+            pthread_join(worker.thread, nullptr);
+            faults += worker.faults;
+        }
+
+        if (munmap(region, region_size) < 0) {
+            perror("munmap");
+            return false;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+
+    faults_per_second = faults / elapsed_seconds(start, now);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int duration = 5;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(max_threads, "Maximum number of threads (defaults to the processor count)", "threads", 't', "number");
+    args_parser.add_option(duration, "Seconds to run each pass", "duration", 'd', "seconds");
+    args_parser.parse(argc, argv);
+
+    if (max_threads <= 0 || duration <= 0) {
+        fprintf(stderr, "Both the number of threads and the duration must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("threads  private faults/sec  shared faults/sec\n");
+    for (int thread_count = 1; thread_count <= max_threads; thread_count++) {
+        double private_faults_per_second = 0;
+        double shared_faults_per_second = 0;
+        if (!run_private_workers(thread_count, duration, private_faults_per_second))
+            return EXIT_FAILURE;
+        if (!run_shared_workers(thread_count, duration, shared_faults_per_second))
+            return EXIT_FAILURE;
+        printf("%7d  %18.0f  %17.0f\n", thread_count, private_faults_per_second, shared_faults_per_second);
+    }
+
+    return EXIT_SUCCESS;
+}
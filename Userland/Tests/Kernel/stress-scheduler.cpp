@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Atomic.h>
+#include <AK/Vector.h>
+#include <LibCore/ArgsParser.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures context switch throughput by having pairs of threads ping-pong a
+// byte through two pipes. Each round trip forces two context switches, so
+// with N pairs running we expect to keep up to N processors busy.
+
+struct PingPongPair {
+    int ping_fds[2] { -1, -1 };
+    int pong_fds[2] { -1, -1 };
+    pthread_t pinger;
+    pthread_t ponger;
+    u64 round_trips { 0 };
+};
+
+static Atomic<bool> s_stop { false };
+
+static void* pinger_main(void* arg)
+{
+    auto& pair = *reinterpret_cast<PingPongPair*>(arg);
+    char byte = 'x';
+    while (!s_stop.load(AK::MemoryOrder::memory_order_relaxed)) {
+        if (write(pair.ping_fds[1], &byte, 1) != 1)
+            break;
+        if (read(pair.pong_fds[0], &byte, 1) != 1)
+            break;
+        pair.round_trips++;
+    }
+    // Let the ponger know we're done.
+    close(pair.ping_fds[1]);
+    return nullptr;
+}
+
+static void* ponger_main(void* arg)
+{
+    auto& pair = *reinterpret_cast<PingPongPair*>(arg);
+    char byte;
+    while (read(pair.ping_fds[0], &byte, 1) == 1) {
+        if (write(pair.pong_fds[1], &byte, 1) != 1)
+            break;
+    }
+    close(pair.pong_fds[1]);
+    return nullptr;
+}
+
+static double elapsed_seconds(const timespec& start, const timespec& end)
+{
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1'000'000'000.0;
+}
+
+static bool run_pairs(int pair_count, int duration, double& switches_per_second)
+{
+    Vector<PingPongPair> pairs;
+    pairs.resize(pair_count);
+    s_stop.store(false);
+
+    for (auto& pair : pairs) {
+        if (pipe(pair.ping_fds) < 0 || pipe(pair.pong_fds) < 0) {
+            perror("pipe");
+            return false;
+        }
+    }
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (auto& pair : pairs) {
+        if (pthread_create(&pair.ponger, nullptr, ponger_main, &pair) != 0 || pthread_create(&pair.pinger, nullptr, pinger_main, &pair) != 0) {
+            perror("pthread_create");
+            return false;
+        }
+    }
+
+    sleep(duration);
+    s_stop.store(true);
+
+    u64 round_trips = 0;
+    for (auto& pair : pairs) {
+        pthread_join(pair.pinger, nullptr);
+        pthread_join(pair.ponger, nullptr);
+        close(pair.ping_fds[0]);
+        close(pair.pong_fds[0]);
+        round_trips += pair.round_trips;
+    }
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    switches_per_second = (round_trips * 2) / elapsed_seconds(start, end);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int max_pairs = sysconf(_SC_NPROCESSORS_ONLN);
+    int duration = 5;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(max_pairs, "Maximum number of ping-pong thread pairs (defaults to the processor count)", "pairs", 'p', "number");
+    args_parser.add_option(duration, "Seconds to run each pass", "duration", 'd', "seconds");
+    args_parser.parse(argc, argv);
+
+    if (max_pairs <= 0 || duration <= 0) {
+        fprintf(stderr, "Both the number of pairs and the duration must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("pairs  switches/sec  switches/sec/pair\n");
+    for (int pair_count = 1; pair_count <= max_pairs; pair_count++) {
+        double switches_per_second = 0;
+        if (!run_pairs(pair_count, duration, switches_per_second))
+            return EXIT_FAILURE;
+        printf("%5d  %12.0f  %17.0f\n", pair_count, switches_per_second, switches_per_second / pair_count);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2021, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Atomic.h>
+#include <AK/Vector.h>
+#include <LibCore/ArgsParser.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures how well the syscalls that don't take the big process lock scale
+// across threads of the same process. Every thread hammers its own file
+// descriptors with read/write/lseek, maps and unmaps anonymous memory and
+// reads the clock. With the big lock held for every syscall the aggregate
+// rate stays flat as threads are added; without it, it should grow with the
+// number of processors.
+
+struct Worker {
+    pthread_t thread;
+    int zero_fd { -1 };
+    int null_fd { -1 };
+    u64 syscalls { 0 };
+    bool failed { false };
+};
+
+static Atomic<bool> s_stop { false };
+
+static void* worker_main(void* arg)
+{
+    auto& worker = *reinterpret_cast<Worker*>(arg);
+    char buffer[64];
+    while (!s_stop.load(AK::MemoryOrder::memory_order_relaxed)) {
+        memset(buffer, 0xff, sizeof(buffer));
+        if (read(worker.zero_fd, buffer, sizeof(buffer)) != sizeof(buffer) || buffer[0] != 0 || buffer[sizeof(buffer) - 1] != 0) {
+            perror("read");
+            worker.failed = true;
+            break;
+        }
+        if (write(worker.null_fd, buffer, sizeof(buffer)) != sizeof(buffer)) {
+            perror("write");
+            worker.failed = true;
+            break;
+        }
+        if (lseek(worker.zero_fd, 0, SEEK_SET) < 0) {
+            perror("lseek");
+            worker.failed = true;
+            break;
+        }
+        timespec now;
+        if (clock_gettime(CLOCK_MONOTONIC, &now) < 0) {
+            perror("clock_gettime");
+            worker.failed = true;
+            break;
+        }
+        void* page = mmap(nullptr, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (page == MAP_FAILED) {
+            perror("mmap");
+            worker.failed = true;
+            break;
+        }
+        *reinterpret_cast<volatile char*>(page) = 1;
+        if (munmap(page, PAGE_SIZE) < 0) {
+            perror("munmap");
+            worker.failed = true;
+            break;
+        }
+        worker.syscalls += 6;
+    }
+    return nullptr;
+}
+
+static double elapsed_seconds(const timespec& start, const timespec& end)
+{
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1'000'000'000.0;
+}
+
+static bool run_workers(int thread_count, int duration, double& syscalls_per_second)
+{
+    Vector<Worker> workers;
+    workers.resize(thread_count);
+    s_stop.store(false);
+
+    for (auto& worker : workers) {
+        worker.zero_fd = open("/dev/zero", O_RDONLY);
+        worker.null_fd = open("/dev/null", O_WRONLY);
+        if (worker.zero_fd < 0 || worker.null_fd < 0) {
+            perror("open");
+            return false;
+        }
+    }
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (auto& worker : workers) {
+        if (pthread_create(&worker.thread, nullptr, worker_main, &worker) != 0) {
+            perror("pthread_create");
+            return false;
+        }
+    }
+
+    sleep(duration);
+    s_stop.store(true);
+
+    u64 syscalls = 0;
+    bool failed = false;
+    for (auto& worker : workers) {
+        pthread_join(worker.thread, nullptr);
+        close(worker.zero_fd);
+        close(worker.null_fd);
+        syscalls += worker.syscalls;
+        failed |= worker.failed;
+    }
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    syscalls_per_second = syscalls / elapsed_seconds(start, end);
+    return !failed;
+}
+
+int main(int argc, char** argv)
+{
+    int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int duration = 5;
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(max_threads, "Maximum number of threads (defaults to the processor count)", "threads", 't', "number");
+    args_parser.add_option(duration, "Seconds to run each pass", "duration", 'd', "seconds");
+    args_parser.parse(argc, argv);
+
+    if (max_threads <= 0 || duration <= 0) {
+        fprintf(stderr, "Both the number of threads and the duration must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("threads  syscalls/sec  syscalls/sec/thread\n");
+    for (int thread_count = 1; thread_count <= max_threads; thread_count++) {
+        double syscalls_per_second = 0;
+        if (!run_workers(thread_count, duration, syscalls_per_second))
+            return EXIT_FAILURE;
+        printf("%7d  %12.0f  %19.0f\n", thread_count, syscalls_per_second, syscalls_per_second / thread_count);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -35,6 +35,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 struct Result {
@@ -59,11 +60,15 @@ static Result average_result(const Vector<Result>& results)
 
 static void exit_with_usage(int rc)
 {
-    warnln("Usage: disk_benchmark [-h] [-d directory] [-t time_per_benchmark] [-f file_size1,file_size2,...] [-b block_size1,block_size2,...]");
+    warnln("Usage: disk_benchmark [-h] [-c] [-r] [-i queue_depth1,queue_depth2,...] [-d directory] [-t time_per_benchmark] [-f file_size1,file_size2,...] [-b block_size1,block_size2,...]");
     exit(rc);
 }
 
 static Optional<Result> benchmark(const String& filename, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache);
+static Optional<u64> benchmark_sequential_read(const String& filename, int file_size, int block_size, ByteBuffer& buffer);
+static Optional<u64> benchmark_random_read(const String& filename, int file_size, int queue_depth, int time_per_benchmark);
+static Optional<bool> read_ahead_enabled();
+static bool set_read_ahead_enabled(bool);
 
 int main(int argc, char** argv)
 {
@@ -72,9 +77,11 @@ int main(int argc, char** argv)
     Vector<size_t> file_sizes;
     Vector<size_t> block_sizes;
     bool allow_cache = false;
+    bool compare_read_ahead = false;
+    Vector<int> queue_depths;
 
     int opt;
-    while ((opt = getopt(argc, argv, "chd:t:f:b:")) != -1) {
+    while ((opt = getopt(argc, argv, "chri:d:t:f:b:")) != -1) {
         switch (opt) {
         case 'h':
             exit_with_usage(0);
@@ -82,6 +89,13 @@ int main(int argc, char** argv)
         case 'c':
             allow_cache = true;
             break;
+        case 'r':
+            compare_read_ahead = true;
+            break;
+        case 'i':
+            for (const auto& depth : String(optarg).split(','))
+                queue_depths.append(atoi(depth.characters()));
+            break;
         case 'd':
             directory = optarg;
             break;
@@ -110,6 +124,64 @@ int main(int argc, char** argv)
 
     auto filename = String::formatted("{}/disk_benchmark.tmp", directory);
 
+    if (!queue_depths.is_empty()) {
+        for (auto file_size : file_sizes) {
+            for (auto queue_depth : queue_depths) {
+                if (queue_depth <= 0)
+                    continue;
+
+                outln("Running: file_size={} queue_depth={} random 4 KiB reads", file_size, queue_depth);
+                auto iops = benchmark_random_read(filename, file_size, queue_depth, time_per_benchmark);
+                if (!iops.has_value())
+                    return 1;
+                outln("Finished: queue_depth={} iops={}", queue_depth, iops.value());
+                sleep(1);
+            }
+        }
+        return 0;
+    }
+
+    if (compare_read_ahead) {
+        auto was_enabled = read_ahead_enabled();
+        if (!was_enabled.has_value())
+            return 1;
+        auto restore_read_ahead = ScopeGuard([&] {
+            set_read_ahead_enabled(was_enabled.value());
+        });
+
+        for (auto file_size : file_sizes) {
+            for (auto block_size : block_sizes) {
+                if (block_size > file_size)
+                    continue;
+
+                auto buffer = ByteBuffer::create_uninitialized(block_size);
+                for (bool read_ahead : { false, true }) {
+                    if (!set_read_ahead_enabled(read_ahead))
+                        return 1;
+
+                    outln("Running: file_size={} block_size={} read_ahead={}", file_size, block_size, read_ahead ? "on" : "off");
+                    u64 total_read_bps = 0;
+                    size_t runs = 0;
+                    Core::ElapsedTimer timer;
+                    timer.start();
+                    while (timer.elapsed() < time_per_benchmark * 1000) {
+                        out(".");
+                        fflush(stdout);
+                        auto read_bps = benchmark_sequential_read(filename, file_size, block_size, buffer);
+                        if (!read_bps.has_value())
+                            return 1;
+                        total_read_bps += read_bps.value();
+                        ++runs;
+                        usleep(100);
+                    }
+                    outln("Finished: runs={} time={}ms read_ahead={} read_bps={}", runs, timer.elapsed(), read_ahead ? "on" : "off", runs ? total_read_bps / runs : 0);
+                    sleep(1);
+                }
+            }
+        }
+        return 0;
+    }
+
     for (auto file_size : file_sizes) {
         for (auto block_size : block_sizes) {
             if (block_size > file_size)
@@ -195,3 +267,189 @@ Optional<Result> benchmark(const String& filename, int file_size, int block_size
     result.read_bps = (u64)(timer.elapsed() ? (file_size / timer.elapsed()) : file_size) * 1000;
     return result;
 }
+
+Optional<bool> read_ahead_enabled()
+{
+    int fd = open("/proc/sys/read_ahead", O_RDONLY);
+    if (fd < 0) {
+        perror("open /proc/sys/read_ahead");
+        return {};
+    }
+    char value = 0;
+    auto nread = read(fd, &value, 1);
+    close(fd);
+    if (nread != 1) {
+        perror("read /proc/sys/read_ahead");
+        return {};
+    }
+    return value == '1';
+}
+
+bool set_read_ahead_enabled(bool enabled)
+{
+    int fd = open("/proc/sys/read_ahead", O_WRONLY);
+    if (fd < 0) {
+        perror("open /proc/sys/read_ahead");
+        return false;
+    }
+    char value = enabled ? '1' : '0';
+    auto nwritten = write(fd, &value, 1);
+    close(fd);
+    if (nwritten != 1) {
+        perror("write /proc/sys/read_ahead");
+        return false;
+    }
+    return true;
+}
+
+Optional<u64> benchmark_sequential_read(const String& filename, int file_size, int block_size, ByteBuffer& buffer)
+{
+    // Write the file with O_DIRECT so that none of it ends up in the block cache,
+    // then read it back sequentially through the cache.
+    int fd = open(filename.characters(), O_CREAT | O_TRUNC | O_WRONLY | O_DIRECT, 0644);
+    if (fd == -1) {
+        perror("open");
+        exit(1);
+    }
+
+    auto unlink_guard = ScopeGuard([filename] {
+        if (unlink(filename.characters()) < 0)
+            perror("unlink");
+    });
+
+    for (ssize_t j = 0; j < file_size; j += block_size) {
+        if (write(fd, buffer.data(), block_size) < 0) {
+            perror("write");
+            close(fd);
+            return {};
+        }
+    }
+    if (close(fd) < 0)
+        perror("close");
+
+    fd = open(filename.characters(), O_RDONLY);
+    if (fd == -1) {
+        perror("open");
+        exit(1);
+    }
+
+    auto fd_cleanup = ScopeGuard([fd] {
+        if (close(fd) < 0)
+            perror("close");
+    });
+
+    Core::ElapsedTimer timer;
+    timer.start();
+    ssize_t total_read = 0;
+    while (total_read < file_size) {
+        auto nread = read(fd, buffer.data(), block_size);
+        if (nread < 0) {
+            perror("read");
+            return {};
+        }
+        if (nread == 0)
+            break;
+        total_read += nread;
+    }
+
+    return (u64)(timer.elapsed() ? (file_size / timer.elapsed()) : file_size) * 1000;
+}
+
+Optional<u64> benchmark_random_read(const String& filename, int file_size, int queue_depth, int time_per_benchmark)
+{
+    // Keep queue_depth reads outstanding by running that many processes, each doing
+    // blocking O_DIRECT reads of random 4 KiB blocks, and count how many complete.
+    constexpr int block_size = 4096;
+    int block_count = file_size / block_size;
+    if (block_count == 0) {
+        warnln("File size {} is too small for 4 KiB reads", file_size);
+        return {};
+    }
+
+    auto buffer = ByteBuffer::create_zeroed(block_size);
+    int fd = open(filename.characters(), O_CREAT | O_TRUNC | O_WRONLY | O_DIRECT, 0644);
+    if (fd == -1) {
+        perror("open");
+        exit(1);
+    }
+
+    auto unlink_guard = ScopeGuard([filename] {
+        if (unlink(filename.characters()) < 0)
+            perror("unlink");
+    });
+
+    for (int i = 0; i < block_count; ++i) {
+        if (write(fd, buffer.data(), block_size) < 0) {
+            perror("write");
+            close(fd);
+            return {};
+        }
+    }
+    if (close(fd) < 0)
+        perror("close");
+
+    int pipe_fds[2];
+    if (pipe(pipe_fds) < 0) {
+        perror("pipe");
+        return {};
+    }
+
+    Core::ElapsedTimer timer;
+    timer.start();
+
+    Vector<pid_t> workers;
+    for (int i = 0; i < queue_depth; ++i) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            break;
+        }
+        if (pid == 0) {
+            close(pipe_fds[0]);
+            int worker_fd = open(filename.characters(), O_RDONLY | O_DIRECT);
+            if (worker_fd < 0) {
+                perror("open");
+                _exit(1);
+            }
+            u64 completed = 0;
+            Core::ElapsedTimer worker_timer;
+            worker_timer.start();
+            while (worker_timer.elapsed() < time_per_benchmark * 1000) {
+                off_t offset = (off_t)(arc4random_uniform(block_count)) * block_size;
+                if (pread(worker_fd, buffer.data(), block_size, offset) != block_size) {
+                    perror("pread");
+                    _exit(1);
+                }
+                ++completed;
+            }
+            if (write(pipe_fds[1], &completed, sizeof(completed)) != sizeof(completed))
+                _exit(1);
+            _exit(0);
+        }
+        workers.append(pid);
+    }
+    close(pipe_fds[1]);
+
+    u64 total_completed = 0;
+    bool failed = workers.size() != (size_t)queue_depth;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        u64 completed = 0;
+        if (read(pipe_fds[0], &completed, sizeof(completed)) != sizeof(completed)) {
+            failed = true;
+            break;
+        }
+        total_completed += completed;
+    }
+    close(pipe_fds[0]);
+
+    for (auto pid : workers) {
+        int status = 0;
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = true;
+    }
+    if (failed)
+        return {};
+
+    auto elapsed = timer.elapsed();
+    return elapsed ? total_completed * 1000 / elapsed : total_completed;
+}
@@ -80,6 +80,9 @@ int main(int argc, char** argv)
             auto packets_out = if_object.get("packets_out").to_u32();
             auto bytes_out = if_object.get("bytes_out").to_u32();
             auto mtu = if_object.get("mtu").to_u32();
+            auto interrupts = if_object.get("interrupts").to_u32();
+            auto interrupts_per_second = if_object.get("interrupts_per_second").to_u32();
+            auto packets_per_batch = if_object.get("packets_per_batch").to_u32();
 
             printf("%s:\n", name.characters());
             printf("\tmac: %s\n", mac_address.characters());
@@ -90,6 +93,7 @@ int main(int argc, char** argv)
             printf("\tRX: %u packets %u bytes (%s)\n", packets_in, bytes_in, human_readable_size(bytes_in).characters());
             printf("\tTX: %u packets %u bytes (%s)\n", packets_out, bytes_out, human_readable_size(bytes_out).characters());
             printf("\tMTU: %u\n", mtu);
+            printf("\tIRQs: %u (%u/s), %u packets per receive batch\n", interrupts, interrupts_per_second, packets_per_batch);
             printf("\n");
         });
     } else {